@@ -16,6 +16,7 @@
 #include "access/amapi.h"
 #include "access/generic_xlog.h"
 #include "catalog/index.h"
+#include "commands/vacuum.h"
 #include "storage/lmgr.h"
 #include "miscadmin.h"
 #include "storage/bufmgr.h"
@@ -120,6 +121,9 @@ blhandler(PG_FUNCTION_ARGS)
 	amroutine->amclusterable = false;
 	amroutine->ampredlocks = false;
 	amroutine->amcanparallel = false;
+	amroutine->amusemaintenanceworkmem = false;
+	amroutine->amparallelvacuumoptions =
+		VACUUM_OPTION_PARALLEL_BULKDEL | VACUUM_OPTION_PARALLEL_CLEANUP;
 	amroutine->amcaninclude = false;
 	amroutine->amkeytype = InvalidOid;
 
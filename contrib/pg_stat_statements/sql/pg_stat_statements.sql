@@ -253,6 +253,15 @@ SELECT query, calls, rows FROM pg_stat_statements ORDER BY query COLLATE "C";
 SELECT pg_stat_statements_reset(0,0,0);
 SELECT query, calls, rows FROM pg_stat_statements ORDER BY query COLLATE "C";
 
+--
+-- JIT code cache counters
+--
+SET jit = off;
+SELECT 1 AS "JIT";
+SELECT query, jit_cache_hits, jit_cache_misses FROM pg_stat_statements
+  WHERE query LIKE '%JIT%' ORDER BY query COLLATE "C";
+RESET jit;
+
 --
 -- cleanup
 --
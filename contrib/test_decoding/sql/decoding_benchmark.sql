@@ -0,0 +1,39 @@
+-- predictability
+SET synchronous_commit = on;
+
+CREATE TABLE bench_tab (a int PRIMARY KEY, b text);
+CREATE PUBLICATION bench_pub FOR TABLE bench_tab;
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+
+INSERT INTO bench_tab VALUES (1, 'one'), (2, 'two');
+BEGIN;
+INSERT INTO bench_tab VALUES (3, 'three');
+UPDATE bench_tab SET b = 'deux' WHERE a = 2;
+COMMIT;
+DELETE FROM bench_tab WHERE a = 1;
+
+-- decode through the slot's own plugin
+SELECT callback, calls > 0 AS called, output_bytes > 0 AS has_output
+FROM pg_logical_slot_decoding_benchmark('regression_slot', NULL, NULL, NULL,
+	'include-xids', '0', 'skip-empty-xacts', '1');
+
+-- the slot was not advanced, so the same changes are decoded again
+SELECT calls FROM pg_logical_slot_decoding_benchmark('regression_slot', NULL, NULL, NULL)
+WHERE callback = 'change';
+
+-- decode through another plugin
+SELECT callback, calls > 0 AS called, output_bytes > 0 AS has_output
+FROM pg_logical_slot_decoding_benchmark('regression_slot', NULL, NULL, 'pgoutput',
+	'proto_version', '1', 'publication_names', 'bench_pub')
+WHERE callback IN ('change', 'commit');
+
+-- errors
+SELECT * FROM pg_logical_slot_decoding_benchmark('regression_slot', NULL, NULL, 'nonexistent_plugin');
+SELECT * FROM pg_logical_slot_decoding_benchmark(NULL, NULL, NULL, NULL);
+
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1');
+
+SELECT pg_drop_replication_slot('regression_slot');
+DROP PUBLICATION bench_pub;
+DROP TABLE bench_tab;
@@ -89,13 +89,17 @@ index_form_tuple(TupleDesc tupleDescriptor,
 
 		/*
 		 * If value is above size target, and is of a compressible datatype,
-		 * try to compress it in-line.
+		 * try to compress it in-line.  Index tuples don't know their heap
+		 * column, so they always use the default compression method.
 		 */
 		if (!VARATT_IS_EXTENDED(DatumGetPointer(untoasted_values[i])) &&
 			VARSIZE(DatumGetPointer(untoasted_values[i])) > TOAST_INDEX_TARGET &&
 			(att->attstorage == 'x' || att->attstorage == 'm'))
 		{
-			Datum		cvalue = toast_compress_datum(untoasted_values[i]);
+			Datum		cvalue;
+
+			cvalue = toast_compress_datum(untoasted_values[i],
+										  (PgCompressionMethod) default_toast_compression);
 
 			if (DatumGetPointer(cvalue) != NULL)
 			{
@@ -59,12 +59,14 @@
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
 #include "storage/procarray.h"
+#include "storage/read_stream.h"
 #include "storage/smgr.h"
 #include "storage/spin.h"
 #include "storage/standby.h"
 #include "utils/datum.h"
 #include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/relcache.h"
 #include "utils/snapmgr.h"
 #include "utils/spccache.h"
@@ -200,6 +202,56 @@ static const int MultiXactStatusLock[MaxMultiXactStatus + 1] =
  * ----------------------------------------------------------------
  */
 
+/*
+ * Read stream callback of sequential scans, returning the pages in the order
+ * heapgettup() and heapgettup_pagemode() visit them when moving forward.
+ */
+static BlockNumber
+heap_scan_stream_next_block(ReadStream *stream, void *callback_private_data)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private_data;
+	BlockNumber page;
+
+	if (scan->rs_base.rs_parallel != NULL)
+		return table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
+												 (ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
+
+	/* start at the scan's start block, which is final by now */
+	if (scan->rs_stream_next == InvalidBlockNumber)
+	{
+		scan->rs_stream_next = scan->rs_startblock;
+		scan->rs_stream_left = scan->rs_nblocks;
+		if (scan->rs_numblocks != InvalidBlockNumber)
+			scan->rs_stream_left = Min(scan->rs_stream_left, scan->rs_numblocks);
+	}
+
+	if (scan->rs_stream_left == 0)
+		return InvalidBlockNumber;
+
+	page = scan->rs_stream_next++;
+	if (scan->rs_stream_next >= scan->rs_nblocks)
+		scan->rs_stream_next = 0;
+	scan->rs_stream_left--;
+
+	return page;
+}
+
+/*
+ * heap_parallelscan_nextpage - get the next page of a parallel scan
+ *
+ * If there is a read stream, it has claimed the pages following the current
+ * one already.
+ */
+static BlockNumber
+heap_parallelscan_nextpage(HeapScanDesc scan)
+{
+	if (scan->rs_read_stream != NULL)
+		return read_stream_peek_block(scan->rs_read_stream);
+
+	return table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
+											 (ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
+}
+
 /* ----------------
  *		initscan - scan code common to heap_beginscan and heap_rescan
  * ----------------
@@ -302,6 +354,32 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
 
+	/*
+	 * Sequential scans read their pages through a read stream, which reads
+	 * runs of pages at once and prefetches ahead.  As the access strategy
+	 * may have changed, a rescan sets up a new one.  The stream lives as
+	 * long as the scan descriptor.
+	 */
+	if (scan->rs_read_stream != NULL)
+	{
+		read_stream_end(scan->rs_read_stream);
+		scan->rs_read_stream = NULL;
+	}
+	if (scan->rs_base.rs_flags & (SO_TYPE_SEQSCAN | SO_TYPE_TIDRANGESCAN))
+	{
+		MemoryContext oldcxt;
+
+		oldcxt = MemoryContextSwitchTo(GetMemoryChunkContext(scan));
+		scan->rs_read_stream = read_stream_begin_relation(scan->rs_base.rs_rd,
+														  MAIN_FORKNUM,
+														  scan->rs_strategy,
+														  heap_scan_stream_next_block,
+														  scan);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	scan->rs_stream_next = InvalidBlockNumber;
+	scan->rs_stream_left = 0;
+
 	/* page-at-a-time fields are always invalid when not rs_inited */
 
 	/*
@@ -377,9 +455,25 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	/* read page using selected strategy, or get it from the read stream */
+	if (scan->rs_read_stream != NULL &&
+		read_stream_peek_block(scan->rs_read_stream) == page)
+		scan->rs_cbuf = read_stream_next_buffer(scan->rs_read_stream);
+	else
+	{
+		/*
+		 * The scan doesn't visit the pages the way the read stream expects,
+		 * as when moving backward.  Stop using the stream.
+		 */
+		if (scan->rs_read_stream != NULL)
+		{
+			read_stream_end(scan->rs_read_stream);
+			scan->rs_read_stream = NULL;
+		}
+		scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM,
+										   page, RBM_NORMAL,
+										   scan->rs_strategy);
+	}
 	scan->rs_cblock = page;
 
 	if (!(scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE))
@@ -524,8 +618,7 @@ heapgettup(HeapScanDesc scan,
 				table_block_parallelscan_startblock_init(scan->rs_base.rs_rd,
 														 pbscan);
 
-				page = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
-														 pbscan);
+				page = heap_parallelscan_nextpage(scan);
 
 				/* Other processes might have already finished the scan. */
 				if (page == InvalidBlockNumber)
@@ -582,8 +675,13 @@ heapgettup(HeapScanDesc scan,
 			 * forward scanners.
 			 */
 			scan->rs_base.rs_flags &= ~SO_ALLOW_SYNC;
-			/* start from last page of the scan */
-			if (scan->rs_startblock > 0)
+			/*
+			 * Start from last page of the scan.  Ensure we take into account
+			 * rs_numblocks if it's been adjusted by heap_setscanlimits().
+			 */
+			if (scan->rs_numblocks != InvalidBlockNumber)
+				page = (scan->rs_startblock + scan->rs_numblocks - 1) % scan->rs_nblocks;
+			else if (scan->rs_startblock > 0)
 				page = scan->rs_startblock - 1;
 			else
 				page = scan->rs_nblocks - 1;
@@ -718,11 +816,7 @@ heapgettup(HeapScanDesc scan,
 		}
 		else if (scan->rs_base.rs_parallel != NULL)
 		{
-			ParallelBlockTableScanDesc pbscan =
-			(ParallelBlockTableScanDesc) scan->rs_base.rs_parallel;
-
-			page = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
-													 pbscan);
+			page = heap_parallelscan_nextpage(scan);
 			finished = (page == InvalidBlockNumber);
 		}
 		else
@@ -838,8 +932,7 @@ heapgettup_pagemode(HeapScanDesc scan,
 				table_block_parallelscan_startblock_init(scan->rs_base.rs_rd,
 														 pbscan);
 
-				page = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
-														 pbscan);
+				page = heap_parallelscan_nextpage(scan);
 
 				/* Other processes might have already finished the scan. */
 				if (page == InvalidBlockNumber)
@@ -893,8 +986,13 @@ heapgettup_pagemode(HeapScanDesc scan,
 			 * forward scanners.
 			 */
 			scan->rs_base.rs_flags &= ~SO_ALLOW_SYNC;
-			/* start from last page of the scan */
-			if (scan->rs_startblock > 0)
+			/*
+			 * Start from last page of the scan.  Ensure we take into account
+			 * rs_numblocks if it's been adjusted by heap_setscanlimits().
+			 */
+			if (scan->rs_numblocks != InvalidBlockNumber)
+				page = (scan->rs_startblock + scan->rs_numblocks - 1) % scan->rs_nblocks;
+			else if (scan->rs_startblock > 0)
 				page = scan->rs_startblock - 1;
 			else
 				page = scan->rs_nblocks - 1;
@@ -1017,11 +1115,7 @@ heapgettup_pagemode(HeapScanDesc scan,
 		}
 		else if (scan->rs_base.rs_parallel != NULL)
 		{
-			ParallelBlockTableScanDesc pbscan =
-			(ParallelBlockTableScanDesc) scan->rs_base.rs_parallel;
-
-			page = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
-													 pbscan);
+			page = heap_parallelscan_nextpage(scan);
 			finished = (page == InvalidBlockNumber);
 		}
 		else
@@ -1156,6 +1250,7 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 	scan->rs_base.rs_flags = flags;
 	scan->rs_base.rs_parallel = parallel_scan;
 	scan->rs_strategy = NULL;	/* set in initscan */
+	scan->rs_read_stream = NULL;	/* set in initscan */
 
 	/*
 	 * Disable page-at-a-time mode if it's not a MVCC-safe snapshot.
@@ -1254,6 +1349,9 @@ heap_endscan(TableScanDesc sscan)
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
 
+	if (scan->rs_read_stream != NULL)
+		read_stream_end(scan->rs_read_stream);
+
 	/*
 	 * decrement relation reference count and free scan descriptor storage
 	 */
@@ -1379,6 +1477,153 @@ heap_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableSlot *s
 	return true;
 }
 
+void
+heap_set_tidrange(TableScanDesc sscan, ItemPointer mintid,
+				  ItemPointer maxtid)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+	BlockNumber startBlk;
+	BlockNumber numBlks;
+	ItemPointerData highestItem;
+	ItemPointerData lowestItem;
+
+	/*
+	 * For relations without any pages, we can simply leave the TID range
+	 * unset.  There will be no tuples to scan, therefore no tuples outside
+	 * the given TID range.
+	 */
+	if (scan->rs_nblocks == 0)
+		return;
+
+	/*
+	 * Set up some ItemPointers which point to the first and last possible
+	 * tuples in the heap.
+	 */
+	ItemPointerSet(&highestItem, scan->rs_nblocks - 1, MaxOffsetNumber);
+	ItemPointerSet(&lowestItem, 0, FirstOffsetNumber);
+
+	/*
+	 * If the given maximum TID is below the highest possible TID in the
+	 * relation, then restrict the range to that, otherwise we scan to the end
+	 * of the relation.
+	 */
+	if (ItemPointerCompare(maxtid, &highestItem) < 0)
+		ItemPointerCopy(maxtid, &highestItem);
+
+	/*
+	 * If the given minimum TID is above the lowest possible TID in the
+	 * relation, then restrict the range to only scan for TIDs above that.
+	 */
+	if (ItemPointerCompare(mintid, &lowestItem) > 0)
+		ItemPointerCopy(mintid, &lowestItem);
+
+	/*
+	 * Check for an empty range and protect from would be negative results
+	 * from the numBlks calculation below.
+	 */
+	if (ItemPointerCompare(&highestItem, &lowestItem) < 0)
+	{
+		/* Set an empty range of blocks to scan */
+		heap_setscanlimits(sscan, 0, 0);
+		return;
+	}
+
+	/*
+	 * Calculate the first block and the number of blocks we must scan. We
+	 * could be more aggressive here and perform some more validation to try
+	 * and further narrow the scope of blocks to scan by checking if the
+	 * lowerItem has an offset above MaxOffsetNumber.  In this case, we could
+	 * advance startBlk by one.  Likewise, if highestItem has an offset of 0
+	 * we could scan one fewer blocks.  However, such an optimization does not
+	 * seem worth troubling over, currently.
+	 */
+	startBlk = ItemPointerGetBlockNumberNoCheck(&lowestItem);
+
+	numBlks = ItemPointerGetBlockNumberNoCheck(&highestItem) -
+		ItemPointerGetBlockNumberNoCheck(&lowestItem) + 1;
+
+	/* Set the start block and number of blocks to scan */
+	heap_setscanlimits(sscan, startBlk, numBlks);
+
+	/* Finally, set the TID range in sscan */
+	ItemPointerCopy(&lowestItem, &sscan->rs_mintid);
+	ItemPointerCopy(&highestItem, &sscan->rs_maxtid);
+}
+
+bool
+heap_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
+						  TupleTableSlot *slot)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+	ItemPointer mintid = &sscan->rs_mintid;
+	ItemPointer maxtid = &sscan->rs_maxtid;
+
+	/* Note: no locking manipulations needed */
+	for (;;)
+	{
+		if (sscan->rs_flags & SO_ALLOW_PAGEMODE)
+			heapgettup_pagemode(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+		else
+			heapgettup(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+
+		if (scan->rs_ctup.t_data == NULL)
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+
+		/*
+		 * heap_set_tidrange will have used heap_setscanlimits to limit the
+		 * range of pages we scan to only ones that can contain the TID range
+		 * we're scanning for.  Here we must filter out any tuples from these
+		 * pages that are outside of that range.
+		 */
+		if (ItemPointerCompare(&scan->rs_ctup.t_self, mintid) < 0)
+		{
+			ExecClearTuple(slot);
+
+			/*
+			 * When scanning backwards, the TIDs will be in descending order.
+			 * Future tuples in this direction will be lower still, so we can
+			 * just return false to indicate there will be no more tuples.
+			 */
+			if (ScanDirectionIsBackward(direction))
+				return false;
+
+			continue;
+		}
+
+		/*
+		 * Likewise for the final page, we must filter out TIDs greater than
+		 * maxtid.
+		 */
+		if (ItemPointerCompare(&scan->rs_ctup.t_self, maxtid) > 0)
+		{
+			ExecClearTuple(slot);
+
+			/*
+			 * When scanning forward, the TIDs will be in ascending order.
+			 * Future tuples in this direction will be higher still, so we can
+			 * just return false to indicate there will be no more tuples.
+			 */
+			if (ScanDirectionIsForward(direction))
+				return false;
+			continue;
+		}
+
+		break;
+	}
+
+	/*
+	 * if we get here it means we have a new current scan tuple, so point to
+	 * the proper return buffer and return the tuple.
+	 */
+	pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+
+	ExecStoreBufferHeapTuple(&scan->rs_ctup, slot, scan->rs_cbuf);
+	return true;
+}
+
 /*
  *	heap_fetch		- retrieve tuple with given tid
  *
@@ -2056,8 +2301,11 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
 	 * relation extension or GIN page locks will not conflict between members
 	 * of a lock group, but we don't prohibit that case here because there are
 	 * useful special cases that we can safely allow, such as CREATE TABLE AS.
+	 * A worker may insert only when its caller says it has been set up to do
+	 * so (see HEAP_INSERT_PARALLEL); relation extension locks conflict within
+	 * a lock group, so that is safe for a plain heap.
 	 */
-	if (IsParallelWorker())
+	if (IsParallelWorker() && !(options & HEAP_INSERT_PARALLEL))
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
 				 errmsg("cannot insert tuples in a parallel worker")));
@@ -35,8 +35,8 @@
 #include "access/tuptoaster.h"
 #include "access/xact.h"
 #include "catalog/catalog.h"
-#include "common/pg_lzcompress.h"
 #include "miscadmin.h"
+#include "utils/attoptcache.h"
 #include "utils/expandeddatum.h"
 #include "utils/fmgroids.h"
 #include "utils/rel.h"
@@ -46,13 +46,17 @@
 
 #undef TOAST_DEBUG
 
+/* GUC variable */
+int			default_toast_compression = PG_COMPRESSION_PGLZ;
+
 /*
- *	The information at the start of the compressed toast data.
+ *	The information at the start of the compressed toast data.  The top
+ *	bits of rawsize hold the compression method; see VARRAWSIZE_4B_C.
  */
 typedef struct toast_compress_header
 {
 	int32		vl_len_;		/* varlena header (do not touch directly!) */
-	int32		rawsize;
+	uint32		rawsize;
 } toast_compress_header;
 
 /*
@@ -60,11 +64,15 @@ typedef struct toast_compress_header
  * toast entries.
  */
 #define TOAST_COMPRESS_HDRSZ		((int32) sizeof(toast_compress_header))
-#define TOAST_COMPRESS_RAWSIZE(ptr) (((toast_compress_header *) (ptr))->rawsize)
+#define TOAST_COMPRESS_RAWSIZE(ptr) \
+	((int32) (((toast_compress_header *) (ptr))->rawsize & VARLENA_RAWSIZE_MASK))
+#define TOAST_COMPRESS_METHOD(ptr) \
+	((PgCompressionMethod) (((toast_compress_header *) (ptr))->rawsize >> VARLENA_RAWSIZE_BITS))
 #define TOAST_COMPRESS_RAWDATA(ptr) \
 	(((char *) (ptr)) + TOAST_COMPRESS_HDRSZ)
-#define TOAST_COMPRESS_SET_RAWSIZE(ptr, len) \
-	(((toast_compress_header *) (ptr))->rawsize = (len))
+#define TOAST_COMPRESS_SET_RAWSIZE_AND_METHOD(ptr, len, cmethod) \
+	(((toast_compress_header *) (ptr))->rawsize = \
+	 ((uint32) (len) | ((uint32) (cmethod) << VARLENA_RAWSIZE_BITS)))
 
 static void toast_delete_datum(Relation rel, Datum value, bool is_speculative);
 static Datum toast_save_datum(Relation rel, Datum value,
@@ -775,7 +783,8 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		if (TupleDescAttr(tupleDesc, i)->attstorage == 'x')
 		{
 			old_value = toast_values[i];
-			new_value = toast_compress_datum(old_value);
+			new_value = toast_compress_datum(old_value,
+											 toast_get_compression_method(rel, i + 1));
 
 			if (DatumGetPointer(new_value) != NULL)
 			{
@@ -916,7 +925,8 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		 */
 		i = biggest_attno;
 		old_value = toast_values[i];
-		new_value = toast_compress_datum(old_value);
+		new_value = toast_compress_datum(old_value,
+										 toast_get_compression_method(rel, i + 1));
 
 		if (DatumGetPointer(new_value) != NULL)
 		{
@@ -1348,7 +1358,8 @@ toast_build_flattened_tuple(TupleDesc tupleDesc,
 /* ----------
  * toast_compress_datum -
  *
- *	Create a compressed version of a varlena datum
+ *	Create a compressed version of a varlena datum, using the given
+ *	compression method
  *
  *	If we fail (ie, compressed result is actually bigger than original)
  *	then return NULL.  We must not use compressed data if it'd expand
@@ -1359,7 +1370,7 @@ toast_build_flattened_tuple(TupleDesc tupleDesc,
  * ----------
  */
 Datum
-toast_compress_datum(Datum value)
+toast_compress_datum(Datum value, PgCompressionMethod cmethod)
 {
 	struct varlena *tmp;
 	int32		valsize = VARSIZE_ANY_EXHDR(DatumGetPointer(value));
@@ -1376,11 +1387,11 @@ toast_compress_datum(Datum value)
 		valsize > PGLZ_strategy_default->max_input_size)
 		return PointerGetDatum(NULL);
 
-	tmp = (struct varlena *) palloc(PGLZ_MAX_OUTPUT(valsize) +
+	tmp = (struct varlena *) palloc(PG_COMPRESS_MAX_OUTPUT(valsize) +
 									TOAST_COMPRESS_HDRSZ);
 
 	/*
-	 * We recheck the actual size even if pglz_compress() reports success,
+	 * We recheck the actual size even if pg_compress() reports success,
 	 * because it might be satisfied with having saved as little as one byte
 	 * in the compressed data --- which could turn into a net loss once you
 	 * consider header and alignment padding.  Worst case, the compressed
@@ -1389,14 +1400,14 @@ toast_compress_datum(Datum value)
 	 * only one header byte and no padding if the value is short enough.  So
 	 * we insist on a savings of more than 2 bytes to ensure we have a gain.
 	 */
-	len = pglz_compress(VARDATA_ANY(DatumGetPointer(value)),
-						valsize,
-						TOAST_COMPRESS_RAWDATA(tmp),
-						PGLZ_strategy_default);
+	len = pg_compress(cmethod,
+					  VARDATA_ANY(DatumGetPointer(value)),
+					  valsize,
+					  TOAST_COMPRESS_RAWDATA(tmp));
 	if (len >= 0 &&
 		len + TOAST_COMPRESS_HDRSZ < valsize - 2)
 	{
-		TOAST_COMPRESS_SET_RAWSIZE(tmp, valsize);
+		TOAST_COMPRESS_SET_RAWSIZE_AND_METHOD(tmp, valsize, cmethod);
 		SET_VARSIZE_COMPRESSED(tmp, len + TOAST_COMPRESS_HDRSZ);
 		/* successful compression */
 		return PointerGetDatum(tmp);
@@ -1410,6 +1421,98 @@ toast_compress_datum(Datum value)
 }
 
 
+/* ----------
+ * toast_get_compression_method -
+ *
+ *	Return the compression method for new values of the given attribute:
+ *	its "compression" option if set, else default_toast_compression.
+ * ----------
+ */
+PgCompressionMethod
+toast_get_compression_method(Relation rel, int attnum)
+{
+	AttributeOpts *aopt;
+	PgCompressionMethod cmethod = (PgCompressionMethod) default_toast_compression;
+
+	aopt = get_attribute_options(RelationGetRelid(rel), attnum);
+	if (aopt != NULL)
+	{
+		if (aopt->compression_offset != 0 &&
+			!get_compression_method_by_name((char *) aopt + aopt->compression_offset,
+											&cmethod))
+			elog(ERROR, "invalid compression method for column %d of relation \"%s\"",
+				 attnum, RelationGetRelationName(rel));
+		pfree(aopt);
+	}
+
+	return cmethod;
+}
+
+
+/* ----------
+ * toast_datum_compression_method -
+ *
+ *	Return the compression method a varlena datum is stored with, or -1 if
+ *	it is not compressed.  For an out-of-line value the method is only
+ *	recorded in the stored data, so this has to fetch it.
+ * ----------
+ */
+int
+toast_datum_compression_method(Datum value)
+{
+	struct varlena *attr = (struct varlena *) DatumGetPointer(value);
+	int			result = -1;
+
+	if (VARATT_IS_EXTERNAL_ONDISK(attr))
+	{
+		struct varatt_external toast_pointer;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+		if (VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+		{
+			struct varlena *fetched = toast_fetch_datum(attr);
+
+			result = VARCOMPRESS_4B_C(fetched);
+			pfree(fetched);
+		}
+	}
+	else if (VARATT_IS_EXTERNAL_INDIRECT(attr))
+	{
+		struct varatt_indirect toast_pointer;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+
+		/* nested indirect Datums aren't allowed */
+		Assert(!VARATT_IS_EXTERNAL_INDIRECT(attr));
+
+		result = toast_datum_compression_method(PointerGetDatum(toast_pointer.pointer));
+	}
+	else if (VARATT_IS_COMPRESSED(attr))
+		result = VARCOMPRESS_4B_C(attr);
+
+	return result;
+}
+
+
+/* ----------
+ * validate_toast_compression_option -
+ *
+ *	Validator for the "compression" attribute option.
+ * ----------
+ */
+void
+validate_toast_compression_option(const char *value)
+{
+	PgCompressionMethod cmethod;
+
+	if (value == NULL || !get_compression_method_by_name(value, &cmethod))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid value for \"compression\" option"),
+				 errdetail("Valid values are \"pglz\" and \"lz4\".")));
+}
+
+
 /* ----------
  * toast_get_valid_index
  *
@@ -2274,10 +2377,11 @@ toast_decompress_datum(struct varlena *attr)
 		palloc(TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 	SET_VARSIZE(result, TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 
-	if (pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
-						VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
-						VARDATA(result),
-						TOAST_COMPRESS_RAWSIZE(attr), true) < 0)
+	if (pg_decompress(TOAST_COMPRESS_METHOD(attr),
+					  TOAST_COMPRESS_RAWDATA(attr),
+					  VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+					  VARDATA(result),
+					  TOAST_COMPRESS_RAWSIZE(attr), true) < 0)
 		elog(ERROR, "compressed data is corrupted");
 
 	return result;
@@ -2301,10 +2405,11 @@ toast_decompress_datum_slice(struct varlena *attr, int32 slicelength)
 
 	result = (struct varlena *) palloc(slicelength + VARHDRSZ);
 
-	rawsize = pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
-							  VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
-							  VARDATA(result),
-							  slicelength, false);
+	rawsize = pg_decompress(TOAST_COMPRESS_METHOD(attr),
+							TOAST_COMPRESS_RAWDATA(attr),
+							VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+							VARDATA(result),
+							slicelength, false);
 	if (rawsize < 0)
 		elog(ERROR, "compressed data is corrupted");
 
@@ -53,6 +53,10 @@ GetTableAmRoutine(Oid amhandler)
 	Assert(routine->scan_rescan != NULL);
 	Assert(routine->scan_getnextslot != NULL);
 
+	/* TID range scan support is optional, but needs both callbacks */
+	Assert((routine->scan_set_tidrange == NULL) ==
+		   (routine->scan_getnextslot_tidrange == NULL));
+
 	Assert(routine->parallelscan_estimate != NULL);
 	Assert(routine->parallelscan_initialize != NULL);
 	Assert(routine->parallelscan_reinitialize != NULL);
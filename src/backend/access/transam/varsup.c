@@ -219,7 +219,14 @@ GetNewTransactionId(bool isSubXact)
 	 * answer later on when someone does have a reason to inquire.)
 	 */
 	if (!isSubXact)
+	{
+		/*
+		 * Our entry in ProcGlobal->xids can't move while we hold XidGenLock,
+		 * see ProcArrayAdd().
+		 */
 		MyPgXact->xid = xid;	/* LWLockRelease acts as barrier */
+		ProcGlobal->xids[MyProc->pgxactoff] = xid;
+	}
 	else
 	{
 		int			nxids = MyPgXact->nxids;
@@ -34,6 +34,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogprefetch.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
@@ -93,7 +94,7 @@ char	   *XLogArchiveCommand = NULL;
 bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
 bool		wal_log_hints = false;
-bool		wal_compression = false;
+int			wal_compression = WAL_COMPRESSION_NONE;
 char	   *wal_consistency_checking_string = NULL;
 bool	   *wal_consistency_checking = NULL;
 bool		wal_init_zero = true;
@@ -166,6 +167,24 @@ const struct config_enum_entry archive_mode_options[] = {
 	{NULL, 0, false}
 };
 
+/*
+ * "on" means pglz, the only method there used to be; we accept all the
+ * likely variants of "on" and "off" too.
+ */
+const struct config_enum_entry wal_compression_options[] = {
+	{"pglz", WAL_COMPRESSION_PGLZ, false},
+	{"lz4", WAL_COMPRESSION_LZ4, false},
+	{"on", WAL_COMPRESSION_PGLZ, false},
+	{"off", WAL_COMPRESSION_NONE, false},
+	{"true", WAL_COMPRESSION_PGLZ, true},
+	{"false", WAL_COMPRESSION_NONE, true},
+	{"yes", WAL_COMPRESSION_PGLZ, true},
+	{"no", WAL_COMPRESSION_NONE, true},
+	{"1", WAL_COMPRESSION_PGLZ, true},
+	{"0", WAL_COMPRESSION_NONE, true},
+	{NULL, 0, false}
+};
+
 const struct config_enum_entry recovery_target_action_options[] = {
 	{"pause", RECOVERY_TARGET_ACTION_PAUSE, false},
 	{"promote", RECOVERY_TARGET_ACTION_PROMOTE, false},
@@ -6745,6 +6764,14 @@ StartupXLOG(void)
 		InRecovery = true;
 	}
 
+	/*
+	 * After a clean shutdown, load the statistics saved by the checkpointer
+	 * into shared memory.  If we have to recover, they may be out of date,
+	 * and are thrown away below instead.
+	 */
+	if (!InRecovery)
+		pgstat_restore_stats();
+
 	/* REDO */
 	if (InRecovery)
 	{
@@ -7029,6 +7056,7 @@ StartupXLOG(void)
 		{
 			ErrorContextCallback errcallback;
 			TimestampTz xtime;
+			XLogPrefetcher *prefetcher = NULL;
 
 			InRedo = true;
 
@@ -7179,6 +7207,24 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
+				/*
+				 * Have the blocks referenced by the upcoming records read
+				 * in while we replay this one.  The settings can change on
+				 * reload.
+				 */
+				if (recovery_prefetch && recovery_prefetch_distance > 0)
+				{
+					if (prefetcher == NULL)
+						prefetcher = XLogPrefetcherAllocate();
+					XLogPrefetcherReadAhead(prefetcher, ReadRecPtr,
+											curFileTLI);
+				}
+				else if (prefetcher != NULL)
+				{
+					XLogPrefetcherFree(prefetcher);
+					prefetcher = NULL;
+				}
+
 				/* Now apply the WAL record itself */
 				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
 
@@ -7253,6 +7299,9 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			if (prefetcher != NULL)
+				XLogPrefetcherFree(prefetcher);
+
 			if (reachedStopPoint)
 			{
 				if (!reachedConsistency)
@@ -0,0 +1,529 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching support for recovery.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogprefetch.c
+ *
+ * NOTES
+ *
+ * Redo of a record that references a block not in shared buffers stalls on
+ * a synchronous read.  To avoid that, the startup process reads ahead in the
+ * WAL with a second xlogreader, up to recovery_prefetch_distance bytes ahead
+ * of the record being replayed, and issues PrefetchSharedBuffer() for the
+ * blocks its records reference, so that the kernel has them read in by the
+ * time redo needs them.
+ *
+ * Blocks that redo won't read are skipped: those restored from full page
+ * images, those initialized from scratch, and repeated references to the
+ * same block.  WAL may reference relations that were created, extended,
+ * truncated or dropped before that point of replay; when a block's file
+ * turns out not to exist, the relation is kept from being prefetched until
+ * replay has passed the record.
+ *
+ * The look-ahead reader only reads WAL segments that are already present in
+ * pg_wal, and never waits for more WAL to arrive.  When it can't read any
+ * further, whether because it reached the end of the available WAL, because
+ * the segment has yet to be restored from the archive or streamed, or
+ * because it found a record it can't make sense of, it stops until replay
+ * has caught up with it and then starts over from replay's position.
+ * Everything it does is only a hint, so it's harmless if it reads WAL that
+ * replay won't, for example on a timeline that replay is about to leave.
+ *
+ * Counters of what the prefetcher did are kept in shared memory, and shown
+ * by the pg_stat_prefetch_recovery view.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/htup_details.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "lib/ilist.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+/* GUCs */
+bool		recovery_prefetch = false;
+int			recovery_prefetch_distance = 256 * 1024;
+
+/*
+ * Counters shown by pg_stat_prefetch_recovery.  Only the startup process
+ * updates them.
+ */
+typedef struct XLogPrefetchStats
+{
+	pg_atomic_uint64 reset_time;	/* time of the start of recovery */
+	pg_atomic_uint64 prefetch;	/* read-aheads issued */
+	pg_atomic_uint64 hit;		/* blocks found in shared buffers */
+	pg_atomic_uint64 skip_new;	/* blocks of files that didn't exist */
+	pg_atomic_uint64 skip_fpw;	/* blocks restored from full page images */
+	pg_atomic_uint64 skip_init; /* blocks initialized from scratch */
+	pg_atomic_uint64 skip_rep;	/* repeated references to a block */
+	pg_atomic_uint64 distance;	/* bytes of WAL read ahead of replay */
+} XLogPrefetchStats;
+
+static XLogPrefetchStats *Stats = NULL;
+
+/*
+ * A relation whose blocks are not to be prefetched, from filter_from_block
+ * onwards, until replay has passed filter_until_replayed.
+ */
+typedef struct XLogPrefetcherFilter
+{
+	RelFileNode rnode;			/* hash key */
+	BlockNumber filter_from_block;
+	XLogRecPtr	filter_until_replayed;
+	dlist_node	link;
+} XLogPrefetcherFilter;
+
+struct XLogPrefetcher
+{
+	XLogReaderState *reader;
+
+	/*
+	 * If 'lost', the reader has given up, and is restarted from replay's
+	 * position once replay has reached restart_after.  Otherwise it's
+	 * positioned to read the record following the last one it returned.
+	 */
+	bool		lost;
+	XLogRecPtr	restart_after;
+
+	/* WAL segment file the reader has open */
+	int			fd;
+	XLogSegNo	segno;
+	TimeLineID	tli;			/* timeline to read from */
+	TimeLineID	fd_tli;			/* timeline of the open file */
+
+	/* the block prefetched last */
+	RelFileNode last_rnode;
+	ForkNumber	last_forknum;
+	BlockNumber last_blkno;
+
+	/* filters, ordered by filter_until_replayed (newest first) */
+	HTAB	   *filter_table;
+	dlist_head	filter_queue;
+};
+
+static void XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher);
+static int	XLogPrefetcherPageRead(XLogReaderState *reader,
+								   XLogRecPtr targetPagePtr, int reqLen,
+								   XLogRecPtr targetRecPtr, char *readBuf,
+								   TimeLineID *pageTLI);
+
+static inline void
+XLogPrefetchIncrement(pg_atomic_uint64 *counter)
+{
+	/* only the startup process writes, so no atomic read-modify-write */
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + 1);
+}
+
+/*
+ * Report shared memory space needed by XLogPrefetchShmemInit.
+ */
+Size
+XLogPrefetchShmemSize(void)
+{
+	return sizeof(XLogPrefetchStats);
+}
+
+/*
+ * Allocate and initialize the shared counters.
+ */
+void
+XLogPrefetchShmemInit(void)
+{
+	bool		found;
+
+	Stats = (XLogPrefetchStats *)
+		ShmemInitStruct("XLogPrefetchStats", sizeof(XLogPrefetchStats),
+						&found);
+	if (!found)
+	{
+		pg_atomic_init_u64(&Stats->reset_time, 0);
+		pg_atomic_init_u64(&Stats->prefetch, 0);
+		pg_atomic_init_u64(&Stats->hit, 0);
+		pg_atomic_init_u64(&Stats->skip_new, 0);
+		pg_atomic_init_u64(&Stats->skip_fpw, 0);
+		pg_atomic_init_u64(&Stats->skip_init, 0);
+		pg_atomic_init_u64(&Stats->skip_rep, 0);
+		pg_atomic_init_u64(&Stats->distance, 0);
+	}
+}
+
+/*
+ * Create a prefetcher, and reset the shared counters.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(void)
+{
+	XLogPrefetcher *prefetcher;
+	HASHCTL		hash_ctl;
+
+	prefetcher = palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(wal_segment_size,
+											XLogPrefetcherPageRead,
+											prefetcher);
+	if (prefetcher->reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	prefetcher->lost = true;
+	prefetcher->restart_after = InvalidXLogRecPtr;
+	prefetcher->fd = -1;
+	prefetcher->last_blkno = InvalidBlockNumber;
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(RelFileNode);
+	hash_ctl.entrysize = sizeof(XLogPrefetcherFilter);
+	prefetcher->filter_table = hash_create("XLogPrefetcherFilterTable", 64,
+										   &hash_ctl,
+										   HASH_ELEM | HASH_BLOBS);
+	dlist_init(&prefetcher->filter_queue);
+
+	pg_atomic_write_u64(&Stats->reset_time, GetCurrentTimestamp());
+	pg_atomic_write_u64(&Stats->prefetch, 0);
+	pg_atomic_write_u64(&Stats->hit, 0);
+	pg_atomic_write_u64(&Stats->skip_new, 0);
+	pg_atomic_write_u64(&Stats->skip_fpw, 0);
+	pg_atomic_write_u64(&Stats->skip_init, 0);
+	pg_atomic_write_u64(&Stats->skip_rep, 0);
+	pg_atomic_write_u64(&Stats->distance, 0);
+
+	return prefetcher;
+}
+
+/*
+ * Destroy a prefetcher.  The counters remain visible.
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->fd >= 0)
+		close(prefetcher->fd);
+	XLogReaderFree(prefetcher->reader);
+	hash_destroy(prefetcher->filter_table);
+	pfree(prefetcher);
+
+	pg_atomic_write_u64(&Stats->distance, 0);
+}
+
+/*
+ * Keep 'rnode' from being prefetched from 'blockno' onwards, until replay
+ * has passed 'lsn'.
+ */
+static void
+XLogPrefetcherAddFilter(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						BlockNumber blockno, XLogRecPtr lsn)
+{
+	XLogPrefetcherFilter *filter;
+	bool		found;
+
+	filter = hash_search(prefetcher->filter_table, &rnode, HASH_ENTER, &found);
+	if (!found)
+		filter->filter_from_block = blockno;
+	else
+	{
+		filter->filter_from_block = Min(filter->filter_from_block, blockno);
+		dlist_delete(&filter->link);
+	}
+	filter->filter_until_replayed = lsn;
+	dlist_push_head(&prefetcher->filter_queue, &filter->link);
+}
+
+/*
+ * Drop the filters that replay has passed.
+ */
+static void
+XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
+							  XLogRecPtr replaying_lsn)
+{
+	while (!dlist_is_empty(&prefetcher->filter_queue))
+	{
+		XLogPrefetcherFilter *filter;
+
+		filter = dlist_tail_element(XLogPrefetcherFilter, link,
+									&prefetcher->filter_queue);
+		if (filter->filter_until_replayed >= replaying_lsn)
+			break;
+		dlist_delete(&filter->link);
+		hash_search(prefetcher->filter_table, &filter->rnode, HASH_REMOVE,
+					NULL);
+	}
+}
+
+/*
+ * Is block 'blockno' of 'rnode' kept from being prefetched?
+ */
+static bool
+XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						 BlockNumber blockno)
+{
+	XLogPrefetcherFilter *filter;
+
+	if (dlist_is_empty(&prefetcher->filter_queue))
+		return false;
+
+	filter = hash_search(prefetcher->filter_table, &rnode, HASH_FIND, NULL);
+	return filter != NULL && filter->filter_from_block <= blockno;
+}
+
+/*
+ * Read ahead of the record at 'replaying_lsn', which is about to be
+ * replayed, and prefetch the blocks referenced by the records read.
+ * 'tli' is the timeline replay is reading WAL from.
+ */
+void
+XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher, XLogRecPtr replaying_lsn,
+						TimeLineID tli)
+{
+	XLogReaderState *reader = prefetcher->reader;
+
+	XLogPrefetcherCompleteFilters(prefetcher, replaying_lsn);
+
+	/* fell behind replay, e.g. after it moved to another timeline? */
+	if (!prefetcher->lost && reader->EndRecPtr <= replaying_lsn)
+	{
+		prefetcher->lost = true;
+		prefetcher->restart_after = InvalidXLogRecPtr;
+	}
+
+	/* wait for replay to reach the WAL the reader couldn't read */
+	if (prefetcher->lost && replaying_lsn < prefetcher->restart_after)
+		return;
+
+	/*
+	 * Segments following a timeline switch are found on the new timeline,
+	 * which has copies of those before it as well.
+	 */
+	prefetcher->tli = tli;
+
+	while (prefetcher->lost ||
+		   reader->EndRecPtr - replaying_lsn <
+		   (uint64) recovery_prefetch_distance)
+	{
+		XLogRecord *record;
+		char	   *errormsg;
+
+		/* start over from the record replay is at, if needed */
+		record = XLogReadRecord(reader,
+								prefetcher->lost ? replaying_lsn :
+								InvalidXLogRecPtr,
+								&errormsg);
+		if (record == NULL)
+		{
+			/* try again once replay has read past the trouble spot */
+			prefetcher->restart_after = prefetcher->lost ?
+				replaying_lsn + 1 : reader->EndRecPtr;
+			prefetcher->lost = true;
+			break;
+		}
+		prefetcher->lost = false;
+
+		/* replay has that one in hand already */
+		if (reader->ReadRecPtr <= replaying_lsn)
+			continue;
+
+		XLogPrefetcherScanBlocks(prefetcher);
+	}
+
+	pg_atomic_write_u64(&Stats->distance,
+						prefetcher->lost ? 0 :
+						reader->EndRecPtr - replaying_lsn);
+}
+
+/*
+ * Prefetch the blocks referenced by the record the reader holds.
+ */
+static void
+XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	int			block_id;
+
+	for (block_id = 0; block_id <= reader->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+		SMgrRelation reln;
+
+		if (!XLogRecGetBlockTag(reader, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		/* replay restores the page from the image without reading it */
+		if (XLogRecBlockImageApply(reader, block_id))
+		{
+			XLogPrefetchIncrement(&Stats->skip_fpw);
+			continue;
+		}
+
+		/* nor does it read pages it initializes */
+		if ((reader->blocks[block_id].flags & BKPBLOCK_WILL_INIT) != 0)
+		{
+			XLogPrefetchIncrement(&Stats->skip_init);
+			continue;
+		}
+
+		/* records often touch the same block repeatedly */
+		if (blkno == prefetcher->last_blkno &&
+			forknum == prefetcher->last_forknum &&
+			RelFileNodeEquals(rnode, prefetcher->last_rnode))
+		{
+			XLogPrefetchIncrement(&Stats->skip_rep);
+			continue;
+		}
+
+		if (XLogPrefetcherIsFiltered(prefetcher, rnode, blkno))
+		{
+			XLogPrefetchIncrement(&Stats->skip_new);
+			continue;
+		}
+
+		reln = smgropen(rnode, InvalidBackendId);
+		switch (PrefetchSharedBuffer(reln, forknum, blkno))
+		{
+			case PREFETCH_BUFFER_HIT:
+				XLogPrefetchIncrement(&Stats->hit);
+				break;
+			case PREFETCH_BUFFER_IO:
+				XLogPrefetchIncrement(&Stats->prefetch);
+				break;
+			case PREFETCH_BUFFER_MISSING:
+
+				/*
+				 * The file will be created by this record or one before it,
+				 * or the relation is dropped later on.  Either way, leave it
+				 * alone until this record has been replayed.
+				 */
+				XLogPrefetcherAddFilter(prefetcher, rnode, blkno,
+										reader->ReadRecPtr);
+				XLogPrefetchIncrement(&Stats->skip_new);
+				break;
+		}
+
+		prefetcher->last_rnode = rnode;
+		prefetcher->last_forknum = forknum;
+		prefetcher->last_blkno = blkno;
+	}
+}
+
+/*
+ * xlogreader callback reading WAL pages from the segment files in pg_wal.
+ *
+ * Unlike the startup process's own callback this never waits for WAL, nor
+ * restores it from the archive; pages that aren't there yet just can't be
+ * read.
+ */
+static int
+XLogPrefetcherPageRead(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) reader->private_data;
+	XLogSegNo	segno;
+	uint32		offset;
+
+	XLByteToSeg(targetPagePtr, segno, wal_segment_size);
+	offset = XLogSegmentOffset(targetPagePtr, wal_segment_size);
+
+	if (prefetcher->fd < 0 || prefetcher->segno != segno ||
+		prefetcher->fd_tli != prefetcher->tli)
+	{
+		char		path[MAXPGPATH];
+
+		if (prefetcher->fd >= 0)
+		{
+			close(prefetcher->fd);
+			prefetcher->fd = -1;
+		}
+
+		XLogFilePath(path, prefetcher->tli, segno, wal_segment_size);
+		prefetcher->fd = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+		if (prefetcher->fd < 0)
+			return -1;
+		prefetcher->segno = segno;
+		prefetcher->fd_tli = prefetcher->tli;
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_READ);
+	if (pg_pread(prefetcher->fd, readBuf, XLOG_BLCKSZ, offset) != XLOG_BLCKSZ)
+	{
+		pgstat_report_wait_end();
+		return -1;
+	}
+	pgstat_report_wait_end();
+
+	*pageTLI = prefetcher->tli;
+	return XLOG_BLCKSZ;
+}
+
+/*
+ * SQL-callable function returning the counters of recovery prefetching.
+ */
+Datum
+pg_stat_get_prefetch_recovery(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PREFETCH_RECOVERY_COLS 8
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_PREFETCH_RECOVERY_COLS];
+	bool		nulls[PG_STAT_GET_PREFETCH_RECOVERY_COLS];
+	TimestampTz reset_time;
+
+	tupdesc = CreateTemplateTupleDesc(PG_STAT_GET_PREFETCH_RECOVERY_COLS);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "stats_reset",
+					   TIMESTAMPTZOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "prefetch",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "hit",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "skip_new",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "skip_fpw",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "skip_init",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "skip_rep",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "distance",
+					   INT8OID, -1, 0);
+	BlessTupleDesc(tupdesc);
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	reset_time = (TimestampTz) pg_atomic_read_u64(&Stats->reset_time);
+	if (reset_time == 0)
+		nulls[0] = true;
+	else
+		values[0] = TimestampTzGetDatum(reset_time);
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&Stats->prefetch));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&Stats->hit));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_new));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_fpw));
+	values[5] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_init));
+	values[6] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_rep));
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&Stats->distance));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -22,7 +22,7 @@
 #include "access/xlog_internal.h"
 #include "access/xlogreader.h"
 #include "catalog/pg_control.h"
-#include "common/pg_lzcompress.h"
+#include "common/compression.h"
 #include "replication/origin.h"
 
 #ifndef FRONTEND
@@ -1424,8 +1424,12 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 	if (bkpb->bimg_info & BKPIMAGE_IS_COMPRESSED)
 	{
 		/* If a backup block image is compressed, decompress it */
-		if (pglz_decompress(ptr, bkpb->bimg_len, tmp.data,
-							BLCKSZ - bkpb->hole_length, true) < 0)
+		PgCompressionMethod cmethod;
+
+		cmethod = (bkpb->bimg_info & BKPIMAGE_COMPRESS_LZ4) ?
+			PG_COMPRESSION_LZ4 : PG_COMPRESSION_PGLZ;
+		if (pg_decompress(cmethod, ptr, bkpb->bimg_len, tmp.data,
+						  BLCKSZ - bkpb->hole_length, true) < 0)
 		{
 			report_invalid_record(record, "invalid compressed image at %X/%X, block %d",
 								  (uint32) (record->ReadRecPtr >> 32),
@@ -1512,10 +1512,22 @@ doDeletion(const ObjectAddress *object, int flags)
 		case OCLASS_ROLE:
 		case OCLASS_DATABASE:
 		case OCLASS_TBLSPACE:
-		case OCLASS_SUBSCRIPTION:
 			elog(ERROR, "global objects cannot be deleted by doDeletion");
 			break;
 
+			/*
+			 * A subscription depends on its conflict table, but dropping the
+			 * subscription also drops its remote slot, which we don't want
+			 * to do behind the user's back.
+			 */
+		case OCLASS_SUBSCRIPTION:
+			ereport(ERROR,
+					(errcode(ERRCODE_DEPENDENT_OBJECTS_STILL_EXIST),
+					 errmsg("cannot drop %s automatically",
+							getObjectDescription(object)),
+					 errhint("Drop the subscription or change its conflict_table first.")));
+			break;
+
 			/*
 			 * There's intentionally no default: case here; we want the
 			 * compiler to warn if a new OCLASS hasn't been handled above.
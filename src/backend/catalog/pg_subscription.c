@@ -73,6 +73,8 @@ GetSubscription(Oid subid, bool missing_ok)
 	sub->owner = subform->subowner;
 	sub->enabled = subform->subenabled;
 	sub->roident = subform->subroident;
+	sub->conflictres = subform->subconflictres;
+	sub->conflictrelid = subform->subconflictrelid;
 
 	/* Get conninfo */
 	datum = SysCacheGetAttr(SUBSCRIPTIONOID,
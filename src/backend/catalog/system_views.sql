@@ -776,7 +776,9 @@ CREATE VIEW pg_stat_replication AS
             W.replay_lag,
             W.sync_priority,
             W.sync_state,
-            W.reply_time
+            W.reply_time,
+            W.pubrel_rebuilds,
+            W.pub_reloads
     FROM pg_stat_get_activity(NULL) AS S
         JOIN pg_stat_get_wal_senders() AS W ON (S.pid = W.pid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
@@ -810,7 +812,10 @@ CREATE VIEW pg_stat_subscription AS
             st.last_msg_send_time,
             st.last_msg_receipt_time,
             st.latest_end_lsn,
-            st.latest_end_time
+            st.latest_end_time,
+            st.insert_conflicts,
+            st.update_conflicts,
+            st.delete_conflicts
     FROM pg_subscription su
             LEFT JOIN pg_stat_get_subscription(NULL) st
                       ON (st.subid = su.oid);
@@ -932,6 +937,18 @@ CREATE VIEW pg_stat_archiver AS
         s.stats_reset
     FROM pg_stat_get_archiver() s;
 
+CREATE VIEW pg_stat_prefetch_recovery AS
+    SELECT
+        s.stats_reset,
+        s.prefetch,
+        s.hit,
+        s.skip_new,
+        s.skip_fpw,
+        s.skip_init,
+        s.skip_rep,
+        s.distance
+    FROM pg_stat_get_prefetch_recovery() s;
+
 CREATE VIEW pg_stat_bgwriter AS
     SELECT
         pg_stat_get_bgwriter_timed_checkpoints() AS checkpoints_timed,
@@ -1058,7 +1075,8 @@ REVOKE ALL ON pg_replication_origin_status FROM public;
 
 -- All columns of pg_subscription except subconninfo are readable.
 REVOKE ALL ON pg_subscription FROM public;
-GRANT SELECT (subdbid, subname, subowner, subenabled, subslotname, subpublications)
+GRANT SELECT (subdbid, subname, subowner, subenabled, subslotname, subpublications,
+              subconflictres, subconflictrelid)
     ON pg_subscription TO public;
 
 
@@ -1197,6 +1215,16 @@ LANGUAGE INTERNAL
 VOLATILE ROWS 1000 COST 1000
 AS 'pg_logical_slot_peek_binary_changes';
 
+CREATE OR REPLACE FUNCTION pg_logical_slot_decoding_benchmark(
+    IN slot_name name, IN start_lsn pg_lsn, IN upto_lsn pg_lsn, IN plugin name,
+    VARIADIC options text[] DEFAULT '{}',
+    OUT callback text, OUT calls int8, OUT total_time float8,
+    OUT output_bytes int8)
+RETURNS SETOF RECORD
+LANGUAGE INTERNAL
+VOLATILE ROWS 9 COST 1000
+AS 'pg_logical_slot_decoding_benchmark';
+
 CREATE OR REPLACE FUNCTION pg_create_physical_replication_slot(
     IN slot_name name, IN immediately_reserve boolean DEFAULT false,
     IN temporary boolean DEFAULT false,
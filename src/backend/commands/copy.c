@@ -18,14 +18,18 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "access/genam.h"
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/dependency.h"
+#include "catalog/pg_am.h"
 #include "catalog/pg_authid.h"
+#include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "commands/copy.h"
 #include "commands/defrem.h"
@@ -39,15 +43,21 @@
 #include "libpq/pqformat.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/clauses.h"
 #include "optimizer/optimizer.h"
 #include "nodes/makefuncs.h"
 #include "parser/parse_coerce.h"
 #include "parser/parse_collate.h"
 #include "parser/parse_expr.h"
 #include "parser/parse_relation.h"
+#include "pgstat.h"
+#include "port/atomics.h"
 #include "port/pg_bswap.h"
+#include "port/simd.h"
+#include "postmaster/bgworker_internals.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/fd.h"
+#include "storage/shm_mq.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -154,6 +164,7 @@ typedef struct CopyStateData
 	List	   *convert_select; /* list of column names (can be NIL) */
 	bool	   *convert_select_flags;	/* per-column CSV/TEXT CS flags */
 	Node	   *whereClause;	/* WHERE condition (or NULL) */
+	int			nworkers;		/* # of parallel workers requested */
 
 	/* these are just for error messages, see CopyFromErrorCallback */
 	const char *cur_relname;	/* table name for error messages */
@@ -187,6 +198,15 @@ typedef struct CopyStateData
 
 	TransitionCaptureState *transition_capture;
 
+	/*
+	 * In a parallel COPY FROM worker, input lines arrive from the leader in
+	 * batches through line_queue, rather than being read from the source.
+	 */
+	shm_mq_handle *line_queue;	/* queue of line batches, or NULL */
+	char	   *line_batch;		/* current batch of lines */
+	Size		line_batch_len; /* total # of bytes in batch */
+	Size		line_batch_pos; /* next byte to process */
+
 	/*
 	 * These variables are used to reduce overhead in textual COPY FROM.
 	 *
@@ -282,6 +302,44 @@ typedef struct CopyMultiInsertInfo
 	int			ti_options;		/* table insert options */
 } CopyMultiInsertInfo;
 
+/*
+ * Parallel COPY FROM.  The leader reads the input and splits it into lines,
+ * which it sends to the workers in batches, round-robin, each worker having
+ * its own queue.  Every line in a batch is stored as its line number
+ * (uint64), its length (uint32) and its contents, already converted to the
+ * server encoding.
+ */
+#define PARALLEL_COPY_KEY_SHARED		UINT64CONST(0xC000000000000001)
+#define PARALLEL_COPY_KEY_OPTIONS		UINT64CONST(0xC000000000000002)
+#define PARALLEL_COPY_KEY_ATTLIST		UINT64CONST(0xC000000000000003)
+#define PARALLEL_COPY_KEY_WHERE			UINT64CONST(0xC000000000000004)
+#define PARALLEL_COPY_KEY_QUERY_TEXT	UINT64CONST(0xC000000000000005)
+#define PARALLEL_COPY_KEY_LINE_QUEUES	UINT64CONST(0xC000000000000006)
+
+/* Size of each worker's queue, and thresholds for sending a batch */
+#define PARALLEL_COPY_QUEUE_SIZE		(RAW_BUF_SIZE * 4)
+#define PARALLEL_COPY_BATCH_SIZE		RAW_BUF_SIZE
+#define PARALLEL_COPY_BATCH_LINES		MAX_BUFFERED_TUPLES
+
+/* Shared state for a parallel COPY FROM */
+typedef struct ParallelCopyShared
+{
+	Oid			relid;			/* target table */
+	pg_atomic_uint64 processed; /* # of rows inserted by all workers */
+} ParallelCopyShared;
+
+/* Leader's state for a parallel COPY FROM */
+typedef struct ParallelCopyLeader
+{
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	shm_mq_handle **queues;		/* queues of the launched workers */
+	int			nqueues;		/* # of queues still attached */
+	int			nextqueue;		/* queue to send the next batch to */
+	StringInfoData batch;		/* batch of lines being assembled */
+	int			batch_lines;	/* # of lines in batch */
+} ParallelCopyLeader;
+
 
 /*
  * These macros centralize code used to process line_buf and raw_buf buffers.
@@ -350,6 +408,35 @@ if (1) \
 
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
 
+/*
+ * Return the length of the longest prefix of buf[0..len) made of whole
+ * Vector8-sized chunks that contain none of the characters c1 to c4 (which
+ * need not be distinct), nor, if stop_at_highbit, any byte with the high bit
+ * set.  The COPY FROM parsing loops use this to skip over runs of ordinary
+ * data in bulk, rather than examining them one byte at a time.
+ */
+static inline int
+CopySkipPlainBytes(const char *buf, int len, char c1, char c2, char c3,
+				   char c4, bool stop_at_highbit)
+{
+	int			i;
+
+	for (i = 0; i + (int) sizeof(Vector8) <= len; i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load(&chunk, (const uint8 *) &buf[i]);
+		if (vector8_has(chunk, (uint8) c1) ||
+			vector8_has(chunk, (uint8) c2) ||
+			vector8_has(chunk, (uint8) c3) ||
+			vector8_has(chunk, (uint8) c4) ||
+			(stop_at_highbit && vector8_is_highbit_set(chunk)))
+			break;
+	}
+
+	return i;
+}
+
 
 /* non-export function prototypes */
 static CopyState BeginCopy(ParseState *pstate, bool is_from, Relation rel,
@@ -364,6 +451,15 @@ static void EndCopyTo(CopyState cstate);
 static uint64 DoCopyTo(CopyState cstate);
 static uint64 CopyTo(CopyState cstate);
 static void CopyOneRowTo(CopyState cstate, TupleTableSlot *slot);
+static bool CopyFromParallelOK(CopyState cstate);
+static bool ParallelCopyFrom(CopyState cstate, const CopyStmt *stmt,
+							 uint64 *processed);
+static void ParallelCopySendBatch(ParallelCopyLeader *pcleader);
+static void ParallelCopyDetachQueues(ParallelCopyLeader *pcleader);
+static void ParallelCopyStoreString(ParallelContext *pcxt, uint64 key,
+									const char *str);
+static int	ParallelCopyNoData(void *outbuf, int minread, int maxread);
+static bool ParallelCopyGetLine(CopyState cstate);
 static bool CopyReadLine(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
 static int	CopyReadAttributesText(CopyState cstate);
@@ -1069,7 +1165,8 @@ DoCopy(ParseState *pstate, const CopyStmt *stmt,
 		cstate = BeginCopyFrom(pstate, rel, stmt->filename, stmt->is_program,
 							   NULL, stmt->attlist, stmt->options);
 		cstate->whereClause = whereClause;
-		*processed = CopyFrom(cstate);	/* copy from file to database */
+		if (!ParallelCopyFrom(cstate, stmt, processed))
+			*processed = CopyFrom(cstate);	/* copy from file to database */
 		EndCopyFrom(cstate);
 	}
 	else
@@ -1114,6 +1211,7 @@ ProcessCopyOptions(ParseState *pstate,
 				   List *options)
 {
 	bool		format_specified = false;
+	bool		parallel_specified = false;
 	ListCell   *option;
 
 	/* Support external use for option sanity checking */
@@ -1276,6 +1374,23 @@ ProcessCopyOptions(ParseState *pstate,
 								defel->defname),
 						 parser_errposition(pstate, defel->location)));
 		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			if (parallel_specified)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options"),
+						 parser_errposition(pstate, defel->location)));
+			parallel_specified = true;
+			cstate->nworkers = defGetInt32(defel);
+			if (cstate->nworkers < 0 ||
+				cstate->nworkers > MAX_PARALLEL_WORKER_LIMIT)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("argument to option \"%s\" must be between 0 and %d",
+								defel->defname, MAX_PARALLEL_WORKER_LIMIT),
+						 parser_errposition(pstate, defel->location)));
+		}
 		else if (strcmp(defel->defname, "encoding") == 0)
 		{
 			if (cstate->file_encoding >= 0)
@@ -1313,6 +1428,11 @@ ProcessCopyOptions(ParseState *pstate,
 				(errcode(ERRCODE_SYNTAX_ERROR),
 				 errmsg("cannot specify NULL in BINARY mode")));
 
+	if (cstate->binary && cstate->nworkers > 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("cannot specify PARALLEL in BINARY mode")));
+
 	/* Set defaults for omitted options */
 	if (!cstate->delim)
 		cstate->delim = cstate->csv_mode ? "," : "\t";
@@ -1429,6 +1549,12 @@ ProcessCopyOptions(ParseState *pstate,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("COPY force null only available using COPY FROM")));
 
+	/* Check parallel */
+	if (cstate->nworkers > 0 && !is_from)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY PARALLEL only available using COPY FROM")));
+
 	/* Don't allow the delimiter to appear in the null string. */
 	if (strchr(cstate->null_print, cstate->delim[0]) != NULL)
 		ereport(ERROR,
@@ -2669,7 +2795,7 @@ CopyFrom(CopyState cstate)
 
 	PartitionTupleRouting *proute = NULL;
 	ErrorContextCallback errcallback;
-	CommandId	mycid = GetCurrentCommandId(true);
+	CommandId	mycid;
 	int			ti_options = 0; /* start with default options for insert */
 	BulkInsertState bistate = NULL;
 	CopyInsertMethod insertMethod;
@@ -2715,6 +2841,18 @@ CopyFrom(CopyState cstate)
 							RelationGetRelationName(cstate->rel))));
 	}
 
+	/*
+	 * A parallel COPY worker inserts with the command ID of its leader, which
+	 * has already marked it as used.
+	 */
+	if (IsParallelWorker())
+	{
+		mycid = GetCurrentCommandId(false);
+		ti_options |= TABLE_INSERT_PARALLEL;
+	}
+	else
+		mycid = GetCurrentCommandId(true);
+
 	/*----------
 	 * Check to see if we can avoid writing WAL
 	 *
@@ -3374,6 +3512,453 @@ CopyFrom(CopyState cstate)
 	return processed;
 }
 
+/*
+ * Decide whether a COPY FROM can be performed by parallel workers.
+ *
+ * The workers insert rows on behalf of the leader, but they can't fire
+ * triggers, route tuples to partitions or evaluate anything that isn't
+ * parallel safe; in all those cases we do a serial COPY instead.
+ */
+static bool
+CopyFromParallelOK(CopyState cstate)
+{
+	Relation	rel = cstate->rel;
+	TupleDesc	tupDesc = RelationGetDescr(rel);
+	TupleConstr *constr = tupDesc->constr;
+	List	   *indexoidlist;
+	ListCell   *lc;
+	int			i;
+
+	if (!IsUnderPostmaster || IsInParallelMode() ||
+		cstate->binary || cstate->freeze ||
+		cstate->copy_dest == COPY_OLD_FE)
+		return false;
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION ||
+		rel->rd_rel->relam != HEAP_TABLE_AM_OID ||
+		RelationUsesLocalBuffers(rel) ||
+		rel->trigdesc != NULL)
+		return false;
+
+	/*
+	 * Workers don't know that the relfilenode is new in this transaction, so
+	 * they would WAL-log pages that a serial COPY might not.  Don't mix the
+	 * two.
+	 */
+	if (rel->rd_createSubid != InvalidSubTransactionId ||
+		rel->rd_newRelfilenodeSubid != InvalidSubTransactionId)
+		return false;
+
+	/* Check the input functions, and generated columns */
+	for (i = 0; i < tupDesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupDesc, i);
+
+		if (att->attisdropped)
+			continue;
+
+		/* domain_in would evaluate the domain's constraints */
+		if (func_parallel(cstate->in_functions[i].fn_oid) != PROPARALLEL_SAFE ||
+			get_typtype(att->atttypid) == TYPTYPE_DOMAIN)
+			return false;
+
+		if (att->attgenerated &&
+			!expression_is_parallel_safe(build_column_default(rel, i + 1)))
+			return false;
+	}
+
+	/* Check defaults for the columns not read from the input */
+	for (i = 0; i < cstate->num_defaults; i++)
+	{
+		if (!expression_is_parallel_safe((Node *) cstate->defexprs[i]->expr))
+			return false;
+	}
+
+	if (!expression_is_parallel_safe(cstate->whereClause))
+		return false;
+
+	if (constr != NULL)
+	{
+		for (i = 0; i < constr->num_check; i++)
+		{
+			if (!expression_is_parallel_safe(stringToNode(constr->check[i].ccbin)))
+				return false;
+		}
+	}
+
+	/* Check index expressions and predicates */
+	indexoidlist = RelationGetIndexList(rel);
+	foreach(lc, indexoidlist)
+	{
+		Relation	indexRel;
+		bool		safe;
+
+		indexRel = index_open(lfirst_oid(lc), RowExclusiveLock);
+		safe = expression_is_parallel_safe((Node *) RelationGetIndexExpressions(indexRel)) &&
+			expression_is_parallel_safe((Node *) RelationGetIndexPredicate(indexRel));
+		index_close(indexRel, NoLock);
+
+		if (!safe)
+			return false;
+	}
+	list_free(indexoidlist);
+
+	return true;
+}
+
+/*
+ * Perform a COPY FROM with the help of parallel workers, if it was requested
+ * and is possible.
+ *
+ * The leader does what only it can do: it reads the input and finds the line
+ * boundaries (which, in CSV mode, depend on quoting all the way back to the
+ * start of the input), converting each line to the server encoding.  The
+ * lines are sent to the workers in batches, and the workers parse them,
+ * convert the fields to datums and insert the rows within the leader's
+ * transaction.  Since every line carries its line number, errors raised by a
+ * worker point at the same line as a serial COPY's would.
+ *
+ * Returns false, without having read any input, if the caller should perform
+ * a serial COPY instead.
+ */
+static bool
+ParallelCopyFrom(CopyState cstate, const CopyStmt *stmt, uint64 *processed)
+{
+	ParallelCopyLeader pcleader;
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	ErrorContextCallback errcallback;
+	char	   *options;
+	char	   *attlist;
+	char	   *where;
+	char	   *queuespace;
+	int			request;
+	int			i;
+
+	request = Min(cstate->nworkers, max_parallel_maintenance_workers);
+	if (request <= 0 || !CopyFromParallelOK(cstate))
+		return false;
+
+	/*
+	 * The workers insert with our transaction ID and command ID, neither of
+	 * which can be assigned once we're in parallel mode.
+	 */
+	(void) GetCurrentTransactionId();
+	(void) GetCurrentCommandId(true);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "ParallelCopyMain", request);
+
+	options = nodeToString(stmt->options);
+	attlist = nodeToString(stmt->attlist);
+	where = nodeToString(cstate->whereClause);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(options) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(attlist) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(where) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(debug_query_string) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(PARALLEL_COPY_QUEUE_SIZE, pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 6);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (ParallelCopyShared *) shm_toc_allocate(pcxt->toc,
+													 sizeof(ParallelCopyShared));
+	shared->relid = RelationGetRelid(cstate->rel);
+	pg_atomic_init_u64(&shared->processed, 0);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_SHARED, shared);
+
+	ParallelCopyStoreString(pcxt, PARALLEL_COPY_KEY_OPTIONS, options);
+	ParallelCopyStoreString(pcxt, PARALLEL_COPY_KEY_ATTLIST, attlist);
+	ParallelCopyStoreString(pcxt, PARALLEL_COPY_KEY_WHERE, where);
+	ParallelCopyStoreString(pcxt, PARALLEL_COPY_KEY_QUERY_TEXT,
+							debug_query_string);
+
+	/* Create a queue for each worker, with ourselves as the sender */
+	pcleader.pcxt = pcxt;
+	pcleader.shared = shared;
+	pcleader.queues = (shm_mq_handle **)
+		palloc0(Max(pcxt->nworkers, 1) * sizeof(shm_mq_handle *));
+	queuespace = shm_toc_allocate(pcxt->toc,
+								  mul_size(PARALLEL_COPY_QUEUE_SIZE,
+										   pcxt->nworkers));
+	for (i = 0; i < pcxt->nworkers; i++)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queuespace + i * PARALLEL_COPY_QUEUE_SIZE,
+						   (Size) PARALLEL_COPY_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+		pcleader.queues[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_LINE_QUEUES, queuespace);
+
+	LaunchParallelWorkers(pcxt);
+
+	/* Drop the queues of workers that couldn't be launched */
+	for (i = pcxt->nworkers_launched; i < pcxt->nworkers; i++)
+		shm_mq_detach(pcleader.queues[i]);
+	pcleader.nqueues = pcxt->nworkers_launched;
+
+	/* If no workers were launched, back out (do serial COPY) */
+	if (pcleader.nqueues == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	/* Let the queues notice if a worker dies before attaching */
+	for (i = 0; i < pcleader.nqueues; i++)
+		shm_mq_set_handle(pcleader.queues[i], pcxt->worker[i].bgwhandle);
+
+	pcleader.nextqueue = 0;
+	initStringInfo(&pcleader.batch);
+	pcleader.batch_lines = 0;
+
+	/*
+	 * Set up callback to identify error line number.  It's installed only
+	 * while we read the input: errors relayed from the workers carry their
+	 * own context, which must not be mixed up with our position.
+	 */
+	errcallback.callback = CopyFromErrorCallback;
+	errcallback.arg = (void *) cstate;
+	errcallback.previous = error_context_stack;
+
+	for (;;)
+	{
+		bool		done;
+		uint32		len;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Read the next line, as NextCopyFromRawFields would */
+		error_context_stack = &errcallback;
+
+		/* on input just throw the header line away */
+		if (cstate->cur_lineno == 0 && cstate->header_line)
+		{
+			cstate->cur_lineno++;
+			if (CopyReadLine(cstate))
+				break;			/* done */
+		}
+
+		cstate->cur_lineno++;
+		done = CopyReadLine(cstate);
+
+		error_context_stack = errcallback.previous;
+
+		/* EOF at start of line means we're done */
+		if (done && cstate->line_buf.len == 0)
+			break;
+
+		len = cstate->line_buf.len;
+		appendBinaryStringInfo(&pcleader.batch,
+							   (char *) &cstate->cur_lineno, sizeof(uint64));
+		appendBinaryStringInfo(&pcleader.batch, (char *) &len, sizeof(uint32));
+		appendBinaryStringInfo(&pcleader.batch, cstate->line_buf.data, len);
+
+		if (++pcleader.batch_lines >= PARALLEL_COPY_BATCH_LINES ||
+			pcleader.batch.len >= PARALLEL_COPY_BATCH_SIZE)
+			ParallelCopySendBatch(&pcleader);
+
+		if (done)
+			break;
+	}
+	error_context_stack = errcallback.previous;
+
+	if (pcleader.batch_lines > 0)
+		ParallelCopySendBatch(&pcleader);
+
+	/* Detaching tells the workers there are no more lines */
+	ParallelCopyDetachQueues(&pcleader);
+	WaitForParallelWorkersToFinish(pcxt);
+
+	*processed = pg_atomic_read_u64(&shared->processed);
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return true;
+}
+
+/*
+ * Send the batch of lines assembled by the leader of a parallel COPY FROM to
+ * the next worker in turn.
+ */
+static void
+ParallelCopySendBatch(ParallelCopyLeader *pcleader)
+{
+	shm_mq_result res;
+
+	res = shm_mq_send(pcleader->queues[pcleader->nextqueue],
+					  pcleader->batch.len, pcleader->batch.data, false);
+	if (res != SHM_MQ_SUCCESS)
+	{
+		/*
+		 * The worker has gone away.  Let the others finish, so that waiting
+		 * for them reports the worker's error if it raised one.
+		 */
+		ParallelCopyDetachQueues(pcleader);
+		WaitForParallelWorkersToFinish(pcleader->pcxt);
+		elog(ERROR, "lost connection to parallel COPY worker");
+	}
+
+	pcleader->nextqueue = (pcleader->nextqueue + 1) % pcleader->nqueues;
+	resetStringInfo(&pcleader->batch);
+	pcleader->batch_lines = 0;
+}
+
+/*
+ * Detach from the queues of all the launched workers of a parallel COPY FROM.
+ */
+static void
+ParallelCopyDetachQueues(ParallelCopyLeader *pcleader)
+{
+	int			i;
+
+	for (i = 0; i < pcleader->nqueues; i++)
+		shm_mq_detach(pcleader->queues[i]);
+	pcleader->nqueues = 0;
+}
+
+/*
+ * Store a string in the DSM segment of a parallel COPY FROM, under 'key'.
+ */
+static void
+ParallelCopyStoreString(ParallelContext *pcxt, uint64 key, const char *str)
+{
+	Size		len = strlen(str) + 1;
+	char	   *sharedstr;
+
+	sharedstr = (char *) shm_toc_allocate(pcxt->toc, len);
+	memcpy(sharedstr, str, len);
+	shm_toc_insert(pcxt->toc, key, sharedstr);
+}
+
+/*
+ * Data source callback for the workers of a parallel COPY FROM, which never
+ * read the input themselves.
+ */
+static int
+ParallelCopyNoData(void *outbuf, int minread, int maxread)
+{
+	elog(ERROR, "parallel COPY worker cannot read COPY data");
+	return 0;					/* keep compiler quiet */
+}
+
+/*
+ * Load the next line sent by the leader of a parallel COPY FROM into
+ * line_buf, and set cur_lineno to its position in the input.
+ *
+ * Returns false when the leader has no more lines for us.
+ */
+static bool
+ParallelCopyGetLine(CopyState cstate)
+{
+	uint64		lineno;
+	uint32		len;
+
+	if (cstate->line_batch_pos >= cstate->line_batch_len)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+
+		res = shm_mq_receive(cstate->line_queue, &nbytes, &data, false);
+		if (res == SHM_MQ_DETACHED)
+			return false;
+		Assert(res == SHM_MQ_SUCCESS && nbytes > 0);
+
+		cstate->line_batch = (char *) data;
+		cstate->line_batch_len = nbytes;
+		cstate->line_batch_pos = 0;
+	}
+
+	memcpy(&lineno, cstate->line_batch + cstate->line_batch_pos,
+		   sizeof(uint64));
+	cstate->line_batch_pos += sizeof(uint64);
+	memcpy(&len, cstate->line_batch + cstate->line_batch_pos, sizeof(uint32));
+	cstate->line_batch_pos += sizeof(uint32);
+	Assert(cstate->line_batch_pos + len <= cstate->line_batch_len);
+
+	resetStringInfo(&cstate->line_buf);
+	appendBinaryStringInfo(&cstate->line_buf,
+						   cstate->line_batch + cstate->line_batch_pos, len);
+	cstate->line_batch_pos += len;
+
+	cstate->cur_lineno = lineno;
+	cstate->line_buf_valid = true;
+	cstate->line_buf_converted = true;
+
+	return true;
+}
+
+/*
+ * Main entry point for the workers of a parallel COPY FROM.
+ */
+void
+ParallelCopyMain(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCopyShared *shared;
+	ParseState *pstate;
+	Relation	rel;
+	CopyState	cstate;
+	List	   *options;
+	List	   *attnamelist;
+	Node	   *whereClause;
+	char	   *queuespace;
+	shm_mq	   *mq;
+	uint64		processed;
+
+	/* Set debug_query_string for individual workers */
+	debug_query_string = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUERY_TEXT,
+										false);
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	shared = (ParallelCopyShared *) shm_toc_lookup(toc, PARALLEL_COPY_KEY_SHARED,
+												   false);
+	options = (List *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_OPTIONS, false));
+	attnamelist = (List *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_ATTLIST, false));
+	whereClause = (Node *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_WHERE, false));
+
+	/* Attach to our queue of lines */
+	queuespace = shm_toc_lookup(toc, PARALLEL_COPY_KEY_LINE_QUEUES, false);
+	mq = (shm_mq *) (queuespace +
+					 ParallelWorkerNumber * PARALLEL_COPY_QUEUE_SIZE);
+	shm_mq_set_receiver(mq, MyProc);
+
+	/* The leader holds a lock of the same mode, which we share */
+	rel = table_open(shared->relid, RowExclusiveLock);
+
+	/* CopyFrom expects the relation to be first in the range table */
+	pstate = make_parsestate(NULL);
+	(void) addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										 NULL, false, false);
+
+	cstate = BeginCopyFrom(pstate, rel, NULL, false, ParallelCopyNoData,
+						   attnamelist, options);
+	cstate->whereClause = whereClause;
+	/* the leader has already skipped any header line */
+	cstate->header_line = false;
+	cstate->line_queue = shm_mq_attach(mq, seg, NULL);
+
+	processed = CopyFrom(cstate);
+
+	EndCopyFrom(cstate);
+	free_parsestate(pstate);
+	table_close(rel, RowExclusiveLock);
+
+	pg_atomic_add_fetch_u64(&shared->processed, processed);
+}
+
 /*
  * Setup to read tuples from a file for COPY FROM.
  *
@@ -3642,26 +4227,35 @@ NextCopyFromRawFields(CopyState cstate, char ***fields, int *nfields)
 	/* only available for text or csv input */
 	Assert(!cstate->binary);
 
-	/* on input just throw the header line away */
-	if (cstate->cur_lineno == 0 && cstate->header_line)
+	if (cstate->line_queue != NULL)
 	{
-		cstate->cur_lineno++;
-		if (CopyReadLine(cstate))
-			return false;		/* done */
+		/* In a parallel COPY worker, the leader has read the line for us */
+		if (!ParallelCopyGetLine(cstate))
+			return false;
 	}
+	else
+	{
+		/* on input just throw the header line away */
+		if (cstate->cur_lineno == 0 && cstate->header_line)
+		{
+			cstate->cur_lineno++;
+			if (CopyReadLine(cstate))
+				return false;	/* done */
+		}
 
-	cstate->cur_lineno++;
+		cstate->cur_lineno++;
 
-	/* Actually read the line into memory here */
-	done = CopyReadLine(cstate);
+		/* Actually read the line into memory here */
+		done = CopyReadLine(cstate);
 
-	/*
-	 * EOF at start of line means we're done.  If we see EOF after some
-	 * characters, we act as though it was newline followed by EOF, ie,
-	 * process the line and then exit loop on next iteration.
-	 */
-	if (done && cstate->line_buf.len == 0)
-		return false;
+		/*
+		 * EOF at start of line means we're done.  If we see EOF after some
+		 * characters, we act as though it was newline followed by EOF, ie,
+		 * process the line and then exit loop on next iteration.
+		 */
+		if (done && cstate->line_buf.len == 0)
+			return false;
+	}
 
 	/* Parse the line into de-escaped field values */
 	if (cstate->csv_mode)
@@ -3996,6 +4590,10 @@ CopyReadLineText(CopyState cstate)
 	char		quotec = '\0';
 	char		escapec = '\0';
 
+	/* characters that stop a bulk skip, besides \r and \n */
+	char		stopc1 = '\\';
+	char		stopc2 = '\\';
+
 	if (cstate->csv_mode)
 	{
 		quotec = cstate->quote[0];
@@ -4003,6 +4601,10 @@ CopyReadLineText(CopyState cstate)
 		/* ignore special escape processing if it's the same as quotec */
 		if (quotec == escapec)
 			escapec = '\0';
+
+		/* after the first character of a line, backslash isn't special */
+		stopc1 = quotec;
+		stopc2 = escapec ? escapec : quotec;
 	}
 
 	mblen_str[1] = '\0';
@@ -4072,6 +4674,31 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip in bulk over data that can't end the line or change our CSV
+		 * state.  That doesn't include the first character of a line, which
+		 * might start an end-of-copy marker.  In encodings that embed ASCII,
+		 * bytes with the high bit set must go through the multi-byte logic
+		 * below.
+		 */
+		if (!first_char_in_line)
+		{
+			int			skip;
+
+			skip = CopySkipPlainBytes(&copy_raw_buf[raw_buf_ptr],
+									  copy_buf_len - raw_buf_ptr,
+									  '\n', '\r', stopc1, stopc2,
+									  cstate->encoding_embeds_ascii);
+			if (skip > 0)
+			{
+				raw_buf_ptr += skip;
+				/* an ordinary character ends any escape sequence */
+				last_was_esc = false;
+				if (raw_buf_ptr >= copy_buf_len)
+					continue;
+			}
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -4445,6 +5072,17 @@ CopyReadAttributesText(CopyState cstate)
 		for (;;)
 		{
 			char		c;
+			int			skip;
+
+			/* Copy runs of bytes that need no de-escaping in bulk */
+			skip = CopySkipPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+									  delimc, '\\', delimc, '\\', false);
+			if (skip > 0)
+			{
+				memcpy(output_ptr, cur_ptr, skip);
+				output_ptr += skip;
+				cur_ptr += skip;
+			}
 
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
@@ -4675,6 +5313,18 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* Not in quote */
 			for (;;)
 			{
+				int			skip;
+
+				skip = CopySkipPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+										  delimc, quotec, delimc, quotec,
+										  false);
+				if (skip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, skip);
+					output_ptr += skip;
+					cur_ptr += skip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -4698,6 +5348,18 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* In quote */
 			for (;;)
 			{
+				int			skip;
+
+				skip = CopySkipPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+										  quotec, escapec, quotec, escapec,
+										  false);
+				if (skip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, skip);
+					output_ptr += skip;
+					cur_ptr += skip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
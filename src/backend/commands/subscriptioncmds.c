@@ -50,10 +50,13 @@
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/regproc.h"
 #include "utils/syscache.h"
 #include "utils/varlena.h"
 
 static List *fetch_table_list(WalReceiverConn *wrconn, List *publications);
+static Oid	get_conflict_table_oid(const char *relname);
+static void record_conflict_table_dependency(Oid subid, Oid conflict_relid);
 
 /*
  * Common option parsing function for CREATE and ALTER SUBSCRIPTION commands.
@@ -67,7 +70,9 @@ parse_subscription_options(List *options, bool *connect, bool *enabled_given,
 						   bool *enabled, bool *create_slot,
 						   bool *slot_name_given, char **slot_name,
 						   bool *copy_data, char **synchronous_commit,
-						   bool *refresh, List **filtered_origins, Oid *roident)
+						   bool *refresh, List **filtered_origins, Oid *roident,
+						   char *conflict_resolution,
+						   bool *conflict_table_given, Oid *conflict_relid)
 {
 	ListCell   *lc;
 	bool		connect_given = false;
@@ -103,6 +108,13 @@ parse_subscription_options(List *options, bool *connect, bool *enabled_given,
 		*filtered_origins = NIL;
 	if (roident)
 		*roident = InvalidOid;
+	if (conflict_resolution)
+		*conflict_resolution = '\0';
+	if (conflict_relid)
+	{
+		*conflict_table_given = false;
+		*conflict_relid = InvalidOid;
+	}
 
 	/* Parse options */
 	foreach(lc, options)
@@ -222,6 +234,48 @@ parse_subscription_options(List *options, bool *connect, bool *enabled_given,
 						 errmsg("replication origin OID out of valid range (1..%u)", PG_UINT16_MAX)));
 			*roident = (Oid) tmp;
 		}
+		else if (strcmp(defel->defname, "conflict_resolution") == 0 &&
+				 conflict_resolution)
+		{
+			char	   *method;
+
+			if (*conflict_resolution != '\0')
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			method = defGetString(defel);
+			if (strcmp(method, "error") == 0)
+				*conflict_resolution = SUBCONFLICT_ERROR;
+			else if (strcmp(method, "skip") == 0)
+				*conflict_resolution = SUBCONFLICT_SKIP;
+			else if (strcmp(method, "last_update_wins") == 0)
+				*conflict_resolution = SUBCONFLICT_LAST_UPDATE_WINS;
+			else if (strcmp(method, "log") == 0)
+				*conflict_resolution = SUBCONFLICT_LOG;
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("unrecognized value for subscription parameter \"%s\": \"%s\"",
+								"conflict_resolution", method)));
+		}
+		else if (strcmp(defel->defname, "conflict_table") == 0 &&
+				 conflict_relid)
+		{
+			char	   *relname;
+
+			if (*conflict_table_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			*conflict_table_given = true;
+			relname = defGetString(defel);
+
+			/* Setting conflict_table = NONE is treated as no table. */
+			if (strcmp(relname, "none") != 0)
+				*conflict_relid = get_conflict_table_oid(relname);
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -294,6 +348,68 @@ parse_subscription_options(List *options, bool *connect, bool *enabled_given,
 	}
 }
 
+/*
+ * Look up the table named by the conflict_table option.
+ *
+ * The apply worker fills the columns it knows about by name (see
+ * log_apply_conflict in worker.c), so we only insist on a plain table here.
+ */
+static Oid
+get_conflict_table_oid(const char *relname)
+{
+	List	   *names;
+	Oid			relid;
+
+	names = stringToQualifiedNameList(relname);
+	relid = RangeVarGetRelid(makeRangeVarFromNameList(names), AccessShareLock,
+							 false);
+
+	if (get_rel_relkind(relid) != RELKIND_RELATION)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("conflict table \"%s\" is not a table", relname)));
+
+	return relid;
+}
+
+/*
+ * Record that the subscription depends on its conflict table, replacing any
+ * dependency on a previous conflict table.
+ *
+ * This keeps the table from being dropped while the apply worker may still
+ * write to it, and makes pg_dump restore it before the subscription.
+ */
+static void
+record_conflict_table_dependency(Oid subid, Oid conflict_relid)
+{
+	ObjectAddress myself;
+	ObjectAddress referenced;
+
+	deleteDependencyRecordsForClass(SubscriptionRelationId, subid,
+									RelationRelationId, DEPENDENCY_NORMAL);
+
+	if (!OidIsValid(conflict_relid))
+		return;
+
+	ObjectAddressSet(myself, SubscriptionRelationId, subid);
+	ObjectAddressSet(referenced, RelationRelationId, conflict_relid);
+	recordDependencyOn(&myself, &referenced, DEPENDENCY_NORMAL);
+}
+
+/*
+ * Check that the conflict resolution method and the conflict table of a
+ * subscription go together.
+ */
+static void
+check_conflict_options(char conflict_resolution, Oid conflict_relid)
+{
+	if (conflict_resolution == SUBCONFLICT_LOG && !OidIsValid(conflict_relid))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("subscription with %s must also set %s",
+						"conflict_resolution = log", "conflict_table")));
+}
+
 /*
  * Auxiliary function to return a Oid array out of a list of Oids.
  */
@@ -429,6 +545,9 @@ CreateSubscription(CreateSubscriptionStmt *stmt, bool isTopLevel)
 	List	   *publications;
 	List	   *filtered_origins;
 	Oid			roident;
+	char		conflict_resolution;
+	bool		conflict_table_given;
+	Oid			conflict_relid;
 
 	/*
 	 * Parse and check options.
@@ -438,7 +557,14 @@ CreateSubscription(CreateSubscriptionStmt *stmt, bool isTopLevel)
 	parse_subscription_options(stmt->options, &connect, &enabled_given,
 							   &enabled, &create_slot, &slotname_given,
 							   &slotname, &copy_data, &synchronous_commit,
-							   NULL, &filtered_origins, &roident);
+							   NULL, &filtered_origins, &roident,
+							   &conflict_resolution, &conflict_table_given,
+							   &conflict_relid);
+
+	/* The default is to stop at the first conflict. */
+	if (conflict_resolution == '\0')
+		conflict_resolution = SUBCONFLICT_ERROR;
+	check_conflict_options(conflict_resolution, conflict_relid);
 
 	/*
 	 * Since creating a replication slot is not transactional, rolling back
@@ -521,6 +647,10 @@ CreateSubscription(CreateSubscriptionStmt *stmt, bool isTopLevel)
 	else
 		nulls[Anum_pg_subscription_subfilterorigins - 1] = true;
 	values[Anum_pg_subscription_subroident - 1] = ObjectIdGetDatum(roident);
+	values[Anum_pg_subscription_subconflictres - 1] =
+		CharGetDatum(conflict_resolution);
+	values[Anum_pg_subscription_subconflictrelid - 1] =
+		ObjectIdGetDatum(conflict_relid);
 
 	tup = heap_form_tuple(RelationGetDescr(rel), values, nulls);
 
@@ -529,6 +659,7 @@ CreateSubscription(CreateSubscriptionStmt *stmt, bool isTopLevel)
 	heap_freetuple(tup);
 
 	recordDependencyOnOwner(SubscriptionRelationId, subid, owner);
+	record_conflict_table_dependency(subid, conflict_relid);
 
 	snprintf(originname, sizeof(originname), "pg_%u", subid);
 	if (OidIsValid(roident))
@@ -790,10 +921,15 @@ AlterSubscription(AlterSubscriptionStmt *stmt)
 				char	   *synchronous_commit;
 				List	   *filtered_origins;
 				Oid			roident;
+				char		conflict_resolution;
+				bool		conflict_table_given;
+				Oid			conflict_relid;
 
 				parse_subscription_options(stmt->options, NULL, NULL, NULL,
 										   NULL, &slotname_given, &slotname,
-										   NULL, &synchronous_commit, NULL, &filtered_origins, &roident);
+										   NULL, &synchronous_commit, NULL, &filtered_origins, &roident,
+										   &conflict_resolution, &conflict_table_given,
+										   &conflict_relid);
 
 				if (OidIsValid(roident))
 					ereport(ERROR,
@@ -831,6 +967,24 @@ AlterSubscription(AlterSubscriptionStmt *stmt)
 				}
 				list_free(filtered_origins);
 
+				if (conflict_resolution != '\0' || conflict_table_given)
+				{
+					if (conflict_resolution == '\0')
+						conflict_resolution = sub->conflictres;
+					if (!conflict_table_given)
+						conflict_relid = sub->conflictrelid;
+					check_conflict_options(conflict_resolution, conflict_relid);
+
+					values[Anum_pg_subscription_subconflictres - 1] =
+						CharGetDatum(conflict_resolution);
+					replaces[Anum_pg_subscription_subconflictres - 1] = true;
+					values[Anum_pg_subscription_subconflictrelid - 1] =
+						ObjectIdGetDatum(conflict_relid);
+					replaces[Anum_pg_subscription_subconflictrelid - 1] = true;
+
+					record_conflict_table_dependency(subid, conflict_relid);
+				}
+
 				/*
 				 * If we allow to change replication_origin_id we should change
 				 * replication origin identifier too. However, it means that we
@@ -852,7 +1006,8 @@ AlterSubscription(AlterSubscriptionStmt *stmt)
 
 				parse_subscription_options(stmt->options, NULL,
 										   &enabled_given, &enabled, NULL,
-										   NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+										   NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+										   NULL, NULL, NULL);
 				Assert(enabled_given);
 
 				if (!sub->slotname && enabled)
@@ -890,7 +1045,8 @@ AlterSubscription(AlterSubscriptionStmt *stmt)
 
 				parse_subscription_options(stmt->options, NULL, NULL, NULL,
 										   NULL, NULL, NULL, &copy_data,
-										   NULL, &refresh, NULL, NULL);
+										   NULL, &refresh, NULL, NULL,
+										   NULL, NULL, NULL);
 
 				values[Anum_pg_subscription_subpublications - 1] =
 					publicationListToArray(stmt->publication);
@@ -927,7 +1083,8 @@ AlterSubscription(AlterSubscriptionStmt *stmt)
 
 				parse_subscription_options(stmt->options, NULL, NULL, NULL,
 										   NULL, NULL, NULL, &copy_data,
-										   NULL, NULL, NULL, NULL);
+										   NULL, NULL, NULL, NULL,
+										   NULL, NULL, NULL);
 
 				AlterSubscription_refresh(sub, copy_data);
 
@@ -1097,6 +1254,7 @@ DropSubscription(DropSubscriptionStmt *stmt, bool isTopLevel)
 
 	/* Clean up dependencies */
 	deleteSharedDependencyRecordsFor(SubscriptionRelationId, subid, 0);
+	deleteDependencyRecordsFor(SubscriptionRelationId, subid, false);
 
 	/* Remove any associated relation synchronization states. */
 	RemoveSubscriptionRel(subid, InvalidOid);
@@ -0,0 +1,615 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Batch-at-a-time evaluation of simple scan quals and aggregates.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ * DESCRIPTION
+ *
+ *	The regular executor passes one tuple at a time from node to node and
+ *	evaluates expressions through ExecEvalExpr, which costs a few function
+ *	calls and branches per row and column.  For the simplest and most
+ *	common shape of analytic query, an ungrouped aggregate directly over a
+ *	sequential scan, that overhead dominates.  When batch_execution is
+ *	enabled, such a scan collects up to EXEC_BATCH_SIZE rows at a time into
+ *	per-column arrays, filters them with quals of the form "column op
+ *	constant" in a loop per qual, and the aggregate consumes the qualifying
+ *	rows with a loop per aggregate.
+ *
+ *	Only int4, int8 and float8 columns, their comparison operators, and
+ *	count, sum, min and max are handled here.  The callers check what can be
+ *	processed this way before execution starts, and use the regular
+ *	row-at-a-time code for anything else.  The loops must produce the same
+ *	results as the corresponding operator and transition functions do.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "common/int.h"
+#include "executor/execBatch.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/float.h"
+#include "utils/fmgroids.h"
+
+
+/* GUC parameter */
+bool		batch_execution = false;
+
+
+/*
+ * Create an empty batch.  Add the columns with ExecBatchAddColumn, and the
+ * quals with ExecBatchAddQual, then call ExecBatchAllocate.
+ */
+ExecBatch *
+ExecBatchCreate(void)
+{
+	ExecBatch  *batch = (ExecBatch *) palloc0(sizeof(ExecBatch));
+
+	batch->maxcols = 8;
+	batch->attnums = (AttrNumber *) palloc(batch->maxcols * sizeof(AttrNumber));
+	batch->quals = NULL;
+	batch->rowquals = false;
+
+	return batch;
+}
+
+/*
+ * Return the index of the batch column holding table column 'attnum',
+ * adding it if not present yet.
+ */
+int
+ExecBatchAddColumn(ExecBatch *batch, AttrNumber attnum)
+{
+	int			col;
+
+	Assert(attnum > 0);
+	Assert(batch->values == NULL);
+
+	for (col = 0; col < batch->ncols; col++)
+	{
+		if (batch->attnums[col] == attnum)
+			return col;
+	}
+
+	if (batch->ncols >= batch->maxcols)
+	{
+		batch->maxcols *= 2;
+		batch->attnums = (AttrNumber *)
+			repalloc(batch->attnums, batch->maxcols * sizeof(AttrNumber));
+	}
+	batch->attnums[batch->ncols] = attnum;
+	batch->maxattnum = Max(batch->maxattnum, attnum);
+
+	return batch->ncols++;
+}
+
+/*
+ * Allocate the arrays holding the data, once all columns have been added.
+ */
+void
+ExecBatchAllocate(ExecBatch *batch)
+{
+	int			col;
+
+	batch->values = (Datum **) palloc(Max(batch->ncols, 1) * sizeof(Datum *));
+	batch->isnull = (bool **) palloc(Max(batch->ncols, 1) * sizeof(bool *));
+	for (col = 0; col < batch->ncols; col++)
+	{
+		batch->values[col] = (Datum *) palloc(EXEC_BATCH_SIZE * sizeof(Datum));
+		batch->isnull[col] = (bool *) palloc(EXEC_BATCH_SIZE * sizeof(bool));
+	}
+	batch->sel = (uint16 *) palloc(EXEC_BATCH_SIZE * sizeof(uint16));
+	batch->nrows = 0;
+	batch->nsel = 0;
+}
+
+/*
+ * Map the type of a column to its BatchType.  int8 and float8 values are
+ * only handled if passed by value: otherwise the Datums collected in a
+ * batch would point into buffers that may no longer be pinned.
+ */
+static bool
+batch_type_for(Oid typid, BatchType *type)
+{
+	switch (typid)
+	{
+		case INT4OID:
+			*type = BATCH_INT4;
+			return true;
+		case INT8OID:
+			*type = BATCH_INT8;
+			return FLOAT8PASSBYVAL;
+		case FLOAT8OID:
+			*type = BATCH_FLOAT8;
+			return FLOAT8PASSBYVAL;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Map the function of a comparison operator to its type and comparison.
+ */
+static bool
+batch_cmp_for(Oid funcid, BatchType *type, BatchCmp *cmp)
+{
+	switch (funcid)
+	{
+		case F_INT4LT:
+		case F_INT8LT:
+		case F_FLOAT8LT:
+			*cmp = BATCH_LT;
+			break;
+		case F_INT4LE:
+		case F_INT8LE:
+		case F_FLOAT8LE:
+			*cmp = BATCH_LE;
+			break;
+		case F_INT4EQ:
+		case F_INT8EQ:
+		case F_FLOAT8EQ:
+			*cmp = BATCH_EQ;
+			break;
+		case F_INT4NE:
+		case F_INT8NE:
+		case F_FLOAT8NE:
+			*cmp = BATCH_NE;
+			break;
+		case F_INT4GE:
+		case F_INT8GE:
+		case F_FLOAT8GE:
+			*cmp = BATCH_GE;
+			break;
+		case F_INT4GT:
+		case F_INT8GT:
+		case F_FLOAT8GT:
+			*cmp = BATCH_GT;
+			break;
+		default:
+			return false;
+	}
+
+	switch (funcid)
+	{
+		case F_INT4LT:
+		case F_INT4LE:
+		case F_INT4EQ:
+		case F_INT4NE:
+		case F_INT4GE:
+		case F_INT4GT:
+			return batch_type_for(INT4OID, type);
+		case F_INT8LT:
+		case F_INT8LE:
+		case F_INT8EQ:
+		case F_INT8NE:
+		case F_INT8GE:
+		case F_INT8GT:
+			return batch_type_for(INT8OID, type);
+		default:
+			return batch_type_for(FLOAT8OID, type);
+	}
+}
+
+/* "a op b" is the same as "b commuted-op a" */
+static BatchCmp
+batch_cmp_commute(BatchCmp cmp)
+{
+	switch (cmp)
+	{
+		case BATCH_LT:
+			return BATCH_GT;
+		case BATCH_LE:
+			return BATCH_GE;
+		case BATCH_GE:
+			return BATCH_LE;
+		case BATCH_GT:
+			return BATCH_LT;
+		default:
+			return cmp;
+	}
+}
+
+/*
+ * Add a scan qual to be evaluated on the batch, if it is a comparison of a
+ * column of relation 'scanrelid' with a non-null constant.  Returns false if
+ * the qual can't be evaluated this way.
+ */
+bool
+ExecBatchAddQual(ExecBatch *batch, Expr *qual, Index scanrelid)
+{
+	OpExpr	   *op;
+	Node	   *left;
+	Node	   *right;
+	Var		   *var;
+	Const	   *con;
+	BatchQual  *bqual;
+	BatchType	type;
+	BatchCmp	cmp;
+
+	if (!IsA(qual, OpExpr))
+		return false;
+	op = (OpExpr *) qual;
+	if (list_length(op->args) != 2)
+		return false;
+
+	set_opfuncid(op);
+	if (!batch_cmp_for(op->opfuncid, &type, &cmp))
+		return false;
+
+	left = (Node *) linitial(op->args);
+	right = (Node *) lsecond(op->args);
+	if (IsA(left, Var) && IsA(right, Const))
+	{
+		var = (Var *) left;
+		con = (Const *) right;
+	}
+	else if (IsA(left, Const) && IsA(right, Var))
+	{
+		var = (Var *) right;
+		con = (Const *) left;
+		cmp = batch_cmp_commute(cmp);
+	}
+	else
+		return false;
+
+	if (var->varno != scanrelid || var->varattno <= 0 ||
+		var->varlevelsup != 0 || con->constisnull)
+		return false;
+
+	if (batch->nquals == 0)
+		batch->quals = (BatchQual *) palloc(sizeof(BatchQual));
+	else
+		batch->quals = (BatchQual *)
+			repalloc(batch->quals, (batch->nquals + 1) * sizeof(BatchQual));
+	bqual = &batch->quals[batch->nquals++];
+	bqual->col = ExecBatchAddColumn(batch, var->varattno);
+	bqual->type = type;
+	bqual->cmp = cmp;
+	bqual->constval = con->constvalue;
+
+	return true;
+}
+
+/*
+ * Loops filtering the selection vector by one comparison, generated for each
+ * datatype.  Rows with a NULL in the column never qualify, as the
+ * comparison operators are strict.
+ */
+#define BATCH_FILTER(GETVAL, OP) \
+	do { \
+		for (i = 0; i < nsel; i++) \
+		{ \
+			int			row = sel[i]; \
+			\
+			if (!isnull[row] && OP(GETVAL(values[row]), c)) \
+				sel[nout++] = row; \
+		} \
+	} while (0)
+
+#define BATCH_FILTER_FUNC(NAME, CTYPE, GETVAL, LT, LE, EQ, NE, GE, GT) \
+static int \
+NAME(const Datum *values, const bool *isnull, uint16 *sel, int nsel, \
+	 BatchCmp cmp, Datum constval) \
+{ \
+	CTYPE		c = GETVAL(constval); \
+	int			nout = 0; \
+	int			i; \
+	\
+	switch (cmp) \
+	{ \
+		case BATCH_LT: \
+			BATCH_FILTER(GETVAL, LT); \
+			break; \
+		case BATCH_LE: \
+			BATCH_FILTER(GETVAL, LE); \
+			break; \
+		case BATCH_EQ: \
+			BATCH_FILTER(GETVAL, EQ); \
+			break; \
+		case BATCH_NE: \
+			BATCH_FILTER(GETVAL, NE); \
+			break; \
+		case BATCH_GE: \
+			BATCH_FILTER(GETVAL, GE); \
+			break; \
+		case BATCH_GT: \
+			BATCH_FILTER(GETVAL, GT); \
+			break; \
+	} \
+	return nout; \
+}
+
+#define INT_LT(a, b) ((a) < (b))
+#define INT_LE(a, b) ((a) <= (b))
+#define INT_EQ(a, b) ((a) == (b))
+#define INT_NE(a, b) ((a) != (b))
+#define INT_GE(a, b) ((a) >= (b))
+#define INT_GT(a, b) ((a) > (b))
+
+BATCH_FILTER_FUNC(batch_filter_int4, int32, DatumGetInt32,
+				  INT_LT, INT_LE, INT_EQ, INT_NE, INT_GE, INT_GT)
+BATCH_FILTER_FUNC(batch_filter_int8, int64, DatumGetInt64,
+				  INT_LT, INT_LE, INT_EQ, INT_NE, INT_GE, INT_GT)
+/* float8_lt() etc. give NaN the same treatment as the SQL operators */
+BATCH_FILTER_FUNC(batch_filter_float8, float8, DatumGetFloat8,
+				  float8_lt, float8_le, float8_eq, float8_ne, float8_ge,
+				  float8_gt)
+
+/*
+ * Evaluate the quals on the rows of the batch, leaving the qualifying ones
+ * in the selection vector.
+ */
+void
+ExecBatchEvalQuals(ExecBatch *batch)
+{
+	int			i;
+
+	for (i = 0; i < batch->nrows; i++)
+		batch->sel[i] = i;
+	batch->nsel = batch->nrows;
+
+	for (i = 0; i < batch->nquals && batch->nsel > 0; i++)
+	{
+		BatchQual  *qual = &batch->quals[i];
+		const Datum *values = batch->values[qual->col];
+		const bool *isnull = batch->isnull[qual->col];
+
+		switch (qual->type)
+		{
+			case BATCH_INT4:
+				batch->nsel = batch_filter_int4(values, isnull, batch->sel,
+												batch->nsel, qual->cmp,
+												qual->constval);
+				break;
+			case BATCH_INT8:
+				batch->nsel = batch_filter_int8(values, isnull, batch->sel,
+												batch->nsel, qual->cmp,
+												qual->constval);
+				break;
+			case BATCH_FLOAT8:
+				batch->nsel = batch_filter_float8(values, isnull, batch->sel,
+												  batch->nsel, qual->cmp,
+												  qual->constval);
+				break;
+		}
+	}
+}
+
+/*
+ * Determine whether an aggregate with transition function 'transfn_oid'
+ * can be advanced by ExecBatchAdvanceAgg, and set up 'agg' for it.
+ * 'inputtype' is the type of the aggregated column, or InvalidOid for
+ * count(*).  The caller fills in agg->col.
+ */
+bool
+ExecBatchCompileAgg(Oid transfn_oid, Oid inputtype, BatchAgg *agg)
+{
+	Oid			expected;
+
+	agg->col = -1;
+	switch (transfn_oid)
+	{
+		case F_INT8INC:
+			/* count(*); the count is an int8 */
+			agg->kind = BATCH_AGG_COUNT_STAR;
+			agg->type = BATCH_INT8;
+			return !OidIsValid(inputtype);
+		case F_INT8INC_ANY:
+			/* count(column) only looks at the nulls, so any type will do */
+			agg->kind = BATCH_AGG_COUNT;
+			agg->type = BATCH_INT8;
+			return OidIsValid(inputtype);
+		case F_INT4_SUM:
+			/* the state is an int8 */
+			agg->kind = BATCH_AGG_SUM;
+			expected = INT4OID;
+			break;
+		case F_FLOAT8PL:
+			agg->kind = BATCH_AGG_SUM;
+			expected = FLOAT8OID;
+			break;
+		case F_INT4SMALLER:
+			agg->kind = BATCH_AGG_MIN;
+			expected = INT4OID;
+			break;
+		case F_INT4LARGER:
+			agg->kind = BATCH_AGG_MAX;
+			expected = INT4OID;
+			break;
+		case F_INT8SMALLER:
+			agg->kind = BATCH_AGG_MIN;
+			expected = INT8OID;
+			break;
+		case F_INT8LARGER:
+			agg->kind = BATCH_AGG_MAX;
+			expected = INT8OID;
+			break;
+		case F_FLOAT8SMALLER:
+			agg->kind = BATCH_AGG_MIN;
+			expected = FLOAT8OID;
+			break;
+		case F_FLOAT8LARGER:
+			agg->kind = BATCH_AGG_MAX;
+			expected = FLOAT8OID;
+			break;
+		default:
+			return false;
+	}
+
+	return inputtype == expected && batch_type_for(inputtype, &agg->type);
+}
+
+/*
+ * Loop computing min or max.  The transition functions return their first
+ * argument, the current state, if KEEP(state, new) holds, else the new
+ * value.  A NULL state is replaced by the first non-null value.
+ */
+#define BATCH_MINMAX(CTYPE, GETVAL, PUTVAL, KEEP) \
+	do { \
+		CTYPE		result = 0; \
+		bool		have = !*transValueIsNull; \
+		\
+		if (have) \
+			result = GETVAL(*transValue); \
+		for (i = 0; i < nsel; i++) \
+		{ \
+			int			row = sel[i]; \
+			CTYPE		v; \
+			\
+			if (isnull[row]) \
+				continue; \
+			v = GETVAL(values[row]); \
+			if (!have || !KEEP(result, v)) \
+				result = v; \
+			have = true; \
+		} \
+		if (have) \
+		{ \
+			*transValue = PUTVAL(result); \
+			*transValueIsNull = false; \
+		} \
+	} while (0)
+
+/*
+ * Advance the transition state of an aggregate over the selected rows of
+ * the batch.
+ */
+void
+ExecBatchAdvanceAgg(ExecBatch *batch, BatchAgg *agg,
+					Datum *transValue, bool *transValueIsNull)
+{
+	const uint16 *sel = batch->sel;
+	int			nsel = batch->nsel;
+	const Datum *values = NULL;
+	const bool *isnull = NULL;
+	int			i;
+
+	if (nsel == 0)
+		return;
+
+	if (agg->col >= 0)
+	{
+		values = batch->values[agg->col];
+		isnull = batch->isnull[agg->col];
+	}
+
+	switch (agg->kind)
+	{
+		case BATCH_AGG_COUNT_STAR:
+		case BATCH_AGG_COUNT:
+			{
+				int64		count = 0;
+				int64		result;
+
+				if (agg->kind == BATCH_AGG_COUNT_STAR)
+					count = nsel;
+				else
+				{
+					for (i = 0; i < nsel; i++)
+						count += !isnull[sel[i]];
+				}
+
+				/* the caller made sure that the count starts from a value */
+				Assert(!*transValueIsNull);
+				if (unlikely(pg_add_s64_overflow(DatumGetInt64(*transValue),
+												 count, &result)))
+					ereport(ERROR,
+							(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+							 errmsg("bigint out of range")));
+				*transValue = Int64GetDatum(result);
+				break;
+			}
+
+		case BATCH_AGG_SUM:
+			if (agg->type == BATCH_INT4)
+			{
+				/* like int4_sum: the state starts at the first non-null */
+				int64		sum = 0;
+				bool		have = !*transValueIsNull;
+
+				if (have)
+					sum = DatumGetInt64(*transValue);
+				for (i = 0; i < nsel; i++)
+				{
+					int			row = sel[i];
+
+					if (isnull[row])
+						continue;
+					sum += (int64) DatumGetInt32(values[row]);
+					have = true;
+				}
+				if (have)
+				{
+					*transValue = Int64GetDatum(sum);
+					*transValueIsNull = false;
+				}
+			}
+			else
+			{
+				/* float8pl is strict, with no initial condition */
+				float8		sum = 0;
+				bool		have = !*transValueIsNull;
+
+				Assert(agg->type == BATCH_FLOAT8);
+				if (have)
+					sum = DatumGetFloat8(*transValue);
+				for (i = 0; i < nsel; i++)
+				{
+					int			row = sel[i];
+					float8		v;
+
+					if (isnull[row])
+						continue;
+					v = DatumGetFloat8(values[row]);
+					sum = have ? float8_pl(sum, v) : v;
+					have = true;
+				}
+				if (have)
+				{
+					*transValue = Float8GetDatum(sum);
+					*transValueIsNull = false;
+				}
+			}
+			break;
+
+		case BATCH_AGG_MIN:
+			switch (agg->type)
+			{
+				case BATCH_INT4:
+					BATCH_MINMAX(int32, DatumGetInt32, Int32GetDatum, INT_LT);
+					break;
+				case BATCH_INT8:
+					BATCH_MINMAX(int64, DatumGetInt64, Int64GetDatum, INT_LT);
+					break;
+				case BATCH_FLOAT8:
+					BATCH_MINMAX(float8, DatumGetFloat8, Float8GetDatum,
+								 float8_lt);
+					break;
+			}
+			break;
+
+		case BATCH_AGG_MAX:
+			switch (agg->type)
+			{
+				case BATCH_INT4:
+					BATCH_MINMAX(int32, DatumGetInt32, Int32GetDatum, INT_GT);
+					break;
+				case BATCH_INT8:
+					BATCH_MINMAX(int64, DatumGetInt64, Int64GetDatum, INT_GT);
+					break;
+				case BATCH_FLOAT8:
+					BATCH_MINMAX(float8, DatumGetFloat8, Float8GetDatum,
+								 float8_gt);
+					break;
+			}
+			break;
+	}
+}
@@ -44,7 +44,8 @@
  * Returns whether any column contains NULLs.
  *
  * This is not generic routine, it expects the idxrel to be replication
- * identity of a rel and meet all limitations associated with that.
+ * identity of a rel and meet all limitations associated with that, or a
+ * unique index on plain columns (as used for apply conflict detection).
  */
 static bool
 build_replindex_scan_key(ScanKey skey, Relation rel, Relation idxrel,
@@ -57,7 +58,8 @@ build_replindex_scan_key(ScanKey skey, Relation rel, Relation idxrel,
 	int2vector *indkey = &idxrel->rd_index->indkey;
 	bool		hasnulls = false;
 
-	Assert(RelationGetReplicaIndex(rel) == RelationGetRelid(idxrel));
+	Assert(RelationGetReplicaIndex(rel) == RelationGetRelid(idxrel) ||
+		   idxrel->rd_index->indisunique);
 
 	indclassDatum = SysCacheGetAttr(INDEXRELID, idxrel->rd_indextuple,
 									Anum_pg_index_indclass, &isnull);
@@ -194,6 +194,38 @@
  *	  transition values.  hashcontext is the single context created to support
  *	  all hash tables.
  *
+ *	  Spilling to disk:
+ *
+ *	  The planner's estimate of the number of groups can be far off, so the
+ *	  hash tables may need much more memory than work_mem.  When the memory
+ *	  used by the hash tables (the hashcontext plus the bucket arrays) exceeds
+ *	  work_mem, we enter "spill mode": groups already in memory keep being
+ *	  advanced, but no new groups are created.  An input tuple that doesn't
+ *	  belong to an existing group is instead written to one of a number of
+ *	  spill files, chosen by bits of its hash value.  That is done per grouping
+ *	  set, as a tuple may find its group in one hash table but not in another;
+ *	  the pergroup pointer of a set the tuple was spilled for is NULL, which
+ *	  makes the transition expression skip that set.
+ *
+ *	  Once the input is exhausted, the groups in memory are emitted, and each
+ *	  spill file becomes a batch of its own.  A batch is processed like the
+ *	  original input, but for a single grouping set: the hash tables are
+ *	  emptied, the batch's tuples are aggregated into them, and what doesn't
+ *	  fit is spilled again, partitioned by the next bits of the hash value.
+ *	  As at least one group is kept in memory in every pass, this always
+ *	  finishes, and memory stays bounded by work_mem plus the spill file
+ *	  buffers (save for transition values that keep growing by themselves).
+ *
+ *    Batch mode:
+ *
+ *	  When batch_execution is enabled, a plain aggregate directly over a
+ *	  sequential scan can read its input in batches of deformed columns (see
+ *	  execBatch.c), if all its aggregates are count, sum, min or max over
+ *	  plain columns of a type that the batch routines handle.  The transition
+ *	  values are then advanced by a loop per aggregate over each batch,
+ *	  rather than by the transition expression for each input tuple.
+ *	  agg_batch_init decides that once, at executor startup.
+ *
  *    Transition / Combine function invocation:
  *
  *    For performance reasons transition functions, including combine
@@ -221,16 +253,21 @@
 #include "catalog/pg_aggregate.h"
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
+#include "executor/nodeSeqscan.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "parser/parsetree.h"
+#include "storage/buffile.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/dynahash.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
@@ -238,6 +275,42 @@
 #include "utils/datum.h"
 
 
+/*
+ * Limits on the number of partitions a hash aggregate spills into per pass.
+ * The number is chosen such that each partition is expected to fit into
+ * memory, with some slack (HASHAGG_PARTITION_FACTOR).
+ */
+#define HASHAGG_PARTITION_FACTOR 1.50
+#define HASHAGG_MIN_PARTITIONS 4
+#define HASHAGG_MAX_PARTITIONS 256
+
+/*
+ * Spill files of one grouping set during one pass over the input.  Tuples are
+ * distributed over the partitions by 'partition_bits' bits of their hash
+ * value, following the bits already used by the enclosing passes.
+ */
+typedef struct HashAggSpill
+{
+	int			npartitions;	/* number of partitions, 0 if not set up */
+	BufFile   **partitions;		/* spill file per partition, or NULL */
+	int64	   *ntuples;		/* number of tuples in each partition */
+	int			used_bits;		/* hash bits used, including these */
+	uint32		mask;			/* mask to find partition from hash value */
+	int			shift;			/* after masking, shift by this amount */
+} HashAggSpill;
+
+/*
+ * A spill file to be aggregated later.  All its tuples belong to grouping
+ * set 'setno', and agree on the first 'used_bits' bits of their hash value.
+ */
+typedef struct HashAggBatch
+{
+	int			setno;			/* grouping set */
+	int			used_bits;		/* hash bits used by enclosing passes */
+	BufFile    *input_file;		/* spilled tuples */
+	int64		input_tuples;	/* number of tuples in the file */
+} HashAggBatch;
+
 static void select_current_set(AggState *aggstate, int setno, bool is_hash);
 static void initialize_phase(AggState *aggstate, int newphase);
 static TupleTableSlot *fetch_input_tuple(AggState *aggstate);
@@ -274,9 +347,26 @@ static bool find_unaggregated_cols_walker(Node *node, Bitmapset **colnos);
 static void build_hash_table(AggState *aggstate);
 static TupleHashEntryData *lookup_hash_entry(AggState *aggstate);
 static void lookup_hash_entries(AggState *aggstate);
+static Size hash_agg_mem_used(AggState *aggstate);
+static void hash_agg_check_limits(AggState *aggstate);
+static int	hash_choose_num_partitions(AggState *aggstate, double input_groups,
+									   int used_bits, int *log2_npartitions);
+static void hashagg_spill_init(AggState *aggstate, HashAggSpill *spill,
+							   int used_bits, double input_groups);
+static void hashagg_spill_tuple(AggState *aggstate, HashAggSpill *spill,
+								TupleTableSlot *slot, uint32 hash);
+static void hashagg_spill_finish(AggState *aggstate, HashAggSpill *spill,
+								 int setno);
+static void hash_agg_finish_spills(AggState *aggstate);
+static MinimalTuple hashagg_batch_read(HashAggBatch *batch, uint32 *hashp);
+static void hashagg_reset_spill_state(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
+static void agg_batch_init(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_batch(AggState *aggstate);
 static void agg_fill_hash_table(AggState *aggstate);
+static bool agg_refill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_hash_table_in_memory(AggState *aggstate);
 static Datum GetAggInitVal(Datum textInitVal, Oid transtype);
 static void build_pertrans_for_aggref(AggStatePerTrans pertrans,
 									  AggState *aggstate, EState *estate,
@@ -1259,17 +1349,23 @@ find_unaggregated_cols_walker(Node *node, Bitmapset **colnos)
  * The contents of the hash tables always live in the hashcontext's per-tuple
  * memory context (there is only one of these for all tables together, since
  * they are all reset at the same time).
+ *
+ * The initial size of the tables is capped by what fits into
+ * hash_mem_limit, as we'd spill before filling a larger one.
  */
 static void
 build_hash_table(AggState *aggstate)
 {
 	MemoryContext tmpmem = aggstate->tmpcontext->ecxt_per_tuple_memory;
 	Size		additionalsize;
+	long		max_nbuckets;
 	int			i;
 
 	Assert(aggstate->aggstrategy == AGG_HASHED || aggstate->aggstrategy == AGG_MIXED);
 
 	additionalsize = aggstate->numtrans * sizeof(AggStatePerGroupData);
+	max_nbuckets = Max(aggstate->hash_mem_limit /
+					   hash_agg_entry_size(aggstate->numtrans), 1);
 
 	for (i = 0; i < aggstate->num_hashes; ++i)
 	{
@@ -1287,7 +1383,8 @@ build_hash_table(AggState *aggstate)
 														perhash->eqfuncoids,
 														perhash->hashfunctions,
 														perhash->aggnode->grpCollations,
-														perhash->aggnode->numGroups,
+														Min(perhash->aggnode->numGroups,
+															max_nbuckets),
 														additionalsize,
 														aggstate->ss.ps.state->es_query_cxt,
 														aggstate->hashcontext->ecxt_per_tuple_memory,
@@ -1460,6 +1557,10 @@ hash_agg_entry_size(int numAggs)
  * set (which the caller must have selected - note that initialize_aggregate
  * depends on this).
  *
+ * In spill mode, no new entries are created; NULL is returned if the tuple's
+ * group isn't in the hashtable yet, and the caller must spill the tuple.  The
+ * hashslot still holds the tuple's grouping columns then.
+ *
  * When called, CurrentMemoryContext should be the per-query context.
  */
 static TupleHashEntryData *
@@ -1469,7 +1570,7 @@ lookup_hash_entry(AggState *aggstate)
 	AggStatePerHash perhash = &aggstate->perhash[aggstate->current_set];
 	TupleTableSlot *hashslot = perhash->hashslot;
 	TupleHashEntryData *entry;
-	bool		isnew;
+	bool		isnew = false;
 	int			i;
 
 	/* transfer just the needed columns into hashslot */
@@ -1486,7 +1587,11 @@ lookup_hash_entry(AggState *aggstate)
 	ExecStoreVirtualTuple(hashslot);
 
 	/* find or create the hashtable entry using the filtered tuple */
-	entry = LookupTupleHashEntry(perhash->hashtable, hashslot, &isnew);
+	entry = LookupTupleHashEntry(perhash->hashtable, hashslot,
+								 aggstate->hash_spill_mode ? NULL : &isnew);
+
+	if (entry == NULL)
+		return NULL;
 
 	if (isnew)
 	{
@@ -1509,6 +1614,9 @@ lookup_hash_entry(AggState *aggstate)
 
 			initialize_aggregate(aggstate, pertrans, pergroupstate);
 		}
+
+		aggstate->hash_ngroups_current++;
+		hash_agg_check_limits(aggstate);
 	}
 
 	return entry;
@@ -1518,6 +1626,9 @@ lookup_hash_entry(AggState *aggstate)
  * Look up hash entries for the current tuple in all hashed grouping sets,
  * returning an array of pergroup pointers suitable for advance_aggregates.
  *
+ * In spill mode, the tuple is spilled for every grouping set it has no group
+ * in yet, and the pergroup pointer of that set is NULL.
+ *
  * Be aware that lookup_hash_entry can reset the tmpcontext.
  */
 static void
@@ -1529,11 +1640,342 @@ lookup_hash_entries(AggState *aggstate)
 
 	for (setno = 0; setno < numHashes; setno++)
 	{
+		AggStatePerHash perhash = &aggstate->perhash[setno];
+		TupleHashEntryData *entry;
+		HashAggSpill *spill;
+		uint32		hash;
+
 		select_current_set(aggstate, setno, true);
-		pergroup[setno] = lookup_hash_entry(aggstate)->additional;
+		entry = lookup_hash_entry(aggstate);
+		if (entry != NULL)
+		{
+			pergroup[setno] = entry->additional;
+			continue;
+		}
+
+		if (aggstate->hash_spills == NULL)
+			aggstate->hash_spills = (HashAggSpill *)
+				MemoryContextAllocZero(aggstate->ss.ps.state->es_query_cxt,
+									   sizeof(HashAggSpill) * numHashes);
+		spill = &aggstate->hash_spills[setno];
+		if (spill->npartitions == 0)
+			hashagg_spill_init(aggstate, spill, 0, perhash->aggnode->numGroups);
+
+		hash = TupleHashTableSlotHash(perhash->hashtable, perhash->hashslot);
+		hashagg_spill_tuple(aggstate, spill,
+							aggstate->tmpcontext->ecxt_outertuple, hash);
+		pergroup[setno] = NULL;
+	}
+}
+
+/*
+ * Memory used by the hash tables: their entries and transition values, and
+ * their bucket arrays.
+ */
+static Size
+hash_agg_mem_used(AggState *aggstate)
+{
+	Size		mem;
+	int			setno;
+
+	mem = MemoryContextMemAllocated(aggstate->hashcontext->ecxt_per_tuple_memory,
+									true);
+
+	for (setno = 0; setno < aggstate->num_hashes; setno++)
+	{
+		TupleHashTable hashtable = aggstate->perhash[setno].hashtable;
+
+		if (hashtable)
+			mem += hashtable->hashtab->size * sizeof(TupleHashEntryData);
+	}
+
+	return mem;
+}
+
+/*
+ * Enter spill mode if the hash tables have outgrown hash_mem_limit.  At least
+ * one group is always allowed, so that every pass makes progress.
+ */
+static void
+hash_agg_check_limits(AggState *aggstate)
+{
+	Size		mem = hash_agg_mem_used(aggstate);
+
+	if (mem > aggstate->hash_mem_peak)
+		aggstate->hash_mem_peak = mem;
+
+	if (!aggstate->hash_spill_mode &&
+		aggstate->hash_ngroups_current > 1 &&
+		mem > aggstate->hash_mem_limit)
+	{
+		aggstate->hash_spill_mode = true;
+		aggstate->hash_ever_spilled = true;
+		aggstate->hashentrysize =
+			(double) mem / aggstate->hash_ngroups_current;
 	}
 }
 
+/*
+ * Choose the number of partitions to spill 'input_groups' groups into, so
+ * that each partition is expected to fit into memory.  The number is a power
+ * of two, and its log2 is returned in *log2_npartitions.
+ */
+static int
+hash_choose_num_partitions(AggState *aggstate, double input_groups,
+						   int used_bits, int *log2_npartitions)
+{
+	double		mem_wanted;
+	double		dpartitions;
+	int			max_partitions;
+	int			npartitions;
+	int			partition_bits;
+
+	mem_wanted = HASHAGG_PARTITION_FACTOR * input_groups *
+		aggstate->hashentrysize;
+	dpartitions = 1 + mem_wanted / aggstate->hash_mem_limit;
+
+	/*
+	 * Each open spill file has a buffer of BLCKSZ bytes; don't let those use
+	 * more than a quarter of the memory limit.
+	 */
+	max_partitions = aggstate->hash_mem_limit / 4 / BLCKSZ;
+
+	if (dpartitions > Min(max_partitions, HASHAGG_MAX_PARTITIONS))
+		dpartitions = Min(max_partitions, HASHAGG_MAX_PARTITIONS);
+	if (dpartitions < HASHAGG_MIN_PARTITIONS)
+		dpartitions = HASHAGG_MIN_PARTITIONS;
+	npartitions = (int) dpartitions;
+
+	partition_bits = my_log2(npartitions);
+
+	/* don't run out of hash bits; a single partition still makes progress */
+	if (partition_bits + used_bits > 32)
+		partition_bits = 32 - used_bits;
+
+	*log2_npartitions = partition_bits;
+	return 1 << partition_bits;
+}
+
+/*
+ * Set up 'spill' for spilling tuples whose hash values agree on their first
+ * 'used_bits' bits.  The spill files themselves are created on demand.
+ */
+static void
+hashagg_spill_init(AggState *aggstate, HashAggSpill *spill, int used_bits,
+				   double input_groups)
+{
+	MemoryContext oldcxt;
+	int			npartitions;
+	int			partition_bits;
+
+	npartitions = hash_choose_num_partitions(aggstate, input_groups,
+											 used_bits, &partition_bits);
+
+	oldcxt = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+	spill->partitions = palloc0(sizeof(BufFile *) * npartitions);
+	spill->ntuples = palloc0(sizeof(int64) * npartitions);
+	MemoryContextSwitchTo(oldcxt);
+
+	spill->npartitions = npartitions;
+	spill->used_bits = used_bits + partition_bits;
+	spill->shift = 32 - used_bits - partition_bits;
+	spill->mask = (uint32) (npartitions - 1) << spill->shift;
+}
+
+/*
+ * Write a tuple to the spill file of the partition its hash value selects.
+ *
+ * The hash value is written along with the tuple, to not have to compute it
+ * again should the tuple need to be spilled once more.  The format is the
+ * same as that of hash join batch files.
+ */
+static void
+hashagg_spill_tuple(AggState *aggstate, HashAggSpill *spill,
+					TupleTableSlot *slot, uint32 hash)
+{
+	int			partition = (hash & spill->mask) >> spill->shift;
+	BufFile    *file = spill->partitions[partition];
+	MinimalTuple tuple;
+	bool		shouldFree;
+	size_t		written;
+
+	if (file == NULL)
+	{
+		MemoryContext oldcxt;
+
+		oldcxt = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+		file = BufFileCreateTemp(false);
+		MemoryContextSwitchTo(oldcxt);
+
+		spill->partitions[partition] = file;
+	}
+
+	tuple = ExecFetchSlotMinimalTuple(slot, &shouldFree);
+
+	written = BufFileWrite(file, (void *) &hash, sizeof(uint32));
+	if (written != sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to hash-aggregate temporary file: %m")));
+
+	written = BufFileWrite(file, (void *) tuple, tuple->t_len);
+	if (written != tuple->t_len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to hash-aggregate temporary file: %m")));
+
+	spill->ntuples[partition]++;
+	aggstate->hash_disk_used += sizeof(uint32) + tuple->t_len;
+
+	if (shouldFree)
+		pfree(tuple);
+}
+
+/*
+ * Turn the spill files of a finished pass into batches to be processed
+ * later, and forget them.
+ */
+static void
+hashagg_spill_finish(AggState *aggstate, HashAggSpill *spill, int setno)
+{
+	MemoryContext oldcxt;
+	int			i;
+
+	if (spill->npartitions == 0)
+		return;					/* nothing was spilled */
+
+	oldcxt = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+
+	for (i = 0; i < spill->npartitions; i++)
+	{
+		BufFile    *file = spill->partitions[i];
+		HashAggBatch *batch;
+
+		if (file == NULL)
+			continue;
+
+		if (BufFileSeek(file, 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not rewind hash-aggregate temporary file: %m")));
+
+		batch = (HashAggBatch *) palloc(sizeof(HashAggBatch));
+		batch->setno = setno;
+		batch->used_bits = spill->used_bits;
+		batch->input_file = file;
+		batch->input_tuples = spill->ntuples[i];
+
+		/* process the newest batches first, to keep few files around */
+		aggstate->hash_batches = lcons(batch, aggstate->hash_batches);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	pfree(spill->partitions);
+	pfree(spill->ntuples);
+	spill->partitions = NULL;
+	spill->ntuples = NULL;
+	spill->npartitions = 0;
+}
+
+/*
+ * Called at the end of the initial pass over the input, to turn whatever
+ * was spilled into batches.
+ */
+static void
+hash_agg_finish_spills(AggState *aggstate)
+{
+	int			setno;
+
+	if (aggstate->hash_spills == NULL)
+		return;
+
+	for (setno = 0; setno < aggstate->num_hashes; setno++)
+		hashagg_spill_finish(aggstate, &aggstate->hash_spills[setno], setno);
+
+	pfree(aggstate->hash_spills);
+	aggstate->hash_spills = NULL;
+}
+
+/*
+ * Read the next tuple from a batch, returning NULL at its end.  The tuple is
+ * palloc'd in the current memory context.
+ */
+static MinimalTuple
+hashagg_batch_read(HashAggBatch *batch, uint32 *hashp)
+{
+	MinimalTuple tuple;
+	uint32		header[2];
+	size_t		nread;
+
+	/*
+	 * Read the hash value and the tuple length, which is the first field of
+	 * the MinimalTuple; see hashagg_spill_tuple().
+	 */
+	nread = BufFileRead(batch->input_file, (void *) header, sizeof(header));
+	if (nread == 0)
+		return NULL;
+	if (nread != sizeof(header))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from hash-aggregate temporary file: %m")));
+
+	*hashp = header[0];
+	tuple = (MinimalTuple) palloc(header[1]);
+	tuple->t_len = header[1];
+	nread = BufFileRead(batch->input_file,
+						(void *) ((char *) tuple + sizeof(uint32)),
+						header[1] - sizeof(uint32));
+	if (nread != header[1] - sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from hash-aggregate temporary file: %m")));
+
+	return tuple;
+}
+
+/*
+ * Close all spill files, of the pass in progress as well as of the batches
+ * not processed yet.
+ */
+static void
+hashagg_reset_spill_state(AggState *aggstate)
+{
+	ListCell   *lc;
+
+	if (aggstate->hash_spills != NULL)
+	{
+		int			setno;
+
+		for (setno = 0; setno < aggstate->num_hashes; setno++)
+		{
+			HashAggSpill *spill = &aggstate->hash_spills[setno];
+			int			i;
+
+			for (i = 0; i < spill->npartitions; i++)
+			{
+				if (spill->partitions[i] != NULL)
+					BufFileClose(spill->partitions[i]);
+			}
+		}
+
+		pfree(aggstate->hash_spills);
+		aggstate->hash_spills = NULL;
+	}
+
+	foreach(lc, aggstate->hash_batches)
+	{
+		HashAggBatch *batch = (HashAggBatch *) lfirst(lc);
+
+		BufFileClose(batch->input_file);
+	}
+	list_free_deep(aggstate->hash_batches);
+	aggstate->hash_batches = NIL;
+
+	aggstate->hash_spill_mode = false;
+	aggstate->hash_ngroups_current = 0;
+}
+
 /*
  * ExecAgg -
  *
@@ -1568,6 +2010,12 @@ ExecAgg(PlanState *pstate)
 				result = agg_retrieve_hash_table(node);
 				break;
 			case AGG_PLAIN:
+				if (node->batch != NULL)
+				{
+					result = agg_retrieve_batch(node);
+					break;
+				}
+				/* FALLTHROUGH */
 			case AGG_SORTED:
 				result = agg_retrieve_direct(node);
 				break;
@@ -1683,6 +2131,7 @@ agg_retrieve_direct(AggState *aggstate)
 				 * Mixed mode; we've output all the grouped stuff and have
 				 * full hashtables, so switch to outputting those.
 				 */
+				hash_agg_finish_spills(aggstate);
 				initialize_phase(aggstate, 0);
 				aggstate->table_filled = true;
 				ResetTupleHashIterator(aggstate->perhash[0].hashtable,
@@ -1920,6 +2369,143 @@ agg_retrieve_direct(AggState *aggstate)
 	return NULL;
 }
 
+/*
+ * Set up batch mode, if all the aggregates of a plain aggregate over a
+ * sequential scan can be advanced by ExecBatchAdvanceAgg.  Else leave
+ * aggstate->batch NULL.
+ */
+static void
+agg_batch_init(AggState *aggstate)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	Scan	   *scan;
+	BatchAgg   *batchaggs;
+	AttrNumber *attnums;
+	ExecBatch  *batch;
+	int			transno;
+
+	if (aggstate->aggstrategy != AGG_PLAIN ||
+		node->groupingSets != NIL ||
+		DO_AGGSPLIT_COMBINE(aggstate->aggsplit) ||
+		aggstate->numtrans == 0 ||
+		!IsA(outerstate, SeqScanState) ||
+		aggstate->ss.ps.state->es_epq_active != NULL)
+		return;
+	scan = (Scan *) outerstate->plan;
+
+	batchaggs = (BatchAgg *) palloc(aggstate->numtrans * sizeof(BatchAgg));
+	attnums = (AttrNumber *) palloc(aggstate->numtrans * sizeof(AttrNumber));
+
+	for (transno = 0; transno < aggstate->numtrans; transno++)
+	{
+		AggStatePerTrans pertrans = &aggstate->pertrans[transno];
+		Aggref	   *aggref = pertrans->aggref;
+		Oid			inputtype = InvalidOid;
+
+		if (aggref->aggkind != AGGKIND_NORMAL ||
+			aggref->aggfilter != NULL ||
+			pertrans->numSortCols > 0 ||
+			!pertrans->transtypeByVal)
+			goto fail;
+
+		attnums[transno] = InvalidAttrNumber;
+		if (aggref->args != NIL)
+		{
+			TargetEntry *tle;
+			Var		   *var;
+
+			/* the argument must be a column of the scan's output ... */
+			if (list_length(aggref->args) != 1)
+				goto fail;
+			var = (Var *) ((TargetEntry *) linitial(aggref->args))->expr;
+			if (!IsA(var, Var) || var->varno != OUTER_VAR)
+				goto fail;
+
+			/* ... that is a column of the table scanned */
+			tle = get_tle_by_resno(scan->plan.targetlist, var->varattno);
+			if (tle == NULL || !IsA(tle->expr, Var))
+				goto fail;
+			var = (Var *) tle->expr;
+			if (var->varno != scan->scanrelid || var->varattno <= 0)
+				goto fail;
+
+			attnums[transno] = var->varattno;
+			inputtype = var->vartype;
+		}
+
+		if (!ExecBatchCompileAgg(pertrans->transfn_oid, inputtype,
+								 &batchaggs[transno]))
+			goto fail;
+
+		/* counting requires a count to start from */
+		if ((batchaggs[transno].kind == BATCH_AGG_COUNT_STAR ||
+			 batchaggs[transno].kind == BATCH_AGG_COUNT) &&
+			pertrans->initValueIsNull)
+			goto fail;
+	}
+
+	batch = ExecSeqScanBatchInit((SeqScanState *) outerstate);
+	for (transno = 0; transno < aggstate->numtrans; transno++)
+	{
+		if (attnums[transno] != InvalidAttrNumber)
+			batchaggs[transno].col = ExecBatchAddColumn(batch,
+														attnums[transno]);
+	}
+	ExecBatchAllocate(batch);
+
+	aggstate->batch = batch;
+	aggstate->batchaggs = batchaggs;
+	pfree(attnums);
+	return;
+
+fail:
+	pfree(batchaggs);
+	pfree(attnums);
+}
+
+/*
+ * ExecAgg for batch mode: aggregate all the input, and return the single
+ * result row of a plain aggregate.
+ */
+static TupleTableSlot *
+agg_retrieve_batch(AggState *aggstate)
+{
+	ExprContext *econtext = aggstate->ss.ps.ps_ExprContext;
+	AggStatePerGroup pergroup = aggstate->pergroups[0];
+	SeqScanState *outerstate = (SeqScanState *) outerPlanState(aggstate);
+	ExecBatch  *batch;
+	int			transno;
+
+	ReScanExprContext(econtext);
+	ReScanExprContext(aggstate->aggcontexts[0]);
+
+	select_current_set(aggstate, 0, false);
+	initialize_aggregates(aggstate, aggstate->pergroups, 1);
+
+	while ((batch = ExecSeqScanBatchNext(outerstate)) != NULL)
+	{
+		for (transno = 0; transno < aggstate->numtrans; transno++)
+			ExecBatchAdvanceAgg(batch, &aggstate->batchaggs[transno],
+								&pergroup[transno].transValue,
+								&pergroup[transno].transValueIsNull);
+	}
+
+	aggstate->agg_done = true;
+
+	/*
+	 * There is no representative input tuple; as we are not grouping, there
+	 * can't be any references to non-aggregated input columns.
+	 */
+	ExecClearTuple(aggstate->ss.ss_ScanTupleSlot);
+	econtext->ecxt_outertuple = aggstate->ss.ss_ScanTupleSlot;
+
+	prepare_projection_slot(aggstate, econtext->ecxt_outertuple, 0);
+	finalize_aggregates(aggstate, aggstate->peragg, pergroup);
+
+	return project_aggregates(aggstate);
+}
+
 /*
  * ExecAgg for hashed case: read input and build hash table
  */
@@ -1955,6 +2541,9 @@ agg_fill_hash_table(AggState *aggstate)
 		ResetExprContext(aggstate->tmpcontext);
 	}
 
+	/* turn the tuples spilled so far into batches */
+	hash_agg_finish_spills(aggstate);
+
 	aggstate->table_filled = true;
 	/* Initialize to walk the first hash table */
 	select_current_set(aggstate, 0, true);
@@ -1963,10 +2552,124 @@ agg_fill_hash_table(AggState *aggstate)
 }
 
 /*
- * ExecAgg for hashed case: retrieving groups from hash table
+ * Empty the hash tables and aggregate the next batch of spilled tuples into
+ * them.  Returns false if there are no batches left.
+ *
+ * Tuples that don't fit are spilled again, into new batches partitioned by
+ * further bits of their hash values.
+ */
+static bool
+agg_refill_hash_table(AggState *aggstate)
+{
+	ExprContext *tmpcontext = aggstate->tmpcontext;
+	TupleTableSlot *spillslot = aggstate->hash_spill_slot;
+	HashAggBatch *batch;
+	HashAggSpill spill;
+	MinimalTuple tuple;
+	uint32		hash;
+	int			setno;
+
+	if (aggstate->hash_batches == NIL)
+		return false;
+
+	batch = (HashAggBatch *) linitial(aggstate->hash_batches);
+	aggstate->hash_batches = list_delete_first(aggstate->hash_batches);
+
+	/*
+	 * Free the groups of the previous pass.  All the hash tables are emptied,
+	 * not just the batch's one, as they share the hashcontext.  Transitions
+	 * for the other grouping sets are skipped by leaving their pergroup
+	 * pointers NULL.
+	 */
+	ReScanExprContext(aggstate->hashcontext);
+	for (setno = 0; setno < aggstate->num_hashes; setno++)
+	{
+		ResetTupleHashTable(aggstate->perhash[setno].hashtable);
+		aggstate->hash_pergroup[setno] = NULL;
+	}
+
+	aggstate->hash_ngroups_current = 0;
+	aggstate->hash_spill_mode = false;
+	aggstate->hash_batches_used++;
+
+	memset(&spill, 0, sizeof(spill));
+
+	select_current_set(aggstate, batch->setno, true);
+
+	for (;;)
+	{
+		TupleHashEntryData *entry;
+
+		CHECK_FOR_INTERRUPTS();
+
+		tuple = hashagg_batch_read(batch, &hash);
+		if (tuple == NULL)
+			break;
+
+		ExecStoreMinimalTuple(tuple, spillslot, true);
+		tmpcontext->ecxt_outertuple = spillslot;
+
+		entry = lookup_hash_entry(aggstate);
+		if (entry != NULL)
+		{
+			aggstate->hash_pergroup[batch->setno] = entry->additional;
+			advance_aggregates(aggstate);
+		}
+		else
+		{
+			if (spill.npartitions == 0)
+				hashagg_spill_init(aggstate, &spill, batch->used_bits,
+								   batch->input_tuples);
+			hashagg_spill_tuple(aggstate, &spill, spillslot, hash);
+		}
+
+		ExecClearTuple(spillslot);
+		ResetExprContext(tmpcontext);
+	}
+
+	BufFileClose(batch->input_file);
+	hashagg_spill_finish(aggstate, &spill, batch->setno);
+
+	/* walk the refilled hash table */
+	ResetTupleHashIterator(aggstate->perhash[batch->setno].hashtable,
+						   &aggstate->perhash[batch->setno].hashiter);
+
+	pfree(batch);
+
+	return true;
+}
+
+/*
+ * ExecAgg for hashed case: retrieving groups from hash table, refilling it
+ * from spilled batches as it is exhausted.
  */
 static TupleTableSlot *
 agg_retrieve_hash_table(AggState *aggstate)
+{
+	TupleTableSlot *result = NULL;
+
+	while (result == NULL)
+	{
+		result = agg_retrieve_hash_table_in_memory(aggstate);
+		if (result == NULL)
+		{
+			if (!agg_refill_hash_table(aggstate))
+			{
+				aggstate->agg_done = true;
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Retrieve groups from the hash tables currently in memory.  Returns NULL
+ * when they are exhausted.
+ */
+static TupleTableSlot *
+agg_retrieve_hash_table_in_memory(AggState *aggstate)
 {
 	ExprContext *econtext;
 	AggStatePerAgg peragg;
@@ -1995,7 +2698,7 @@ agg_retrieve_hash_table(AggState *aggstate)
 	 * We loop retrieving groups until we find one satisfying
 	 * aggstate->ss.ps.qual
 	 */
-	while (!aggstate->agg_done)
+	for (;;)
 	{
 		TupleTableSlot *hashslot = perhash->hashslot;
 		int			i;
@@ -2026,8 +2729,7 @@ agg_retrieve_hash_table(AggState *aggstate)
 			}
 			else
 			{
-				/* No more hashtables, so done */
-				aggstate->agg_done = true;
+				/* No more hashtables in memory */
 				return NULL;
 			}
 		}
@@ -2079,9 +2781,6 @@ agg_retrieve_hash_table(AggState *aggstate)
 		if (result)
 			return result;
 	}
-
-	/* No more groups */
-	return NULL;
 }
 
 /* -----------------
@@ -2268,6 +2967,21 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 			aggstate->ss.ps.outeropsfixed = false;
 	}
 
+	/*
+	 * Hashing may spill input tuples to disk, and they are read back into a
+	 * slot of their own.  As with sorting, that may not be the same type of
+	 * slot as the outer plan's.
+	 */
+	if (use_hashing)
+	{
+		aggstate->hash_spill_slot = ExecInitExtraTupleSlot(estate, scanDesc,
+														   &TTSOpsMinimalTuple);
+
+		if (aggstate->ss.ps.outeropsfixed &&
+			aggstate->ss.ps.outerops != &TTSOpsMinimalTuple)
+			aggstate->ss.ps.outeropsfixed = false;
+	}
+
 	/*
 	 * Initialize result type, slot and projection.
 	 */
@@ -2497,6 +3211,9 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		aggstate->hash_pergroup = pergroups;
 
 		find_hash_columns(aggstate);
+
+		aggstate->hash_mem_limit = work_mem * 1024L;
+		aggstate->hash_batches_used = 1;
 		build_hash_table(aggstate);
 		aggstate->table_filled = false;
 	}
@@ -2883,11 +3600,12 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		else if (aggstate->aggstrategy == AGG_MIXED && phaseidx == 0)
 		{
 			/*
-			 * No need to compute a transition function for an AGG_MIXED phase
-			 * 0 - the contents of the hashtables will have been computed
-			 * during phase 1.
+			 * The contents of the hashtables of an AGG_MIXED phase 0 will
+			 * have been computed during phase 1, but tuples spilled to disk
+			 * are aggregated in phase 0.
 			 */
-			continue;
+			dohash = true;
+			dosort = false;
 		}
 		else if (phase->aggstrategy == AGG_PLAIN ||
 				 phase->aggstrategy == AGG_SORTED)
@@ -2907,6 +3625,11 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 
 	}
 
+	aggstate->batch = NULL;
+	aggstate->batchaggs = NULL;
+	if (batch_execution)
+		agg_batch_init(aggstate);
+
 	return aggstate;
 }
 
@@ -3398,6 +4121,9 @@ ExecEndAgg(AggState *node)
 	if (node->sort_out)
 		tuplesort_end(node->sort_out);
 
+	/* ... and any files hash aggregation spilled to */
+	hashagg_reset_spill_state(node);
+
 	for (transno = 0; transno < node->numtrans; transno++)
 	{
 		AggStatePerTrans pertrans = &node->pertrans[transno];
@@ -3456,9 +4182,11 @@ ExecReScanAgg(AggState *node)
 		 * If we do have the hash table, and the subplan does not have any
 		 * parameter changes, and none of our own parameter changes affect
 		 * input expressions of the aggregated functions, then we can just
-		 * rescan the existing hash table; no need to build it again.
+		 * rescan the existing hash table; no need to build it again.  That
+		 * doesn't work if it ever spilled, as it then holds only the groups
+		 * of the last batch.
 		 */
-		if (outerPlan->chgParam == NULL &&
+		if (outerPlan->chgParam == NULL && !node->hash_ever_spilled &&
 			!bms_overlap(node->ss.ps.chgParam, aggnode->aggParams))
 		{
 			ResetTupleHashIterator(node->perhash[0].hashtable,
@@ -3515,6 +4243,9 @@ ExecReScanAgg(AggState *node)
 	 */
 	if (node->aggstrategy == AGG_HASHED || node->aggstrategy == AGG_MIXED)
 	{
+		hashagg_reset_spill_state(node);
+		node->hash_ever_spilled = false;
+
 		ReScanExprContext(node->hashcontext);
 		/* Rebuild an empty hash table */
 		build_hash_table(node);
@@ -37,7 +37,9 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "port/pg_bitutils.h"
 #include "utils/dynahash.h"
+#include "utils/hashutils.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
@@ -61,6 +63,10 @@ static HashJoinTuple ExecParallelHashTupleAlloc(HashJoinTable hashtable,
 												dsa_pointer *shared);
 static void MultiExecPrivateHash(HashState *node);
 static void MultiExecParallelHash(HashState *node);
+static uint32 ExecHashBloomChooseSize(double ntuples);
+static inline void ExecHashBloomAdd(uint64 *bloom, uint32 mask,
+									uint32 hashvalue);
+static void ExecHashBloomFinish(HashJoinTable hashtable);
 static inline HashJoinTuple ExecParallelHashFirstTuple(HashJoinTable table,
 													   int bucketno);
 static inline HashJoinTuple ExecParallelHashNextTuple(HashJoinTable table,
@@ -186,10 +192,16 @@ MultiExecPrivateHash(HashState *node)
 				/* Not subject to skew optimization, so insert normally */
 				ExecHashTableInsert(hashtable, slot, hashvalue);
 			}
+			if (hashtable->bloom != NULL)
+				ExecHashBloomAdd(hashtable->bloom, hashtable->bloom_mask,
+								 hashvalue);
 			hashtable->totalTuples += 1;
 		}
 	}
 
+	if (hashtable->bloom != NULL)
+		ExecHashBloomFinish(hashtable);
+
 	/* resize the hash table if needed (NTUP_PER_BUCKET exceeded) */
 	if (hashtable->nbuckets != hashtable->nbuckets_optimal)
 		ExecHashIncreaseNumBuckets(hashtable);
@@ -277,6 +289,16 @@ MultiExecParallelHash(HashState *node)
 				ExecParallelHashIncreaseNumBuckets(hashtable);
 			ExecParallelHashEnsureBatchAccessors(hashtable);
 			ExecParallelHashTableSetCurrentBatch(hashtable, 0);
+
+			/* Collect our share of the bloom filter privately. */
+			if (pstate->bloom_nwords > 0)
+			{
+				hashtable->bloom_mask = pstate->bloom_nwords - 1;
+				hashtable->bloom = (uint64 *)
+					MemoryContextAllocZero(hashtable->hashCxt,
+										   pstate->bloom_nwords * sizeof(uint64));
+			}
+
 			for (;;)
 			{
 				slot = ExecProcNode(outerNode);
@@ -286,10 +308,31 @@ MultiExecParallelHash(HashState *node)
 				if (ExecHashGetHashValue(hashtable, econtext, hashkeys,
 										 false, hashtable->keepNulls,
 										 &hashvalue))
+				{
 					ExecParallelHashTableInsert(hashtable, slot, hashvalue);
+					if (hashtable->bloom != NULL)
+						ExecHashBloomAdd(hashtable->bloom,
+										 hashtable->bloom_mask, hashvalue);
+				}
 				hashtable->partialTuples++;
 			}
 
+			/* Merge our share of the bloom filter into the shared one. */
+			if (hashtable->bloom != NULL)
+			{
+				uint64	   *shared_bloom;
+				uint32		w;
+
+				shared_bloom = (uint64 *) dsa_get_address(hashtable->area,
+														  pstate->bloom);
+				LWLockAcquire(&pstate->lock, LW_EXCLUSIVE);
+				for (w = 0; w <= hashtable->bloom_mask; w++)
+					shared_bloom[w] |= hashtable->bloom[w];
+				LWLockRelease(&pstate->lock);
+				pfree(hashtable->bloom);
+				hashtable->bloom = NULL;
+			}
+
 			/*
 			 * Make sure that any tuples we wrote to disk are visible to
 			 * others before anyone tries to load them.
@@ -334,6 +377,15 @@ MultiExecParallelHash(HashState *node)
 	hashtable->totalTuples = pstate->total_tuples;
 	ExecParallelHashEnsureBatchAccessors(hashtable);
 
+	/* Everyone's share of the bloom filter is in the shared one by now. */
+	if (DsaPointerIsValid(pstate->bloom))
+	{
+		hashtable->bloom = (uint64 *) dsa_get_address(hashtable->area,
+													  pstate->bloom);
+		hashtable->bloom_mask = pstate->bloom_nwords - 1;
+		ExecHashBloomFinish(hashtable);
+	}
+
 	/*
 	 * The next synchronization point is in ExecHashJoin's HJ_BUILD_HASHTABLE
 	 * case, which will bring the build phase to PHJ_BUILD_DONE (if it isn't
@@ -366,6 +418,7 @@ ExecInitHash(Hash *node, EState *estate, int eflags)
 	hashstate->ps.ExecProcNode = ExecHash;
 	hashstate->hashtable = NULL;
 	hashstate->hashkeys = NIL;	/* will be set by parent HashJoin */
+	hashstate->build_bloom = false; /* may be set by parent HashJoin */
 
 	/*
 	 * Miscellaneous initialization
@@ -512,6 +565,9 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	hashtable->parallel_state = state->parallel_state;
 	hashtable->area = state->ps.state->es_query_dsa;
 	hashtable->batches = NULL;
+	hashtable->bloom = NULL;
+	hashtable->bloom_mask = 0;
+	hashtable->bloom_ready = false;
 
 #ifdef HJDEBUG
 	printf("Hashjoin %p: initial nbatch = %d, nbuckets = %d\n",
@@ -577,6 +633,21 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 		PrepareTempTablespaces();
 	}
 
+	/*
+	 * Allocate the bloom filter for a private hashtable.  For a shared one,
+	 * see below.
+	 */
+	if (state->build_bloom && hashtable->parallel_state == NULL)
+	{
+		uint32		nwords = ExecHashBloomChooseSize(rows);
+
+		if (nwords > 0)
+		{
+			hashtable->bloom = (uint64 *) palloc0(nwords * sizeof(uint64));
+			hashtable->bloom_mask = nwords - 1;
+		}
+	}
+
 	MemoryContextSwitchTo(oldcxt);
 
 	if (hashtable->parallel_state)
@@ -609,6 +680,13 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 			pstate->space_allowed = space_allowed;
 			pstate->growth = PHJ_GROWTH_OK;
 
+			/* Allocate the shared bloom filter, if wanted. */
+			pstate->bloom_nwords =
+				state->build_bloom ? ExecHashBloomChooseSize(rows) : 0;
+			if (pstate->bloom_nwords > 0)
+				pstate->bloom = dsa_allocate0(hashtable->area,
+											  pstate->bloom_nwords * sizeof(uint64));
+
 			/* Set up the shared state for coordinating batches. */
 			ExecParallelHashJoinSetUpBatches(hashtable, nbatch);
 
@@ -1869,6 +1947,122 @@ ExecHashGetHashValue(HashJoinTable hashtable,
 	return true;
 }
 
+/*
+ * The bloom filter over the inner hash values is "blocked": all the bits for
+ * one hash value are in the same uint64 word, so adding or testing a value
+ * touches a single cache line.  We set HASH_BLOOM_NBITS bits per value, and
+ * aim for HASH_BLOOM_BITS_PER_TUPLE bits of filter per inner tuple, which
+ * makes for a false positive rate of around 1%, but we don't use more than
+ * 1/16 of work_mem for the filter.  If that means fewer than half the bits
+ * we'd like, the filter would be too full to be of much use, so we don't
+ * build one at all.
+ */
+#define HASH_BLOOM_NBITS			3
+#define HASH_BLOOM_BITS_PER_TUPLE	16
+#define HASH_BLOOM_MIN_WORDS		16
+#define HASH_BLOOM_MAX_WORDS		(1 << 24)
+
+/*
+ * Choose the number of words in the bloom filter for a hashtable of the
+ * given estimated number of tuples.  Returns 0 if it's not worth building.
+ */
+static uint32
+ExecHashBloomChooseSize(double ntuples)
+{
+	double		target_words;
+	double		max_words;
+	uint32		nwords;
+
+	target_words = ntuples * HASH_BLOOM_BITS_PER_TUPLE / 64;
+	max_words = (double) work_mem * 1024L / 16 / sizeof(uint64);
+	max_words = Min(max_words, HASH_BLOOM_MAX_WORDS);
+
+	if (target_words > max_words * 2)
+		return 0;
+
+	/* Round up to a power of two, but not past max_words */
+	nwords = HASH_BLOOM_MIN_WORDS;
+	while (nwords < target_words && nwords * 2 <= max_words)
+		nwords *= 2;
+
+	return nwords;
+}
+
+/*
+ * Compute the word and the bits within it for a hash value.  The word is
+ * chosen by a remix of the hash value, as its own low bits are correlated
+ * with the bucket and batch numbers.
+ */
+static inline uint64
+ExecHashBloomBits(uint32 hashvalue, uint32 mask, uint32 *wordno)
+{
+	uint32		h = murmurhash32(hashvalue);
+
+	StaticAssertStmt(HASH_BLOOM_NBITS == 3, "bloom filter bits mismatch");
+
+	*wordno = h & mask;
+	return (UINT64CONST(1) << (h >> 26)) |
+		(UINT64CONST(1) << (hashvalue & 63)) |
+		(UINT64CONST(1) << ((hashvalue >> 6) & 63));
+}
+
+/*
+ * Add a hash value to a bloom filter.
+ */
+static inline void
+ExecHashBloomAdd(uint64 *bloom, uint32 mask, uint32 hashvalue)
+{
+	uint32		wordno;
+	uint64		bits = ExecHashBloomBits(hashvalue, mask, &wordno);
+
+	bloom[wordno] |= bits;
+}
+
+/*
+ * Once the bloom filter is complete, check that it's selective enough to be
+ * worth consulting.  If more than half of its bits are set, because there
+ * were many more inner tuples than estimated, it would let through too many
+ * outer tuples, so forget about it.
+ */
+static void
+ExecHashBloomFinish(HashJoinTable hashtable)
+{
+	uint64		nwords = (uint64) hashtable->bloom_mask + 1;
+	uint64		nset;
+
+	nset = pg_popcount((const char *) hashtable->bloom,
+					   (int) (nwords * sizeof(uint64)));
+	if (nset > nwords * 64 / 2)
+	{
+		/* a shared filter is freed by ExecHashTableDetach */
+		if (hashtable->parallel_state == NULL)
+			pfree(hashtable->bloom);
+		hashtable->bloom = NULL;
+		return;
+	}
+
+	hashtable->bloom_ready = true;
+}
+
+/*
+ * ExecHashBloomMayMatch
+ *		Could a tuple with the given hash value have a match in the hashtable?
+ *
+ * Returns true if it could, or if there is no bloom filter to tell.
+ */
+bool
+ExecHashBloomMayMatch(HashJoinTable hashtable, uint32 hashvalue)
+{
+	uint32		wordno;
+	uint64		bits;
+
+	if (!hashtable->bloom_ready)
+		return true;
+
+	bits = ExecHashBloomBits(hashvalue, hashtable->bloom_mask, &wordno);
+	return (hashtable->bloom[wordno] & bits) == bits;
+}
+
 /*
  * ExecHashGetBucketAndBatch
  *		Determine the bucket number and batch number for a hash value
@@ -3166,8 +3360,17 @@ ExecHashTableDetach(HashJoinTable hashtable)
 				dsa_free(hashtable->area, pstate->batches);
 				pstate->batches = InvalidDsaPointer;
 			}
+			if (DsaPointerIsValid(pstate->bloom))
+			{
+				dsa_free(hashtable->area, pstate->bloom);
+				pstate->bloom = InvalidDsaPointer;
+			}
 		}
 
+		/* The shared bloom filter may be gone now. */
+		hashtable->bloom = NULL;
+		hashtable->bloom_ready = false;
+
 		hashtable->parallel_state = NULL;
 	}
 }
@@ -729,6 +729,25 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_HashOperators = node->hashoperators;
 	hjstate->hj_Collations = node->hashcollations;
 
+	/*
+	 * If the planner asked for it, have the Hash node build a bloom filter,
+	 * and push it down into the outer scan.  The scan evaluates the hash
+	 * keys itself, in its own terms.
+	 */
+	if (node->filterkeys != NIL &&
+		IsA(outerPlanState(hjstate), SeqScanState))
+	{
+		SeqScanState *scanstate = (SeqScanState *) outerPlanState(hjstate);
+		RuntimeFilterState *filter;
+
+		filter = (RuntimeFilterState *) palloc0(sizeof(RuntimeFilterState));
+		filter->hashjoin = hjstate;
+		filter->hashkeys = ExecInitExprList(node->filterkeys,
+											(PlanState *) scanstate);
+		scanstate->runtime_filter = filter;
+		((HashState *) innerPlanState(hjstate))->build_bloom = true;
+	}
+
 	hjstate->hj_JoinState = HJ_BUILD_HASHTABLE;
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
@@ -1347,6 +1366,59 @@ ExecReScanHashJoin(HashJoinState *node)
 		ExecReScan(node->js.ps.lefttree);
 }
 
+/*
+ * ExecHashJoinRuntimeFilter
+ *		Check a tuple read by the outer scan against the bloom filter
+ *
+ * Called by the scan for tuples that have passed its quals, with slot being
+ * its scan tuple.  Returns false if the tuple can't have a match in the
+ * hashtable, in which case the scan throws it away.  The planner only pushes
+ * the filter down for joins that have no use for such tuples.  Until the
+ * hashtable has been built, or if it has no bloom filter, every tuple passes.
+ *
+ * Checking a tuple costs about as much as computing its hash value, which
+ * the join does again for the tuples that pass, so if the filter doesn't
+ * throw away at least one in eight of the first RUNTIME_FILTER_SAMPLE
+ * tuples, we stop checking.
+ */
+#define RUNTIME_FILTER_SAMPLE	4096
+
+bool
+ExecHashJoinRuntimeFilter(RuntimeFilterState *filter, ExprContext *econtext,
+						  TupleTableSlot *slot)
+{
+	HashJoinTable hashtable = filter->hashjoin->hj_HashTable;
+	uint32		hashvalue;
+	bool		pass;
+
+	if (filter->disabled || hashtable == NULL || !hashtable->bloom_ready)
+		return true;
+
+	/*
+	 * Hashing the keys may allocate memory in the per-tuple context, e.g. to
+	 * detoast them.  We mustn't reset it here, as the scan's projected tuple
+	 * may live there too; ExecScan resets it before fetching the next tuple.
+	 */
+
+	/* A tuple with a null join key can't match either */
+	econtext->ecxt_scantuple = slot;
+	if (ExecHashGetHashValue(hashtable, econtext, filter->hashkeys,
+							 true, false, &hashvalue))
+		pass = ExecHashBloomMayMatch(hashtable, hashvalue);
+	else
+		pass = false;
+
+	filter->nchecked++;
+	if (!pass)
+		filter->nremoved++;
+
+	if (filter->nchecked == RUNTIME_FILTER_SAMPLE &&
+		filter->nremoved < RUNTIME_FILTER_SAMPLE / 8)
+		filter->disabled = true;
+
+	return pass;
+}
+
 void
 ExecShutdownHashJoin(HashJoinState *node)
 {
@@ -1453,6 +1525,8 @@ ExecHashJoinInitializeDSM(HashJoinState *state, ParallelContext *pcxt)
 	pg_atomic_init_u32(&pstate->distributor, 0);
 	pstate->nparticipants = pcxt->nworkers + 1;
 	pstate->total_tuples = 0;
+	pstate->bloom = InvalidDsaPointer;
+	pstate->bloom_nwords = 0;
 	LWLockInitialize(&pstate->lock,
 					 LWTRANCHE_PARALLEL_HASH_JOIN);
 	BarrierInit(&pstate->build_barrier, 0);
@@ -0,0 +1,368 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeIncrementalSort.c
+ *	  Routines to handle incremental sorting of relations.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeIncrementalSort.c
+ *
+ * DESCRIPTION
+ *
+ *	Incremental sort is a variant of sort that takes advantage of input
+ *	that is already sorted by a prefix of the requested sort keys.  Given
+ *	input ordered by (a), and a requested ordering of (a, b), only the
+ *	tuples within each group of equal a need to be sorted by b:
+ *
+ *		(1, 5), (1, 2), (2, 9), (2, 7), (2, 1)
+ *
+ *	is sorted as the groups (1, 5), (1, 2) and (2, 9), (2, 7), (2, 1), which
+ *	are emitted in turn.  That way, the first tuples can be returned long
+ *	before the input is exhausted, and memory is only needed for a group at
+ *	a time, which matters most below a LIMIT.
+ *
+ *	Setting up a tuplesort per group would be expensive for small groups,
+ *	so whole groups are collected into batches of at least
+ *	INCSORT_MIN_BATCH_SIZE tuples.  A batch is sorted by all the sort keys,
+ *	which leaves the groups in it in order, as they arrived ordered.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execdebug.h"
+#include "executor/nodeIncrementalSort.h"
+#include "miscadmin.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplesort.h"
+
+
+/*
+ * Prepare the equality test of the presorted keys, comparing a tuple in
+ * ecxt_innertuple against one in ecxt_outertuple.
+ */
+static ExprState *
+prepare_presorted_eq(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	int			nkeys = plannode->nPresortedCols;
+	Oid		   *eqOperators;
+	int			i;
+
+	eqOperators = (Oid *) palloc(nkeys * sizeof(Oid));
+	for (i = 0; i < nkeys; i++)
+	{
+		Oid			sortop = plannode->sort.sortOperators[i];
+
+		eqOperators[i] = get_equality_op_for_ordering_op(sortop, NULL);
+		if (!OidIsValid(eqOperators[i]))
+			elog(ERROR, "missing equality operator for ordering operator %u",
+				 sortop);
+	}
+
+	return execTuplesMatchPrepare(ExecGetResultType(outerPlanState(node)),
+								  nkeys,
+								  plannode->sort.sortColIdx,
+								  eqOperators,
+								  plannode->sort.collations,
+								  &node->ss.ps);
+}
+
+/*
+ * Is 'slot' in the same group of presorted keys as the group pivot?
+ */
+static bool
+is_same_group(IncrementalSortState *node, TupleTableSlot *slot)
+{
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	econtext->ecxt_innertuple = node->group_pivot;
+	econtext->ecxt_outertuple = slot;
+	return ExecQualAndReset(node->presorted_eq, econtext);
+}
+
+/*
+ * Read the next batch of input tuples into a new tuplesort, and sort it.
+ *
+ * The batch begins with the tuple stashed in the group pivot, if any, and
+ * takes in whole groups until it holds at least INCSORT_MIN_BATCH_SIZE
+ * tuples.  The first tuple of the following group is stashed in the group
+ * pivot.
+ */
+static void
+incsort_read_batch(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	PlanState  *outerNode = outerPlanState(node);
+	Tuplesortstate *tuplesortstate;
+	TuplesortInstrumentation stats;
+	int64		ntuples = 0;
+
+	tuplesortstate = tuplesort_begin_heap(ExecGetResultType(outerNode),
+										  plannode->sort.numCols,
+										  plannode->sort.sortColIdx,
+										  plannode->sort.sortOperators,
+										  plannode->sort.collations,
+										  plannode->sort.nullsFirst,
+										  work_mem,
+										  NULL, false);
+
+	/*
+	 * All the tuples of this batch follow those returned already, so only
+	 * the remainder of the bound needs to be kept.
+	 */
+	if (node->bounded && node->bound > node->bound_done)
+		tuplesort_set_bound(tuplesortstate, node->bound - node->bound_done);
+	node->tuplesortstate = (void *) tuplesortstate;
+
+	if (node->have_pivot)
+	{
+		tuplesort_puttupleslot(tuplesortstate, node->group_pivot);
+		node->have_pivot = false;
+		ntuples++;
+	}
+
+	for (;;)
+	{
+		TupleTableSlot *slot = ExecProcNode(outerNode);
+
+		if (TupIsNull(slot))
+		{
+			node->outer_done = true;
+			break;
+		}
+
+		if (ntuples >= INCSORT_MIN_BATCH_SIZE)
+		{
+			/*
+			 * The batch is large enough; it ends with the group of the
+			 * tuple in the pivot.  A tuple of a different group begins the
+			 * next batch.
+			 */
+			if (!is_same_group(node, slot))
+			{
+				ExecCopySlot(node->group_pivot, slot);
+				node->have_pivot = true;
+				break;
+			}
+		}
+
+		tuplesort_puttupleslot(tuplesortstate, slot);
+		ntuples++;
+
+		/* remember a tuple of the group the batch must be completed with */
+		if (ntuples == INCSORT_MIN_BATCH_SIZE)
+			ExecCopySlot(node->group_pivot, slot);
+	}
+
+	tuplesort_performsort(tuplesortstate);
+	node->batch_sorted = true;
+
+	node->nbatches++;
+	tuplesort_get_stats(tuplesortstate, &stats);
+	if (stats.spaceUsed > node->max_space_used)
+		node->max_space_used = stats.spaceUsed;
+	if (stats.spaceType == SORT_SPACE_TYPE_DISK)
+		node->spilled = true;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Returns the tuples of the outer subtree in sorted order, sorting
+ *		them batch by batch as they are needed.
+ *
+ *		Conditions:
+ *		  -- none.
+ *
+ *		Initial States:
+ *		  -- the outer child is prepared to return the first tuple.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecIncrementalSort(PlanState *pstate)
+{
+	IncrementalSortState *node = castNode(IncrementalSortState, pstate);
+	EState	   *estate = node->ss.ps.state;
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* the input can only be read forward, so neither can we */
+	Assert(ScanDirectionIsForward(estate->es_direction));
+
+	for (;;)
+	{
+		if (node->batch_sorted)
+		{
+			Tuplesortstate *tuplesortstate =
+			(Tuplesortstate *) node->tuplesortstate;
+
+			if (tuplesort_gettupleslot(tuplesortstate, true, false, slot, NULL))
+			{
+				node->bound_done++;
+				return slot;
+			}
+
+			/* batch exhausted */
+			tuplesort_end(tuplesortstate);
+			node->tuplesortstate = NULL;
+			node->batch_sorted = false;
+		}
+
+		if (node->outer_done && !node->have_pivot)
+			return ExecClearTuple(slot);
+
+		SO1_printf("ExecIncrementalSort: %s\n", "sorting next batch");
+
+		incsort_read_batch(node);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitIncrementalSort
+ *
+ *		Creates the run-time state information for the incremental sort
+ *		node produced by the planner and initializes its outer subtree.
+ * ----------------------------------------------------------------
+ */
+IncrementalSortState *
+ExecInitIncrementalSort(IncrementalSort *node, EState *estate, int eflags)
+{
+	IncrementalSortState *incrsortstate;
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "initializing incremental sort node");
+
+	/*
+	 * Incremental sort can't be used with EXEC_FLAG_BACKWARD or
+	 * EXEC_FLAG_MARK, as it only keeps the current batch.
+	 */
+	Assert((eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) == 0);
+
+	/*
+	 * create state structure
+	 */
+	incrsortstate = makeNode(IncrementalSortState);
+	incrsortstate->ss.ps.plan = (Plan *) node;
+	incrsortstate->ss.ps.state = estate;
+	incrsortstate->ss.ps.ExecProcNode = ExecIncrementalSort;
+
+	incrsortstate->bounded = false;
+	incrsortstate->have_pivot = false;
+	incrsortstate->outer_done = false;
+	incrsortstate->batch_sorted = false;
+	incrsortstate->bound_done = 0;
+	incrsortstate->tuplesortstate = NULL;
+	incrsortstate->nbatches = 0;
+	incrsortstate->max_space_used = 0;
+	incrsortstate->spilled = false;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * The ExprContext is needed to compare presorted keys.
+	 */
+	ExecAssignExprContext(estate, &incrsortstate->ss.ps);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND, BACKWARD, or
+	 * MARK/RESTORE.
+	 */
+	eflags &= ~(EXEC_FLAG_REWIND | EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK);
+
+	outerPlanState(incrsortstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * Initialize scan slot and type.
+	 */
+	ExecCreateScanSlotFromOuterPlan(estate, &incrsortstate->ss, &TTSOpsVirtual);
+
+	/*
+	 * Initialize return slot and type. No need to initialize projection info
+	 * because this node doesn't do projections.
+	 */
+	ExecInitResultTupleSlotTL(&incrsortstate->ss.ps, &TTSOpsMinimalTuple);
+	incrsortstate->ss.ps.ps_ProjInfo = NULL;
+
+	/* slot and expression to detect changes of the presorted keys */
+	incrsortstate->group_pivot =
+		ExecInitExtraTupleSlot(estate,
+							   ExecGetResultType(outerPlanState(incrsortstate)),
+							   &TTSOpsMinimalTuple);
+	incrsortstate->presorted_eq = prepare_presorted_eq(incrsortstate);
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "incremental sort node initialized");
+
+	return incrsortstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndIncrementalSort(node)
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndIncrementalSort(IncrementalSortState *node)
+{
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "shutting down incremental sort node");
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+
+	/*
+	 * Release tuplesort resources
+	 */
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "incremental sort node shutdown");
+}
+
+void
+ExecReScanIncrementalSort(IncrementalSortState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	/*
+	 * As only the current batch is kept, there is nothing to rewind; start
+	 * over reading the outer plan.
+	 */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+
+	node->have_pivot = false;
+	node->outer_done = false;
+	node->batch_sorted = false;
+	node->bound_done = 0;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (outerPlan->chgParam == NULL)
+		ExecReScan(outerPlan);
+}
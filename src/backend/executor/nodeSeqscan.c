@@ -20,6 +20,9 @@
  *		ExecEndSeqScan			releases any storage allocated.
  *		ExecReScanSeqScan		rescans the relation
  *
+ *		ExecSeqScanBatchInit	prepares to return tuples in batches
+ *		ExecSeqScanBatchNext	retrieves the next batch of qualifying tuples
+ *
  *		ExecSeqScanEstimate		estimates DSM space needed for parallel scan
  *		ExecSeqScanInitializeDSM initialize DSM for parallel scan
  *		ExecSeqScanReInitializeDSM reinitialize DSM for fresh parallel scan
@@ -29,8 +32,12 @@
 
 #include "access/relscan.h"
 #include "access/tableam.h"
+#include "executor/execBatch.h"
 #include "executor/execdebug.h"
+#include "executor/instrument.h"
+#include "executor/nodeHashjoin.h"
 #include "executor/nodeSeqscan.h"
+#include "miscadmin.h"
 #include "utils/rel.h"
 
 static TupleTableSlot *SeqNext(SeqScanState *node);
@@ -108,10 +115,148 @@ static TupleTableSlot *
 ExecSeqScan(PlanState *pstate)
 {
 	SeqScanState *node = castNode(SeqScanState, pstate);
+	TupleTableSlot *slot;
+
+	if (node->runtime_filter == NULL)
+		return ExecScan(&node->ss,
+						(ExecScanAccessMtd) SeqNext,
+						(ExecScanRecheckMtd) SeqRecheck);
+
+	/*
+	 * Skip the tuples that the bloom filter pushed down from a hash join
+	 * above us says can't be joined.  The filter is only checked once the
+	 * tuple has passed our quals, so that the join keys are never computed
+	 * for rows that the quals, including any security barrier quals, reject.
+	 */
+	for (;;)
+	{
+		ExprContext *econtext = node->ss.ps.ps_ExprContext;
+		TupleTableSlot *scanslot;
+
+		slot = ExecScan(&node->ss,
+						(ExecScanAccessMtd) SeqNext,
+						(ExecScanRecheckMtd) SeqRecheck);
+		if (TupIsNull(slot))
+			return slot;
+
+		/* unless ExecScan projected, it returned the scan tuple itself */
+		scanslot = node->ss.ps.ps_ProjInfo ? econtext->ecxt_scantuple : slot;
+		if (ExecHashJoinRuntimeFilter(node->runtime_filter, econtext,
+									  scanslot))
+			return slot;
+
+		InstrCountFiltered2(node, 1);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *						Batch Mode Support
+ * ----------------------------------------------------------------
+ */
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatchInit
+ *
+ *		Sets up the scan to be read by ExecSeqScanBatchNext instead of
+ *		ExecProcNode.  The caller adds the columns it needs to the
+ *		returned batch, then calls ExecBatchAllocate.
+ *
+ *		The scan quals are evaluated on whole batches if all of them are
+ *		simple enough for it, else on each tuple as it is read.
+ * ----------------------------------------------------------------
+ */
+ExecBatch *
+ExecSeqScanBatchInit(SeqScanState *node)
+{
+	Scan	   *plan = (Scan *) node->ss.ps.plan;
+	ExecBatch  *batch = ExecBatchCreate();
+	ListCell   *lc;
+
+	/* only Agg reads scans in batches, and it never pushes a filter down */
+	Assert(node->runtime_filter == NULL);
+
+	foreach(lc, plan->plan.qual)
+	{
+		if (!ExecBatchAddQual(batch, (Expr *) lfirst(lc), plan->scanrelid))
+		{
+			batch->nquals = 0;
+			batch->rowquals = true;
+			break;
+		}
+	}
+
+	node->batch = batch;
+	return batch;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatchNext
+ *
+ *		Reads the next batch of up to EXEC_BATCH_SIZE tuples, and
+ *		returns it with the tuples passing the quals selected.  Returns
+ *		NULL at the end of the scan.
+ *
+ *		The node's projection is bypassed; the batch holds the columns of
+ *		the scan tuples.
+ * ----------------------------------------------------------------
+ */
+ExecBatch *
+ExecSeqScanBatchNext(SeqScanState *node)
+{
+	ExecBatch  *batch = node->batch;
+	ExprState  *qual = node->ss.ps.qual;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	int			nrows = 0;
+	int			col;
+
+	Assert(batch != NULL && batch->values != NULL);
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* as in ExecProcNode */
+	if (node->ss.ps.chgParam != NULL)
+		ExecReScan((PlanState *) node);
+
+	if (node->ss.ps.instrument)
+		InstrStartNode(node->ss.ps.instrument);
+
+	while (nrows < EXEC_BATCH_SIZE)
+	{
+		TupleTableSlot *slot = SeqNext(node);
+
+		if (slot == NULL)
+			break;
+
+		if (batch->rowquals)
+		{
+			econtext->ecxt_scantuple = slot;
+			ResetExprContext(econtext);
+			if (!ExecQual(qual, econtext))
+			{
+				InstrCountFiltered1(node, 1);
+				continue;
+			}
+		}
+
+		slot_getsomeattrs(slot, batch->maxattnum);
+		for (col = 0; col < batch->ncols; col++)
+		{
+			int			attoff = batch->attnums[col] - 1;
+
+			batch->values[col][nrows] = slot->tts_values[attoff];
+			batch->isnull[col][nrows] = slot->tts_isnull[attoff];
+		}
+		nrows++;
+	}
+
+	batch->nrows = nrows;
+	ExecBatchEvalQuals(batch);
+	InstrCountFiltered1(node, batch->nrows - batch->nsel);
+
+	if (node->ss.ps.instrument)
+		InstrStopNode(node->ss.ps.instrument, batch->nsel);
 
-	return ExecScan(&node->ss,
-					(ExecScanAccessMtd) SeqNext,
-					(ExecScanRecheckMtd) SeqRecheck);
+	return nrows > 0 ? batch : NULL;
 }
 
 
@@ -138,6 +283,8 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	scanstate->ss.ps.plan = (Plan *) node;
 	scanstate->ss.ps.state = estate;
 	scanstate->ss.ps.ExecProcNode = ExecSeqScan;
+	scanstate->batch = NULL;
+	scanstate->runtime_filter = NULL;	/* may be set by parent HashJoin */
 
 	/*
 	 * Miscellaneous initialization
@@ -16,8 +16,11 @@
 #include "jit/llvmjit.h"
 #include "jit/llvmjit_emit.h"
 
+#include "access/hash.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 
+#include "utils/hsearch.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 #include "portability/instr_time.h"
@@ -47,6 +50,34 @@ typedef struct LLVMJitHandle
 	LLVMOrcModuleHandle orc_handle;
 } LLVMJitHandle;
 
+/*
+ * Module emitted for code that may be reused by later JIT contexts. It stays
+ * loaded as long as a cache entry, or a context that might be running its
+ * code, references it.
+ */
+typedef struct LLVMJitCachedModule
+{
+	LLVMJitHandle handle;
+	int			refcount;
+} LLVMJitCachedModule;
+
+/* key of the code cache, an opaque description built by the caller */
+typedef struct LLVMJitCacheKey
+{
+	uint32		hash;
+	int			len;
+	char	   *data;
+} LLVMJitCacheKey;
+
+typedef struct LLVMJitCacheEntry
+{
+	LLVMJitCacheKey key;		/* hash key, must be first */
+	LLVMJitCachedModule *module;	/* module containing the function */
+	char	   *funcname;
+	void	   *addr;			/* address of funcname, once looked up */
+	dlist_node	lru_node;		/* position in llvm_cache_lru */
+} LLVMJitCacheEntry;
+
 
 /* types & functions commonly needed for JITing */
 LLVMTypeRef TypeSizeT;
@@ -104,12 +135,29 @@ static LLVMTargetRef llvm_targetref;
 static LLVMOrcJITStackRef llvm_opt0_orc;
 static LLVMOrcJITStackRef llvm_opt3_orc;
 
+/* per-backend cache of emitted code, see llvm_cache_lookup() */
+static HTAB *llvm_cache = NULL;
+static dlist_head llvm_cache_lru = DLIST_STATIC_INIT(llvm_cache_lru);
+static int	llvm_cache_nentries = 0;
+
 
 static void llvm_release_context(JitContext *context);
 static void llvm_session_initialize(void);
 static void llvm_shutdown(int code, Datum arg);
 static void llvm_compile_module(LLVMJitContext *context);
+static void llvm_emit_module(LLVMJitContext *context, LLVMModuleRef module,
+							 const char *suffix, LLVMJitHandle *handle);
 static void llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module);
+static void *llvm_handle_get_function(LLVMJitHandle *handle,
+									  const char *funcname);
+
+static uint32 llvm_cache_key_hash(const void *key, Size keysize);
+static int	llvm_cache_key_match(const void *key1, const void *key2,
+								 Size keysize);
+static void llvm_cache_insert_pending(LLVMJitContext *context,
+									  LLVMJitCachedModule *cmod);
+static void llvm_cache_trim(void);
+static void llvm_unpin_cached_module(LLVMJitCachedModule *cmod);
 
 static void llvm_create_types(void);
 static uint64_t llvm_resolve_symbol(const char *name, void *ctx);
@@ -181,6 +229,41 @@ llvm_release_context(JitContext *context)
 			llvm_context->module = NULL;
 		}
 
+		if (llvm_context->cache_module)
+		{
+			LLVMDisposeModule(llvm_context->cache_module);
+			llvm_context->cache_module = NULL;
+		}
+
+		/* the code for pending entries never got emitted */
+		while (llvm_context->pending_cache_entries != NIL)
+		{
+			LLVMJitCacheEntry *pending;
+
+			pending = (LLVMJitCacheEntry *)
+				linitial(llvm_context->pending_cache_entries);
+			llvm_context->pending_cache_entries =
+				list_delete_first(llvm_context->pending_cache_entries);
+
+			pfree(pending->key.data);
+			pfree(pending->funcname);
+			pfree(pending);
+		}
+
+		while (llvm_context->cache_pins != NIL)
+		{
+			LLVMJitCachedModule *cmod;
+
+			cmod = (LLVMJitCachedModule *) linitial(llvm_context->cache_pins);
+			llvm_context->cache_pins =
+				list_delete_first(llvm_context->cache_pins);
+
+			llvm_unpin_cached_module(cmod);
+		}
+
+		/* apply a reduced jit_cache_size */
+		llvm_cache_trim();
+
 		while (llvm_context->handles != NIL)
 		{
 			LLVMJitHandle *jit_handle;
@@ -246,10 +329,8 @@ llvm_expand_funcname(struct LLVMJitContext *context, const char *basename)
 void *
 llvm_get_function(LLVMJitContext *context, const char *funcname)
 {
-	LLVMOrcTargetAddress addr = 0;
-#if defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
 	ListCell   *lc;
-#endif
+	void	   *addr;
 
 	llvm_assert_in_fatal_section();
 
@@ -262,48 +343,57 @@ llvm_get_function(LLVMJitContext *context, const char *funcname)
 		llvm_compile_module(context);
 	}
 
-	/*
-	 * ORC's symbol table is of *unmangled* symbols. Therefore we don't need
-	 * to mangle here.
-	 */
-
-#if defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
 	foreach(lc, context->handles)
 	{
 		LLVMJitHandle *handle = (LLVMJitHandle *) lfirst(lc);
 
-		addr = 0;
-		if (LLVMOrcGetSymbolAddressIn(handle->stack, &addr, handle->orc_handle, funcname))
-			elog(ERROR, "failed to look up symbol \"%s\"", funcname);
+		addr = llvm_handle_get_function(handle, funcname);
 		if (addr)
-			return (void *) (uintptr_t) addr;
+			return addr;
 	}
 
-#else
-
-#if LLVM_VERSION_MAJOR < 5
-	if ((addr = LLVMOrcGetSymbolAddress(llvm_opt0_orc, funcname)))
-		return (void *) (uintptr_t) addr;
-	if ((addr = LLVMOrcGetSymbolAddress(llvm_opt3_orc, funcname)))
-		return (void *) (uintptr_t) addr;
-#else
-	if (LLVMOrcGetSymbolAddress(llvm_opt0_orc, &addr, funcname))
-		elog(ERROR, "failed to look up symbol \"%s\"", funcname);
-	if (addr)
-		return (void *) (uintptr_t) addr;
-	if (LLVMOrcGetSymbolAddress(llvm_opt3_orc, &addr, funcname))
-		elog(ERROR, "failed to look up symbol \"%s\"", funcname);
-	if (addr)
-		return (void *) (uintptr_t) addr;
-#endif							/* LLVM_VERSION_MAJOR */
+	/* code emitted for the cache is only referenced via the pins */
+	foreach(lc, context->cache_pins)
+	{
+		LLVMJitCachedModule *cmod = (LLVMJitCachedModule *) lfirst(lc);
 
-#endif							/* HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN */
+		addr = llvm_handle_get_function(&cmod->handle, funcname);
+		if (addr)
+			return addr;
+	}
 
 	elog(ERROR, "failed to JIT: %s", funcname);
 
 	return NULL;
 }
 
+/*
+ * Return pointer to function funcname in the code emitted for handle, or NULL
+ * if it can't be found there.
+ */
+static void *
+llvm_handle_get_function(LLVMJitHandle *handle, const char *funcname)
+{
+	LLVMOrcTargetAddress addr = 0;
+
+	/*
+	 * ORC's symbol table is of *unmangled* symbols. Therefore we don't need
+	 * to mangle here.
+	 */
+
+#if defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
+	if (LLVMOrcGetSymbolAddressIn(handle->stack, &addr, handle->orc_handle, funcname))
+		elog(ERROR, "failed to look up symbol \"%s\"", funcname);
+#elif LLVM_VERSION_MAJOR < 5
+	addr = LLVMOrcGetSymbolAddress(handle->stack, funcname);
+#else
+	if (LLVMOrcGetSymbolAddress(handle->stack, &addr, funcname))
+		elog(ERROR, "failed to look up symbol \"%s\"", funcname);
+#endif
+
+	return (void *) (uintptr_t) addr;
+}
+
 /*
  * Return declaration for passed function, adding it to the module if
  * necessary.
@@ -457,7 +547,7 @@ llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
 	 * functions are emitted, to reduce memory usage a bit.
 	 */
 	LLVMInitializeFunctionPassManager(llvm_fpm);
-	for (func = LLVMGetFirstFunction(context->module);
+	for (func = LLVMGetFirstFunction(module);
 		 func != NULL;
 		 func = LLVMGetNextFunction(func))
 		LLVMRunFunctionPassManager(llvm_fpm, func);
@@ -478,21 +568,76 @@ llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
 	if (context->base.flags & PGJIT_INLINE
 		&& !(context->base.flags & PGJIT_OPT3))
 		LLVMAddFunctionInliningPass(llvm_mpm);
-	LLVMRunPassManager(llvm_mpm, context->module);
+	LLVMRunPassManager(llvm_mpm, module);
 	LLVMDisposePassManager(llvm_mpm);
 
 	LLVMPassManagerBuilderDispose(llvm_pmb);
 }
 
 /*
- * Emit code for the currently pending module.
+ * Emit code for the currently pending modules.
  */
 static void
 llvm_compile_module(LLVMJitContext *context)
 {
-	LLVMOrcModuleHandle orc_handle;
 	MemoryContext oldcontext;
-	static LLVMOrcJITStackRef compile_orc;
+
+	Assert(!context->cache_module_active);
+
+	if (context->module)
+	{
+		LLVMJitHandle *handle;
+
+		/* remember emitted code for cleanup and lookups */
+		handle = (LLVMJitHandle *)
+			MemoryContextAlloc(TopMemoryContext, sizeof(LLVMJitHandle));
+		llvm_emit_module(context, context->module, "", handle);
+		context->module = NULL;
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		context->handles = lappend(context->handles, handle);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	if (context->cache_module)
+	{
+		LLVMJitCachedModule *cmod;
+
+		cmod = (LLVMJitCachedModule *)
+			MemoryContextAlloc(TopMemoryContext, sizeof(LLVMJitCachedModule));
+		llvm_emit_module(context, context->cache_module, ".cache",
+						 &cmod->handle);
+		context->cache_module = NULL;
+
+		/* this context may run the code, keep it until it's released */
+		cmod->refcount = 1;
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		context->cache_pins = lappend(context->cache_pins, cmod);
+		MemoryContextSwitchTo(oldcontext);
+
+		llvm_cache_insert_pending(context, cmod);
+	}
+
+	context->compiled = true;
+
+	ereport(DEBUG1,
+			(errmsg("time to inline: %.3fs, opt: %.3fs, emit: %.3fs",
+					INSTR_TIME_GET_DOUBLE(context->base.instr.inlining_counter),
+					INSTR_TIME_GET_DOUBLE(context->base.instr.optimization_counter),
+					INSTR_TIME_GET_DOUBLE(context->base.instr.emission_counter)),
+			 errhidestmt(true),
+			 errhidecontext(true)));
+}
+
+/*
+ * Optimize and emit module, which is consumed, and fill in handle.
+ */
+static void
+llvm_emit_module(LLVMJitContext *context, LLVMModuleRef module,
+				 const char *suffix, LLVMJitHandle *handle)
+{
+	LLVMOrcModuleHandle orc_handle;
+	LLVMOrcJITStackRef compile_orc;
 	instr_time	starttime;
 	instr_time	endtime;
 
@@ -505,7 +650,7 @@ llvm_compile_module(LLVMJitContext *context)
 	if (context->base.flags & PGJIT_INLINE)
 	{
 		INSTR_TIME_SET_CURRENT(starttime);
-		llvm_inline(context->module);
+		llvm_inline(module);
 		INSTR_TIME_SET_CURRENT(endtime);
 		INSTR_TIME_ACCUM_DIFF(context->base.instr.inlining_counter,
 							  endtime, starttime);
@@ -515,17 +660,18 @@ llvm_compile_module(LLVMJitContext *context)
 	{
 		char	   *filename;
 
-		filename = psprintf("%u.%zu.bc",
+		filename = psprintf("%u.%zu%s.bc",
 							MyProcPid,
-							context->module_generation);
-		LLVMWriteBitcodeToFile(context->module, filename);
+							context->module_generation,
+							suffix);
+		LLVMWriteBitcodeToFile(module, filename);
 		pfree(filename);
 	}
 
 
 	/* optimize according to the chosen optimization settings */
 	INSTR_TIME_SET_CURRENT(starttime);
-	llvm_optimize_module(context, context->module);
+	llvm_optimize_module(context, module);
 	INSTR_TIME_SET_CURRENT(endtime);
 	INSTR_TIME_ACCUM_DIFF(context->base.instr.optimization_counter,
 						  endtime, starttime);
@@ -534,10 +680,11 @@ llvm_compile_module(LLVMJitContext *context)
 	{
 		char	   *filename;
 
-		filename = psprintf("%u.%zu.optimized.bc",
+		filename = psprintf("%u.%zu%s.optimized.bc",
 							MyProcPid,
-							context->module_generation);
-		LLVMWriteBitcodeToFile(context->module, filename);
+							context->module_generation,
+							suffix);
+		LLVMWriteBitcodeToFile(module, filename);
 		pfree(filename);
 	}
 
@@ -550,7 +697,7 @@ llvm_compile_module(LLVMJitContext *context)
 	INSTR_TIME_SET_CURRENT(starttime);
 #if LLVM_VERSION_MAJOR > 6
 	{
-		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &orc_handle, context->module,
+		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &orc_handle, module,
 										llvm_resolve_symbol, NULL))
 		{
 			elog(ERROR, "failed to JIT module");
@@ -562,7 +709,7 @@ llvm_compile_module(LLVMJitContext *context)
 	{
 		LLVMSharedModuleRef smod;
 
-		smod = LLVMOrcMakeSharedModule(context->module);
+		smod = LLVMOrcMakeSharedModule(module);
 		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &orc_handle, smod,
 										llvm_resolve_symbol, NULL))
 		{
@@ -572,38 +719,268 @@ llvm_compile_module(LLVMJitContext *context)
 	}
 #else							/* LLVM 4.0 and 3.9 */
 	{
-		orc_handle = LLVMOrcAddEagerlyCompiledIR(compile_orc, context->module,
+		orc_handle = LLVMOrcAddEagerlyCompiledIR(compile_orc, module,
 												 llvm_resolve_symbol, NULL);
-		LLVMDisposeModule(context->module);
+		LLVMDisposeModule(module);
 	}
 #endif
 	INSTR_TIME_SET_CURRENT(endtime);
 	INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
 						  endtime, starttime);
 
-	context->module = NULL;
-	context->compiled = true;
+	handle->stack = compile_orc;
+	handle->orc_handle = orc_handle;
+}
 
-	/* remember emitted code for cleanup and lookups */
-	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+/*
+ * Direct code generation to the context's cache module, until
+ * llvm_leave_cache_module() is called.
+ *
+ * Functions created in between, including those they call, e.g. deforming
+ * functions, are emitted separately from the context's other code, and can
+ * thus be kept for later contexts via llvm_cache_enter(). Such code must not
+ * embed pointers that are only valid for the current execution.
+ */
+void
+llvm_enter_cache_module(LLVMJitContext *context)
+{
+	LLVMModuleRef module = context->module;
+
+	Assert(!context->cache_module_active);
+
+	context->module = context->cache_module;
+	context->cache_module = module;
+	context->cache_module_active = true;
+}
+
+void
+llvm_leave_cache_module(LLVMJitContext *context)
+{
+	LLVMModuleRef module = context->module;
+
+	Assert(context->cache_module_active);
+
+	context->module = context->cache_module;
+	context->cache_module = module;
+	context->cache_module_active = false;
+}
+
+/*
+ * Look up code previously registered with llvm_cache_enter() under the same
+ * key, by this or an earlier context of this backend.
+ *
+ * Returns the function's address, which stays valid until context is
+ * released, or NULL if there is no such code.
+ */
+void *
+llvm_cache_lookup(LLVMJitContext *context, const char *key, int keylen)
+{
+	LLVMJitCacheKey hkey;
+	LLVMJitCacheEntry *entry = NULL;
+
+	llvm_assert_in_fatal_section();
+
+	/* apply a reduced jit_cache_size */
+	llvm_cache_trim();
+
+	if (llvm_cache != NULL)
 	{
-		LLVMJitHandle *handle;
+		hkey.hash = DatumGetUInt32(hash_any((const unsigned char *) key,
+											keylen));
+		hkey.len = keylen;
+		hkey.data = (char *) key;
 
-		handle = (LLVMJitHandle *) palloc(sizeof(LLVMJitHandle));
-		handle->stack = compile_orc;
-		handle->orc_handle = orc_handle;
+		entry = (LLVMJitCacheEntry *) hash_search(llvm_cache, &hkey,
+												  HASH_FIND, NULL);
+	}
 
-		context->handles = lappend(context->handles, handle);
+	if (entry == NULL)
+	{
+		context->base.instr.cache_misses++;
+		return NULL;
+	}
+
+	if (entry->addr == NULL)
+	{
+		entry->addr = llvm_handle_get_function(&entry->module->handle,
+											   entry->funcname);
+		if (entry->addr == NULL)
+			elog(ERROR, "failed to JIT: %s", entry->funcname);
 	}
+
+	/* the module may not be unloaded while this context can run its code */
+	if (!list_member_ptr(context->cache_pins, entry->module))
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		context->cache_pins = lappend(context->cache_pins, entry->module);
+		MemoryContextSwitchTo(oldcontext);
+
+		entry->module->refcount++;
+	}
+
+	dlist_delete(&entry->lru_node);
+	dlist_push_tail(&llvm_cache_lru, &entry->lru_node);
+
+	context->base.instr.cache_hits++;
+
+	return entry->addr;
+}
+
+/*
+ * Register funcname, which has to have been created in the context's cache
+ * module, as the code for key.
+ *
+ * The entry only becomes visible to llvm_cache_lookup() once the module has
+ * been emitted.
+ */
+void
+llvm_cache_enter(LLVMJitContext *context, const char *key, int keylen,
+				 const char *funcname)
+{
+	MemoryContext oldcontext;
+	LLVMJitCacheEntry *pending;
+
+	Assert(context->cache_module_active);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	pending = (LLVMJitCacheEntry *) palloc0(sizeof(LLVMJitCacheEntry));
+	pending->key.hash = DatumGetUInt32(hash_any((const unsigned char *) key,
+												keylen));
+	pending->key.len = keylen;
+	pending->key.data = palloc(keylen);
+	memcpy(pending->key.data, key, keylen);
+	pending->funcname = pstrdup(funcname);
+
+	context->pending_cache_entries =
+		lappend(context->pending_cache_entries, pending);
+
 	MemoryContextSwitchTo(oldcontext);
+}
 
-	ereport(DEBUG1,
-			(errmsg("time to inline: %.3fs, opt: %.3fs, emit: %.3fs",
-					INSTR_TIME_GET_DOUBLE(context->base.instr.inlining_counter),
-					INSTR_TIME_GET_DOUBLE(context->base.instr.optimization_counter),
-					INSTR_TIME_GET_DOUBLE(context->base.instr.emission_counter)),
-			 errhidestmt(true),
-			 errhidecontext(true)));
+/*
+ * Make the context's pending cache entries, whose code has just been emitted
+ * as cmod, visible.
+ */
+static void
+llvm_cache_insert_pending(LLVMJitContext *context, LLVMJitCachedModule *cmod)
+{
+	ListCell   *lc;
+
+	if (llvm_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(LLVMJitCacheKey);
+		ctl.entrysize = sizeof(LLVMJitCacheEntry);
+		ctl.hash = llvm_cache_key_hash;
+		ctl.match = llvm_cache_key_match;
+
+		llvm_cache = hash_create("LLVM JIT code cache", 256, &ctl,
+								 HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+	}
+
+	foreach(lc, context->pending_cache_entries)
+	{
+		LLVMJitCacheEntry *pending = (LLVMJitCacheEntry *) lfirst(lc);
+		LLVMJitCacheEntry *entry;
+		bool		found;
+
+		entry = (LLVMJitCacheEntry *) hash_search(llvm_cache, &pending->key,
+												  HASH_ENTER, &found);
+		if (found)
+		{
+			/* identical code got cached in the meantime, keep that */
+			pfree(pending->key.data);
+			pfree(pending->funcname);
+		}
+		else
+		{
+			/* the entry took over the key's data */
+			entry->module = cmod;
+			entry->funcname = pending->funcname;
+			entry->addr = NULL;
+			dlist_push_tail(&llvm_cache_lru, &entry->lru_node);
+
+			cmod->refcount++;
+			llvm_cache_nentries++;
+		}
+
+		pfree(pending);
+	}
+
+	list_free(context->pending_cache_entries);
+	context->pending_cache_entries = NIL;
+
+	llvm_cache_trim();
+}
+
+/*
+ * Evict least recently used cache entries until at most jit_cache_size
+ * remain.
+ */
+static void
+llvm_cache_trim(void)
+{
+	while (llvm_cache_nentries > jit_cache_size)
+	{
+		LLVMJitCacheEntry *entry;
+		LLVMJitCachedModule *cmod;
+		char	   *data;
+		char	   *funcname;
+
+		entry = dlist_head_element(LLVMJitCacheEntry, lru_node,
+								   &llvm_cache_lru);
+		cmod = entry->module;
+		data = entry->key.data;
+		funcname = entry->funcname;
+
+		dlist_delete(&entry->lru_node);
+		if (hash_search(llvm_cache, &entry->key, HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "LLVM JIT code cache is corrupted");
+		llvm_cache_nentries--;
+
+		pfree(data);
+		pfree(funcname);
+
+		llvm_unpin_cached_module(cmod);
+	}
+}
+
+/*
+ * Drop a reference to cmod, unloading its code once it's unreferenced.
+ */
+static void
+llvm_unpin_cached_module(LLVMJitCachedModule *cmod)
+{
+	Assert(cmod->refcount > 0);
+
+	if (--cmod->refcount > 0)
+		return;
+
+	LLVMOrcRemoveModule(cmod->handle.stack, cmod->handle.orc_handle);
+	pfree(cmod);
+}
+
+static uint32
+llvm_cache_key_hash(const void *key, Size keysize)
+{
+	return ((const LLVMJitCacheKey *) key)->hash;
+}
+
+static int
+llvm_cache_key_match(const void *key1, const void *key2, Size keysize)
+{
+	const LLVMJitCacheKey *k1 = (const LLVMJitCacheKey *) key1;
+	const LLVMJitCacheKey *k2 = (const LLVMJitCacheKey *) key2;
+
+	if (k1->hash != k2->hash || k1->len != k2->len)
+		return 1;
+
+	return memcmp(k1->data, k2->data, k1->len);
 }
 
 /*
@@ -30,6 +30,7 @@
 #include "funcapi.h"
 #include "jit/llvmjit.h"
 #include "jit/llvmjit_emit.h"
+#include "lib/stringinfo.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -51,18 +52,29 @@ typedef struct CompiledExprState
 {
 	LLVMJitContext *context;
 	const char *funcname;
+	/* previously emitted code found in the cache, if any */
+	ExprStateEvalFunc func;
 } CompiledExprState;
 
 
 static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull);
 
+static bool expr_cache_key(ExprState *state, int jit_flags, StringInfo key);
+static LLVMValueRef l_step_ptr(LLVMBuilderRef b, LLVMValueRef v_steps,
+							   ExprEvalStep *op, int opno);
+static LLVMValueRef l_step_load(LLVMBuilderRef b, LLVMValueRef v_steps,
+								int opno, size_t offset, LLVMTypeRef type);
+static LLVMValueRef l_step_field_ptr(LLVMBuilderRef b, LLVMValueRef v_steps,
+									 ExprEvalStep *op, int opno,
+									 size_t offset, LLVMTypeRef type);
 static LLVMValueRef BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 								LLVMModuleRef mod, FunctionCallInfo fcinfo,
+								LLVMValueRef v_fcinfo,
 								LLVMValueRef *v_fcinfo_isnull);
 static void build_EvalXFunc(LLVMBuilderRef b, LLVMModuleRef mod,
 							const char *funcname,
 							LLVMValueRef v_state, LLVMValueRef v_econtext,
-							ExprEvalStep *op);
+							LLVMValueRef v_op);
 static LLVMValueRef create_LifetimeEnd(LLVMModuleRef mod);
 
 
@@ -89,6 +101,11 @@ llvm_compile_expr(ExprState *state)
 	LLVMValueRef v_state;
 	LLVMValueRef v_econtext;
 
+	/* state->steps, if the code has to work for any ExprState of this shape */
+	LLVMValueRef v_steps = NULL;
+	StringInfoData cache_key;
+	bool		cacheable = false;
+
 	/* returnvalue */
 	LLVMValueRef v_isnullp;
 
@@ -139,6 +156,49 @@ llvm_compile_expr(ExprState *state)
 
 	INSTR_TIME_SET_CURRENT(starttime);
 
+	/*
+	 * If an expression of the same shape has been compiled before, by this
+	 * or an earlier query, reuse its code.  Otherwise arrange for the code
+	 * we're about to generate to be kept for later.
+	 */
+	if (jit_cache_size > 0)
+	{
+		initStringInfo(&cache_key);
+		cacheable = expr_cache_key(state, context->base.flags, &cache_key);
+		if (!cacheable)
+			pfree(cache_key.data);
+	}
+
+	if (cacheable)
+	{
+		ExprStateEvalFunc func;
+
+		func = (ExprStateEvalFunc) llvm_cache_lookup(context, cache_key.data,
+													 cache_key.len);
+		if (func)
+		{
+			CompiledExprState *cstate = palloc0(sizeof(CompiledExprState));
+
+			cstate->context = context;
+			cstate->func = func;
+
+			state->evalfunc = ExecRunCompiledExpr;
+			state->evalfunc_private = cstate;
+
+			pfree(cache_key.data);
+
+			llvm_leave_fatal_on_oom();
+
+			INSTR_TIME_SET_CURRENT(endtime);
+			INSTR_TIME_ACCUM_DIFF(context->base.instr.generation_counter,
+								  endtime, starttime);
+
+			return true;
+		}
+
+		llvm_enter_cache_module(context);
+	}
+
 	mod = llvm_mutable_module(context);
 
 	b = LLVMCreateBuilder();
@@ -191,6 +251,10 @@ llvm_compile_expr(ExprState *state)
 	v_resultslot = l_load_struct_gep(b, v_state,
 									 FIELDNO_EXPRSTATE_RESULTSLOT,
 									 "v_resultslot");
+	if (cacheable)
+		v_steps = l_load_struct_gep(b, v_state,
+									FIELDNO_EXPRSTATE_STEPS,
+									"v.state.steps");
 
 	/* build global values/isnull pointers */
 	v_scanvalues = l_load_struct_gep(b, v_scanslot,
@@ -238,6 +302,7 @@ llvm_compile_expr(ExprState *state)
 	{
 		ExprEvalStep *op;
 		ExprEvalOp	opcode;
+		LLVMValueRef v_op;
 		LLVMValueRef v_resvaluep;
 		LLVMValueRef v_resnullp;
 
@@ -246,8 +311,17 @@ llvm_compile_expr(ExprState *state)
 		op = &state->steps[i];
 		opcode = ExecEvalStepOp(state, op);
 
-		v_resvaluep = l_ptr_const(op->resvalue, l_ptr(TypeSizeT));
-		v_resnullp = l_ptr_const(op->resnull, l_ptr(TypeStorageBool));
+		/*
+		 * Steps with code that might be cached, see expr_cache_key(), have to
+		 * reference per-ExprState data via v_op and l_step_field_ptr().
+		 */
+		v_op = l_step_ptr(b, v_steps, op, i);
+		v_resvaluep = l_step_field_ptr(b, v_steps, op, i,
+									   offsetof(ExprEvalStep, resvalue),
+									   l_ptr(TypeSizeT));
+		v_resnullp = l_step_field_ptr(b, v_steps, op, i,
+									  offsetof(ExprEvalStep, resnull),
+									  l_ptr(TypeStorageBool));
 
 		switch (opcode)
 		{
@@ -403,7 +477,7 @@ llvm_compile_expr(ExprState *state)
 						v_slot = v_scanslot;
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+					v_params[1] = v_op;
 					v_params[2] = v_econtext;
 					v_params[3] = v_slot;
 
@@ -417,7 +491,7 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_WHOLEROW:
 				build_EvalXFunc(b, mod, "ExecEvalWholeRowVar",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -553,8 +627,22 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_constvalue,
 								v_constnull;
 
-					v_constvalue = l_sizet_const(op->d.constval.value);
-					v_constnull = l_sbool_const(op->d.constval.isnull);
+					if (v_steps)
+					{
+						v_constvalue =
+							l_step_load(b, v_steps, i,
+										offsetof(ExprEvalStep, d.constval.value),
+										TypeSizeT);
+						v_constnull =
+							l_step_load(b, v_steps, i,
+										offsetof(ExprEvalStep, d.constval.isnull),
+										TypeStorageBool);
+					}
+					else
+					{
+						v_constvalue = l_sizet_const(op->d.constval.value);
+						v_constnull = l_sbool_const(op->d.constval.isnull);
+					}
 
 					LLVMBuildStore(b, v_constvalue, v_resvaluep);
 					LLVMBuildStore(b, v_constnull, v_resnullp);
@@ -565,7 +653,6 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_FUNCEXPR_STRICT:
 				{
-					FunctionCallInfo fcinfo = op->d.func.fcinfo_data;
 					LLVMBasicBlockRef b_nonull;
 					int			argno;
 					LLVMValueRef v_fcinfo;
@@ -583,7 +670,9 @@ llvm_compile_expr(ExprState *state)
 						elog(ERROR, "argumentless strict functions are pointless");
 
 					v_fcinfo =
-						l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.func.fcinfo_data),
+										 l_ptr(StructFunctionCallInfoData));
 
 					/*
 					 * set resnull to true, if the function is actually
@@ -633,10 +722,15 @@ llvm_compile_expr(ExprState *state)
 			case EEOP_FUNCEXPR:
 				{
 					FunctionCallInfo fcinfo = op->d.func.fcinfo_data;
+					LLVMValueRef v_fcinfo;
 					LLVMValueRef v_fcinfo_isnull;
 					LLVMValueRef v_retval;
 
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_fcinfo =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.func.fcinfo_data),
+										 l_ptr(StructFunctionCallInfoData));
+					v_retval = BuildV1Call(context, b, mod, fcinfo, v_fcinfo,
 										   &v_fcinfo_isnull);
 					LLVMBuildStore(b, v_retval, v_resvaluep);
 					LLVMBuildStore(b, v_fcinfo_isnull, v_resnullp);
@@ -647,14 +741,14 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_FUNCEXPR_FUSAGE:
 				build_EvalXFunc(b, mod, "ExecEvalFuncExprFusage",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 
 			case EEOP_FUNCEXPR_STRICT_FUSAGE:
 				build_EvalXFunc(b, mod, "ExecEvalFuncExprStrictFusage",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -662,8 +756,10 @@ llvm_compile_expr(ExprState *state)
 				{
 					LLVMValueRef v_boolanynullp;
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.boolexpr.anynull),
+										 l_ptr(TypeStorageBool));
 					LLVMBuildStore(b, l_sbool_const(0), v_boolanynullp);
 
 				}
@@ -698,8 +794,10 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[i + 1],
 											   "b.%d.boolcont", i);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.boolexpr.anynull),
+										 l_ptr(TypeStorageBool));
 
 					v_boolnull = LLVMBuildLoad(b, v_resnullp, "");
 					v_boolvalue = LLVMBuildLoad(b, v_resvaluep, "");
@@ -764,8 +862,10 @@ llvm_compile_expr(ExprState *state)
 				{
 					LLVMValueRef v_boolanynullp;
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.boolexpr.anynull),
+										 l_ptr(TypeStorageBool));
 					LLVMBuildStore(b, l_sbool_const(0), v_boolanynullp);
 				}
 				/* FALLTHROUGH */
@@ -800,8 +900,10 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[i + 1],
 											   "b.%d.boolcont", i);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
-												 l_ptr(TypeStorageBool));
+					v_boolanynullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.boolexpr.anynull),
+										 l_ptr(TypeStorageBool));
 
 					v_boolnull = LLVMBuildLoad(b, v_resnullp, "");
 					v_boolvalue = LLVMBuildLoad(b, v_resvaluep, "");
@@ -1028,13 +1130,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_NULLTEST_ROWISNULL:
 				build_EvalXFunc(b, mod, "ExecEvalRowNull",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_NULLTEST_ROWISNOTNULL:
 				build_EvalXFunc(b, mod, "ExecEvalRowNotNull",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1105,13 +1207,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_PARAM_EXEC:
 				build_EvalXFunc(b, mod, "ExecEvalParamExec",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_PARAM_EXTERN:
 				build_EvalXFunc(b, mod, "ExecEvalParamExtern",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1123,7 +1225,7 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_func;
 
 					param_types[0] = l_ptr(StructExprState);
-					param_types[1] = l_ptr(TypeSizeT);
+					param_types[1] = l_ptr(StructExprEvalStep);
 					param_types[2] = l_ptr(StructExprContext);
 
 					v_functype = LLVMFunctionType(LLVMVoidType(),
@@ -1134,7 +1236,7 @@ llvm_compile_expr(ExprState *state)
 										 l_ptr(v_functype));
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(TypeSizeT));
+					v_params[1] = v_op;
 					v_params[2] = v_econtext;
 					LLVMBuildCall(b,
 								  v_func,
@@ -1146,19 +1248,19 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_SBSREF_OLD:
 				build_EvalXFunc(b, mod, "ExecEvalSubscriptingRefOld",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_SBSREF_ASSIGN:
 				build_EvalXFunc(b, mod, "ExecEvalSubscriptingRefAssign",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_SBSREF_FETCH:
 				build_EvalXFunc(b, mod, "ExecEvalSubscriptingRefFetch",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1177,10 +1279,14 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[i + 1],
 											   "op.%d.notavail", i);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
-											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
-											  l_ptr(TypeStorageBool));
+					v_casevaluep =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.casetest.value),
+										 l_ptr(TypeSizeT));
+					v_casenullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.casetest.isnull),
+										 l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
 						LLVMBuildICmp(b, LLVMIntEQ,
@@ -1225,8 +1331,10 @@ llvm_compile_expr(ExprState *state)
 					b_notnull = l_bb_before_v(opblocks[i + 1],
 											  "op.%d.readonly.notnull", i);
 
-					v_nullp = l_ptr_const(op->d.make_readonly.isnull,
-										  l_ptr(TypeStorageBool));
+					v_nullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.make_readonly.isnull),
+										 l_ptr(TypeStorageBool));
 
 					v_null = LLVMBuildLoad(b, v_nullp, "");
 
@@ -1242,8 +1350,10 @@ llvm_compile_expr(ExprState *state)
 					/* if value is not null, convert to RO datum */
 					LLVMPositionBuilderAtEnd(b, b_notnull);
 
-					v_valuep = l_ptr_const(op->d.make_readonly.value,
-										   l_ptr(TypeSizeT));
+					v_valuep =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.make_readonly.value),
+										 l_ptr(TypeSizeT));
 
 					v_value = LLVMBuildLoad(b, v_valuep, "");
 
@@ -1467,7 +1577,7 @@ llvm_compile_expr(ExprState *state)
 					/* neither argument is null: compare */
 					LLVMPositionBuilderAtEnd(b, b_noargnull);
 
-					v_result = BuildV1Call(context, b, mod, fcinfo,
+					v_result = BuildV1Call(context, b, mod, fcinfo, v_fcinfo,
 										   &v_fcinfo_isnull);
 
 					if (opcode == EEOP_DISTINCT)
@@ -1537,7 +1647,8 @@ llvm_compile_expr(ExprState *state)
 					/* build block to invoke function and check result */
 					LLVMPositionBuilderAtEnd(b, b_nonull);
 
-					v_retval = BuildV1Call(context, b, mod, fcinfo, &v_fcinfo_isnull);
+					v_retval = BuildV1Call(context, b, mod, fcinfo, v_fcinfo,
+										   &v_fcinfo_isnull);
 
 					/*
 					 * If result not null, and arguments are equal return null
@@ -1568,37 +1679,37 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_SQLVALUEFUNCTION:
 				build_EvalXFunc(b, mod, "ExecEvalSQLValueFunction",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_CURRENTOFEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalCurrentOfExpr",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_NEXTVALUEEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalNextValueExpr",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_ARRAYEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalArrayExpr",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_ARRAYCOERCE:
 				build_EvalXFunc(b, mod, "ExecEvalArrayCoerce",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_ROW:
 				build_EvalXFunc(b, mod, "ExecEvalRow",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1662,6 +1773,7 @@ llvm_compile_expr(ExprState *state)
 
 					/* call function */
 					v_retval = BuildV1Call(context, b, mod, fcinfo,
+										   l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData)),
 										   &v_fcinfo_isnull);
 					LLVMBuildStore(b, v_retval, v_resvaluep);
 
@@ -1753,25 +1865,25 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_MINMAX:
 				build_EvalXFunc(b, mod, "ExecEvalMinMax",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_FIELDSELECT:
 				build_EvalXFunc(b, mod, "ExecEvalFieldSelect",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_FIELDSTORE_DEFORM:
 				build_EvalXFunc(b, mod, "ExecEvalFieldStoreDeForm",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_FIELDSTORE_FORM:
 				build_EvalXFunc(b, mod, "ExecEvalFieldStoreForm",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1785,7 +1897,7 @@ llvm_compile_expr(ExprState *state)
 					v_fn = llvm_get_decl(mod, FuncExecEvalSubscriptingRef);
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+					v_params[1] = v_op;
 					v_ret = LLVMBuildCall(b, v_fn,
 										  v_params, lengthof(v_params), "");
 					v_ret = LLVMBuildZExt(b, v_ret, TypeStorageBool, "");
@@ -1813,10 +1925,14 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[i + 1],
 											   "op.%d.notavail", i);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
-											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
-											  l_ptr(TypeStorageBool));
+					v_casevaluep =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.casetest.value),
+										 l_ptr(TypeSizeT));
+					v_casenullp =
+						l_step_field_ptr(b, v_steps, op, i,
+										 offsetof(ExprEvalStep, d.casetest.isnull),
+										 l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
 						LLVMBuildICmp(b, LLVMIntEQ,
@@ -1854,31 +1970,31 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_DOMAIN_NOTNULL:
 				build_EvalXFunc(b, mod, "ExecEvalConstraintNotNull",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_DOMAIN_CHECK:
 				build_EvalXFunc(b, mod, "ExecEvalConstraintCheck",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_CONVERT_ROWTYPE:
 				build_EvalXFunc(b, mod, "ExecEvalConvertRowtype",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_SCALARARRAYOP:
 				build_EvalXFunc(b, mod, "ExecEvalScalarArrayOp",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_XMLEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalXmlExpr",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1913,7 +2029,7 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_GROUPING_FUNC:
 				build_EvalXFunc(b, mod, "ExecEvalGroupingFunc",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -1949,13 +2065,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_SUBPLAN:
 				build_EvalXFunc(b, mod, "ExecEvalSubPlan",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_ALTERNATIVE_SUBPLAN:
 				build_EvalXFunc(b, mod, "ExecEvalAlternativeSubPlan",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -2003,6 +2119,7 @@ llvm_compile_expr(ExprState *state)
 									l_ptr(StructMemoryContextData));
 					v_oldcontext = l_mcxt_switch(mod, b, v_tmpcontext);
 					v_retval = BuildV1Call(context, b, mod, fcinfo,
+										   l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData)),
 										   &v_fcinfo_isnull);
 					l_mcxt_switch(mod, b, v_oldcontext);
 
@@ -2181,6 +2298,41 @@ llvm_compile_expr(ExprState *state)
 					break;
 				}
 
+			case EEOP_AGG_PLAIN_PERGROUP_NULLCHECK:
+				{
+					int			jumpnull;
+					LLVMValueRef v_aggstatep;
+					LLVMValueRef v_allpergroupsp;
+					LLVMValueRef v_pergroup_allaggs;
+					LLVMValueRef v_setoff;
+
+					jumpnull = op->d.agg_plain_pergroup_nullcheck.jumpnull;
+
+					/*
+					 * if (aggstate->all_pergroups
+					 * [op->d.agg_plain_pergroup_nullcheck.setoff] == NULL)
+					 */
+					v_aggstatep =
+						l_ptr_const(op->d.agg_plain_pergroup_nullcheck.aggstate,
+									l_ptr(StructAggState));
+					v_allpergroupsp =
+						l_load_struct_gep(b, v_aggstatep,
+										  FIELDNO_AGGSTATE_ALL_PERGROUPS,
+										  "aggstate.all_pergroups");
+					v_setoff =
+						l_int32_const(op->d.agg_plain_pergroup_nullcheck.setoff);
+					v_pergroup_allaggs =
+						l_load_gep1(b, v_allpergroupsp, v_setoff, "");
+
+					LLVMBuildCondBr(b,
+									LLVMBuildICmp(b, LLVMIntEQ,
+												  LLVMBuildPtrToInt(b, v_pergroup_allaggs, TypeSizeT, ""),
+												  l_sizet_const(0), ""),
+									opblocks[jumpnull],
+									opblocks[i + 1]);
+					break;
+				}
+
 			case EEOP_AGG_STRICT_TRANS_CHECK:
 				{
 					AggState   *aggstate;
@@ -2340,7 +2492,7 @@ llvm_compile_expr(ExprState *state)
 								   l_funcnullp(b, v_fcinfo, 0));
 
 					/* and invoke transition function */
-					v_retval = BuildV1Call(context, b, mod, fcinfo,
+					v_retval = BuildV1Call(context, b, mod, fcinfo, v_fcinfo,
 										   &v_fcinfo_isnull);
 
 					/*
@@ -2421,13 +2573,13 @@ llvm_compile_expr(ExprState *state)
 
 			case EEOP_AGG_ORDERED_TRANS_DATUM:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransDatum",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
 			case EEOP_AGG_ORDERED_TRANS_TUPLE:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransTuple",
-								v_state, v_econtext, op);
+								v_state, v_econtext, v_op);
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
@@ -2439,6 +2591,13 @@ llvm_compile_expr(ExprState *state)
 
 	LLVMDisposeBuilder(b);
 
+	if (cacheable)
+	{
+		llvm_cache_enter(context, cache_key.data, cache_key.len, funcname);
+		llvm_leave_cache_module(context);
+		pfree(cache_key.data);
+	}
+
 	/*
 	 * Don't immediately emit function, instead do so the first time the
 	 * expression is actually evaluated. That allows to emit a lot of
@@ -2470,21 +2629,25 @@ llvm_compile_expr(ExprState *state)
  *
  * This will only be called the first time a JITed expression is called. We
  * first make sure the expression is still up2date, and then get a pointer to
- * the emitted function. The latter can be the first thing that triggers
- * optimizing and emitting all the generated functions.
+ * the emitted function, unless it was found in the cache. The latter can be
+ * the first thing that triggers optimizing and emitting all the generated
+ * functions.
  */
 static Datum
 ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 {
 	CompiledExprState *cstate = state->evalfunc_private;
-	ExprStateEvalFunc func;
+	ExprStateEvalFunc func = cstate->func;
 
 	CheckExprStillValid(state, econtext);
 
-	llvm_enter_fatal_on_oom();
-	func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
-												 cstate->funcname);
-	llvm_leave_fatal_on_oom();
+	if (func == NULL)
+	{
+		llvm_enter_fatal_on_oom();
+		func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
+													 cstate->funcname);
+		llvm_leave_fatal_on_oom();
+	}
 	Assert(func);
 
 	/* remove indirection via this function for future calls */
@@ -2493,19 +2656,268 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 	return func(state, econtext, isNull);
 }
 
+/*
+ * Build the cache key for state's code into key.
+ *
+ * Code that may be cached loads all pointers into the steps, and everything
+ * they point to, at runtime, see l_step_field_ptr(). The key thus only needs
+ * to describe what does get embedded into the code: opcodes, jump targets,
+ * attribute numbers, called functions and the layout of tuples to deform.
+ * Returns false if state contains a step whose code still embeds addresses
+ * private to state, e.g. the aggregate transition steps.
+ */
+static bool
+expr_cache_key(ExprState *state, int jit_flags, StringInfo key)
+{
+	int			i;
+
+	jit_flags &= PGJIT_OPT3 | PGJIT_INLINE | PGJIT_DEFORM;
+	appendBinaryStringInfo(key, (char *) &jit_flags, sizeof(jit_flags));
+	appendBinaryStringInfo(key, (char *) &state->steps_len,
+						   sizeof(state->steps_len));
+
+	for (i = 0; i < state->steps_len; i++)
+	{
+		ExprEvalStep *op = &state->steps[i];
+		ExprEvalOp	opcode = ExecEvalStepOp(state, op);
+
+		appendBinaryStringInfo(key, (char *) &opcode, sizeof(opcode));
+
+		switch (opcode)
+		{
+			case EEOP_INNER_FETCHSOME:
+			case EEOP_OUTER_FETCHSOME:
+			case EEOP_SCAN_FETCHSOME:
+				{
+					TupleDesc	desc = op->d.fetch.known_desc;
+					bool		has_desc = (desc != NULL);
+					int			attnum;
+
+					appendBinaryStringInfo(key, (char *) &op->d.fetch.last_var,
+										   sizeof(op->d.fetch.last_var));
+					appendBinaryStringInfo(key, (char *) &op->d.fetch.fixed,
+										   sizeof(op->d.fetch.fixed));
+					if (op->d.fetch.fixed)
+						appendBinaryStringInfo(key, (char *) &op->d.fetch.kind,
+											   sizeof(op->d.fetch.kind));
+
+					/* what the generated deform function depends upon */
+					appendBinaryStringInfo(key, (char *) &has_desc,
+										   sizeof(has_desc));
+					if (!has_desc)
+						break;
+
+					appendBinaryStringInfo(key, (char *) &desc->natts,
+										   sizeof(desc->natts));
+					for (attnum = 0; attnum < desc->natts; attnum++)
+					{
+						Form_pg_attribute att = TupleDescAttr(desc, attnum);
+
+						appendBinaryStringInfo(key, (char *) &att->attlen,
+											   sizeof(att->attlen));
+						appendBinaryStringInfo(key, (char *) &att->attbyval,
+											   sizeof(att->attbyval));
+						appendBinaryStringInfo(key, (char *) &att->attalign,
+											   sizeof(att->attalign));
+						appendBinaryStringInfo(key, (char *) &att->attnotnull,
+											   sizeof(att->attnotnull));
+						appendBinaryStringInfo(key, (char *) &att->atthasmissing,
+											   sizeof(att->atthasmissing));
+						appendBinaryStringInfo(key, (char *) &att->attisdropped,
+											   sizeof(att->attisdropped));
+					}
+					break;
+				}
+
+			case EEOP_INNER_VAR:
+			case EEOP_OUTER_VAR:
+			case EEOP_SCAN_VAR:
+				appendBinaryStringInfo(key, (char *) &op->d.var.attnum,
+									   sizeof(op->d.var.attnum));
+				break;
+
+			case EEOP_ASSIGN_INNER_VAR:
+			case EEOP_ASSIGN_OUTER_VAR:
+			case EEOP_ASSIGN_SCAN_VAR:
+				appendBinaryStringInfo(key, (char *) &op->d.assign_var.attnum,
+									   sizeof(op->d.assign_var.attnum));
+				appendBinaryStringInfo(key, (char *) &op->d.assign_var.resultnum,
+									   sizeof(op->d.assign_var.resultnum));
+				break;
+
+			case EEOP_ASSIGN_TMP:
+			case EEOP_ASSIGN_TMP_MAKE_RO:
+				appendBinaryStringInfo(key, (char *) &op->d.assign_tmp.resultnum,
+									   sizeof(op->d.assign_tmp.resultnum));
+				break;
+
+			case EEOP_FUNCEXPR:
+			case EEOP_FUNCEXPR_STRICT:
+				{
+					FunctionCallInfo fcinfo = op->d.func.fcinfo_data;
+
+					appendBinaryStringInfo(key, (char *) &fcinfo->flinfo->fn_oid,
+										   sizeof(fcinfo->flinfo->fn_oid));
+					appendBinaryStringInfo(key, (char *) &fcinfo->flinfo->fn_addr,
+										   sizeof(fcinfo->flinfo->fn_addr));
+					appendBinaryStringInfo(key, (char *) &fcinfo->nargs,
+										   sizeof(fcinfo->nargs));
+					break;
+				}
+
+			case EEOP_BOOL_AND_STEP_FIRST:
+			case EEOP_BOOL_AND_STEP:
+			case EEOP_BOOL_AND_STEP_LAST:
+			case EEOP_BOOL_OR_STEP_FIRST:
+			case EEOP_BOOL_OR_STEP:
+			case EEOP_BOOL_OR_STEP_LAST:
+				appendBinaryStringInfo(key, (char *) &op->d.boolexpr.jumpdone,
+									   sizeof(op->d.boolexpr.jumpdone));
+				break;
+
+			case EEOP_QUAL:
+				appendBinaryStringInfo(key, (char *) &op->d.qualexpr.jumpdone,
+									   sizeof(op->d.qualexpr.jumpdone));
+				break;
+
+			case EEOP_JUMP:
+			case EEOP_JUMP_IF_NULL:
+			case EEOP_JUMP_IF_NOT_NULL:
+			case EEOP_JUMP_IF_NOT_TRUE:
+				appendBinaryStringInfo(key, (char *) &op->d.jump.jumpdone,
+									   sizeof(op->d.jump.jumpdone));
+				break;
+
+			case EEOP_SBSREF_SUBSCRIPT:
+				appendBinaryStringInfo(key, (char *) &op->d.sbsref_subscript.jumpdone,
+									   sizeof(op->d.sbsref_subscript.jumpdone));
+				break;
+
+			case EEOP_PARAM_CALLBACK:
+				appendBinaryStringInfo(key, (char *) &op->d.cparam.paramfunc,
+									   sizeof(op->d.cparam.paramfunc));
+				break;
+
+				/* code only references the step's data at runtime */
+			case EEOP_DONE:
+			case EEOP_INNER_SYSVAR:
+			case EEOP_OUTER_SYSVAR:
+			case EEOP_SCAN_SYSVAR:
+			case EEOP_WHOLEROW:
+			case EEOP_CONST:
+			case EEOP_FUNCEXPR_FUSAGE:
+			case EEOP_FUNCEXPR_STRICT_FUSAGE:
+			case EEOP_BOOL_NOT_STEP:
+			case EEOP_NULLTEST_ISNULL:
+			case EEOP_NULLTEST_ISNOTNULL:
+			case EEOP_NULLTEST_ROWISNULL:
+			case EEOP_NULLTEST_ROWISNOTNULL:
+			case EEOP_BOOLTEST_IS_TRUE:
+			case EEOP_BOOLTEST_IS_NOT_TRUE:
+			case EEOP_BOOLTEST_IS_FALSE:
+			case EEOP_BOOLTEST_IS_NOT_FALSE:
+			case EEOP_PARAM_EXEC:
+			case EEOP_PARAM_EXTERN:
+			case EEOP_CASE_TESTVAL:
+			case EEOP_MAKE_READONLY:
+			case EEOP_SQLVALUEFUNCTION:
+			case EEOP_CURRENTOFEXPR:
+			case EEOP_NEXTVALUEEXPR:
+			case EEOP_ARRAYEXPR:
+			case EEOP_ARRAYCOERCE:
+			case EEOP_ROW:
+			case EEOP_MINMAX:
+			case EEOP_FIELDSELECT:
+			case EEOP_FIELDSTORE_DEFORM:
+			case EEOP_FIELDSTORE_FORM:
+			case EEOP_SBSREF_OLD:
+			case EEOP_SBSREF_ASSIGN:
+			case EEOP_SBSREF_FETCH:
+			case EEOP_DOMAIN_NOTNULL:
+			case EEOP_DOMAIN_CHECK:
+			case EEOP_CONVERT_ROWTYPE:
+			case EEOP_SCALARARRAYOP:
+			case EEOP_XMLEXPR:
+			case EEOP_GROUPING_FUNC:
+			case EEOP_SUBPLAN:
+			case EEOP_ALTERNATIVE_SUBPLAN:
+				break;
+
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Return the address of step opno.
+ *
+ * If v_steps is set, the code may be run for other ExprStates of the same
+ * shape, and the address is computed from it at runtime. Otherwise it is
+ * emitted as a constant.
+ */
+static LLVMValueRef
+l_step_ptr(LLVMBuilderRef b, LLVMValueRef v_steps, ExprEvalStep *op, int opno)
+{
+	LLVMValueRef v_opno;
+
+	if (v_steps == NULL)
+		return l_ptr_const(op, l_ptr(StructExprEvalStep));
+
+	v_opno = l_int32_const(opno);
+	return LLVMBuildGEP(b, v_steps, &v_opno, 1, "");
+}
+
+/*
+ * Load a value of the passed type, stored offset bytes into step opno, at
+ * runtime.
+ */
+static LLVMValueRef
+l_step_load(LLVMBuilderRef b, LLVMValueRef v_steps, int opno,
+			size_t offset, LLVMTypeRef type)
+{
+	LLVMValueRef v_off;
+	LLVMValueRef v_fieldp;
+
+	v_off = l_sizet_const(offset);
+	v_fieldp = LLVMBuildBitCast(b, l_step_ptr(b, v_steps, NULL, opno),
+								l_ptr(LLVMInt8Type()), "");
+	v_fieldp = LLVMBuildGEP(b, v_fieldp, &v_off, 1, "");
+	v_fieldp = LLVMBuildBitCast(b, v_fieldp, l_ptr(type), "");
+
+	return LLVMBuildLoad(b, v_fieldp, "");
+}
+
+/*
+ * Return the pointer stored offset bytes into step op, which is step opno.
+ * See l_step_ptr() for the role of v_steps.
+ */
+static LLVMValueRef
+l_step_field_ptr(LLVMBuilderRef b, LLVMValueRef v_steps, ExprEvalStep *op,
+				 int opno, size_t offset, LLVMTypeRef type)
+{
+	if (v_steps == NULL)
+		return l_ptr_const(*(void **) ((char *) op + offset), type);
+
+	return l_step_load(b, v_steps, opno, offset, type);
+}
+
+/*
+ * Call the function of fcinfo, which v_fcinfo has to point to at runtime.
+ */
 static LLVMValueRef
 BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 			LLVMModuleRef mod, FunctionCallInfo fcinfo,
-			LLVMValueRef *v_fcinfo_isnull)
+			LLVMValueRef v_fcinfo, LLVMValueRef *v_fcinfo_isnull)
 {
 	LLVMValueRef v_fn;
 	LLVMValueRef v_fcinfo_isnullp;
 	LLVMValueRef v_retval;
-	LLVMValueRef v_fcinfo;
 
 	v_fn = llvm_function_reference(context, b, mod, fcinfo);
 
-	v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
 	v_fcinfo_isnullp = LLVMBuildStructGEP(b, v_fcinfo,
 										  FIELDNO_FUNCTIONCALLINFODATA_ISNULL,
 										  "v_fcinfo_isnull");
@@ -2525,11 +2937,16 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 		LLVMValueRef params[2];
 
 		params[0] = l_int64_const(sizeof(NullableDatum) * fcinfo->nargs);
-		params[1] = l_ptr_const(fcinfo->args, l_ptr(LLVMInt8Type()));
+		params[1] = LLVMBuildBitCast(b,
+									 LLVMBuildStructGEP(b, v_fcinfo,
+														FIELDNO_FUNCTIONCALLINFODATA_ARGS,
+														""),
+									 l_ptr(LLVMInt8Type()), "");
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 
 		params[0] = l_int64_const(sizeof(fcinfo->isnull));
-		params[1] = l_ptr_const(&fcinfo->isnull, l_ptr(LLVMInt8Type()));
+		params[1] = LLVMBuildBitCast(b, v_fcinfo_isnullp,
+									 l_ptr(LLVMInt8Type()), "");
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 	}
 
@@ -2542,7 +2959,7 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 static void
 build_EvalXFunc(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
 				LLVMValueRef v_state, LLVMValueRef v_econtext,
-				ExprEvalStep *op)
+				LLVMValueRef v_op)
 {
 	LLVMTypeRef sig;
 	LLVMValueRef v_fn;
@@ -2563,7 +2980,7 @@ build_EvalXFunc(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
 	}
 
 	params[0] = v_state;
-	params[1] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+	params[1] = v_op;
 	params[2] = v_econtext;
 
 	LLVMBuildCall(b,
@@ -17,8 +17,11 @@
  * is only expected to happen a small number of times until a stable size is
  * found, since growth is geometric.
  *
- * Future versions may support iterators and incremental resizing; for now
- * the implementation is minimalist.
+ * Sequential scans visit the partitions in order, holding one partition lock
+ * at a time, so they don't block concurrent access to the rest of the table.
+ *
+ * Future versions may support incremental resizing; for now the
+ * implementation is minimalist.
  *
  * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -153,6 +156,10 @@ struct dshash_table
 #define BUCKET_INDEX_FOR_PARTITION(partition, size_log2)	\
 	((partition) << NUM_SPLITS(size_log2))
 
+/* The partition a given bucket belongs to. */
+#define PARTITION_FOR_BUCKET_INDEX(bucket_idx, size_log2)	\
+	((bucket_idx) >> NUM_SPLITS(size_log2))
+
 /* The head of the active bucket for a given hash value (lvalue). */
 #define BUCKET_FOR_HASH(hash_table, hash)								\
 	(hash_table->buckets[												\
@@ -574,6 +581,131 @@ dshash_release_lock(dshash_table *hash_table, void *entry)
 	LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
 }
 
+/*
+ * Begin a sequential scan of the hash table.  No locks are taken until the
+ * first call to dshash_seq_next().  Every entry present for the whole
+ * duration of the scan is returned exactly once; entries inserted or deleted
+ * concurrently may or may not be.
+ *
+ * The caller must not call any other dshash function on the same table until
+ * the scan has been ended with dshash_seq_term(), except
+ * dshash_delete_current() in an exclusive scan.
+ */
+void
+dshash_seq_init(dshash_seq_status *status, dshash_table *hash_table,
+				bool exclusive)
+{
+	status->hash_table = hash_table;
+	status->curbucket = 0;
+	status->nbuckets = 0;
+	status->curitem = NULL;
+	status->pnextitem = InvalidDsaPointer;
+	status->curpartition = -1;
+	status->exclusive = exclusive;
+}
+
+/*
+ * Return the next entry of a sequential scan, or NULL at the end.  The entry
+ * is protected by the lock of its partition, which is held until the scan
+ * moves on to another partition or is ended.
+ */
+void *
+dshash_seq_next(dshash_seq_status *status)
+{
+	dshash_table *hash_table = status->hash_table;
+	LWLockMode	mode = status->exclusive ? LW_EXCLUSIVE : LW_SHARED;
+	dsa_pointer next_item_pointer;
+
+	if (status->curpartition == -1)
+	{
+		/*
+		 * First call.  Buckets are visited in partition order, so start by
+		 * locking partition 0.  Once we hold a partition lock the table can't
+		 * be resized, so the bucket count stays valid for the whole scan.
+		 */
+		Assert(hash_table->control->magic == DSHASH_MAGIC);
+		Assert(!hash_table->find_locked);
+
+		status->curpartition = 0;
+		LWLockAcquire(PARTITION_LOCK(hash_table, 0), mode);
+		ensure_valid_bucket_pointers(hash_table);
+
+		status->nbuckets = ((size_t) 1) << hash_table->size_log2;
+		next_item_pointer = hash_table->buckets[0];
+	}
+	else
+		next_item_pointer = status->pnextitem;
+
+	Assert(LWLockHeldByMeInMode(PARTITION_LOCK(hash_table,
+											   status->curpartition),
+								mode));
+
+	/* Advance to the next non-empty bucket if this one is done */
+	while (!DsaPointerIsValid(next_item_pointer))
+	{
+		int			next_partition;
+
+		if (++status->curbucket >= status->nbuckets)
+			return NULL;
+
+		next_partition = PARTITION_FOR_BUCKET_INDEX(status->curbucket,
+													hash_table->size_log2);
+		if (next_partition != status->curpartition)
+		{
+			/*
+			 * Lock the next partition before releasing the current one, so
+			 * that the table can't be resized in between.  resize() takes the
+			 * locks in the same ascending order, so this can't deadlock.
+			 */
+			LWLockAcquire(PARTITION_LOCK(hash_table, next_partition), mode);
+			LWLockRelease(PARTITION_LOCK(hash_table, status->curpartition));
+			status->curpartition = next_partition;
+		}
+
+		next_item_pointer = hash_table->buckets[status->curbucket];
+	}
+
+	status->curitem = dsa_get_address(hash_table->area, next_item_pointer);
+
+	/* Remember the next item, in case the caller deletes this one */
+	status->pnextitem = status->curitem->next;
+
+	return ENTRY_FROM_ITEM(status->curitem);
+}
+
+/*
+ * End a sequential scan, releasing the partition lock if one is held.
+ */
+void
+dshash_seq_term(dshash_seq_status *status)
+{
+	if (status->curpartition >= 0)
+		LWLockRelease(PARTITION_LOCK(status->hash_table,
+									 status->curpartition));
+	status->curpartition = -1;
+}
+
+/*
+ * Delete the entry most recently returned by dshash_seq_next().  The scan
+ * must have been started with exclusive = true.
+ */
+void
+dshash_delete_current(dshash_seq_status *status)
+{
+	dshash_table *hash_table = status->hash_table;
+	dshash_table_item *item = status->curitem;
+
+	Assert(status->exclusive);
+	Assert(item != NULL);
+	Assert(hash_table->control->magic == DSHASH_MAGIC);
+	Assert(LWLockHeldByMeInMode(PARTITION_LOCK(hash_table,
+											   PARTITION_FOR_HASH(item->hash)),
+								LW_EXCLUSIVE));
+
+	delete_item(hash_table, item);
+	status->curitem = NULL;
+}
+
 /*
  * A compare function that forwards to memcmp.
  */
@@ -892,6 +892,27 @@ is_parallel_safe(PlannerInfo *root, Node *node)
 	return !max_parallel_hazard_walker(node, &context);
 }
 
+/*
+ * expression_is_parallel_safe
+ *		Detect whether a standalone expression contains only parallel-safe
+ *		functions
+ *
+ * This is for utility commands that evaluate expressions such as column
+ * defaults or constraints in parallel workers, outside of any plan.  Such
+ * expressions never contain PARAM_EXEC Params, so unlike is_parallel_safe
+ * we need no PlannerInfo.
+ */
+bool
+expression_is_parallel_safe(Node *node)
+{
+	max_parallel_hazard_context context;
+
+	context.max_hazard = PROPARALLEL_SAFE;
+	context.max_interesting = PROPARALLEL_RESTRICTED;
+	context.safe_param_ids = NIL;
+	return !max_parallel_hazard_walker(node, &context);
+}
+
 /* core logic for all parallel-hazard checks */
 static bool
 max_parallel_hazard_test(char proparallel, max_parallel_hazard_context *context)
@@ -222,6 +222,13 @@ CheckpointerMain(void)
 	/* We allow SIGQUIT (quickdie) at all times */
 	sigdelset(&BlockSig, SIGQUIT);
 
+	/*
+	 * The checkpointer is the last process with access to the shared
+	 * statistics at shutdown, after the shutdown checkpoint, so it is the
+	 * one to save them to disk.
+	 */
+	before_shmem_exit(pgstat_before_server_shutdown, 0);
+
 	/*
 	 * Initialize so that first time-driven event happens at the correct time.
 	 */
@@ -1,12 +1,15 @@
 /* ----------
  * pgstat.c
  *
- *	All the statistics collector stuff hacked up in one big, ugly file.
+ *	All the cumulative statistics stuff hacked up in one big, ugly file.
  *
- *	TODO:	- Separate collector, postmaster and backend stuff
- *			  into different files.
+ *	Backends accumulate counts locally and periodically fold them into
+ *	hash tables kept in shared memory, where any other process can read
+ *	them directly.  The shared statistics are written to disk by the
+ *	checkpointer at shutdown and loaded back by the startup process.
  *
- *			- Add some automatic call for pgstat vacuuming.
+ *	TODO:	- Separate shared-memory, postmaster and backend stuff
+ *			  into different files.
  *
  *			- Add a pgstat config column to pg_database, so this
  *			  entire thing can be enabled/disabled on a per db basis.
@@ -22,15 +25,8 @@
 #include <fcntl.h>
 #include <sys/param.h>
 #include <sys/time.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 #include <signal.h>
 #include <time.h>
-#ifdef HAVE_SYS_SELECT_H
-#include <sys/select.h>
-#endif
 
 #include "pgstat.h"
 
@@ -42,14 +38,12 @@
 #include "access/xact.h"
 #include "catalog/pg_database.h"
 #include "catalog/pg_proc.h"
-#include "common/ip.h"
+#include "lib/dshash.h"
 #include "libpq/libpq.h"
-#include "libpq/pqsignal.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "postmaster/autovacuum.h"
-#include "postmaster/fork_process.h"
 #include "postmaster/postmaster.h"
 #include "replication/walsender.h"
 #include "storage/backendid.h"
@@ -58,10 +52,12 @@
 #include "storage/ipc.h"
 #include "storage/latch.h"
 #include "storage/lmgr.h"
-#include "storage/pg_shmem.h"
 #include "storage/procsignal.h"
+#include "storage/shmem.h"
 #include "storage/sinvaladt.h"
+#include "storage/spin.h"
 #include "utils/ascii.h"
+#include "utils/dsa.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
@@ -74,37 +70,26 @@
  * Timer definitions.
  * ----------
  */
-#define PGSTAT_STAT_INTERVAL	500 /* Minimum time between stats file
-									 * updates; in milliseconds. */
-
-#define PGSTAT_RETRY_DELAY		10	/* How long to wait between checks for a
-									 * new file; in milliseconds. */
-
-#define PGSTAT_MAX_WAIT_TIME	10000	/* Maximum time to wait for a stats
-										 * file update; in milliseconds. */
-
-#define PGSTAT_INQ_INTERVAL		640 /* How often to ping the collector for a
-									 * new file; in milliseconds. */
-
-#define PGSTAT_RESTART_INTERVAL 60	/* How often to attempt to restart a
-									 * failed statistics collector; in
-									 * seconds. */
-
-#define PGSTAT_POLL_LOOP_COUNT	(PGSTAT_MAX_WAIT_TIME / PGSTAT_RETRY_DELAY)
-#define PGSTAT_INQ_LOOP_COUNT	(PGSTAT_INQ_INTERVAL / PGSTAT_RETRY_DELAY)
-
-/* Minimum receive buffer size for the collector's socket. */
-#define PGSTAT_MIN_RCVBUF		(100 * 1024)
+#define PGSTAT_STAT_INTERVAL	500 /* Minimum time between flushes of a
+									 * backend's counts; in milliseconds. */
 
 
 /* ----------
- * The initial size hints for the hash tables used in the collector.
+ * The initial size hints for the hash tables holding a backend's snapshot
+ * of the shared statistics.
  * ----------
  */
 #define PGSTAT_DB_HASH_SIZE		16
 #define PGSTAT_TAB_HASH_SIZE	512
 #define PGSTAT_FUNCTION_HASH_SIZE	512
 
+/*
+ * Size of the DSA area embedded in the statistics' fixed shared memory.  It
+ * must be large enough for the initial allocations of the hash tables; they
+ * grow into dynamic shared memory segments beyond that.
+ */
+#define PGSTAT_SHMEM_DSA_SIZE	(256 * 1024)
+
 
 /* ----------
  * Total number of backends including auxiliary
@@ -132,8 +117,6 @@ int			pgstat_track_activity_query_size = 1024;
  * ----------
  */
 char	   *pgstat_stat_directory = NULL;
-char	   *pgstat_stat_filename = NULL;
-char	   *pgstat_stat_tmpname = NULL;
 
 /*
  * BgWriter global statistics counters (unused in other processes).
@@ -143,20 +126,99 @@ char	   *pgstat_stat_tmpname = NULL;
 PgStat_MsgBgWriter BgWriterStats;
 
 /* ----------
- * Local data
+ * Shared-memory statistics
+ *
+ * The per-database, per-table and per-function statistics live in dshash
+ * tables inside a DSA area, which is created in place right after the
+ * PgStat_ShmemControl struct so that it exists for as long as the main
+ * shared memory segment does.  Table and function entries are keyed by
+ * database and object OID together; shared catalogs are filed under
+ * InvalidOid as their database.
+ *
+ * The cluster-wide statistics are small and of fixed size, so they are kept
+ * in the control struct itself, each behind a spinlock.  That also lets the
+ * archiver, which has no PGPROC and so cannot take LWLocks, report to them.
  * ----------
  */
-NON_EXEC_STATIC pgsocket pgStatSock = PGINVALID_SOCKET;
+struct PgStat_ShmemControl
+{
+	dshash_table_handle db_hash_handle;
+	dshash_table_handle tab_hash_handle;
+	dshash_table_handle func_hash_handle;
+
+	slock_t		global_lock;	/* protects global_stats */
+	PgStat_GlobalStats global_stats;
+
+	slock_t		archiver_lock;	/* protects archiver_stats */
+	PgStat_ArchiverStats archiver_stats;
+};
 
-static struct sockaddr_storage pgStatAddr;
+#define PgStatShmemDSAPlace(ctl) \
+	((void *) ((char *) (ctl) + MAXALIGN(sizeof(PgStat_ShmemControl))))
 
-static time_t last_pgstat_start_time;
+/* Hash key for table and function entries */
+typedef struct PgStat_StatObjKey
+{
+	Oid			databaseid;		/* InvalidOid for shared catalogs */
+	Oid			objectid;		/* table or function OID */
+} PgStat_StatObjKey;
+
+typedef struct PgStatShared_TabEntry
+{
+	PgStat_StatObjKey key;
+	PgStat_StatTabEntry stats;
+} PgStatShared_TabEntry;
+
+typedef struct PgStatShared_FuncEntry
+{
+	PgStat_StatObjKey key;
+	PgStat_StatFuncEntry stats;
+} PgStatShared_FuncEntry;
+
+static const dshash_parameters dsh_dbparams = {
+	sizeof(Oid),
+	sizeof(PgStat_StatDBEntry),
+	dshash_memcmp,
+	dshash_memhash,
+	LWTRANCHE_STATS_HASH
+};
+
+static const dshash_parameters dsh_tabparams = {
+	sizeof(PgStat_StatObjKey),
+	sizeof(PgStatShared_TabEntry),
+	dshash_memcmp,
+	dshash_memhash,
+	LWTRANCHE_STATS_HASH
+};
+
+static const dshash_parameters dsh_funcparams = {
+	sizeof(PgStat_StatObjKey),
+	sizeof(PgStatShared_FuncEntry),
+	dshash_memcmp,
+	dshash_memhash,
+	LWTRANCHE_STATS_HASH
+};
+
+NON_EXEC_STATIC PgStat_ShmemControl *pgStatShmem = NULL;
+
+/*
+ * This process's attachment to the hash tables.  Only processes with a
+ * PGPROC attach, in pgstat_initialize(); the rest can update only the
+ * cluster-wide statistics.
+ */
+static dsa_area *pgStatDSA = NULL;
+static dshash_table *pgStatSharedDBHash = NULL;
+static dshash_table *pgStatSharedTabHash = NULL;
+static dshash_table *pgStatSharedFuncHash = NULL;
 
-static bool pgStatRunningInCollector = false;
+/* ----------
+ * Local data
+ * ----------
+ */
 
 /*
  * Structures in which backends store per-table info that's waiting to be
- * sent to the collector.
+ * added to the shared statistics.
  *
  * NOTE: once allocated, TabStatusArray structures are never moved or deleted
  * for the life of the backend.  Also, we zero out the t_id fields of the
@@ -191,14 +253,14 @@ typedef struct TabStatHashEntry
 static HTAB *pgStatTabHash = NULL;
 
 /*
- * Backends store per-function info that's waiting to be sent to the collector
- * in this hash table (indexed by function OID).
+ * Backends store per-function info that's waiting to be added to the shared
+ * statistics in this hash table (indexed by function OID).
  */
 static HTAB *pgStatFunctions = NULL;
 
 /*
  * Indicates if backend has some function stats that it hasn't yet
- * sent to the collector.
+ * added to the shared statistics.
  */
 static bool have_function_stats = false;
 
@@ -238,10 +300,39 @@ typedef struct TwoPhasePgStatRecord
 } TwoPhasePgStatRecord;
 
 /*
- * Info about current "snapshot" of stats file
+ * Info about the current "snapshot" of the shared statistics.
+ *
+ * An entry is copied out of shared memory the first time it is asked for in
+ * a transaction and reused from then on, so that repeated reads within a
+ * transaction see the same values.  Objects that have no statistics are
+ * remembered as well, to avoid searching for them again.
  */
+typedef struct PgStat_SnapshotDBEntry
+{
+	Oid			databaseid;		/* hash key (must be first) */
+	bool		found;			/* does the database have statistics? */
+	PgStat_StatDBEntry stats;
+} PgStat_SnapshotDBEntry;
+
+typedef struct PgStat_SnapshotTabEntry
+{
+	PgStat_StatObjKey key;		/* hash key (must be first) */
+	bool		found;			/* does the table have statistics? */
+	PgStat_StatTabEntry stats;
+} PgStat_SnapshotTabEntry;
+
+typedef struct PgStat_SnapshotFuncEntry
+{
+	PgStat_StatObjKey key;		/* hash key (must be first) */
+	bool		found;			/* does the function have statistics? */
+	PgStat_StatFuncEntry stats;
+} PgStat_SnapshotFuncEntry;
+
 static MemoryContext pgStatLocalContext = NULL;
-static HTAB *pgStatDBHash = NULL;
+static HTAB *pgStatSnapshotDBHash = NULL;
+static HTAB *pgStatSnapshotTabHash = NULL;
+static HTAB *pgStatSnapshotFuncHash = NULL;
+static TimestampTz pgStatSnapshotTimestamp = 0;
 
 /* Status for backends including auxiliary */
 static LocalPgBackendStatus *localBackendStatusTable = NULL;
@@ -250,23 +341,13 @@ static LocalPgBackendStatus *localBackendStatusTable = NULL;
 static int	localNumBackends = 0;
 
 /*
- * Cluster wide statistics, kept in the stats collector.
- * Contains statistics that are not collected per database
- * or per table.
+ * Snapshot copies of the cluster-wide statistics, valid if the
+ * corresponding flag is set.
  */
 static PgStat_ArchiverStats archiverStats;
 static PgStat_GlobalStats globalStats;
-
-/*
- * List of OIDs of databases we need to write out.  If an entry is InvalidOid,
- * it means to write only the shared-catalog stats ("DB 0"); otherwise, we
- * will write both that DB's data and the shared stats.
- */
-static List *pending_write_requests = NIL;
-
-/* Signal handler flags */
-static volatile bool need_exit = false;
-static volatile bool got_SIGHUP = false;
+static bool archiverStatsValid = false;
+static bool globalStatsValid = false;
 
 /*
  * Total time charged to functions so far in the current backend.
@@ -280,28 +361,23 @@ static instr_time total_func_time;
  * Local function forward declarations
  * ----------
  */
-#ifdef EXEC_BACKEND
-static pid_t pgstat_forkexec(void);
-#endif
-
-NON_EXEC_STATIC void PgstatCollectorMain(int argc, char *argv[]) pg_attribute_noreturn();
-static void pgstat_exit(SIGNAL_ARGS);
+static void pgstat_attach_shmem(void);
+static void pgstat_detach_shmem(void);
+static void pgstat_shutdown_hook(int code, Datum arg);
 static void pgstat_beshutdown_hook(int code, Datum arg);
-static void pgstat_sighup_handler(SIGNAL_ARGS);
 
+static void reset_dbentry_counters(PgStat_StatDBEntry *dbentry);
 static PgStat_StatDBEntry *pgstat_get_db_entry(Oid databaseid, bool create);
-static PgStat_StatTabEntry *pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry,
-												 Oid tableoid, bool create);
-static void pgstat_write_statsfiles(bool permanent, bool allDbs);
-static void pgstat_write_db_statsfile(PgStat_StatDBEntry *dbentry, bool permanent);
-static HTAB *pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep);
-static void pgstat_read_db_statsfile(Oid databaseid, HTAB *tabhash, HTAB *funchash, bool permanent);
-static void backend_read_statsfile(void);
+static PgStatShared_TabEntry *pgstat_get_tab_entry(Oid databaseid,
+												   Oid tableoid, bool create);
+static PgStatShared_FuncEntry *pgstat_get_func_entry(Oid databaseid,
+													 Oid functionid,
+													 bool create);
+static void pgstat_drop_db_objects(Oid databaseid);
+static void pgstat_clear_shared_stats(void);
+static void pgstat_write_statsfile(void);
 static void pgstat_read_current_status(void);
 
-static bool pgstat_write_statsfile_needed(void);
-static bool pgstat_db_requested(Oid databaseid);
-
 static void pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg);
 static void pgstat_send_funcstats(void);
 static HTAB *pgstat_collect_oids(Oid catalogid, AttrNumber anum_oid);
@@ -309,6 +385,7 @@ static HTAB *pgstat_collect_oids(Oid catalogid, AttrNumber anum_oid);
 static PgStat_TableStatus *get_tabstat_entry(Oid rel_id, bool isshared);
 
 static void pgstat_setup_memcxt(void);
+static void pgstat_setup_snapshot(void);
 
 static const char *pgstat_get_wait_activity(WaitEventActivity w);
 static const char *pgstat_get_wait_client(WaitEventClient w);
@@ -319,316 +396,94 @@ static const char *pgstat_get_wait_io(WaitEventIO w);
 static void pgstat_setheader(PgStat_MsgHdr *hdr, StatMsgType mtype);
 static void pgstat_send(void *msg, int len);
 
-static void pgstat_recv_inquiry(PgStat_MsgInquiry *msg, int len);
-static void pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len);
-static void pgstat_recv_tabpurge(PgStat_MsgTabpurge *msg, int len);
-static void pgstat_recv_dropdb(PgStat_MsgDropdb *msg, int len);
-static void pgstat_recv_resetcounter(PgStat_MsgResetcounter *msg, int len);
-static void pgstat_recv_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len);
-static void pgstat_recv_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len);
-static void pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len);
-static void pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len);
-static void pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len);
-static void pgstat_recv_archiver(PgStat_MsgArchiver *msg, int len);
-static void pgstat_recv_bgwriter(PgStat_MsgBgWriter *msg, int len);
-static void pgstat_recv_funcstat(PgStat_MsgFuncstat *msg, int len);
-static void pgstat_recv_funcpurge(PgStat_MsgFuncpurge *msg, int len);
-static void pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len);
-static void pgstat_recv_deadlock(PgStat_MsgDeadlock *msg, int len);
-static void pgstat_recv_checksum_failure(PgStat_MsgChecksumFailure *msg, int len);
-static void pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len);
+static void pgstat_apply_tabstat(PgStat_MsgTabstat *msg, int len);
+static void pgstat_apply_tabpurge(PgStat_MsgTabpurge *msg, int len);
+static void pgstat_apply_dropdb(PgStat_MsgDropdb *msg, int len);
+static void pgstat_apply_resetcounter(PgStat_MsgResetcounter *msg, int len);
+static void pgstat_apply_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len);
+static void pgstat_apply_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len);
+static void pgstat_apply_autovac(PgStat_MsgAutovacStart *msg, int len);
+static void pgstat_apply_vacuum(PgStat_MsgVacuum *msg, int len);
+static void pgstat_apply_analyze(PgStat_MsgAnalyze *msg, int len);
+static void pgstat_apply_archiver(PgStat_MsgArchiver *msg, int len);
+static void pgstat_apply_bgwriter(PgStat_MsgBgWriter *msg, int len);
+static void pgstat_apply_funcstat(PgStat_MsgFuncstat *msg, int len);
+static void pgstat_apply_funcpurge(PgStat_MsgFuncpurge *msg, int len);
+static void pgstat_apply_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len);
+static void pgstat_apply_deadlock(PgStat_MsgDeadlock *msg, int len);
+static void pgstat_apply_checksum_failure(PgStat_MsgChecksumFailure *msg, int len);
+static void pgstat_apply_tempfile(PgStat_MsgTempFile *msg, int len);
 
 /* ------------------------------------------------------------
  * Public functions called from postmaster follow
  * ------------------------------------------------------------
  */
 
-/* ----------
- * pgstat_init() -
- *
- *	Called from postmaster at startup. Create the resources required
- *	by the statistics collector process.  If unable to do so, do not
- *	fail --- better to let the postmaster start with stats collection
- *	disabled.
- * ----------
+/*
+ * Report shared-memory space needed by StatsShmemInit.
  */
-void
-pgstat_init(void)
+Size
+StatsShmemSize(void)
 {
-	ACCEPT_TYPE_ARG3 alen;
-	struct addrinfo *addrs = NULL,
-			   *addr,
-				hints;
-	int			ret;
-	fd_set		rset;
-	struct timeval tv;
-	char		test_byte;
-	int			sel_res;
-	int			tries = 0;
-
-#define TESTBYTEVAL ((char) 199)
+	return add_size(MAXALIGN(sizeof(PgStat_ShmemControl)),
+					PGSTAT_SHMEM_DSA_SIZE);
+}
 
-	/*
-	 * This static assertion verifies that we didn't mess up the calculations
-	 * involved in selecting maximum payload sizes for our UDP messages.
-	 * Because the only consequence of overrunning PGSTAT_MAX_MSG_SIZE would
-	 * be silent performance loss from fragmentation, it seems worth having a
-	 * compile-time cross-check that we didn't.
-	 */
-	StaticAssertStmt(sizeof(PgStat_Msg) <= PGSTAT_MAX_MSG_SIZE,
-					 "maximum stats message size exceeds PGSTAT_MAX_MSG_SIZE");
+/*
+ * Initialize the shared statistics during postmaster startup, or attach to
+ * them in an EXEC_BACKEND child.
+ */
+void
+StatsShmemInit(void)
+{
+	bool		found;
 
-	/*
-	 * Create the UDP socket for sending and receiving statistic messages
-	 */
-	hints.ai_flags = AI_PASSIVE;
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_DGRAM;
-	hints.ai_protocol = 0;
-	hints.ai_addrlen = 0;
-	hints.ai_addr = NULL;
-	hints.ai_canonname = NULL;
-	hints.ai_next = NULL;
-	ret = pg_getaddrinfo_all("localhost", NULL, &hints, &addrs);
-	if (ret || !addrs)
-	{
-		ereport(LOG,
-				(errmsg("could not resolve \"localhost\": %s",
-						gai_strerror(ret))));
-		goto startup_failed;
-	}
+	pgStatShmem = (PgStat_ShmemControl *)
+		ShmemInitStruct("Shared Statistics", StatsShmemSize(), &found);
 
-	/*
-	 * On some platforms, pg_getaddrinfo_all() may return multiple addresses
-	 * only one of which will actually work (eg, both IPv6 and IPv4 addresses
-	 * when kernel will reject IPv6).  Worse, the failure may occur at the
-	 * bind() or perhaps even connect() stage.  So we must loop through the
-	 * results till we find a working combination. We will generate LOG
-	 * messages, but no error, for bogus combinations.
-	 */
-	for (addr = addrs; addr; addr = addr->ai_next)
+	if (!found)
 	{
-#ifdef HAVE_UNIX_SOCKETS
-		/* Ignore AF_UNIX sockets, if any are returned. */
-		if (addr->ai_family == AF_UNIX)
-			continue;
-#endif
-
-		if (++tries > 1)
-			ereport(LOG,
-					(errmsg("trying another address for the statistics collector")));
-
-		/*
-		 * Create the socket.
-		 */
-		if ((pgStatSock = socket(addr->ai_family, SOCK_DGRAM, 0)) == PGINVALID_SOCKET)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not create socket for statistics collector: %m")));
-			continue;
-		}
-
-		/*
-		 * Bind it to a kernel assigned port on localhost and get the assigned
-		 * port via getsockname().
-		 */
-		if (bind(pgStatSock, addr->ai_addr, addr->ai_addrlen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not bind socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		alen = sizeof(pgStatAddr);
-		if (getsockname(pgStatSock, (struct sockaddr *) &pgStatAddr, &alen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not get address of socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/*
-		 * Connect the socket to its own address.  This saves a few cycles by
-		 * not having to respecify the target address on every send. This also
-		 * provides a kernel-level check that only packets from this same
-		 * address will be received.
-		 */
-		if (connect(pgStatSock, (struct sockaddr *) &pgStatAddr, alen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not connect socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/*
-		 * Try to send and receive a one-byte test message on the socket. This
-		 * is to catch situations where the socket can be created but will not
-		 * actually pass data (for instance, because kernel packet filtering
-		 * rules prevent it).
-		 */
-		test_byte = TESTBYTEVAL;
+		dsa_area   *dsa;
+		dshash_table *dsh;
+		TimestampTz now = GetCurrentTimestamp();
 
-retry1:
-		if (send(pgStatSock, &test_byte, 1, 0) != 1)
-		{
-			if (errno == EINTR)
-				goto retry1;	/* if interrupted, just retry */
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not send test message on socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
+		Assert(!IsUnderPostmaster);
 
 		/*
-		 * There could possibly be a little delay before the message can be
-		 * received.  We arbitrarily allow up to half a second before deciding
-		 * it's broken.
+		 * Create the DSA area in place, and the hash tables within it.  The
+		 * area's size is capped while we do so, so that the tables' initial
+		 * allocations all come out of the in-place memory and the postmaster
+		 * never has to create or map a DSM segment.
 		 */
-		for (;;)				/* need a loop to handle EINTR */
-		{
-			FD_ZERO(&rset);
-			FD_SET(pgStatSock, &rset);
-
-			tv.tv_sec = 0;
-			tv.tv_usec = 500000;
-			sel_res = select(pgStatSock + 1, &rset, NULL, NULL, &tv);
-			if (sel_res >= 0 || errno != EINTR)
-				break;
-		}
-		if (sel_res < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("select() failed in statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-		if (sel_res == 0 || !FD_ISSET(pgStatSock, &rset))
-		{
-			/*
-			 * This is the case we actually think is likely, so take pains to
-			 * give a specific message for it.
-			 *
-			 * errno will not be set meaningfully here, so don't use it.
-			 */
-			ereport(LOG,
-					(errcode(ERRCODE_CONNECTION_FAILURE),
-					 errmsg("test message did not get through on socket for statistics collector")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		test_byte++;			/* just make sure variable is changed */
-
-retry2:
-		if (recv(pgStatSock, &test_byte, 1, 0) != 1)
-		{
-			if (errno == EINTR)
-				goto retry2;	/* if interrupted, just retry */
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not receive test message on socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		if (test_byte != TESTBYTEVAL)	/* strictly paranoia ... */
-		{
-			ereport(LOG,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("incorrect test message transmission on socket for statistics collector")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/* If we get here, we have a working socket */
-		break;
-	}
-
-	/* Did we find a working address? */
-	if (!addr || pgStatSock == PGINVALID_SOCKET)
-		goto startup_failed;
-
-	/*
-	 * Set the socket to non-blocking IO.  This ensures that if the collector
-	 * falls behind, statistics messages will be discarded; backends won't
-	 * block waiting to send messages to the collector.
-	 */
-	if (!pg_set_noblock(pgStatSock))
-	{
-		ereport(LOG,
-				(errcode_for_socket_access(),
-				 errmsg("could not set statistics collector socket to nonblocking mode: %m")));
-		goto startup_failed;
-	}
-
-	/*
-	 * Try to ensure that the socket's receive buffer is at least
-	 * PGSTAT_MIN_RCVBUF bytes, so that it won't easily overflow and lose
-	 * data.  Use of UDP protocol means that we are willing to lose data under
-	 * heavy load, but we don't want it to happen just because of ridiculously
-	 * small default buffer sizes (such as 8KB on older Windows versions).
-	 */
-	{
-		int			old_rcvbuf;
-		int			new_rcvbuf;
-		ACCEPT_TYPE_ARG3 rcvbufsize = sizeof(old_rcvbuf);
-
-		if (getsockopt(pgStatSock, SOL_SOCKET, SO_RCVBUF,
-					   (char *) &old_rcvbuf, &rcvbufsize) < 0)
-		{
-			elog(LOG, "getsockopt(SO_RCVBUF) failed: %m");
-			/* if we can't get existing size, always try to set it */
-			old_rcvbuf = 0;
-		}
-
-		new_rcvbuf = PGSTAT_MIN_RCVBUF;
-		if (old_rcvbuf < new_rcvbuf)
-		{
-			if (setsockopt(pgStatSock, SOL_SOCKET, SO_RCVBUF,
-						   (char *) &new_rcvbuf, sizeof(new_rcvbuf)) < 0)
-				elog(LOG, "setsockopt(SO_RCVBUF) failed: %m");
-		}
+		dsa = dsa_create_in_place(PgStatShmemDSAPlace(pgStatShmem),
+								  PGSTAT_SHMEM_DSA_SIZE,
+								  LWTRANCHE_STATS_DSA, NULL);
+		dsa_pin(dsa);
+		dsa_set_size_limit(dsa, PGSTAT_SHMEM_DSA_SIZE);
+
+		dsh = dshash_create(dsa, &dsh_dbparams, NULL);
+		pgStatShmem->db_hash_handle = dshash_get_hash_table_handle(dsh);
+		dshash_detach(dsh);
+
+		dsh = dshash_create(dsa, &dsh_tabparams, NULL);
+		pgStatShmem->tab_hash_handle = dshash_get_hash_table_handle(dsh);
+		dshash_detach(dsh);
+
+		dsh = dshash_create(dsa, &dsh_funcparams, NULL);
+		pgStatShmem->func_hash_handle = dshash_get_hash_table_handle(dsh);
+		dshash_detach(dsh);
+
+		dsa_set_size_limit(dsa, -1);
+		dsa_detach(dsa);
+
+		SpinLockInit(&pgStatShmem->global_lock);
+		memset(&pgStatShmem->global_stats, 0, sizeof(PgStat_GlobalStats));
+		pgStatShmem->global_stats.stat_reset_timestamp = now;
+
+		SpinLockInit(&pgStatShmem->archiver_lock);
+		memset(&pgStatShmem->archiver_stats, 0, sizeof(PgStat_ArchiverStats));
+		pgStatShmem->archiver_stats.stat_reset_timestamp = now;
 	}
-
-	pg_freeaddrinfo_all(hints.ai_family, addrs);
-
-	return;
-
-startup_failed:
-	ereport(LOG,
-			(errmsg("disabling statistics collector for lack of working socket")));
-
-	if (addrs)
-		pg_freeaddrinfo_all(hints.ai_family, addrs);
-
-	if (pgStatSock != PGINVALID_SOCKET)
-		closesocket(pgStatSock);
-	pgStatSock = PGINVALID_SOCKET;
-
-	/*
-	 * Adjust GUC variables to suppress useless activity, and for debugging
-	 * purposes (seeing track_counts off is a clue that we failed here). We
-	 * use PGC_S_OVERRIDE because there is no point in trying to turn it back
-	 * on from postgresql.conf without a restart.
-	 */
-	SetConfigOption("track_counts", "off", PGC_INTERNAL, PGC_S_OVERRIDE);
 }
 
 /*
@@ -648,8 +503,8 @@ pgstat_reset_remove_files(const char *directory)
 		Oid			tmp_oid;
 
 		/*
-		 * Skip directory entries that don't match the file names we write.
-		 * See get_dbstat_filename for the database-specific pattern.
+		 * Skip directory entries that don't match the file names we write,
+		 * or that the statistics collector of older releases used to write.
 		 */
 		if (strncmp(entry->d_name, "global.", 7) == 0)
 			nchars = 7;
@@ -680,7 +535,8 @@ pgstat_reset_remove_files(const char *directory)
  * pgstat_reset_all() -
  *
  * Remove the stats files.  This is currently used only if WAL
- * recovery is needed after a crash.
+ * recovery is needed after a crash, in which case the shared statistics
+ * have just been created empty and stay that way.
  */
 void
 pgstat_reset_all(void)
@@ -689,142 +545,321 @@ pgstat_reset_all(void)
 	pgstat_reset_remove_files(PGSTAT_STAT_PERMANENT_DIRECTORY);
 }
 
-#ifdef EXEC_BACKEND
-
-/*
- * pgstat_forkexec() -
+/* ----------
+ * pgstat_restore_stats() -
  *
- * Format up the arglist for, then fork and exec, statistics collector process
+ *	Load the statistics file written at the last clean shutdown into shared
+ *	memory, then remove it; from here on the shared statistics are
+ *	authoritative.  Called by the startup process, or by a standalone
+ *	backend, before anybody else can be using the statistics.
+ * ----------
  */
-static pid_t
-pgstat_forkexec(void)
+void
+pgstat_restore_stats(void)
 {
-	char	   *av[10];
-	int			ac = 0;
-
-	av[ac++] = "postgres";
-	av[ac++] = "--forkcol";
-	av[ac++] = NULL;			/* filled in by postmaster_forkexec */
-
-	av[ac] = NULL;
-	Assert(ac < lengthof(av));
-
-	return postmaster_forkexec(ac, av);
-}
-#endif							/* EXEC_BACKEND */
-
+	FILE	   *fpin;
+	int32		format_id;
+	PgStat_GlobalStats global_stats;
+	PgStat_ArchiverStats archiver_stats;
+	const char *statfile = PGSTAT_STAT_PERMANENT_FILENAME;
 
-/*
- * pgstat_start() -
- *
- *	Called from postmaster at startup or after an existing collector
- *	died.  Attempt to fire up a fresh statistics collector.
- *
- *	Returns PID of child process, or 0 if fail.
- *
- *	Note: if fail, we will be called again from the postmaster main loop.
- */
-int
-pgstat_start(void)
-{
-	time_t		curtime;
-	pid_t		pgStatPid;
+	/* A standalone backend gets here before pgstat_initialize() */
+	pgstat_attach_shmem();
 
 	/*
-	 * Check that the socket is there, else pgstat_init failed and we can do
-	 * nothing useful.
+	 * Try to open the stats file.  If it doesn't exist, we simply start from
+	 * scratch with empty counters.
 	 */
-	if (pgStatSock == PGINVALID_SOCKET)
-		return 0;
+	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
+	{
+		if (errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open statistics file \"%s\": %m",
+							statfile)));
+		return;
+	}
 
 	/*
-	 * Do nothing if too soon since last collector start.  This is a safety
-	 * valve to protect against continuous respawn attempts if the collector
-	 * is dying immediately at launch.  Note that since we will be re-called
-	 * from the postmaster main loop, we will get another chance later.
+	 * Verify it's of the expected format, and read the cluster-wide stats.
 	 */
-	curtime = time(NULL);
-	if ((unsigned int) (curtime - last_pgstat_start_time) <
-		(unsigned int) PGSTAT_RESTART_INTERVAL)
-		return 0;
-	last_pgstat_start_time = curtime;
+	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
+		format_id != PGSTAT_FILE_FORMAT_ID ||
+		fread(&global_stats, 1, sizeof(global_stats), fpin) != sizeof(global_stats) ||
+		fread(&archiver_stats, 1, sizeof(archiver_stats), fpin) != sizeof(archiver_stats))
+		goto corrupted;
+
+	SpinLockAcquire(&pgStatShmem->global_lock);
+	memcpy(&pgStatShmem->global_stats, &global_stats, sizeof(global_stats));
+	SpinLockRelease(&pgStatShmem->global_lock);
+
+	SpinLockAcquire(&pgStatShmem->archiver_lock);
+	memcpy(&pgStatShmem->archiver_stats, &archiver_stats,
+		   sizeof(archiver_stats));
+	SpinLockRelease(&pgStatShmem->archiver_lock);
 
 	/*
-	 * Okay, fork off the collector.
+	 * Then the database, table and function entries, until the end marker.
 	 */
-#ifdef EXEC_BACKEND
-	switch ((pgStatPid = pgstat_forkexec()))
-#else
-	switch ((pgStatPid = fork_process()))
-#endif
+	for (;;)
 	{
-		case -1:
-			ereport(LOG,
-					(errmsg("could not fork statistics collector: %m")));
-			return 0;
+		PgStat_StatDBEntry dbbuf;
+		PgStat_StatDBEntry *dbentry;
+		PgStatShared_TabEntry tabbuf;
+		PgStatShared_TabEntry *tabentry;
+		PgStatShared_FuncEntry funcbuf;
+		PgStatShared_FuncEntry *funcentry;
+		bool		found;
+
+		switch (fgetc(fpin))
+		{
+				/*
+				 * 'D'	A PgStat_StatDBEntry struct describing a database
+				 * follows.
+				 */
+			case 'D':
+				if (fread(&dbbuf, 1, sizeof(dbbuf), fpin) != sizeof(dbbuf))
+					goto corrupted;
 
-#ifndef EXEC_BACKEND
-		case 0:
-			/* in postmaster child ... */
-			InitPostmasterChild();
+				dbentry = dshash_find_or_insert(pgStatSharedDBHash,
+												&dbbuf.databaseid, &found);
+				memcpy(dbentry, &dbbuf, sizeof(dbbuf));
+				dshash_release_lock(pgStatSharedDBHash, dbentry);
+				if (found)
+					goto corrupted;
+				break;
 
-			/* Close the postmaster's sockets */
-			ClosePostmasterPorts(false);
+				/*
+				 * 'T'	A PgStat_StatTabEntry and the database it belongs to
+				 * follow.
+				 */
+			case 'T':
+				if (fread(&tabbuf, 1, sizeof(tabbuf), fpin) != sizeof(tabbuf))
+					goto corrupted;
 
-			/* Drop our connection to postmaster's shared memory, as well */
-			dsm_detach_all();
-			PGSharedMemoryDetach();
+				tabentry = dshash_find_or_insert(pgStatSharedTabHash,
+												 &tabbuf.key, &found);
+				memcpy(tabentry, &tabbuf, sizeof(tabbuf));
+				dshash_release_lock(pgStatSharedTabHash, tabentry);
+				if (found)
+					goto corrupted;
+				break;
 
-			PgstatCollectorMain(0, NULL);
-			break;
-#endif
+				/*
+				 * 'F'	A PgStat_StatFuncEntry and the database it belongs to
+				 * follow.
+				 */
+			case 'F':
+				if (fread(&funcbuf, 1, sizeof(funcbuf), fpin) != sizeof(funcbuf))
+					goto corrupted;
 
-		default:
-			return (int) pgStatPid;
-	}
+				funcentry = dshash_find_or_insert(pgStatSharedFuncHash,
+												  &funcbuf.key, &found);
+				memcpy(funcentry, &funcbuf, sizeof(funcbuf));
+				dshash_release_lock(pgStatSharedFuncHash, funcentry);
+				if (found)
+					goto corrupted;
+				break;
 
-	/* shouldn't get here */
-	return 0;
-}
+			case 'E':
+				goto done;
 
-void
-allow_immediate_pgstat_restart(void)
-{
-	last_pgstat_start_time = 0;
-}
+			default:
+				goto corrupted;
+		}
+	}
 
-/* ------------------------------------------------------------
- * Public functions used by backends follow
- *------------------------------------------------------------
- */
+corrupted:
+	ereport(LOG,
+			(errmsg("corrupted statistics file \"%s\"", statfile)));
+	/* Don't keep anything we loaded from a file we can't trust */
+	pgstat_clear_shared_stats();
+
+done:
+	FreeFile(fpin);
 
+	elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
+	unlink(statfile);
+}
 
 /* ----------
- * pgstat_report_stat() -
+ * pgstat_before_server_shutdown() -
  *
- *	Must be called by processes that performs DML: tcop/postgres.c, logical
- *	receiver processes, SPI worker, etc. to send the so far collected
- *	per-table and function usage statistics to the collector.  Note that this
- *	is called only when not within a transaction, so it is fair to use
- *	transaction stop time as an approximation of current time.
+ *	Write the shared statistics out to the permanent stats file, so that
+ *	they survive a clean restart.  Registered as a before_shmem_exit
+ *	callback by the checkpointer, which runs last among the processes that
+ *	report statistics, and by a standalone backend.
  * ----------
  */
 void
-pgstat_report_stat(bool force)
+pgstat_before_server_shutdown(int code, Datum arg)
 {
-	/* we assume this inits to all zeroes: */
-	static const PgStat_TableCounts all_zeroes;
-	static TimestampTz last_report = 0;
+	/* Make sure this process's own counts are included */
+	if (OidIsValid(MyDatabaseId))
+		pgstat_report_stat(true);
 
-	TimestampTz now;
-	PgStat_MsgTabstat regular_msg;
-	PgStat_MsgTabstat shared_msg;
-	TabStatusArray *tsa;
-	int			i;
+	/*
+	 * Only a clean shutdown writes the file.  After a crash the statistics
+	 * are thrown away anyway, since they may not match the recovered state.
+	 */
+	if (code == 0 && pgStatDSA != NULL)
+		pgstat_write_statsfile();
+}
 
-	/* Don't expend a clock check if nothing to do */
-	if ((pgStatTabList == NULL || pgStatTabList->tsa_used == 0) &&
-		pgStatXactCommit == 0 && pgStatXactRollback == 0 &&
+/* ----------
+ * pgstat_write_statsfile() -
+ *		Write the shared statistics to the permanent stats file.
+ * ----------
+ */
+static void
+pgstat_write_statsfile(void)
+{
+	dshash_seq_status hstat;
+	PgStat_StatDBEntry *dbentry;
+	PgStatShared_TabEntry *tabentry;
+	PgStatShared_FuncEntry *funcentry;
+	PgStat_GlobalStats global_stats;
+	PgStat_ArchiverStats archiver_stats;
+	FILE	   *fpout;
+	int32		format_id;
+	const char *tmpfile = PGSTAT_STAT_PERMANENT_TMPFILE;
+	const char *statfile = PGSTAT_STAT_PERMANENT_FILENAME;
+	int			rc;
+
+	elog(DEBUG2, "writing stats file \"%s\"", statfile);
+
+	/*
+	 * Open the statistics temp file to write out the current values.
+	 */
+	fpout = AllocateFile(tmpfile, PG_BINARY_W);
+	if (fpout == NULL)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not open temporary statistics file \"%s\": %m",
+						tmpfile)));
+		return;
+	}
+
+	/*
+	 * Write the file header --- currently just a format ID.
+	 */
+	format_id = PGSTAT_FILE_FORMAT_ID;
+	rc = fwrite(&format_id, sizeof(format_id), 1, fpout);
+	(void) rc;					/* we'll check for error with ferror */
+
+	/*
+	 * Write global and archiver stats structs
+	 */
+	SpinLockAcquire(&pgStatShmem->global_lock);
+	memcpy(&global_stats, &pgStatShmem->global_stats, sizeof(global_stats));
+	SpinLockRelease(&pgStatShmem->global_lock);
+	rc = fwrite(&global_stats, sizeof(global_stats), 1, fpout);
+	(void) rc;					/* we'll check for error with ferror */
+
+	SpinLockAcquire(&pgStatShmem->archiver_lock);
+	memcpy(&archiver_stats, &pgStatShmem->archiver_stats,
+		   sizeof(archiver_stats));
+	SpinLockRelease(&pgStatShmem->archiver_lock);
+	rc = fwrite(&archiver_stats, sizeof(archiver_stats), 1, fpout);
+	(void) rc;					/* we'll check for error with ferror */
+
+	/*
+	 * Walk through the database, table and function hash tables.
+	 */
+	dshash_seq_init(&hstat, pgStatSharedDBHash, false);
+	while ((dbentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		fputc('D', fpout);
+		rc = fwrite(dbentry, sizeof(PgStat_StatDBEntry), 1, fpout);
+		(void) rc;				/* we'll check for error with ferror */
+	}
+	dshash_seq_term(&hstat);
+
+	dshash_seq_init(&hstat, pgStatSharedTabHash, false);
+	while ((tabentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		fputc('T', fpout);
+		rc = fwrite(tabentry, sizeof(PgStatShared_TabEntry), 1, fpout);
+		(void) rc;				/* we'll check for error with ferror */
+	}
+	dshash_seq_term(&hstat);
+
+	dshash_seq_init(&hstat, pgStatSharedFuncHash, false);
+	while ((funcentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		fputc('F', fpout);
+		rc = fwrite(funcentry, sizeof(PgStatShared_FuncEntry), 1, fpout);
+		(void) rc;				/* we'll check for error with ferror */
+	}
+	dshash_seq_term(&hstat);
+
+	/*
+	 * No more output to be done. Close the temp file and replace the old
+	 * pgstat.stat with it.  The ferror() check replaces testing for error
+	 * after each individual fputc or fwrite above.
+	 */
+	fputc('E', fpout);
+
+	if (ferror(fpout))
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write temporary statistics file \"%s\": %m",
+						tmpfile)));
+		FreeFile(fpout);
+		unlink(tmpfile);
+	}
+	else if (FreeFile(fpout) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not close temporary statistics file \"%s\": %m",
+						tmpfile)));
+		unlink(tmpfile);
+	}
+	else if (rename(tmpfile, statfile) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename temporary statistics file \"%s\" to \"%s\": %m",
+						tmpfile, statfile)));
+		unlink(tmpfile);
+	}
+}
+
+/* ------------------------------------------------------------
+ * Public functions used by backends follow
+ *------------------------------------------------------------
+ */
+
+
+/* ----------
+ * pgstat_report_stat() -
+ *
+ *	Must be called by processes that performs DML: tcop/postgres.c, logical
+ *	receiver processes, SPI worker, etc. to send the so far collected
+ *	per-table and function usage statistics to the shared statistics.  Note that this
+ *	is called only when not within a transaction, so it is fair to use
+ *	transaction stop time as an approximation of current time.
+ * ----------
+ */
+void
+pgstat_report_stat(bool force)
+{
+	/* we assume this inits to all zeroes: */
+	static const PgStat_TableCounts all_zeroes;
+	static TimestampTz last_report = 0;
+
+	TimestampTz now;
+	PgStat_MsgTabstat regular_msg;
+	PgStat_MsgTabstat shared_msg;
+	TabStatusArray *tsa;
+	int			i;
+
+	/* Don't expend a clock check if nothing to do */
+	if ((pgStatTabList == NULL || pgStatTabList->tsa_used == 0) &&
+		pgStatXactCommit == 0 && pgStatXactRollback == 0 &&
 		!have_function_stats)
 		return;
 
@@ -922,8 +957,11 @@ pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
 	int			n;
 	int			len;
 
-	/* It's unlikely we'd get here with no socket, but maybe not impossible */
-	if (pgStatSock == PGINVALID_SOCKET)
+	/*
+	 * Nothing to do if we haven't attached to the shared statistics yet, or
+	 * have already detached from them during shutdown.
+	 */
+	if (pgStatDSA == NULL)
 		return;
 
 	/*
@@ -1016,179 +1054,111 @@ pgstat_send_funcstats(void)
 /* ----------
  * pgstat_vacuum_stat() -
  *
- *	Will tell the collector about objects he can get rid of.
+ *	Remove the statistics of objects that no longer exist.
  * ----------
  */
 void
 pgstat_vacuum_stat(void)
 {
 	HTAB	   *htab;
-	PgStat_MsgTabpurge msg;
-	PgStat_MsgFuncpurge f_msg;
-	HASH_SEQ_STATUS hstat;
+	dshash_seq_status hstat;
 	PgStat_StatDBEntry *dbentry;
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatFuncEntry *funcentry;
-	int			len;
+	PgStatShared_TabEntry *tabentry;
+	PgStatShared_FuncEntry *funcentry;
+	List	   *dead_dbs = NIL;
+	ListCell   *lc;
+	bool		have_funcs = false;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
-	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
-	 */
-	backend_read_statsfile();
-
 	/*
 	 * Read pg_database and make a list of OIDs of all existing databases
 	 */
 	htab = pgstat_collect_oids(DatabaseRelationId, Anum_pg_database_oid);
 
 	/*
-	 * Search the database hash table for dead databases and tell the
-	 * collector to drop them.
+	 * Search the database hash table for dead databases.  Dropping one takes
+	 * locks on other hash entries, so just remember them while scanning.
 	 */
-	hash_seq_init(&hstat, pgStatDBHash);
-	while ((dbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
+	dshash_seq_init(&hstat, pgStatSharedDBHash, false);
+	while ((dbentry = dshash_seq_next(&hstat)) != NULL)
 	{
 		Oid			dbid = dbentry->databaseid;
 
-		CHECK_FOR_INTERRUPTS();
-
 		/* the DB entry for shared tables (with InvalidOid) is never dropped */
 		if (OidIsValid(dbid) &&
 			hash_search(htab, (void *) &dbid, HASH_FIND, NULL) == NULL)
-			pgstat_drop_database(dbid);
+			dead_dbs = lappend_oid(dead_dbs, dbid);
+	}
+	dshash_seq_term(&hstat);
+
+	foreach(lc, dead_dbs)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		pgstat_drop_database(lfirst_oid(lc));
 	}
 
 	/* Clean up */
+	list_free(dead_dbs);
 	hash_destroy(htab);
 
 	/*
-	 * Lookup our own database entry; if not found, nothing more to do.
-	 */
-	dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-												 (void *) &MyDatabaseId,
-												 HASH_FIND, NULL);
-	if (dbentry == NULL || dbentry->tables == NULL)
-		return;
-
-	/*
-	 * Similarly to above, make a list of all known relations in this DB.
+	 * Similarly to above, make a list of all known relations in this DB, and
+	 * remove the stats of any of our tables that aren't in it.
 	 */
 	htab = pgstat_collect_oids(RelationRelationId, Anum_pg_class_oid);
 
-	/*
-	 * Initialize our messages table counter to zero
-	 */
-	msg.m_nentries = 0;
-
-	/*
-	 * Check for all tables listed in stats hashtable if they still exist.
-	 */
-	hash_seq_init(&hstat, dbentry->tables);
-	while ((tabentry = (PgStat_StatTabEntry *) hash_seq_search(&hstat)) != NULL)
+	dshash_seq_init(&hstat, pgStatSharedTabHash, true);
+	while ((tabentry = dshash_seq_next(&hstat)) != NULL)
 	{
-		Oid			tabid = tabentry->tableid;
-
-		CHECK_FOR_INTERRUPTS();
-
-		if (hash_search(htab, (void *) &tabid, HASH_FIND, NULL) != NULL)
+		if (tabentry->key.databaseid != MyDatabaseId)
 			continue;
 
-		/*
-		 * Not there, so add this table's Oid to the message
-		 */
-		msg.m_tableid[msg.m_nentries++] = tabid;
-
-		/*
-		 * If the message is full, send it out and reinitialize to empty
-		 */
-		if (msg.m_nentries >= PGSTAT_NUM_TABPURGE)
-		{
-			len = offsetof(PgStat_MsgTabpurge, m_tableid[0])
-				+ msg.m_nentries * sizeof(Oid);
-
-			pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_TABPURGE);
-			msg.m_databaseid = MyDatabaseId;
-			pgstat_send(&msg, len);
-
-			msg.m_nentries = 0;
-		}
-	}
-
-	/*
-	 * Send the rest
-	 */
-	if (msg.m_nentries > 0)
-	{
-		len = offsetof(PgStat_MsgTabpurge, m_tableid[0])
-			+ msg.m_nentries * sizeof(Oid);
-
-		pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_TABPURGE);
-		msg.m_databaseid = MyDatabaseId;
-		pgstat_send(&msg, len);
+		if (hash_search(htab, (void *) &tabentry->key.objectid,
+						HASH_FIND, NULL) == NULL)
+			dshash_delete_current(&hstat);
 	}
+	dshash_seq_term(&hstat);
 
 	/* Clean up */
 	hash_destroy(htab);
 
 	/*
 	 * Now repeat the above steps for functions.  However, we needn't bother
-	 * in the common case where no function stats are being collected.
+	 * reading pg_proc in the common case where no function stats are being
+	 * collected.
 	 */
-	if (dbentry->functions != NULL &&
-		hash_get_num_entries(dbentry->functions) > 0)
+	dshash_seq_init(&hstat, pgStatSharedFuncHash, false);
+	while ((funcentry = dshash_seq_next(&hstat)) != NULL)
 	{
-		htab = pgstat_collect_oids(ProcedureRelationId, Anum_pg_proc_oid);
-
-		pgstat_setheader(&f_msg.m_hdr, PGSTAT_MTYPE_FUNCPURGE);
-		f_msg.m_databaseid = MyDatabaseId;
-		f_msg.m_nentries = 0;
-
-		hash_seq_init(&hstat, dbentry->functions);
-		while ((funcentry = (PgStat_StatFuncEntry *) hash_seq_search(&hstat)) != NULL)
+		if (funcentry->key.databaseid == MyDatabaseId)
 		{
-			Oid			funcid = funcentry->functionid;
-
-			CHECK_FOR_INTERRUPTS();
-
-			if (hash_search(htab, (void *) &funcid, HASH_FIND, NULL) != NULL)
-				continue;
-
-			/*
-			 * Not there, so add this function's Oid to the message
-			 */
-			f_msg.m_functionid[f_msg.m_nentries++] = funcid;
-
-			/*
-			 * If the message is full, send it out and reinitialize to empty
-			 */
-			if (f_msg.m_nentries >= PGSTAT_NUM_FUNCPURGE)
-			{
-				len = offsetof(PgStat_MsgFuncpurge, m_functionid[0])
-					+ f_msg.m_nentries * sizeof(Oid);
-
-				pgstat_send(&f_msg, len);
-
-				f_msg.m_nentries = 0;
-			}
+			have_funcs = true;
+			break;
 		}
+	}
+	dshash_seq_term(&hstat);
 
-		/*
-		 * Send the rest
-		 */
-		if (f_msg.m_nentries > 0)
-		{
-			len = offsetof(PgStat_MsgFuncpurge, m_functionid[0])
-				+ f_msg.m_nentries * sizeof(Oid);
+	if (!have_funcs)
+		return;
 
-			pgstat_send(&f_msg, len);
-		}
+	htab = pgstat_collect_oids(ProcedureRelationId, Anum_pg_proc_oid);
 
-		hash_destroy(htab);
+	dshash_seq_init(&hstat, pgStatSharedFuncHash, true);
+	while ((funcentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		if (funcentry->key.databaseid != MyDatabaseId)
+			continue;
+
+		if (hash_search(htab, (void *) &funcentry->key.objectid,
+						HASH_FIND, NULL) == NULL)
+			dshash_delete_current(&hstat);
 	}
+	dshash_seq_term(&hstat);
+
+	hash_destroy(htab);
 }
 
 
@@ -1246,7 +1216,7 @@ pgstat_collect_oids(Oid catalogid, AttrNumber anum_oid)
 /* ----------
  * pgstat_drop_database() -
  *
- *	Tell the collector that we just dropped a database.
+ *	Tell the statistics system that we just dropped a database.
  *	(If the message gets lost, we will still clean the dead DB eventually
  *	via future invocations of pgstat_vacuum_stat().)
  * ----------
@@ -1256,7 +1226,7 @@ pgstat_drop_database(Oid databaseid)
 {
 	PgStat_MsgDropdb msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DROPDB);
@@ -1268,7 +1238,7 @@ pgstat_drop_database(Oid databaseid)
 /* ----------
  * pgstat_drop_relation() -
  *
- *	Tell the collector that we just dropped a relation.
+ *	Tell the statistics system that we just dropped a relation.
  *	(If the message gets lost, we will still clean the dead entry eventually
  *	via future invocations of pgstat_vacuum_stat().)
  *
@@ -1283,7 +1253,7 @@ pgstat_drop_relation(Oid relid)
 	PgStat_MsgTabpurge msg;
 	int			len;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	msg.m_tableid[0] = relid;
@@ -1301,7 +1271,7 @@ pgstat_drop_relation(Oid relid)
 /* ----------
  * pgstat_reset_counters() -
  *
- *	Tell the statistics collector to reset counters for our database.
+ *	Tell the statistics system to reset counters for our database.
  *
  *	Permission checking for this function is managed through the normal
  *	GRANT system.
@@ -1312,7 +1282,7 @@ pgstat_reset_counters(void)
 {
 	PgStat_MsgResetcounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RESETCOUNTER);
@@ -1323,7 +1293,7 @@ pgstat_reset_counters(void)
 /* ----------
  * pgstat_reset_shared_counters() -
  *
- *	Tell the statistics collector to reset cluster-wide shared counters.
+ *	Tell the statistics system to reset cluster-wide shared counters.
  *
  *	Permission checking for this function is managed through the normal
  *	GRANT system.
@@ -1334,7 +1304,7 @@ pgstat_reset_shared_counters(const char *target)
 {
 	PgStat_MsgResetsharedcounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	if (strcmp(target, "archiver") == 0)
@@ -1354,7 +1324,7 @@ pgstat_reset_shared_counters(const char *target)
 /* ----------
  * pgstat_reset_single_counter() -
  *
- *	Tell the statistics collector to reset a single counter.
+ *	Tell the statistics system to reset a single counter.
  *
  *	Permission checking for this function is managed through the normal
  *	GRANT system.
@@ -1365,7 +1335,7 @@ pgstat_reset_single_counter(Oid objoid, PgStat_Single_Reset_Type type)
 {
 	PgStat_MsgResetsinglecounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RESETSINGLECOUNTER);
@@ -1389,7 +1359,7 @@ pgstat_report_autovac(Oid dboid)
 {
 	PgStat_MsgAutovacStart msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatDSA == NULL)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_AUTOVAC_START);
@@ -1403,7 +1373,7 @@ pgstat_report_autovac(Oid dboid)
 /* ---------
  * pgstat_report_vacuum() -
  *
- *	Tell the collector about the table we just vacuumed.
+ *	Tell the statistics system about the table we just vacuumed.
  * ---------
  */
 void
@@ -1412,7 +1382,7 @@ pgstat_report_vacuum(Oid tableoid, bool shared,
 {
 	PgStat_MsgVacuum msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_VACUUM);
@@ -1428,7 +1398,7 @@ pgstat_report_vacuum(Oid tableoid, bool shared,
 /* --------
  * pgstat_report_analyze() -
  *
- *	Tell the collector about the table we just analyzed.
+ *	Tell the statistics system about the table we just analyzed.
  *
  * Caller must provide new live- and dead-tuples estimates, as well as a
  * flag indicating whether to reset the changes_since_analyze counter.
@@ -1441,7 +1411,7 @@ pgstat_report_analyze(Relation rel,
 {
 	PgStat_MsgAnalyze msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	/*
@@ -1449,9 +1419,9 @@ pgstat_report_analyze(Relation rel,
 	 * already inserted and/or deleted rows in the target table. ANALYZE will
 	 * have counted such rows as live or dead respectively. Because we will
 	 * report our counts of such rows at transaction end, we should subtract
-	 * off these counts from what we send to the collector now, else they'll
-	 * be double-counted after commit.  (This approach also ensures that the
-	 * collector ends up with the right numbers if we abort instead of
+	 * off these counts from what we report now, else they'll be
+	 * double-counted after commit.  (This approach also ensures that the
+	 * shared statistics end up with the right numbers if we abort instead of
 	 * committing.)
 	 */
 	if (rel->pgstat_info != NULL)
@@ -1484,7 +1454,7 @@ pgstat_report_analyze(Relation rel,
 /* --------
  * pgstat_report_recovery_conflict() -
  *
- *	Tell the collector about a Hot Standby recovery conflict.
+ *	Tell the statistics system about a Hot Standby recovery conflict.
  * --------
  */
 void
@@ -1492,7 +1462,7 @@ pgstat_report_recovery_conflict(int reason)
 {
 	PgStat_MsgRecoveryConflict msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RECOVERYCONFLICT);
@@ -1504,7 +1474,7 @@ pgstat_report_recovery_conflict(int reason)
 /* --------
  * pgstat_report_deadlock() -
  *
- *	Tell the collector about a deadlock detected.
+ *	Tell the statistics system about a deadlock detected.
  * --------
  */
 void
@@ -1512,7 +1482,7 @@ pgstat_report_deadlock(void)
 {
 	PgStat_MsgDeadlock msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DEADLOCK);
@@ -1525,7 +1495,7 @@ pgstat_report_deadlock(void)
 /* --------
  * pgstat_report_checksum_failures_in_db() -
  *
- *	Tell the collector about one or more checksum failures.
+ *	Tell the statistics system about one or more checksum failures.
  * --------
  */
 void
@@ -1533,7 +1503,7 @@ pgstat_report_checksum_failures_in_db(Oid dboid, int failurecount)
 {
 	PgStat_MsgChecksumFailure msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_CHECKSUMFAILURE);
@@ -1547,7 +1517,7 @@ pgstat_report_checksum_failures_in_db(Oid dboid, int failurecount)
 /* --------
  * pgstat_report_checksum_failure() -
  *
- *	Tell the collector about a checksum failure.
+ *	Tell the statistics system about a checksum failure.
  * --------
  */
 void
@@ -1559,7 +1529,7 @@ pgstat_report_checksum_failure(void)
 /* --------
  * pgstat_report_tempfile() -
  *
- *	Tell the collector about a temporary file.
+ *	Tell the statistics system about a temporary file.
  * --------
  */
 void
@@ -1567,7 +1537,7 @@ pgstat_report_tempfile(size_t filesize)
 {
 	PgStat_MsgTempFile msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_TEMPFILE);
@@ -1577,43 +1547,6 @@ pgstat_report_tempfile(size_t filesize)
 }
 
 
-/* ----------
- * pgstat_ping() -
- *
- *	Send some junk data to the collector to increase traffic.
- * ----------
- */
-void
-pgstat_ping(void)
-{
-	PgStat_MsgDummy msg;
-
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
-	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DUMMY);
-	pgstat_send(&msg, sizeof(msg));
-}
-
-/* ----------
- * pgstat_send_inquiry() -
- *
- *	Notify collector that we need fresh data.
- * ----------
- */
-static void
-pgstat_send_inquiry(TimestampTz clock_time, TimestampTz cutoff_time, Oid databaseid)
-{
-	PgStat_MsgInquiry msg;
-
-	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_INQUIRY);
-	msg.clock_time = clock_time;
-	msg.cutoff_time = cutoff_time;
-	msg.databaseid = databaseid;
-	pgstat_send(&msg, sizeof(msg));
-}
-
-
 /*
  * Initialize function call usage data.
  * Called by the executor before invoking a function.
@@ -1764,7 +1697,7 @@ pgstat_initstats(Relation rel)
 		return;
 	}
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (pgStatDSA == NULL || !pgstat_track_counts)
 	{
 		/* We're not counting at all */
 		rel->pgstat_info = NULL;
@@ -2320,7 +2253,7 @@ AtPrepare_PgStat(void)
  *
  * All we need do here is unlink the transaction stats state from the
  * nontransactional state.  The nontransactional action counts will be
- * reported to the stats collector immediately, while the effects on live
+ * reported to the shared statistics immediately, while the effects on live
  * and dead tuple counts are preserved in the 2PC state file.
  *
  * Note: AtEOXact_PgStat is not called during PREPARE.
@@ -2424,25 +2357,41 @@ pgstat_twophase_postabort(TransactionId xid, uint16 info,
  *
  *	Support function for the SQL-callable pgstat* functions. Returns
  *	the collected statistics for one database or NULL. NULL doesn't mean
- *	that the database doesn't exist, it is just not yet known by the
- *	collector, so the caller is better off to report ZERO instead.
+ *	that the database doesn't exist, it is just not yet known to the
+ *	statistics system, so the caller is better off to report ZERO instead.
  * ----------
  */
 PgStat_StatDBEntry *
 pgstat_fetch_stat_dbentry(Oid dbid)
 {
-	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
-	 */
-	backend_read_statsfile();
+	PgStat_SnapshotDBEntry *snapent;
+	bool		found;
+
+	if (pgStatDSA == NULL)
+		return NULL;
 
 	/*
-	 * Lookup the requested database; return NULL if not found
+	 * Copy the entry into our snapshot, if not done yet in this transaction.
 	 */
-	return (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-											  (void *) &dbid,
-											  HASH_FIND, NULL);
+	pgstat_setup_snapshot();
+	snapent = (PgStat_SnapshotDBEntry *) hash_search(pgStatSnapshotDBHash,
+													 (void *) &dbid,
+													 HASH_ENTER, &found);
+	if (!found)
+	{
+		PgStat_StatDBEntry *dbentry;
+
+		snapent->found = false;
+		dbentry = dshash_find(pgStatSharedDBHash, &dbid, false);
+		if (dbentry != NULL)
+		{
+			memcpy(&snapent->stats, dbentry, sizeof(PgStat_StatDBEntry));
+			dshash_release_lock(pgStatSharedDBHash, dbentry);
+			snapent->found = true;
+		}
+	}
+
+	return snapent->found ? &snapent->stats : NULL;
 }
 
 
@@ -2451,85 +2400,110 @@ pgstat_fetch_stat_dbentry(Oid dbid)
  *
  *	Support function for the SQL-callable pgstat* functions. Returns
  *	the collected statistics for one table or NULL. NULL doesn't mean
- *	that the table doesn't exist, it is just not yet known by the
- *	collector, so the caller is better off to report ZERO instead.
+ *	that the table doesn't exist, it is just not yet known to the
+ *	statistics system, so the caller is better off to report ZERO instead.
  * ----------
  */
 PgStat_StatTabEntry *
 pgstat_fetch_stat_tabentry(Oid relid)
 {
-	Oid			dbid;
-	PgStat_StatDBEntry *dbentry;
 	PgStat_StatTabEntry *tabentry;
 
 	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
-	 */
-	backend_read_statsfile();
-
-	/*
-	 * Lookup our database, then look in its table hash table.
+	 * Look in our own database first.  If we don't find it there, maybe it's
+	 * a shared table.
 	 */
-	dbid = MyDatabaseId;
-	dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-												 (void *) &dbid,
-												 HASH_FIND, NULL);
-	if (dbentry != NULL && dbentry->tables != NULL)
-	{
-		tabentry = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-													   (void *) &relid,
-													   HASH_FIND, NULL);
-		if (tabentry)
-			return tabentry;
-	}
-
-	/*
-	 * If we didn't find it, maybe it's a shared table.
-	 */
-	dbid = InvalidOid;
-	dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-												 (void *) &dbid,
-												 HASH_FIND, NULL);
-	if (dbentry != NULL && dbentry->tables != NULL)
-	{
-		tabentry = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-													   (void *) &relid,
-													   HASH_FIND, NULL);
-		if (tabentry)
-			return tabentry;
-	}
+	tabentry = pgstat_fetch_stat_tabentry_extended(false, relid);
+	if (tabentry == NULL)
+		tabentry = pgstat_fetch_stat_tabentry_extended(true, relid);
 
-	return NULL;
+	return tabentry;
 }
 
 
 /* ----------
- * pgstat_fetch_stat_funcentry() -
+ * pgstat_fetch_stat_tabentry_extended() -
  *
- *	Support function for the SQL-callable pgstat* functions. Returns
- *	the collected statistics for one function or NULL.
+ *	Like pgstat_fetch_stat_tabentry(), but for callers that know whether
+ *	the table is a shared catalog or belongs to our database.
  * ----------
  */
-PgStat_StatFuncEntry *
-pgstat_fetch_stat_funcentry(Oid func_id)
+PgStat_StatTabEntry *
+pgstat_fetch_stat_tabentry_extended(bool shared, Oid relid)
 {
-	PgStat_StatDBEntry *dbentry;
-	PgStat_StatFuncEntry *funcentry = NULL;
+	PgStat_StatObjKey key;
+	PgStat_SnapshotTabEntry *snapent;
+	bool		found;
+
+	if (pgStatDSA == NULL)
+		return NULL;
 
-	/* load the stats file if needed */
-	backend_read_statsfile();
+	key.databaseid = shared ? InvalidOid : MyDatabaseId;
+	key.objectid = relid;
 
-	/* Lookup our database, then find the requested function.  */
-	dbentry = pgstat_fetch_stat_dbentry(MyDatabaseId);
-	if (dbentry != NULL && dbentry->functions != NULL)
+	pgstat_setup_snapshot();
+	snapent = (PgStat_SnapshotTabEntry *) hash_search(pgStatSnapshotTabHash,
+													  (void *) &key,
+													  HASH_ENTER, &found);
+	if (!found)
 	{
-		funcentry = (PgStat_StatFuncEntry *) hash_search(dbentry->functions,
-														 (void *) &func_id,
-														 HASH_FIND, NULL);
+		PgStatShared_TabEntry *tabentry;
+
+		snapent->found = false;
+		tabentry = dshash_find(pgStatSharedTabHash, &key, false);
+		if (tabentry != NULL)
+		{
+			memcpy(&snapent->stats, &tabentry->stats,
+				   sizeof(PgStat_StatTabEntry));
+			dshash_release_lock(pgStatSharedTabHash, tabentry);
+			snapent->found = true;
+		}
 	}
 
-	return funcentry;
+	return snapent->found ? &snapent->stats : NULL;
+}
+
+
+/* ----------
+ * pgstat_fetch_stat_funcentry() -
+ *
+ *	Support function for the SQL-callable pgstat* functions. Returns
+ *	the collected statistics for one function or NULL.
+ * ----------
+ */
+PgStat_StatFuncEntry *
+pgstat_fetch_stat_funcentry(Oid func_id)
+{
+	PgStat_StatObjKey key;
+	PgStat_SnapshotFuncEntry *snapent;
+	bool		found;
+
+	if (pgStatDSA == NULL)
+		return NULL;
+
+	key.databaseid = MyDatabaseId;
+	key.objectid = func_id;
+
+	pgstat_setup_snapshot();
+	snapent = (PgStat_SnapshotFuncEntry *) hash_search(pgStatSnapshotFuncHash,
+													   (void *) &key,
+													   HASH_ENTER, &found);
+	if (!found)
+	{
+		PgStatShared_FuncEntry *funcentry;
+
+		snapent->found = false;
+		funcentry = dshash_find(pgStatSharedFuncHash, &key, false);
+		if (funcentry != NULL)
+		{
+			memcpy(&snapent->stats, &funcentry->stats,
+				   sizeof(PgStat_StatFuncEntry));
+			dshash_release_lock(pgStatSharedFuncHash, funcentry);
+			snapent->found = true;
+		}
+	}
+
+	return snapent->found ? &snapent->stats : NULL;
 }
 
 
@@ -2603,7 +2577,21 @@ pgstat_fetch_stat_numbackends(void)
 PgStat_ArchiverStats *
 pgstat_fetch_stat_archiver(void)
 {
-	backend_read_statsfile();
+	pgstat_setup_snapshot();
+
+	if (!archiverStatsValid)
+	{
+		if (pgStatShmem != NULL)
+		{
+			SpinLockAcquire(&pgStatShmem->archiver_lock);
+			memcpy(&archiverStats, &pgStatShmem->archiver_stats,
+				   sizeof(archiverStats));
+			SpinLockRelease(&pgStatShmem->archiver_lock);
+		}
+		else
+			memset(&archiverStats, 0, sizeof(archiverStats));
+		archiverStatsValid = true;
+	}
 
 	return &archiverStats;
 }
@@ -2620,7 +2608,22 @@ pgstat_fetch_stat_archiver(void)
 PgStat_GlobalStats *
 pgstat_fetch_global(void)
 {
-	backend_read_statsfile();
+	pgstat_setup_snapshot();
+
+	if (!globalStatsValid)
+	{
+		if (pgStatShmem != NULL)
+		{
+			SpinLockAcquire(&pgStatShmem->global_lock);
+			memcpy(&globalStats, &pgStatShmem->global_stats,
+				   sizeof(globalStats));
+			SpinLockRelease(&pgStatShmem->global_lock);
+		}
+		else
+			memset(&globalStats, 0, sizeof(globalStats));
+		globalStats.stats_timestamp = pgStatSnapshotTimestamp;
+		globalStatsValid = true;
+	}
 
 	return &globalStats;
 }
@@ -2836,6 +2839,14 @@ pgstat_initialize(void)
 		MyBEEntry = &BackendStatusArray[MaxBackends + MyAuxProcType];
 	}
 
+	/*
+	 * Attach to the shared statistics.  They must be flushed and detached
+	 * before the dynamic shared memory goes away, so that part is done in a
+	 * before_shmem_exit hook.
+	 */
+	pgstat_attach_shmem();
+	before_shmem_exit(pgstat_shutdown_hook, 0);
+
 	/* Set up a process-exit hook to clean up */
 	on_shmem_exit(pgstat_beshutdown_hook, 0);
 }
@@ -3071,28 +3082,37 @@ pgstat_bestart(void)
 }
 
 /*
- * Shut down a single backend's statistics reporting at process exit.
+ * Flush a single backend's statistics before its shared memory goes away.
  *
- * Flush any remaining statistics counts out to the collector.
- * Without this, operations triggered during backend exit (such as
- * temp table deletions) won't be counted.
- *
- * Lastly, clear out our entry in the PgBackendStatus array.
+ * Without this, operations triggered during backend exit (such as temp table
+ * deletions) won't be counted.  Those happen in before_shmem_exit callbacks
+ * registered after ours, so they have already run by the time we get here.
  */
 static void
-pgstat_beshutdown_hook(int code, Datum arg)
+pgstat_shutdown_hook(int code, Datum arg)
 {
-	volatile PgBackendStatus *beentry = MyBEEntry;
-
 	/*
 	 * If we got as far as discovering our own database ID, we can report what
-	 * we did to the collector.  Otherwise, we'd be sending an invalid
-	 * database ID, so forget it.  (This means that accesses to pg_database
-	 * during failed backend starts might never get counted.)
+	 * we did.  Otherwise, we'd be reporting an invalid database ID, so forget
+	 * it.  (This means that accesses to pg_database during failed backend
+	 * starts might never get counted.)
 	 */
 	if (OidIsValid(MyDatabaseId))
 		pgstat_report_stat(true);
 
+	pgstat_detach_shmem();
+}
+
+/*
+ * Shut down a single backend's statistics reporting at process exit.
+ *
+ * Clear out our entry in the PgBackendStatus array.
+ */
+static void
+pgstat_beshutdown_hook(int code, Datum arg)
+{
+	volatile PgBackendStatus *beentry = MyBEEntry;
+
 	/*
 	 * Clear my status entry, following the protocol of bumping st_changecount
 	 * before and after.  We use a volatile pointer here to ensure the
@@ -3363,7 +3383,6 @@ pgstat_read_current_status(void)
 #endif
 	int			i;
 
-	Assert(!pgStatRunningInCollector);
 	if (localBackendStatusTable)
 		return;					/* already done */
 
@@ -3655,12 +3674,12 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_LOGICAL_APPLY_MAIN:
 			event_name = "LogicalApplyMain";
 			break;
+		case WAIT_EVENT_LOGICAL_DECODING_MAIN:
+			event_name = "LogicalDecodingMain";
+			break;
 		case WAIT_EVENT_LOGICAL_LAUNCHER_MAIN:
 			event_name = "LogicalLauncherMain";
 			break;
-		case WAIT_EVENT_PGSTAT_MAIN:
-			event_name = "PgStatMain";
-			break;
 		case WAIT_EVENT_RECOVERY_WAL_ALL:
 			event_name = "RecoveryWalAll";
 			break;
@@ -3744,6 +3763,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 
 	switch (w)
 	{
+		case WAIT_EVENT_APPEND_READY:
+			event_name = "AppendReady";
+			break;
 		case WAIT_EVENT_BGWORKER_SHUTDOWN:
 			event_name = "BgWorkerShutdown";
 			break;
@@ -4318,6 +4340,63 @@ pgstat_get_backend_desc(BackendType backendType)
  */
 
 
+/* ----------
+ * pgstat_attach_shmem() -
+ *
+ *	Attach to the shared statistics hash tables, if not done already.
+ *	The attachment lasts until pgstat_detach_shmem().
+ * ----------
+ */
+static void
+pgstat_attach_shmem(void)
+{
+	MemoryContext oldcontext;
+
+	if (pgStatDSA != NULL)
+		return;
+
+	Assert(pgStatShmem != NULL);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	pgStatDSA = dsa_attach_in_place(PgStatShmemDSAPlace(pgStatShmem), NULL);
+	dsa_pin_mapping(pgStatDSA);
+
+	pgStatSharedDBHash = dshash_attach(pgStatDSA, &dsh_dbparams,
+									   pgStatShmem->db_hash_handle, NULL);
+	pgStatSharedTabHash = dshash_attach(pgStatDSA, &dsh_tabparams,
+										pgStatShmem->tab_hash_handle, NULL);
+	pgStatSharedFuncHash = dshash_attach(pgStatDSA, &dsh_funcparams,
+										 pgStatShmem->func_hash_handle, NULL);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/* ----------
+ * pgstat_detach_shmem() -
+ *
+ *	Detach from the shared statistics hash tables.
+ * ----------
+ */
+static void
+pgstat_detach_shmem(void)
+{
+	if (pgStatDSA == NULL)
+		return;
+
+	dshash_detach(pgStatSharedDBHash);
+	dshash_detach(pgStatSharedTabHash);
+	dshash_detach(pgStatSharedFuncHash);
+	pgStatSharedDBHash = NULL;
+	pgStatSharedTabHash = NULL;
+	pgStatSharedFuncHash = NULL;
+
+	dsa_detach(pgStatDSA);
+	dsa_release_in_place(PgStatShmemDSAPlace(pgStatShmem));
+	pgStatDSA = NULL;
+}
+
+
 /* ----------
  * pgstat_setheader() -
  *
@@ -4334,37 +4413,113 @@ pgstat_setheader(PgStat_MsgHdr *hdr, StatMsgType mtype)
 /* ----------
  * pgstat_send() -
  *
- *		Send out one statistics message to the collector
+ *		Apply one statistics message to the shared statistics
  * ----------
  */
 static void
 pgstat_send(void *msg, int len)
 {
-	int			rc;
+	PgStat_MsgHdr *hdr = (PgStat_MsgHdr *) msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	if (pgStatShmem == NULL)
 		return;
 
-	((PgStat_MsgHdr *) msg)->m_size = len;
+	hdr->m_size = len;
 
-	/* We'll retry after EINTR, but ignore all other failures */
-	do
+	/*
+	 * The cluster-wide statistics can be updated by anyone attached to the
+	 * main shared memory segment; everything else lives in the hash tables.
+	 */
+	switch (hdr->m_type)
 	{
-		rc = send(pgStatSock, msg, len, 0);
-	} while (rc < 0 && errno == EINTR);
+		case PGSTAT_MTYPE_RESETSHAREDCOUNTER:
+			pgstat_apply_resetsharedcounter(msg, len);
+			return;
 
-#ifdef USE_ASSERT_CHECKING
-	/* In debug builds, log send failures ... */
-	if (rc < 0)
-		elog(LOG, "could not send to statistics collector: %m");
-#endif
+		case PGSTAT_MTYPE_ARCHIVER:
+			pgstat_apply_archiver(msg, len);
+			return;
+
+		case PGSTAT_MTYPE_BGWRITER:
+			pgstat_apply_bgwriter(msg, len);
+			return;
+
+		default:
+			break;
+	}
+
+	if (pgStatDSA == NULL)
+		return;
+
+	switch (hdr->m_type)
+	{
+		case PGSTAT_MTYPE_TABSTAT:
+			pgstat_apply_tabstat(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_TABPURGE:
+			pgstat_apply_tabpurge(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_DROPDB:
+			pgstat_apply_dropdb(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_RESETCOUNTER:
+			pgstat_apply_resetcounter(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_RESETSINGLECOUNTER:
+			pgstat_apply_resetsinglecounter(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_AUTOVAC_START:
+			pgstat_apply_autovac(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_VACUUM:
+			pgstat_apply_vacuum(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_ANALYZE:
+			pgstat_apply_analyze(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_FUNCSTAT:
+			pgstat_apply_funcstat(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_FUNCPURGE:
+			pgstat_apply_funcpurge(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_RECOVERYCONFLICT:
+			pgstat_apply_recoveryconflict(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_DEADLOCK:
+			pgstat_apply_deadlock(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_CHECKSUMFAILURE:
+			pgstat_apply_checksum_failure(msg, len);
+			break;
+
+		case PGSTAT_MTYPE_TEMPFILE:
+			pgstat_apply_tempfile(msg, len);
+			break;
+
+		default:
+			elog(ERROR, "unrecognized statistics message type: %d",
+				 (int) hdr->m_type);
+	}
 }
 
 /* ----------
  * pgstat_send_archiver() -
  *
- *	Tell the collector about the WAL file that we successfully
- *	archived or failed to archive.
+ *	Report the WAL file that we successfully archived or failed to
+ *	archive.
  * ----------
  */
 void
@@ -4385,7 +4540,7 @@ pgstat_send_archiver(const char *xlog, bool failed)
 /* ----------
  * pgstat_send_bgwriter() -
  *
- *		Send bgwriter statistics to the collector
+ *		Add the pending bgwriter statistics to the shared statistics
  * ----------
  */
 void
@@ -4396,8 +4551,7 @@ pgstat_send_bgwriter(void)
 
 	/*
 	 * This function can be called even if nothing at all has happened. In
-	 * this case, avoid sending a completely empty message to the stats
-	 * collector.
+	 * this case, don't bother taking the lock.
 	 */
 	if (memcmp(&BgWriterStats, &all_zeroes, sizeof(PgStat_MsgBgWriter)) == 0)
 		return;
@@ -4414,307 +4568,12 @@ pgstat_send_bgwriter(void)
 	MemSet(&BgWriterStats, 0, sizeof(BgWriterStats));
 }
 
-
-/* ----------
- * PgstatCollectorMain() -
- *
- *	Start up the statistics collector process.  This is the body of the
- *	postmaster child process.
- *
- *	The argc/argv parameters are valid only in EXEC_BACKEND case.
- * ----------
- */
-NON_EXEC_STATIC void
-PgstatCollectorMain(int argc, char *argv[])
-{
-	int			len;
-	PgStat_Msg	msg;
-	int			wr;
-
-	/*
-	 * Ignore all signals usually bound to some action in the postmaster,
-	 * except SIGHUP and SIGQUIT.  Note we don't need a SIGUSR1 handler to
-	 * support latch operations, because we only use a local latch.
-	 */
-	pqsignal(SIGHUP, pgstat_sighup_handler);
-	pqsignal(SIGINT, SIG_IGN);
-	pqsignal(SIGTERM, SIG_IGN);
-	pqsignal(SIGQUIT, pgstat_exit);
-	pqsignal(SIGALRM, SIG_IGN);
-	pqsignal(SIGPIPE, SIG_IGN);
-	pqsignal(SIGUSR1, SIG_IGN);
-	pqsignal(SIGUSR2, SIG_IGN);
-	/* Reset some signals that are accepted by postmaster but not here */
-	pqsignal(SIGCHLD, SIG_DFL);
-	PG_SETMASK(&UnBlockSig);
-
-	/*
-	 * Identify myself via ps
-	 */
-	init_ps_display("stats collector", "", "", "");
-
-	/*
-	 * Read in existing stats files or initialize the stats to zero.
-	 */
-	pgStatRunningInCollector = true;
-	pgStatDBHash = pgstat_read_statsfiles(InvalidOid, true, true);
-
-	/*
-	 * Loop to process messages until we get SIGQUIT or detect ungraceful
-	 * death of our parent postmaster.
-	 *
-	 * For performance reasons, we don't want to do ResetLatch/WaitLatch after
-	 * every message; instead, do that only after a recv() fails to obtain a
-	 * message.  (This effectively means that if backends are sending us stuff
-	 * like mad, we won't notice postmaster death until things slack off a
-	 * bit; which seems fine.)	To do that, we have an inner loop that
-	 * iterates as long as recv() succeeds.  We do recognize got_SIGHUP inside
-	 * the inner loop, which means that such interrupts will get serviced but
-	 * the latch won't get cleared until next time there is a break in the
-	 * action.
-	 */
-	for (;;)
-	{
-		/* Clear any already-pending wakeups */
-		ResetLatch(MyLatch);
-
-		/*
-		 * Quit if we get SIGQUIT from the postmaster.
-		 */
-		if (need_exit)
-			break;
-
-		/*
-		 * Inner loop iterates as long as we keep getting messages, or until
-		 * need_exit becomes set.
-		 */
-		while (!need_exit)
-		{
-			/*
-			 * Reload configuration if we got SIGHUP from the postmaster.
-			 */
-			if (got_SIGHUP)
-			{
-				got_SIGHUP = false;
-				ProcessConfigFile(PGC_SIGHUP);
-			}
-
-			/*
-			 * Write the stats file(s) if a new request has arrived that is
-			 * not satisfied by existing file(s).
-			 */
-			if (pgstat_write_statsfile_needed())
-				pgstat_write_statsfiles(false, false);
-
-			/*
-			 * Try to receive and process a message.  This will not block,
-			 * since the socket is set to non-blocking mode.
-			 *
-			 * XXX On Windows, we have to force pgwin32_recv to cooperate,
-			 * despite the previous use of pg_set_noblock() on the socket.
-			 * This is extremely broken and should be fixed someday.
-			 */
-#ifdef WIN32
-			pgwin32_noblock = 1;
-#endif
-
-			len = recv(pgStatSock, (char *) &msg,
-					   sizeof(PgStat_Msg), 0);
-
-#ifdef WIN32
-			pgwin32_noblock = 0;
-#endif
-
-			if (len < 0)
-			{
-				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
-					break;		/* out of inner loop */
-				ereport(ERROR,
-						(errcode_for_socket_access(),
-						 errmsg("could not read statistics message: %m")));
-			}
-
-			/*
-			 * We ignore messages that are smaller than our common header
-			 */
-			if (len < sizeof(PgStat_MsgHdr))
-				continue;
-
-			/*
-			 * The received length must match the length in the header
-			 */
-			if (msg.msg_hdr.m_size != len)
-				continue;
-
-			/*
-			 * O.K. - we accept this message.  Process it.
-			 */
-			switch (msg.msg_hdr.m_type)
-			{
-				case PGSTAT_MTYPE_DUMMY:
-					break;
-
-				case PGSTAT_MTYPE_INQUIRY:
-					pgstat_recv_inquiry(&msg.msg_inquiry, len);
-					break;
-
-				case PGSTAT_MTYPE_TABSTAT:
-					pgstat_recv_tabstat(&msg.msg_tabstat, len);
-					break;
-
-				case PGSTAT_MTYPE_TABPURGE:
-					pgstat_recv_tabpurge(&msg.msg_tabpurge, len);
-					break;
-
-				case PGSTAT_MTYPE_DROPDB:
-					pgstat_recv_dropdb(&msg.msg_dropdb, len);
-					break;
-
-				case PGSTAT_MTYPE_RESETCOUNTER:
-					pgstat_recv_resetcounter(&msg.msg_resetcounter, len);
-					break;
-
-				case PGSTAT_MTYPE_RESETSHAREDCOUNTER:
-					pgstat_recv_resetsharedcounter(
-												   &msg.msg_resetsharedcounter,
-												   len);
-					break;
-
-				case PGSTAT_MTYPE_RESETSINGLECOUNTER:
-					pgstat_recv_resetsinglecounter(
-												   &msg.msg_resetsinglecounter,
-												   len);
-					break;
-
-				case PGSTAT_MTYPE_AUTOVAC_START:
-					pgstat_recv_autovac(&msg.msg_autovacuum_start, len);
-					break;
-
-				case PGSTAT_MTYPE_VACUUM:
-					pgstat_recv_vacuum(&msg.msg_vacuum, len);
-					break;
-
-				case PGSTAT_MTYPE_ANALYZE:
-					pgstat_recv_analyze(&msg.msg_analyze, len);
-					break;
-
-				case PGSTAT_MTYPE_ARCHIVER:
-					pgstat_recv_archiver(&msg.msg_archiver, len);
-					break;
-
-				case PGSTAT_MTYPE_BGWRITER:
-					pgstat_recv_bgwriter(&msg.msg_bgwriter, len);
-					break;
-
-				case PGSTAT_MTYPE_FUNCSTAT:
-					pgstat_recv_funcstat(&msg.msg_funcstat, len);
-					break;
-
-				case PGSTAT_MTYPE_FUNCPURGE:
-					pgstat_recv_funcpurge(&msg.msg_funcpurge, len);
-					break;
-
-				case PGSTAT_MTYPE_RECOVERYCONFLICT:
-					pgstat_recv_recoveryconflict(
-												 &msg.msg_recoveryconflict,
-												 len);
-					break;
-
-				case PGSTAT_MTYPE_DEADLOCK:
-					pgstat_recv_deadlock(&msg.msg_deadlock, len);
-					break;
-
-				case PGSTAT_MTYPE_TEMPFILE:
-					pgstat_recv_tempfile(&msg.msg_tempfile, len);
-					break;
-
-				case PGSTAT_MTYPE_CHECKSUMFAILURE:
-					pgstat_recv_checksum_failure(
-												 &msg.msg_checksumfailure,
-												 len);
-					break;
-
-				default:
-					break;
-			}
-		}						/* end of inner message-processing loop */
-
-		/* Sleep until there's something to do */
-#ifndef WIN32
-		wr = WaitLatchOrSocket(MyLatch,
-							   WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_SOCKET_READABLE,
-							   pgStatSock, -1L,
-							   WAIT_EVENT_PGSTAT_MAIN);
-#else
-
-		/*
-		 * Windows, at least in its Windows Server 2003 R2 incarnation,
-		 * sometimes loses FD_READ events.  Waking up and retrying the recv()
-		 * fixes that, so don't sleep indefinitely.  This is a crock of the
-		 * first water, but until somebody wants to debug exactly what's
-		 * happening there, this is the best we can do.  The two-second
-		 * timeout matches our pre-9.2 behavior, and needs to be short enough
-		 * to not provoke "using stale statistics" complaints from
-		 * backend_read_statsfile.
-		 */
-		wr = WaitLatchOrSocket(MyLatch,
-							   WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_SOCKET_READABLE | WL_TIMEOUT,
-							   pgStatSock,
-							   2 * 1000L /* msec */ ,
-							   WAIT_EVENT_PGSTAT_MAIN);
-#endif
-
-		/*
-		 * Emergency bailout if postmaster has died.  This is to avoid the
-		 * necessity for manual cleanup of all postmaster children.
-		 */
-		if (wr & WL_POSTMASTER_DEATH)
-			break;
-	}							/* end of outer loop */
-
-	/*
-	 * Save the final stats to reuse at next startup.
-	 */
-	pgstat_write_statsfiles(true, true);
-
-	exit(0);
-}
-
-
-/* SIGQUIT signal handler for collector process */
-static void
-pgstat_exit(SIGNAL_ARGS)
-{
-	int			save_errno = errno;
-
-	need_exit = true;
-	SetLatch(MyLatch);
-
-	errno = save_errno;
-}
-
-/* SIGHUP handler for collector process */
-static void
-pgstat_sighup_handler(SIGNAL_ARGS)
-{
-	int			save_errno = errno;
-
-	got_SIGHUP = true;
-	SetLatch(MyLatch);
-
-	errno = save_errno;
-}
-
 /*
  * Subroutine to clear stats in a database entry
- *
- * Tables and functions hashes are initialized to empty.
  */
 static void
 reset_dbentry_counters(PgStat_StatDBEntry *dbentry)
 {
-	HASHCTL		hash_ctl;
-
 	dbentry->n_xact_commit = 0;
 	dbentry->n_xact_rollback = 0;
 	dbentry->n_blocks_fetched = 0;
@@ -4739,1030 +4598,162 @@ reset_dbentry_counters(PgStat_StatDBEntry *dbentry)
 	dbentry->n_block_write_time = 0;
 
 	dbentry->stat_reset_timestamp = GetCurrentTimestamp();
-	dbentry->stats_timestamp = 0;
-
-	memset(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatTabEntry);
-	dbentry->tables = hash_create("Per-database table",
-								  PGSTAT_TAB_HASH_SIZE,
-								  &hash_ctl,
-								  HASH_ELEM | HASH_BLOBS);
-
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatFuncEntry);
-	dbentry->functions = hash_create("Per-database function",
-									 PGSTAT_FUNCTION_HASH_SIZE,
-									 &hash_ctl,
-									 HASH_ELEM | HASH_BLOBS);
-}
-
-/*
- * Lookup the hash table entry for the specified database. If no hash
- * table entry exists, initialize it, if the create parameter is true.
- * Else, return NULL.
- */
-static PgStat_StatDBEntry *
-pgstat_get_db_entry(Oid databaseid, bool create)
-{
-	PgStat_StatDBEntry *result;
-	bool		found;
-	HASHACTION	action = (create ? HASH_ENTER : HASH_FIND);
-
-	/* Lookup or create the hash table entry for this database */
-	result = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-												&databaseid,
-												action, &found);
-
-	if (!create && !found)
-		return NULL;
-
-	/*
-	 * If not found, initialize the new one.  This creates empty hash tables
-	 * for tables and functions, too.
-	 */
-	if (!found)
-		reset_dbentry_counters(result);
-
-	return result;
 }
 
-
 /*
- * Lookup the hash table entry for the specified table. If no hash
- * table entry exists, initialize it, if the create parameter is true.
+ * Lookup the shared hash table entry for the specified database.  If no
+ * hash table entry exists, initialize it, if the create parameter is true.
  * Else, return NULL.
- */
-static PgStat_StatTabEntry *
-pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry, Oid tableoid, bool create)
-{
-	PgStat_StatTabEntry *result;
-	bool		found;
-	HASHACTION	action = (create ? HASH_ENTER : HASH_FIND);
-
-	/* Lookup or create the hash table entry for this table */
-	result = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-												 &tableoid,
-												 action, &found);
-
-	if (!create && !found)
-		return NULL;
-
-	/* If not found, initialize the new one. */
-	if (!found)
-	{
-		result->numscans = 0;
-		result->tuples_returned = 0;
-		result->tuples_fetched = 0;
-		result->tuples_inserted = 0;
-		result->tuples_updated = 0;
-		result->tuples_deleted = 0;
-		result->tuples_hot_updated = 0;
-		result->n_live_tuples = 0;
-		result->n_dead_tuples = 0;
-		result->changes_since_analyze = 0;
-		result->blocks_fetched = 0;
-		result->blocks_hit = 0;
-		result->vacuum_timestamp = 0;
-		result->vacuum_count = 0;
-		result->autovac_vacuum_timestamp = 0;
-		result->autovac_vacuum_count = 0;
-		result->analyze_timestamp = 0;
-		result->analyze_count = 0;
-		result->autovac_analyze_timestamp = 0;
-		result->autovac_analyze_count = 0;
-	}
-
-	return result;
-}
-
-
-/* ----------
- * pgstat_write_statsfiles() -
- *		Write the global statistics file, as well as requested DB files.
- *
- *	'permanent' specifies writing to the permanent files not temporary ones.
- *	When true (happens only when the collector is shutting down), also remove
- *	the temporary files so that backends starting up under a new postmaster
- *	can't read old data before the new collector is ready.
- *
- *	When 'allDbs' is false, only the requested databases (listed in
- *	pending_write_requests) will be written; otherwise, all databases
- *	will be written.
- * ----------
- */
-static void
-pgstat_write_statsfiles(bool permanent, bool allDbs)
-{
-	HASH_SEQ_STATUS hstat;
-	PgStat_StatDBEntry *dbentry;
-	FILE	   *fpout;
-	int32		format_id;
-	const char *tmpfile = permanent ? PGSTAT_STAT_PERMANENT_TMPFILE : pgstat_stat_tmpname;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
-	int			rc;
-
-	elog(DEBUG2, "writing stats file \"%s\"", statfile);
-
-	/*
-	 * Open the statistics temp file to write out the current values.
-	 */
-	fpout = AllocateFile(tmpfile, PG_BINARY_W);
-	if (fpout == NULL)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not open temporary statistics file \"%s\": %m",
-						tmpfile)));
-		return;
-	}
-
-	/*
-	 * Set the timestamp of the stats file.
-	 */
-	globalStats.stats_timestamp = GetCurrentTimestamp();
-
-	/*
-	 * Write the file header --- currently just a format ID.
-	 */
-	format_id = PGSTAT_FILE_FORMAT_ID;
-	rc = fwrite(&format_id, sizeof(format_id), 1, fpout);
-	(void) rc;					/* we'll check for error with ferror */
-
-	/*
-	 * Write global stats struct
-	 */
-	rc = fwrite(&globalStats, sizeof(globalStats), 1, fpout);
-	(void) rc;					/* we'll check for error with ferror */
-
-	/*
-	 * Write archiver stats struct
-	 */
-	rc = fwrite(&archiverStats, sizeof(archiverStats), 1, fpout);
-	(void) rc;					/* we'll check for error with ferror */
-
-	/*
-	 * Walk through the database table.
-	 */
-	hash_seq_init(&hstat, pgStatDBHash);
-	while ((dbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
-	{
-		/*
-		 * Write out the table and function stats for this DB into the
-		 * appropriate per-DB stat file, if required.
-		 */
-		if (allDbs || pgstat_db_requested(dbentry->databaseid))
-		{
-			/* Make DB's timestamp consistent with the global stats */
-			dbentry->stats_timestamp = globalStats.stats_timestamp;
-
-			pgstat_write_db_statsfile(dbentry, permanent);
-		}
-
-		/*
-		 * Write out the DB entry. We don't write the tables or functions
-		 * pointers, since they're of no use to any other process.
-		 */
-		fputc('D', fpout);
-		rc = fwrite(dbentry, offsetof(PgStat_StatDBEntry, tables), 1, fpout);
-		(void) rc;				/* we'll check for error with ferror */
-	}
-
-	/*
-	 * No more output to be done. Close the temp file and replace the old
-	 * pgstat.stat with it.  The ferror() check replaces testing for error
-	 * after each individual fputc or fwrite above.
-	 */
-	fputc('E', fpout);
-
-	if (ferror(fpout))
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write temporary statistics file \"%s\": %m",
-						tmpfile)));
-		FreeFile(fpout);
-		unlink(tmpfile);
-	}
-	else if (FreeFile(fpout) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not close temporary statistics file \"%s\": %m",
-						tmpfile)));
-		unlink(tmpfile);
-	}
-	else if (rename(tmpfile, statfile) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not rename temporary statistics file \"%s\" to \"%s\": %m",
-						tmpfile, statfile)));
-		unlink(tmpfile);
-	}
-
-	if (permanent)
-		unlink(pgstat_stat_filename);
-
-	/*
-	 * Now throw away the list of requests.  Note that requests sent after we
-	 * started the write are still waiting on the network socket.
-	 */
-	list_free(pending_write_requests);
-	pending_write_requests = NIL;
-}
-
-/*
- * return the filename for a DB stat file; filename is the output buffer,
- * of length len.
- */
-static void
-get_dbstat_filename(bool permanent, bool tempname, Oid databaseid,
-					char *filename, int len)
-{
-	int			printed;
-
-	/* NB -- pgstat_reset_remove_files knows about the pattern this uses */
-	printed = snprintf(filename, len, "%s/db_%u.%s",
-					   permanent ? PGSTAT_STAT_PERMANENT_DIRECTORY :
-					   pgstat_stat_directory,
-					   databaseid,
-					   tempname ? "tmp" : "stat");
-	if (printed >= len)
-		elog(ERROR, "overlength pgstat path");
-}
-
-/* ----------
- * pgstat_write_db_statsfile() -
- *		Write the stat file for a single database.
- *
- *	If writing to the permanent file (happens when the collector is
- *	shutting down only), remove the temporary file so that backends
- *	starting up under a new postmaster can't read the old data before
- *	the new collector is ready.
- * ----------
- */
-static void
-pgstat_write_db_statsfile(PgStat_StatDBEntry *dbentry, bool permanent)
-{
-	HASH_SEQ_STATUS tstat;
-	HASH_SEQ_STATUS fstat;
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatFuncEntry *funcentry;
-	FILE	   *fpout;
-	int32		format_id;
-	Oid			dbid = dbentry->databaseid;
-	int			rc;
-	char		tmpfile[MAXPGPATH];
-	char		statfile[MAXPGPATH];
-
-	get_dbstat_filename(permanent, true, dbid, tmpfile, MAXPGPATH);
-	get_dbstat_filename(permanent, false, dbid, statfile, MAXPGPATH);
-
-	elog(DEBUG2, "writing stats file \"%s\"", statfile);
-
-	/*
-	 * Open the statistics temp file to write out the current values.
-	 */
-	fpout = AllocateFile(tmpfile, PG_BINARY_W);
-	if (fpout == NULL)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not open temporary statistics file \"%s\": %m",
-						tmpfile)));
-		return;
-	}
-
-	/*
-	 * Write the file header --- currently just a format ID.
-	 */
-	format_id = PGSTAT_FILE_FORMAT_ID;
-	rc = fwrite(&format_id, sizeof(format_id), 1, fpout);
-	(void) rc;					/* we'll check for error with ferror */
-
-	/*
-	 * Walk through the database's access stats per table.
-	 */
-	hash_seq_init(&tstat, dbentry->tables);
-	while ((tabentry = (PgStat_StatTabEntry *) hash_seq_search(&tstat)) != NULL)
-	{
-		fputc('T', fpout);
-		rc = fwrite(tabentry, sizeof(PgStat_StatTabEntry), 1, fpout);
-		(void) rc;				/* we'll check for error with ferror */
-	}
-
-	/*
-	 * Walk through the database's function stats table.
-	 */
-	hash_seq_init(&fstat, dbentry->functions);
-	while ((funcentry = (PgStat_StatFuncEntry *) hash_seq_search(&fstat)) != NULL)
-	{
-		fputc('F', fpout);
-		rc = fwrite(funcentry, sizeof(PgStat_StatFuncEntry), 1, fpout);
-		(void) rc;				/* we'll check for error with ferror */
-	}
-
-	/*
-	 * No more output to be done. Close the temp file and replace the old
-	 * pgstat.stat with it.  The ferror() check replaces testing for error
-	 * after each individual fputc or fwrite above.
-	 */
-	fputc('E', fpout);
-
-	if (ferror(fpout))
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write temporary statistics file \"%s\": %m",
-						tmpfile)));
-		FreeFile(fpout);
-		unlink(tmpfile);
-	}
-	else if (FreeFile(fpout) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not close temporary statistics file \"%s\": %m",
-						tmpfile)));
-		unlink(tmpfile);
-	}
-	else if (rename(tmpfile, statfile) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not rename temporary statistics file \"%s\" to \"%s\": %m",
-						tmpfile, statfile)));
-		unlink(tmpfile);
-	}
-
-	if (permanent)
-	{
-		get_dbstat_filename(false, false, dbid, statfile, MAXPGPATH);
-
-		elog(DEBUG2, "removing temporary stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
-}
-
-/* ----------
- * pgstat_read_statsfiles() -
- *
- *	Reads in some existing statistics collector files and returns the
- *	databases hash table that is the top level of the data.
- *
- *	If 'onlydb' is not InvalidOid, it means we only want data for that DB
- *	plus the shared catalogs ("DB 0").  We'll still populate the DB hash
- *	table for all databases, but we don't bother even creating table/function
- *	hash tables for other databases.
- *
- *	'permanent' specifies reading from the permanent files not temporary ones.
- *	When true (happens only when the collector is starting up), remove the
- *	files after reading; the in-memory status is now authoritative, and the
- *	files would be out of date in case somebody else reads them.
- *
- *	If a 'deep' read is requested, table/function stats are read, otherwise
- *	the table/function hash tables remain empty.
- * ----------
- */
-static HTAB *
-pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
-{
-	PgStat_StatDBEntry *dbentry;
-	PgStat_StatDBEntry dbbuf;
-	HASHCTL		hash_ctl;
-	HTAB	   *dbhash;
-	FILE	   *fpin;
-	int32		format_id;
-	bool		found;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
-
-	/*
-	 * The tables will live in pgStatLocalContext.
-	 */
-	pgstat_setup_memcxt();
-
-	/*
-	 * Create the DB hashtable
-	 */
-	memset(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatDBEntry);
-	hash_ctl.hcxt = pgStatLocalContext;
-	dbhash = hash_create("Databases hash", PGSTAT_DB_HASH_SIZE, &hash_ctl,
-						 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-	/*
-	 * Clear out global and archiver statistics so they start from zero in
-	 * case we can't load an existing statsfile.
-	 */
-	memset(&globalStats, 0, sizeof(globalStats));
-	memset(&archiverStats, 0, sizeof(archiverStats));
-
-	/*
-	 * Set the current timestamp (will be kept only in case we can't load an
-	 * existing statsfile).
-	 */
-	globalStats.stat_reset_timestamp = GetCurrentTimestamp();
-	archiverStats.stat_reset_timestamp = globalStats.stat_reset_timestamp;
-
-	/*
-	 * Try to open the stats file. If it doesn't exist, the backends simply
-	 * return zero for anything and the collector simply starts from scratch
-	 * with empty counters.
-	 *
-	 * ENOENT is a possibility if the stats collector is not running or has
-	 * not yet written the stats file the first time.  Any other failure
-	 * condition is suspicious.
-	 */
-	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
-	{
-		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not open statistics file \"%s\": %m",
-							statfile)));
-		return dbhash;
-	}
-
-	/*
-	 * Verify it's of the expected format.
-	 */
-	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
-		format_id != PGSTAT_FILE_FORMAT_ID)
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * Read global stats struct
-	 */
-	if (fread(&globalStats, 1, sizeof(globalStats), fpin) != sizeof(globalStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		memset(&globalStats, 0, sizeof(globalStats));
-		goto done;
-	}
-
-	/*
-	 * In the collector, disregard the timestamp we read from the permanent
-	 * stats file; we should be willing to write a temp stats file immediately
-	 * upon the first request from any backend.  This only matters if the old
-	 * file's timestamp is less than PGSTAT_STAT_INTERVAL ago, but that's not
-	 * an unusual scenario.
-	 */
-	if (pgStatRunningInCollector)
-		globalStats.stats_timestamp = 0;
-
-	/*
-	 * Read archiver stats struct
-	 */
-	if (fread(&archiverStats, 1, sizeof(archiverStats), fpin) != sizeof(archiverStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		memset(&archiverStats, 0, sizeof(archiverStats));
-		goto done;
-	}
-
-	/*
-	 * We found an existing collector stats file. Read it and put all the
-	 * hashtable entries into place.
-	 */
-	for (;;)
-	{
-		switch (fgetc(fpin))
-		{
-				/*
-				 * 'D'	A PgStat_StatDBEntry struct describing a database
-				 * follows.
-				 */
-			case 'D':
-				if (fread(&dbbuf, 1, offsetof(PgStat_StatDBEntry, tables),
-						  fpin) != offsetof(PgStat_StatDBEntry, tables))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Add to the DB hash
-				 */
-				dbentry = (PgStat_StatDBEntry *) hash_search(dbhash,
-															 (void *) &dbbuf.databaseid,
-															 HASH_ENTER,
-															 &found);
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(dbentry, &dbbuf, sizeof(PgStat_StatDBEntry));
-				dbentry->tables = NULL;
-				dbentry->functions = NULL;
-
-				/*
-				 * In the collector, disregard the timestamp we read from the
-				 * permanent stats file; we should be willing to write a temp
-				 * stats file immediately upon the first request from any
-				 * backend.
-				 */
-				if (pgStatRunningInCollector)
-					dbentry->stats_timestamp = 0;
-
-				/*
-				 * Don't create tables/functions hashtables for uninteresting
-				 * databases.
-				 */
-				if (onlydb != InvalidOid)
-				{
-					if (dbbuf.databaseid != onlydb &&
-						dbbuf.databaseid != InvalidOid)
-						break;
-				}
-
-				memset(&hash_ctl, 0, sizeof(hash_ctl));
-				hash_ctl.keysize = sizeof(Oid);
-				hash_ctl.entrysize = sizeof(PgStat_StatTabEntry);
-				hash_ctl.hcxt = pgStatLocalContext;
-				dbentry->tables = hash_create("Per-database table",
-											  PGSTAT_TAB_HASH_SIZE,
-											  &hash_ctl,
-											  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-				hash_ctl.keysize = sizeof(Oid);
-				hash_ctl.entrysize = sizeof(PgStat_StatFuncEntry);
-				hash_ctl.hcxt = pgStatLocalContext;
-				dbentry->functions = hash_create("Per-database function",
-												 PGSTAT_FUNCTION_HASH_SIZE,
-												 &hash_ctl,
-												 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-				/*
-				 * If requested, read the data from the database-specific
-				 * file.  Otherwise we just leave the hashtables empty.
-				 */
-				if (deep)
-					pgstat_read_db_statsfile(dbentry->databaseid,
-											 dbentry->tables,
-											 dbentry->functions,
-											 permanent);
-
-				break;
-
-			case 'E':
-				goto done;
-
-			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
-						(errmsg("corrupted statistics file \"%s\"",
-								statfile)));
-				goto done;
-		}
-	}
-
-done:
-	FreeFile(fpin);
-
-	/* If requested to read the permanent file, also get rid of it. */
-	if (permanent)
-	{
-		elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
-
-	return dbhash;
-}
-
-
-/* ----------
- * pgstat_read_db_statsfile() -
- *
- *	Reads in the existing statistics collector file for the given database,
- *	filling the passed-in tables and functions hash tables.
- *
- *	As in pgstat_read_statsfiles, if the permanent file is requested, it is
- *	removed after reading.
- *
- *	Note: this code has the ability to skip storing per-table or per-function
- *	data, if NULL is passed for the corresponding hashtable.  That's not used
- *	at the moment though.
- * ----------
- */
-static void
-pgstat_read_db_statsfile(Oid databaseid, HTAB *tabhash, HTAB *funchash,
-						 bool permanent)
-{
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatTabEntry tabbuf;
-	PgStat_StatFuncEntry funcbuf;
-	PgStat_StatFuncEntry *funcentry;
-	FILE	   *fpin;
-	int32		format_id;
-	bool		found;
-	char		statfile[MAXPGPATH];
-
-	get_dbstat_filename(permanent, false, databaseid, statfile, MAXPGPATH);
-
-	/*
-	 * Try to open the stats file. If it doesn't exist, the backends simply
-	 * return zero for anything and the collector simply starts from scratch
-	 * with empty counters.
-	 *
-	 * ENOENT is a possibility if the stats collector is not running or has
-	 * not yet written the stats file the first time.  Any other failure
-	 * condition is suspicious.
-	 */
-	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
-	{
-		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not open statistics file \"%s\": %m",
-							statfile)));
-		return;
-	}
-
-	/*
-	 * Verify it's of the expected format.
-	 */
-	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
-		format_id != PGSTAT_FILE_FORMAT_ID)
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * We found an existing collector stats file. Read it and put all the
-	 * hashtable entries into place.
-	 */
-	for (;;)
-	{
-		switch (fgetc(fpin))
-		{
-				/*
-				 * 'T'	A PgStat_StatTabEntry follows.
-				 */
-			case 'T':
-				if (fread(&tabbuf, 1, sizeof(PgStat_StatTabEntry),
-						  fpin) != sizeof(PgStat_StatTabEntry))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Skip if table data not wanted.
-				 */
-				if (tabhash == NULL)
-					break;
-
-				tabentry = (PgStat_StatTabEntry *) hash_search(tabhash,
-															   (void *) &tabbuf.tableid,
-															   HASH_ENTER, &found);
-
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(tabentry, &tabbuf, sizeof(tabbuf));
-				break;
-
-				/*
-				 * 'F'	A PgStat_StatFuncEntry follows.
-				 */
-			case 'F':
-				if (fread(&funcbuf, 1, sizeof(PgStat_StatFuncEntry),
-						  fpin) != sizeof(PgStat_StatFuncEntry))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Skip if function data not wanted.
-				 */
-				if (funchash == NULL)
-					break;
-
-				funcentry = (PgStat_StatFuncEntry *) hash_search(funchash,
-																 (void *) &funcbuf.functionid,
-																 HASH_ENTER, &found);
-
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(funcentry, &funcbuf, sizeof(funcbuf));
-				break;
-
-				/*
-				 * 'E'	The EOF marker of a complete stats file.
-				 */
-			case 'E':
-				goto done;
-
-			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
-						(errmsg("corrupted statistics file \"%s\"",
-								statfile)));
-				goto done;
-		}
-	}
-
-done:
-	FreeFile(fpin);
-
-	if (permanent)
-	{
-		elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
-}
-
-/* ----------
- * pgstat_read_db_statsfile_timestamp() -
- *
- *	Attempt to determine the timestamp of the last db statfile write.
- *	Returns true if successful; the timestamp is stored in *ts.
- *
- *	This needs to be careful about handling databases for which no stats file
- *	exists, such as databases without a stat entry or those not yet written:
- *
- *	- if there's a database entry in the global file, return the corresponding
- *	stats_timestamp value.
- *
- *	- if there's no db stat entry (e.g. for a new or inactive database),
- *	there's no stats_timestamp value, but also nothing to write so we return
- *	the timestamp of the global statfile.
- * ----------
- */
-static bool
-pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
-								   TimestampTz *ts)
-{
-	PgStat_StatDBEntry dbentry;
-	PgStat_GlobalStats myGlobalStats;
-	PgStat_ArchiverStats myArchiverStats;
-	FILE	   *fpin;
-	int32		format_id;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
-
-	/*
-	 * Try to open the stats file.  As above, anything but ENOENT is worthy of
-	 * complaining about.
-	 */
-	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
-	{
-		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not open statistics file \"%s\": %m",
-							statfile)));
-		return false;
-	}
-
-	/*
-	 * Verify it's of the expected format.
-	 */
-	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
-		format_id != PGSTAT_FILE_FORMAT_ID)
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
-	}
-
-	/*
-	 * Read global stats struct
-	 */
-	if (fread(&myGlobalStats, 1, sizeof(myGlobalStats),
-			  fpin) != sizeof(myGlobalStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
-	}
-
-	/*
-	 * Read archiver stats struct
-	 */
-	if (fread(&myArchiverStats, 1, sizeof(myArchiverStats),
-			  fpin) != sizeof(myArchiverStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
-	}
-
-	/* By default, we're going to return the timestamp of the global file. */
-	*ts = myGlobalStats.stats_timestamp;
-
-	/*
-	 * We found an existing collector stats file.  Read it and look for a
-	 * record for the requested database.  If found, use its timestamp.
-	 */
-	for (;;)
-	{
-		switch (fgetc(fpin))
-		{
-				/*
-				 * 'D'	A PgStat_StatDBEntry struct describing a database
-				 * follows.
-				 */
-			case 'D':
-				if (fread(&dbentry, 1, offsetof(PgStat_StatDBEntry, tables),
-						  fpin) != offsetof(PgStat_StatDBEntry, tables))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * If this is the DB we're looking for, save its timestamp and
-				 * we're done.
-				 */
-				if (dbentry.databaseid == databaseid)
-				{
-					*ts = dbentry.stats_timestamp;
-					goto done;
-				}
+ *
+ * The entry is returned locked exclusively; the caller must release it with
+ * dshash_release_lock() before looking up any other entry.
+ */
+static PgStat_StatDBEntry *
+pgstat_get_db_entry(Oid databaseid, bool create)
+{
+	PgStat_StatDBEntry *result;
+	bool		found;
 
-				break;
+	if (!create)
+		return (PgStat_StatDBEntry *)
+			dshash_find(pgStatSharedDBHash, &databaseid, true);
 
-			case 'E':
-				goto done;
+	result = (PgStat_StatDBEntry *)
+		dshash_find_or_insert(pgStatSharedDBHash, &databaseid, &found);
 
-			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
-						(errmsg("corrupted statistics file \"%s\"",
-								statfile)));
-				goto done;
-		}
-	}
+	/* If not found, initialize the new one. */
+	if (!found)
+		reset_dbentry_counters(result);
 
-done:
-	FreeFile(fpin);
-	return true;
+	return result;
 }
 
+
 /*
- * If not already done, read the statistics collector stats file into
- * some hash tables.  The results will be kept until pgstat_clear_snapshot()
- * is called (typically, at end of transaction).
+ * Lookup the shared hash table entry for the specified table, as
+ * pgstat_get_db_entry() does for databases.
  */
-static void
-backend_read_statsfile(void)
+static PgStatShared_TabEntry *
+pgstat_get_tab_entry(Oid databaseid, Oid tableoid, bool create)
 {
-	TimestampTz min_ts = 0;
-	TimestampTz ref_ts = 0;
-	Oid			inquiry_db;
-	int			count;
+	PgStatShared_TabEntry *result;
+	PgStat_StatObjKey key;
+	bool		found;
 
-	/* already read it? */
-	if (pgStatDBHash)
-		return;
-	Assert(!pgStatRunningInCollector);
+	key.databaseid = databaseid;
+	key.objectid = tableoid;
 
-	/*
-	 * In a normal backend, we check staleness of the data for our own DB, and
-	 * so we send MyDatabaseId in inquiry messages.  In the autovac launcher,
-	 * check staleness of the shared-catalog data, and send InvalidOid in
-	 * inquiry messages so as not to force writing unnecessary data.
-	 */
-	if (IsAutoVacuumLauncherProcess())
-		inquiry_db = InvalidOid;
-	else
-		inquiry_db = MyDatabaseId;
+	if (!create)
+		return (PgStatShared_TabEntry *)
+			dshash_find(pgStatSharedTabHash, &key, true);
 
-	/*
-	 * Loop until fresh enough stats file is available or we ran out of time.
-	 * The stats inquiry message is sent repeatedly in case collector drops
-	 * it; but not every single time, as that just swamps the collector.
-	 */
-	for (count = 0; count < PGSTAT_POLL_LOOP_COUNT; count++)
+	result = (PgStatShared_TabEntry *)
+		dshash_find_or_insert(pgStatSharedTabHash, &key, &found);
+
+	/* If not found, initialize the new one. */
+	if (!found)
 	{
-		bool		ok;
-		TimestampTz file_ts = 0;
-		TimestampTz cur_ts;
+		memset(&result->stats, 0, sizeof(PgStat_StatTabEntry));
+		result->stats.tableid = tableoid;
+	}
 
-		CHECK_FOR_INTERRUPTS();
+	return result;
+}
 
-		ok = pgstat_read_db_statsfile_timestamp(inquiry_db, false, &file_ts);
 
-		cur_ts = GetCurrentTimestamp();
-		/* Calculate min acceptable timestamp, if we didn't already */
-		if (count == 0 || cur_ts < ref_ts)
-		{
-			/*
-			 * We set the minimum acceptable timestamp to PGSTAT_STAT_INTERVAL
-			 * msec before now.  This indirectly ensures that the collector
-			 * needn't write the file more often than PGSTAT_STAT_INTERVAL. In
-			 * an autovacuum worker, however, we want a lower delay to avoid
-			 * using stale data, so we use PGSTAT_RETRY_DELAY (since the
-			 * number of workers is low, this shouldn't be a problem).
-			 *
-			 * We don't recompute min_ts after sleeping, except in the
-			 * unlikely case that cur_ts went backwards.  So we might end up
-			 * accepting a file a bit older than PGSTAT_STAT_INTERVAL.  In
-			 * practice that shouldn't happen, though, as long as the sleep
-			 * time is less than PGSTAT_STAT_INTERVAL; and we don't want to
-			 * tell the collector that our cutoff time is less than what we'd
-			 * actually accept.
-			 */
-			ref_ts = cur_ts;
-			if (IsAutoVacuumWorkerProcess())
-				min_ts = TimestampTzPlusMilliseconds(ref_ts,
-													 -PGSTAT_RETRY_DELAY);
-			else
-				min_ts = TimestampTzPlusMilliseconds(ref_ts,
-													 -PGSTAT_STAT_INTERVAL);
-		}
+/*
+ * Lookup the shared hash table entry for the specified function, as
+ * pgstat_get_db_entry() does for databases.
+ */
+static PgStatShared_FuncEntry *
+pgstat_get_func_entry(Oid databaseid, Oid functionid, bool create)
+{
+	PgStatShared_FuncEntry *result;
+	PgStat_StatObjKey key;
+	bool		found;
 
-		/*
-		 * If the file timestamp is actually newer than cur_ts, we must have
-		 * had a clock glitch (system time went backwards) or there is clock
-		 * skew between our processor and the stats collector's processor.
-		 * Accept the file, but send an inquiry message anyway to make
-		 * pgstat_recv_inquiry do a sanity check on the collector's time.
-		 */
-		if (ok && file_ts > cur_ts)
-		{
-			/*
-			 * A small amount of clock skew between processors isn't terribly
-			 * surprising, but a large difference is worth logging.  We
-			 * arbitrarily define "large" as 1000 msec.
-			 */
-			if (file_ts >= TimestampTzPlusMilliseconds(cur_ts, 1000))
-			{
-				char	   *filetime;
-				char	   *mytime;
-
-				/* Copy because timestamptz_to_str returns a static buffer */
-				filetime = pstrdup(timestamptz_to_str(file_ts));
-				mytime = pstrdup(timestamptz_to_str(cur_ts));
-				elog(LOG, "stats collector's time %s is later than backend local time %s",
-					 filetime, mytime);
-				pfree(filetime);
-				pfree(mytime);
-			}
+	key.databaseid = databaseid;
+	key.objectid = functionid;
 
-			pgstat_send_inquiry(cur_ts, min_ts, inquiry_db);
-			break;
-		}
+	if (!create)
+		return (PgStatShared_FuncEntry *)
+			dshash_find(pgStatSharedFuncHash, &key, true);
+
+	result = (PgStatShared_FuncEntry *)
+		dshash_find_or_insert(pgStatSharedFuncHash, &key, &found);
+
+	/* If not found, initialize the new one. */
+	if (!found)
+	{
+		memset(&result->stats, 0, sizeof(PgStat_StatFuncEntry));
+		result->stats.functionid = functionid;
+	}
+
+	return result;
+}
 
-		/* Normal acceptance case: file is not older than cutoff time */
-		if (ok && file_ts >= min_ts)
-			break;
 
-		/* Not there or too old, so kick the collector and wait a bit */
-		if ((count % PGSTAT_INQ_LOOP_COUNT) == 0)
-			pgstat_send_inquiry(cur_ts, min_ts, inquiry_db);
+/*
+ * Remove all table and function entries belonging to the given database.
+ */
+static void
+pgstat_drop_db_objects(Oid databaseid)
+{
+	dshash_seq_status hstat;
+	PgStatShared_TabEntry *tabentry;
+	PgStatShared_FuncEntry *funcentry;
 
-		pg_usleep(PGSTAT_RETRY_DELAY * 1000L);
+	dshash_seq_init(&hstat, pgStatSharedTabHash, true);
+	while ((tabentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		if (tabentry->key.databaseid == databaseid)
+			dshash_delete_current(&hstat);
 	}
+	dshash_seq_term(&hstat);
 
-	if (count >= PGSTAT_POLL_LOOP_COUNT)
-		ereport(LOG,
-				(errmsg("using stale statistics instead of current ones "
-						"because stats collector is not responding")));
+	dshash_seq_init(&hstat, pgStatSharedFuncHash, true);
+	while ((funcentry = dshash_seq_next(&hstat)) != NULL)
+	{
+		if (funcentry->key.databaseid == databaseid)
+			dshash_delete_current(&hstat);
+	}
+	dshash_seq_term(&hstat);
+}
 
-	/*
-	 * Autovacuum launcher wants stats about all databases, but a shallow read
-	 * is sufficient.  Regular backends want a deep read for just the tables
-	 * they can see (MyDatabaseId + shared catalogs).
-	 */
-	if (IsAutoVacuumLauncherProcess())
-		pgStatDBHash = pgstat_read_statsfiles(InvalidOid, false, false);
-	else
-		pgStatDBHash = pgstat_read_statsfiles(MyDatabaseId, false, true);
+
+/*
+ * Remove all the shared statistics and reset the cluster-wide counters.
+ */
+static void
+pgstat_clear_shared_stats(void)
+{
+	dshash_seq_status hstat;
+	TimestampTz now = GetCurrentTimestamp();
+
+	dshash_seq_init(&hstat, pgStatSharedDBHash, true);
+	while (dshash_seq_next(&hstat) != NULL)
+		dshash_delete_current(&hstat);
+	dshash_seq_term(&hstat);
+
+	dshash_seq_init(&hstat, pgStatSharedTabHash, true);
+	while (dshash_seq_next(&hstat) != NULL)
+		dshash_delete_current(&hstat);
+	dshash_seq_term(&hstat);
+
+	dshash_seq_init(&hstat, pgStatSharedFuncHash, true);
+	while (dshash_seq_next(&hstat) != NULL)
+		dshash_delete_current(&hstat);
+	dshash_seq_term(&hstat);
+
+	SpinLockAcquire(&pgStatShmem->global_lock);
+	memset(&pgStatShmem->global_stats, 0, sizeof(PgStat_GlobalStats));
+	pgStatShmem->global_stats.stat_reset_timestamp = now;
+	SpinLockRelease(&pgStatShmem->global_lock);
+
+	SpinLockAcquire(&pgStatShmem->archiver_lock);
+	memset(&pgStatShmem->archiver_stats, 0, sizeof(PgStat_ArchiverStats));
+	pgStatShmem->archiver_stats.stat_reset_timestamp = now;
+	SpinLockRelease(&pgStatShmem->archiver_lock);
 }
 
 
@@ -5782,6 +4773,50 @@ pgstat_setup_memcxt(void)
 }
 
 
+/* ----------
+ * pgstat_setup_snapshot() -
+ *
+ *	Start a snapshot of the shared statistics, if not already done in the
+ *	current transaction.  Entries are copied into it as they are fetched.
+ * ----------
+ */
+static void
+pgstat_setup_snapshot(void)
+{
+	HASHCTL		hash_ctl;
+
+	if (pgStatSnapshotDBHash != NULL)
+		return;
+
+	pgstat_setup_memcxt();
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(PgStat_SnapshotDBEntry);
+	hash_ctl.hcxt = pgStatLocalContext;
+	pgStatSnapshotDBHash = hash_create("Databases snapshot",
+									   PGSTAT_DB_HASH_SIZE,
+									   &hash_ctl,
+									   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	hash_ctl.keysize = sizeof(PgStat_StatObjKey);
+	hash_ctl.entrysize = sizeof(PgStat_SnapshotTabEntry);
+	pgStatSnapshotTabHash = hash_create("Tables snapshot",
+										PGSTAT_TAB_HASH_SIZE,
+										&hash_ctl,
+										HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	hash_ctl.keysize = sizeof(PgStat_StatObjKey);
+	hash_ctl.entrysize = sizeof(PgStat_SnapshotFuncEntry);
+	pgStatSnapshotFuncHash = hash_create("Functions snapshot",
+										 PGSTAT_FUNCTION_HASH_SIZE,
+										 &hash_ctl,
+										 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	pgStatSnapshotTimestamp = GetCurrentTimestamp();
+}
+
+
 /* ----------
  * pgstat_clear_snapshot() -
  *
@@ -5801,128 +4836,31 @@ pgstat_clear_snapshot(void)
 
 	/* Reset variables */
 	pgStatLocalContext = NULL;
-	pgStatDBHash = NULL;
+	pgStatSnapshotDBHash = NULL;
+	pgStatSnapshotTabHash = NULL;
+	pgStatSnapshotFuncHash = NULL;
+	pgStatSnapshotTimestamp = 0;
+	archiverStatsValid = false;
+	globalStatsValid = false;
 	localBackendStatusTable = NULL;
 	localNumBackends = 0;
 }
 
 
 /* ----------
- * pgstat_recv_inquiry() -
- *
- *	Process stat inquiry requests.
- * ----------
- */
-static void
-pgstat_recv_inquiry(PgStat_MsgInquiry *msg, int len)
-{
-	PgStat_StatDBEntry *dbentry;
-
-	elog(DEBUG2, "received inquiry for database %u", msg->databaseid);
-
-	/*
-	 * If there's already a write request for this DB, there's nothing to do.
-	 *
-	 * Note that if a request is found, we return early and skip the below
-	 * check for clock skew.  This is okay, since the only way for a DB
-	 * request to be present in the list is that we have been here since the
-	 * last write round.  It seems sufficient to check for clock skew once per
-	 * write round.
-	 */
-	if (list_member_oid(pending_write_requests, msg->databaseid))
-		return;
-
-	/*
-	 * Check to see if we last wrote this database at a time >= the requested
-	 * cutoff time.  If so, this is a stale request that was generated before
-	 * we updated the DB file, and we don't need to do so again.
-	 *
-	 * If the requestor's local clock time is older than stats_timestamp, we
-	 * should suspect a clock glitch, ie system time going backwards; though
-	 * the more likely explanation is just delayed message receipt.  It is
-	 * worth expending a GetCurrentTimestamp call to be sure, since a large
-	 * retreat in the system clock reading could otherwise cause us to neglect
-	 * to update the stats file for a long time.
-	 */
-	dbentry = pgstat_get_db_entry(msg->databaseid, false);
-	if (dbentry == NULL)
-	{
-		/*
-		 * We have no data for this DB.  Enter a write request anyway so that
-		 * the global stats will get updated.  This is needed to prevent
-		 * backend_read_statsfile from waiting for data that we cannot supply,
-		 * in the case of a new DB that nobody has yet reported any stats for.
-		 * See the behavior of pgstat_read_db_statsfile_timestamp.
-		 */
-	}
-	else if (msg->clock_time < dbentry->stats_timestamp)
-	{
-		TimestampTz cur_ts = GetCurrentTimestamp();
-
-		if (cur_ts < dbentry->stats_timestamp)
-		{
-			/*
-			 * Sure enough, time went backwards.  Force a new stats file write
-			 * to get back in sync; but first, log a complaint.
-			 */
-			char	   *writetime;
-			char	   *mytime;
-
-			/* Copy because timestamptz_to_str returns a static buffer */
-			writetime = pstrdup(timestamptz_to_str(dbentry->stats_timestamp));
-			mytime = pstrdup(timestamptz_to_str(cur_ts));
-			elog(LOG,
-				 "stats_timestamp %s is later than collector's time %s for database %u",
-				 writetime, mytime, dbentry->databaseid);
-			pfree(writetime);
-			pfree(mytime);
-		}
-		else
-		{
-			/*
-			 * Nope, it's just an old request.  Assuming msg's clock_time is
-			 * >= its cutoff_time, it must be stale, so we can ignore it.
-			 */
-			return;
-		}
-	}
-	else if (msg->cutoff_time <= dbentry->stats_timestamp)
-	{
-		/* Stale request, ignore it */
-		return;
-	}
-
-	/*
-	 * We need to write this DB, so create a request.
-	 */
-	pending_write_requests = lappend_oid(pending_write_requests,
-										 msg->databaseid);
-}
-
-
-/* ----------
- * pgstat_recv_tabstat() -
+ * pgstat_apply_tabstat() -
  *
  *	Count what the backend has done.
  * ----------
  */
 static void
-pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
+pgstat_apply_tabstat(PgStat_MsgTabstat *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
-	PgStat_StatTabEntry *tabentry;
+	PgStat_TableCounts dbcounts;
 	int			i;
-	bool		found;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
-
-	/*
-	 * Update database-wide stats.
-	 */
-	dbentry->n_xact_commit += (PgStat_Counter) (msg->m_xact_commit);
-	dbentry->n_xact_rollback += (PgStat_Counter) (msg->m_xact_rollback);
-	dbentry->n_block_read_time += msg->m_block_read_time;
-	dbentry->n_block_write_time += msg->m_block_write_time;
+	memset(&dbcounts, 0, sizeof(dbcounts));
 
 	/*
 	 * Process all table entries in the message.
@@ -5930,167 +4868,131 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 	for (i = 0; i < msg->m_nentries; i++)
 	{
 		PgStat_TableEntry *tabmsg = &(msg->m_entry[i]);
-
-		tabentry = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-													   (void *) &(tabmsg->t_id),
-													   HASH_ENTER, &found);
-
-		if (!found)
-		{
-			/*
-			 * If it's a new table entry, initialize counters to the values we
-			 * just got.
-			 */
-			tabentry->numscans = tabmsg->t_counts.t_numscans;
-			tabentry->tuples_returned = tabmsg->t_counts.t_tuples_returned;
-			tabentry->tuples_fetched = tabmsg->t_counts.t_tuples_fetched;
-			tabentry->tuples_inserted = tabmsg->t_counts.t_tuples_inserted;
-			tabentry->tuples_updated = tabmsg->t_counts.t_tuples_updated;
-			tabentry->tuples_deleted = tabmsg->t_counts.t_tuples_deleted;
-			tabentry->tuples_hot_updated = tabmsg->t_counts.t_tuples_hot_updated;
-			tabentry->n_live_tuples = tabmsg->t_counts.t_delta_live_tuples;
-			tabentry->n_dead_tuples = tabmsg->t_counts.t_delta_dead_tuples;
-			tabentry->changes_since_analyze = tabmsg->t_counts.t_changed_tuples;
-			tabentry->blocks_fetched = tabmsg->t_counts.t_blocks_fetched;
-			tabentry->blocks_hit = tabmsg->t_counts.t_blocks_hit;
-
-			tabentry->vacuum_timestamp = 0;
-			tabentry->vacuum_count = 0;
-			tabentry->autovac_vacuum_timestamp = 0;
-			tabentry->autovac_vacuum_count = 0;
-			tabentry->analyze_timestamp = 0;
-			tabentry->analyze_count = 0;
-			tabentry->autovac_analyze_timestamp = 0;
-			tabentry->autovac_analyze_count = 0;
-		}
-		else
+		PgStatShared_TabEntry *shentry;
+		PgStat_StatTabEntry *tabentry;
+
+		shentry = pgstat_get_tab_entry(msg->m_databaseid, tabmsg->t_id, true);
+		tabentry = &shentry->stats;
+
+		tabentry->numscans += tabmsg->t_counts.t_numscans;
+		tabentry->tuples_returned += tabmsg->t_counts.t_tuples_returned;
+		tabentry->tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
+		tabentry->tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
+		tabentry->tuples_updated += tabmsg->t_counts.t_tuples_updated;
+		tabentry->tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
+		tabentry->tuples_hot_updated += tabmsg->t_counts.t_tuples_hot_updated;
+		/* If table was truncated, first reset the live/dead counters */
+		if (tabmsg->t_counts.t_truncated)
 		{
-			/*
-			 * Otherwise add the values to the existing entry.
-			 */
-			tabentry->numscans += tabmsg->t_counts.t_numscans;
-			tabentry->tuples_returned += tabmsg->t_counts.t_tuples_returned;
-			tabentry->tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
-			tabentry->tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
-			tabentry->tuples_updated += tabmsg->t_counts.t_tuples_updated;
-			tabentry->tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
-			tabentry->tuples_hot_updated += tabmsg->t_counts.t_tuples_hot_updated;
-			/* If table was truncated, first reset the live/dead counters */
-			if (tabmsg->t_counts.t_truncated)
-			{
-				tabentry->n_live_tuples = 0;
-				tabentry->n_dead_tuples = 0;
-			}
-			tabentry->n_live_tuples += tabmsg->t_counts.t_delta_live_tuples;
-			tabentry->n_dead_tuples += tabmsg->t_counts.t_delta_dead_tuples;
-			tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
-			tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
-			tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
+			tabentry->n_live_tuples = 0;
+			tabentry->n_dead_tuples = 0;
 		}
+		tabentry->n_live_tuples += tabmsg->t_counts.t_delta_live_tuples;
+		tabentry->n_dead_tuples += tabmsg->t_counts.t_delta_dead_tuples;
+		tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
+		tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
+		tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
 
 		/* Clamp n_live_tuples in case of negative delta_live_tuples */
 		tabentry->n_live_tuples = Max(tabentry->n_live_tuples, 0);
 		/* Likewise for n_dead_tuples */
 		tabentry->n_dead_tuples = Max(tabentry->n_dead_tuples, 0);
 
+		dshash_release_lock(pgStatSharedTabHash, shentry);
+
 		/*
-		 * Add per-table stats to the per-database entry, too.
+		 * Add per-table stats to the per-database totals, too.
 		 */
-		dbentry->n_tuples_returned += tabmsg->t_counts.t_tuples_returned;
-		dbentry->n_tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
-		dbentry->n_tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
-		dbentry->n_tuples_updated += tabmsg->t_counts.t_tuples_updated;
-		dbentry->n_tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
-		dbentry->n_blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
-		dbentry->n_blocks_hit += tabmsg->t_counts.t_blocks_hit;
+		dbcounts.t_tuples_returned += tabmsg->t_counts.t_tuples_returned;
+		dbcounts.t_tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
+		dbcounts.t_tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
+		dbcounts.t_tuples_updated += tabmsg->t_counts.t_tuples_updated;
+		dbcounts.t_tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
+		dbcounts.t_blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
+		dbcounts.t_blocks_hit += tabmsg->t_counts.t_blocks_hit;
 	}
+
+	/*
+	 * Update database-wide stats.  This is done once the table entries have
+	 * been released, so that we never hold more than one entry lock.
+	 */
+	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+
+	dbentry->n_xact_commit += (PgStat_Counter) (msg->m_xact_commit);
+	dbentry->n_xact_rollback += (PgStat_Counter) (msg->m_xact_rollback);
+	dbentry->n_block_read_time += msg->m_block_read_time;
+	dbentry->n_block_write_time += msg->m_block_write_time;
+	dbentry->n_tuples_returned += dbcounts.t_tuples_returned;
+	dbentry->n_tuples_fetched += dbcounts.t_tuples_fetched;
+	dbentry->n_tuples_inserted += dbcounts.t_tuples_inserted;
+	dbentry->n_tuples_updated += dbcounts.t_tuples_updated;
+	dbentry->n_tuples_deleted += dbcounts.t_tuples_deleted;
+	dbentry->n_blocks_fetched += dbcounts.t_blocks_fetched;
+	dbentry->n_blocks_hit += dbcounts.t_blocks_hit;
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 
 /* ----------
- * pgstat_recv_tabpurge() -
+ * pgstat_apply_tabpurge() -
  *
- *	Arrange for dead table removal.
+ *	Remove the stats of dead tables.
  * ----------
  */
 static void
-pgstat_recv_tabpurge(PgStat_MsgTabpurge *msg, int len)
+pgstat_apply_tabpurge(PgStat_MsgTabpurge *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
 	int			i;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
-
-	/*
-	 * No need to purge if we don't even know the database.
-	 */
-	if (!dbentry || !dbentry->tables)
-		return;
-
 	/*
 	 * Process all table entries in the message.
 	 */
 	for (i = 0; i < msg->m_nentries; i++)
 	{
+		PgStat_StatObjKey key;
+
+		key.databaseid = msg->m_databaseid;
+		key.objectid = msg->m_tableid[i];
+
 		/* Remove from hashtable if present; we don't care if it's not. */
-		(void) hash_search(dbentry->tables,
-						   (void *) &(msg->m_tableid[i]),
-						   HASH_REMOVE, NULL);
+		(void) dshash_delete_key(pgStatSharedTabHash, &key);
 	}
 }
 
 
 /* ----------
- * pgstat_recv_dropdb() -
+ * pgstat_apply_dropdb() -
  *
- *	Arrange for dead database removal
+ *	Remove the stats of a dead database.
  * ----------
  */
 static void
-pgstat_recv_dropdb(PgStat_MsgDropdb *msg, int len)
+pgstat_apply_dropdb(PgStat_MsgDropdb *msg, int len)
 {
 	Oid			dbid = msg->m_databaseid;
 	PgStat_StatDBEntry *dbentry;
 
 	/*
-	 * Lookup the database in the hashtable.
+	 * Get rid of the database's tables and functions first, then the
+	 * database itself.
 	 */
-	dbentry = pgstat_get_db_entry(dbid, false);
+	pgstat_drop_db_objects(dbid);
 
-	/*
-	 * If found, remove it (along with the db statfile).
-	 */
+	dbentry = pgstat_get_db_entry(dbid, false);
 	if (dbentry)
-	{
-		char		statfile[MAXPGPATH];
-
-		get_dbstat_filename(false, false, dbid, statfile, MAXPGPATH);
-
-		elog(DEBUG2, "removing stats file \"%s\"", statfile);
-		unlink(statfile);
-
-		if (dbentry->tables != NULL)
-			hash_destroy(dbentry->tables);
-		if (dbentry->functions != NULL)
-			hash_destroy(dbentry->functions);
-
-		if (hash_search(pgStatDBHash,
-						(void *) &dbid,
-						HASH_REMOVE, NULL) == NULL)
-			ereport(ERROR,
-					(errmsg("database hash table corrupted during cleanup --- abort")));
-	}
+		dshash_delete_entry(pgStatSharedDBHash, dbentry);
 }
 
 
 /* ----------
- * pgstat_recv_resetcounter() -
+ * pgstat_apply_resetcounter() -
  *
  *	Reset the statistics for the specified database.
  * ----------
  */
 static void
-pgstat_recv_resetcounter(PgStat_MsgResetcounter *msg, int len)
+pgstat_apply_resetcounter(PgStat_MsgResetcounter *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
@@ -6103,44 +5005,41 @@ pgstat_recv_resetcounter(PgStat_MsgResetcounter *msg, int len)
 		return;
 
 	/*
-	 * We simply throw away all the database's table entries by recreating a
-	 * new hash table for them.
-	 */
-	if (dbentry->tables != NULL)
-		hash_destroy(dbentry->tables);
-	if (dbentry->functions != NULL)
-		hash_destroy(dbentry->functions);
-
-	dbentry->tables = NULL;
-	dbentry->functions = NULL;
-
-	/*
-	 * Reset database-level stats, too.  This creates empty hash tables for
-	 * tables and functions.
+	 * Reset database-level stats, and throw away all the database's table
+	 * and function entries.
 	 */
 	reset_dbentry_counters(dbentry);
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
+
+	pgstat_drop_db_objects(msg->m_databaseid);
 }
 
 /* ----------
- * pgstat_recv_resetshared() -
+ * pgstat_apply_resetsharedcounter() -
  *
  *	Reset some shared statistics of the cluster.
  * ----------
  */
 static void
-pgstat_recv_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len)
+pgstat_apply_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len)
 {
+	TimestampTz now = GetCurrentTimestamp();
+
 	if (msg->m_resettarget == RESET_BGWRITER)
 	{
 		/* Reset the global background writer statistics for the cluster. */
-		memset(&globalStats, 0, sizeof(globalStats));
-		globalStats.stat_reset_timestamp = GetCurrentTimestamp();
+		SpinLockAcquire(&pgStatShmem->global_lock);
+		memset(&pgStatShmem->global_stats, 0, sizeof(PgStat_GlobalStats));
+		pgStatShmem->global_stats.stat_reset_timestamp = now;
+		SpinLockRelease(&pgStatShmem->global_lock);
 	}
 	else if (msg->m_resettarget == RESET_ARCHIVER)
 	{
 		/* Reset the archiver statistics for the cluster. */
-		memset(&archiverStats, 0, sizeof(archiverStats));
-		archiverStats.stat_reset_timestamp = GetCurrentTimestamp();
+		SpinLockAcquire(&pgStatShmem->archiver_lock);
+		memset(&pgStatShmem->archiver_stats, 0, sizeof(PgStat_ArchiverStats));
+		pgStatShmem->archiver_stats.stat_reset_timestamp = now;
+		SpinLockRelease(&pgStatShmem->archiver_lock);
 	}
 
 	/*
@@ -6150,15 +5049,16 @@ pgstat_recv_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len)
 }
 
 /* ----------
- * pgstat_recv_resetsinglecounter() -
+ * pgstat_apply_resetsinglecounter() -
  *
  *	Reset a statistics for a single object
  * ----------
  */
 static void
-pgstat_recv_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len)
+pgstat_apply_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
+	PgStat_StatObjKey key;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
 
@@ -6167,24 +5067,25 @@ pgstat_recv_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len)
 
 	/* Set the reset timestamp for the whole database */
 	dbentry->stat_reset_timestamp = GetCurrentTimestamp();
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 
 	/* Remove object if it exists, ignore it if not */
+	key.databaseid = msg->m_databaseid;
+	key.objectid = msg->m_objectid;
 	if (msg->m_resettype == RESET_TABLE)
-		(void) hash_search(dbentry->tables, (void *) &(msg->m_objectid),
-						   HASH_REMOVE, NULL);
+		(void) dshash_delete_key(pgStatSharedTabHash, &key);
 	else if (msg->m_resettype == RESET_FUNCTION)
-		(void) hash_search(dbentry->functions, (void *) &(msg->m_objectid),
-						   HASH_REMOVE, NULL);
+		(void) dshash_delete_key(pgStatSharedFuncHash, &key);
 }
 
 /* ----------
- * pgstat_recv_autovac() -
+ * pgstat_apply_autovac() -
  *
  *	Process an autovacuum signalling message.
  * ----------
  */
 static void
-pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len)
+pgstat_apply_autovac(PgStat_MsgAutovacStart *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
@@ -6194,26 +5095,27 @@ pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len)
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
 
 	dbentry->last_autovac_time = msg->m_start_time;
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 /* ----------
- * pgstat_recv_vacuum() -
+ * pgstat_apply_vacuum() -
  *
  *	Process a VACUUM message.
  * ----------
  */
 static void
-pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len)
+pgstat_apply_vacuum(PgStat_MsgVacuum *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
+	PgStatShared_TabEntry *shentry;
 	PgStat_StatTabEntry *tabentry;
 
 	/*
 	 * Store the data in the table's hashtable entry.
 	 */
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
-
-	tabentry = pgstat_get_tab_entry(dbentry, msg->m_tableoid, true);
+	shentry = pgstat_get_tab_entry(msg->m_databaseid, msg->m_tableoid, true);
+	tabentry = &shentry->stats;
 
 	tabentry->n_live_tuples = msg->m_live_tuples;
 	tabentry->n_dead_tuples = msg->m_dead_tuples;
@@ -6228,26 +5130,27 @@ pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len)
 		tabentry->vacuum_timestamp = msg->m_vacuumtime;
 		tabentry->vacuum_count++;
 	}
+
+	dshash_release_lock(pgStatSharedTabHash, shentry);
 }
 
 /* ----------
- * pgstat_recv_analyze() -
+ * pgstat_apply_analyze() -
  *
  *	Process an ANALYZE message.
  * ----------
  */
 static void
-pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len)
+pgstat_apply_analyze(PgStat_MsgAnalyze *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
+	PgStatShared_TabEntry *shentry;
 	PgStat_StatTabEntry *tabentry;
 
 	/*
 	 * Store the data in the table's hashtable entry.
 	 */
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
-
-	tabentry = pgstat_get_tab_entry(dbentry, msg->m_tableoid, true);
+	shentry = pgstat_get_tab_entry(msg->m_databaseid, msg->m_tableoid, true);
+	tabentry = &shentry->stats;
 
 	tabentry->n_live_tuples = msg->m_live_tuples;
 	tabentry->n_dead_tuples = msg->m_dead_tuples;
@@ -6270,65 +5173,75 @@ pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len)
 		tabentry->analyze_timestamp = msg->m_analyzetime;
 		tabentry->analyze_count++;
 	}
+
+	dshash_release_lock(pgStatSharedTabHash, shentry);
 }
 
 
 /* ----------
- * pgstat_recv_archiver() -
+ * pgstat_apply_archiver() -
  *
  *	Process a ARCHIVER message.
  * ----------
  */
 static void
-pgstat_recv_archiver(PgStat_MsgArchiver *msg, int len)
+pgstat_apply_archiver(PgStat_MsgArchiver *msg, int len)
 {
+	PgStat_ArchiverStats *stats = &pgStatShmem->archiver_stats;
+
+	SpinLockAcquire(&pgStatShmem->archiver_lock);
 	if (msg->m_failed)
 	{
 		/* Failed archival attempt */
-		++archiverStats.failed_count;
-		memcpy(archiverStats.last_failed_wal, msg->m_xlog,
-			   sizeof(archiverStats.last_failed_wal));
-		archiverStats.last_failed_timestamp = msg->m_timestamp;
+		++stats->failed_count;
+		memcpy(stats->last_failed_wal, msg->m_xlog,
+			   sizeof(stats->last_failed_wal));
+		stats->last_failed_timestamp = msg->m_timestamp;
 	}
 	else
 	{
 		/* Successful archival operation */
-		++archiverStats.archived_count;
-		memcpy(archiverStats.last_archived_wal, msg->m_xlog,
-			   sizeof(archiverStats.last_archived_wal));
-		archiverStats.last_archived_timestamp = msg->m_timestamp;
+		++stats->archived_count;
+		memcpy(stats->last_archived_wal, msg->m_xlog,
+			   sizeof(stats->last_archived_wal));
+		stats->last_archived_timestamp = msg->m_timestamp;
 	}
+	SpinLockRelease(&pgStatShmem->archiver_lock);
 }
 
 /* ----------
- * pgstat_recv_bgwriter() -
+ * pgstat_apply_bgwriter() -
  *
  *	Process a BGWRITER message.
  * ----------
  */
 static void
-pgstat_recv_bgwriter(PgStat_MsgBgWriter *msg, int len)
+pgstat_apply_bgwriter(PgStat_MsgBgWriter *msg, int len)
 {
-	globalStats.timed_checkpoints += msg->m_timed_checkpoints;
-	globalStats.requested_checkpoints += msg->m_requested_checkpoints;
-	globalStats.checkpoint_write_time += msg->m_checkpoint_write_time;
-	globalStats.checkpoint_sync_time += msg->m_checkpoint_sync_time;
-	globalStats.buf_written_checkpoints += msg->m_buf_written_checkpoints;
-	globalStats.buf_written_clean += msg->m_buf_written_clean;
-	globalStats.maxwritten_clean += msg->m_maxwritten_clean;
-	globalStats.buf_written_backend += msg->m_buf_written_backend;
-	globalStats.buf_fsync_backend += msg->m_buf_fsync_backend;
-	globalStats.buf_alloc += msg->m_buf_alloc;
+	PgStat_GlobalStats *stats = &pgStatShmem->global_stats;
+
+	SpinLockAcquire(&pgStatShmem->global_lock);
+	stats->timed_checkpoints += msg->m_timed_checkpoints;
+	stats->requested_checkpoints += msg->m_requested_checkpoints;
+	stats->checkpoint_write_time += msg->m_checkpoint_write_time;
+	stats->checkpoint_sync_time += msg->m_checkpoint_sync_time;
+	stats->buf_written_checkpoints += msg->m_buf_written_checkpoints;
+	stats->buf_written_clean += msg->m_buf_written_clean;
+	stats->maxwritten_clean += msg->m_maxwritten_clean;
+	stats->buf_written_backend += msg->m_buf_written_backend;
+	stats->buf_fsync_backend += msg->m_buf_fsync_backend;
+	stats->buf_alloc += msg->m_buf_alloc;
+	SpinLockRelease(&pgStatShmem->global_lock);
 }
 
 /* ----------
- * pgstat_recv_recoveryconflict() -
+ * pgstat_apply_recoveryconflict() -
  *
  *	Process a RECOVERYCONFLICT message.
  * ----------
  */
 static void
-pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len)
+pgstat_apply_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
@@ -6359,32 +5272,36 @@ pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len)
 			dbentry->n_conflict_startup_deadlock++;
 			break;
 	}
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 /* ----------
- * pgstat_recv_deadlock() -
+ * pgstat_apply_deadlock() -
  *
  *	Process a DEADLOCK message.
  * ----------
  */
 static void
-pgstat_recv_deadlock(PgStat_MsgDeadlock *msg, int len)
+pgstat_apply_deadlock(PgStat_MsgDeadlock *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
 
 	dbentry->n_deadlocks++;
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 /* ----------
- * pgstat_recv_checksum_failure() -
+ * pgstat_apply_checksum_failure() -
  *
  *	Process a CHECKSUMFAILURE message.
  * ----------
  */
 static void
-pgstat_recv_checksum_failure(PgStat_MsgChecksumFailure *msg, int len)
+pgstat_apply_checksum_failure(PgStat_MsgChecksumFailure *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
@@ -6392,16 +5309,18 @@ pgstat_recv_checksum_failure(PgStat_MsgChecksumFailure *msg, int len)
 
 	dbentry->n_checksum_failures += msg->m_failurecount;
 	dbentry->last_checksum_failure = msg->m_failure_time;
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 /* ----------
- * pgstat_recv_tempfile() -
+ * pgstat_apply_tempfile() -
  *
  *	Process a TEMPFILE message.
  * ----------
  */
 static void
-pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len)
+pgstat_apply_tempfile(PgStat_MsgTempFile *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
 
@@ -6409,127 +5328,66 @@ pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len)
 
 	dbentry->n_temp_bytes += msg->m_filesize;
 	dbentry->n_temp_files += 1;
+
+	dshash_release_lock(pgStatSharedDBHash, dbentry);
 }
 
 /* ----------
- * pgstat_recv_funcstat() -
+ * pgstat_apply_funcstat() -
  *
  *	Count what the backend has done.
  * ----------
  */
 static void
-pgstat_recv_funcstat(PgStat_MsgFuncstat *msg, int len)
+pgstat_apply_funcstat(PgStat_MsgFuncstat *msg, int len)
 {
 	PgStat_FunctionEntry *funcmsg = &(msg->m_entry[0]);
-	PgStat_StatDBEntry *dbentry;
-	PgStat_StatFuncEntry *funcentry;
 	int			i;
-	bool		found;
-
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
 
 	/*
 	 * Process all function entries in the message.
 	 */
 	for (i = 0; i < msg->m_nentries; i++, funcmsg++)
 	{
-		funcentry = (PgStat_StatFuncEntry *) hash_search(dbentry->functions,
-														 (void *) &(funcmsg->f_id),
-														 HASH_ENTER, &found);
+		PgStatShared_FuncEntry *shentry;
+		PgStat_StatFuncEntry *funcentry;
 
-		if (!found)
-		{
-			/*
-			 * If it's a new function entry, initialize counters to the values
-			 * we just got.
-			 */
-			funcentry->f_numcalls = funcmsg->f_numcalls;
-			funcentry->f_total_time = funcmsg->f_total_time;
-			funcentry->f_self_time = funcmsg->f_self_time;
-		}
-		else
-		{
-			/*
-			 * Otherwise add the values to the existing entry.
-			 */
-			funcentry->f_numcalls += funcmsg->f_numcalls;
-			funcentry->f_total_time += funcmsg->f_total_time;
-			funcentry->f_self_time += funcmsg->f_self_time;
-		}
+		shentry = pgstat_get_func_entry(msg->m_databaseid, funcmsg->f_id,
+										true);
+		funcentry = &shentry->stats;
+
+		funcentry->f_numcalls += funcmsg->f_numcalls;
+		funcentry->f_total_time += funcmsg->f_total_time;
+		funcentry->f_self_time += funcmsg->f_self_time;
+
+		dshash_release_lock(pgStatSharedFuncHash, shentry);
 	}
 }
 
 /* ----------
- * pgstat_recv_funcpurge() -
+ * pgstat_apply_funcpurge() -
  *
- *	Arrange for dead function removal.
+ *	Remove the stats of dead functions.
  * ----------
  */
 static void
-pgstat_recv_funcpurge(PgStat_MsgFuncpurge *msg, int len)
+pgstat_apply_funcpurge(PgStat_MsgFuncpurge *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
 	int			i;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
-
-	/*
-	 * No need to purge if we don't even know the database.
-	 */
-	if (!dbentry || !dbentry->functions)
-		return;
-
 	/*
 	 * Process all function entries in the message.
 	 */
 	for (i = 0; i < msg->m_nentries; i++)
 	{
-		/* Remove from hashtable if present; we don't care if it's not. */
-		(void) hash_search(dbentry->functions,
-						   (void *) &(msg->m_functionid[i]),
-						   HASH_REMOVE, NULL);
-	}
-}
-
-/* ----------
- * pgstat_write_statsfile_needed() -
- *
- *	Do we need to write out any stats files?
- * ----------
- */
-static bool
-pgstat_write_statsfile_needed(void)
-{
-	if (pending_write_requests != NIL)
-		return true;
-
-	/* Everything was written recently */
-	return false;
-}
-
-/* ----------
- * pgstat_db_requested() -
- *
- *	Checks whether stats for a particular DB need to be written to a file.
- * ----------
- */
-static bool
-pgstat_db_requested(Oid databaseid)
-{
-	/*
-	 * If any requests are outstanding at all, we should write the stats for
-	 * shared catalogs (the "database" with OID 0).  This ensures that
-	 * backends will see up-to-date stats for shared catalogs, even though
-	 * they send inquiry messages mentioning only their own DB.
-	 */
-	if (databaseid == InvalidOid && pending_write_requests != NIL)
-		return true;
+		PgStat_StatObjKey key;
 
-	/* Search to see if there's an open request to write this database. */
-	if (list_member_oid(pending_write_requests, databaseid))
-		return true;
+		key.databaseid = msg->m_databaseid;
+		key.objectid = msg->m_functionid[i];
 
-	return false;
+		/* Remove from hashtable if present; we don't care if it's not. */
+		(void) dshash_delete_key(pgStatSharedFuncHash, &key);
+	}
 }
 
 /*
@@ -0,0 +1,738 @@
+/*-------------------------------------------------------------------------
+ * decodeworker.c
+ *	   Background worker decoding WAL on behalf of a logical walsender
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/decodeworker.c
+ *
+ * NOTES
+ *	  When logical_decoding_pipeline is enabled, a logical walsender does not
+ *	  decode WAL itself.  Instead it launches a dynamic background worker
+ *	  which acquires the replication slot, reads and decodes WAL, reassembles
+ *	  transactions in the reorder buffer and runs the output plugin.  The
+ *	  output is passed back to the walsender through a shared memory queue,
+ *	  already formatted as XLogData messages.  The walsender only has to move
+ *	  the messages to the socket, handle the client's replies and keepalives,
+ *	  and track lag, so network I/O and feedback processing for earlier
+ *	  transactions overlap with the decoding of later ones.
+ *
+ *	  The output plugin has to run in the same process as the reorder buffer,
+ *	  because its callbacks access the catalogs using the historic snapshots
+ *	  built during decoding.  The queue is therefore placed after the output
+ *	  plugin.
+ *
+ *	  The worker reports how far it has decoded with position messages that
+ *	  are queued behind the output they cover, so that the walsender never
+ *	  reports a sent position ahead of data it has not sent yet.  Flush
+ *	  confirmations received by the walsender are passed on through shared
+ *	  memory, and the worker advances the slot accordingly.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlogutils.h"
+#include "libpq/pqformat.h"
+#include "libpq/pqmq.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "replication/decode.h"
+#include "replication/decodeworker.h"
+#include "replication/logical.h"
+#include "replication/slot.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+/* Magic number identifying the decoding worker's DSM segment */
+#define DECODING_WORKER_MAGIC			0x4c4f4744
+
+/* Keys for the shm_toc */
+#define DECODING_KEY_SHARED				1
+#define DECODING_KEY_OPTIONS			2
+#define DECODING_KEY_GUC				3
+#define DECODING_KEY_DATA_QUEUE			4
+#define DECODING_KEY_ERROR_QUEUE		5
+
+/*
+ * Size of the queue carrying output plugin data.  This bounds how far the
+ * decoding worker can get ahead of the network.
+ */
+#define DECODING_WORKER_QUEUE_SIZE		(4 * 1024 * 1024)
+#define DECODING_WORKER_ERROR_QUEUE_SIZE	16384
+
+/* Send a position message at least every this many records */
+#define DECODING_WORKER_POSITION_INTERVAL	1024
+
+/* Timeout for waiting for new WAL, in case a wakeup gets lost */
+#define DECODING_WORKER_NAPTIME			1000L
+
+/* State shared between the walsender and its decoding worker */
+typedef struct DecodingWorkerShared
+{
+	/* Fixed at startup */
+	Oid			database_id;
+	Oid			authenticated_user_id;
+	XLogRecPtr	startpoint;
+	NameData	slotname;
+
+	/* Protects the fields below */
+	slock_t		mutex;
+
+	Latch	   *worker_latch;	/* set once the worker has started */
+	XLogRecPtr	confirmed_flush;	/* last flush confirmed by the client */
+	bool		stop;			/* walsender is no longer listening */
+} DecodingWorkerShared;
+
+/* Walsender's view of its decoding worker */
+struct DecodingWorkerHandle
+{
+	dsm_segment *seg;
+	DecodingWorkerShared *shared;
+	shm_mq_handle *data_mqh;
+	shm_mq_handle *error_mqh;
+	BackgroundWorkerHandle *bgwhandle;
+	bool		terminated;		/* worker reported being terminated */
+};
+
+/* Worker-side state */
+static DecodingWorkerShared *MyDecodingWorker = NULL;
+static shm_mq_handle *decoding_data_mqh = NULL;
+static StringInfoData decoding_msg;
+static XLogRecPtr decoding_confirmed_flush = InvalidXLogRecPtr;
+static XLogRecPtr decoding_position_sent = InvalidXLogRecPtr;
+static bool decoding_caught_up_sent = false;
+
+static volatile sig_atomic_t got_SIGHUP = false;
+
+static void decoding_worker_detach(dsm_segment *seg, Datum arg);
+static void decoding_worker_sighup(SIGNAL_ARGS);
+static bool decoding_worker_stop_requested(void);
+static void decoding_worker_confirm(void);
+static void decoding_worker_send(const char *data, Size len);
+static void decoding_worker_send_position(XLogRecPtr lsn, bool caught_up);
+static int	decoding_worker_read_page(XLogReaderState *state,
+									  XLogRecPtr targetPagePtr, int reqLen,
+									  XLogRecPtr targetRecPtr, char *cur_page,
+									  TimeLineID *pageTLI);
+static void decoding_worker_prepare_write(LogicalDecodingContext *ctx,
+										  XLogRecPtr lsn, TransactionId xid,
+										  bool last_write);
+static void decoding_worker_write(LogicalDecodingContext *ctx,
+								  XLogRecPtr lsn, TransactionId xid,
+								  bool last_write);
+static void decoding_worker_update_progress(LogicalDecodingContext *ctx,
+											XLogRecPtr lsn, TransactionId xid);
+
+/*
+ * Launch a decoding worker for the given slot.
+ *
+ * Returns NULL if no background worker could be registered, in which case
+ * the caller is expected to decode by itself.  Otherwise the worker's first
+ * message will be DECODING_WORKER_MSG_READY, or it will detach after
+ * reporting an error.
+ */
+DecodingWorkerHandle *
+StartDecodingWorker(const char *slotname, XLogRecPtr startpoint,
+					List *options)
+{
+	DecodingWorkerHandle *handle;
+	DecodingWorkerShared *shared;
+	shm_toc_estimator estimator;
+	shm_toc    *toc;
+	dsm_segment *seg;
+	BackgroundWorker worker;
+	char	   *options_str;
+	char	   *options_space;
+	char	   *guc_space;
+	Size		options_len;
+	Size		guc_len;
+	Size		segsize;
+	shm_mq	   *mq;
+
+	options_str = nodeToString(options);
+	options_len = strlen(options_str) + 1;
+	guc_len = EstimateGUCStateSpace();
+
+	shm_toc_initialize_estimator(&estimator);
+	shm_toc_estimate_chunk(&estimator, sizeof(DecodingWorkerShared));
+	shm_toc_estimate_chunk(&estimator, options_len);
+	shm_toc_estimate_chunk(&estimator, guc_len);
+	shm_toc_estimate_chunk(&estimator, DECODING_WORKER_QUEUE_SIZE);
+	shm_toc_estimate_chunk(&estimator, DECODING_WORKER_ERROR_QUEUE_SIZE);
+	shm_toc_estimate_keys(&estimator, 5);
+	segsize = shm_toc_estimate(&estimator);
+
+	seg = dsm_create(segsize, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+		return NULL;
+	dsm_pin_mapping(seg);
+
+	toc = shm_toc_create(DECODING_WORKER_MAGIC, dsm_segment_address(seg),
+						 segsize);
+
+	shared = shm_toc_allocate(toc, sizeof(DecodingWorkerShared));
+	shared->database_id = MyDatabaseId;
+	shared->authenticated_user_id = GetAuthenticatedUserId();
+	shared->startpoint = startpoint;
+	namestrcpy(&shared->slotname, slotname);
+	SpinLockInit(&shared->mutex);
+	shared->worker_latch = NULL;
+	shared->confirmed_flush = InvalidXLogRecPtr;
+	shared->stop = false;
+	shm_toc_insert(toc, DECODING_KEY_SHARED, shared);
+
+	options_space = shm_toc_allocate(toc, options_len);
+	memcpy(options_space, options_str, options_len);
+	shm_toc_insert(toc, DECODING_KEY_OPTIONS, options_space);
+
+	guc_space = shm_toc_allocate(toc, guc_len);
+	SerializeGUCState(guc_len, guc_space);
+	shm_toc_insert(toc, DECODING_KEY_GUC, guc_space);
+
+	handle = palloc0(sizeof(DecodingWorkerHandle));
+	handle->seg = seg;
+	handle->shared = shared;
+
+	mq = shm_mq_create(shm_toc_allocate(toc, DECODING_WORKER_QUEUE_SIZE),
+					   DECODING_WORKER_QUEUE_SIZE);
+	shm_toc_insert(toc, DECODING_KEY_DATA_QUEUE, mq);
+	shm_mq_set_receiver(mq, MyProc);
+	handle->data_mqh = shm_mq_attach(mq, seg, NULL);
+
+	mq = shm_mq_create(shm_toc_allocate(toc, DECODING_WORKER_ERROR_QUEUE_SIZE),
+					   DECODING_WORKER_ERROR_QUEUE_SIZE);
+	shm_toc_insert(toc, DECODING_KEY_ERROR_QUEUE, mq);
+	shm_mq_set_receiver(mq, MyProc);
+	handle->error_mqh = shm_mq_attach(mq, seg, NULL);
+
+	/* Tell the worker to stop as soon as we detach, however that happens */
+	on_dsm_detach(seg, decoding_worker_detach, PointerGetDatum(shared));
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "LogicalDecodingWorkerMain");
+	snprintf(worker.bgw_name, BGW_MAXLEN,
+			 "logical decoding worker for slot %s", slotname);
+	snprintf(worker.bgw_type, BGW_MAXLEN, "logical decoding worker");
+	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+	worker.bgw_notify_pid = MyProcPid;
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle->bgwhandle))
+	{
+		dsm_detach(seg);
+		pfree(handle);
+		return NULL;
+	}
+
+	shm_mq_set_handle(handle->data_mqh, handle->bgwhandle);
+	shm_mq_set_handle(handle->error_mqh, handle->bgwhandle);
+
+	return handle;
+}
+
+/*
+ * Stop the decoding worker and wait for it to exit, so that the slot is
+ * free again once we return.
+ */
+void
+StopDecodingWorker(DecodingWorkerHandle *handle)
+{
+	/* This also detaches the queues and tells the worker to stop */
+	dsm_detach(handle->seg);
+
+	(void) WaitForBackgroundWorkerShutdown(handle->bgwhandle);
+
+	pfree(handle->bgwhandle);
+	pfree(handle);
+}
+
+/*
+ * Receive the next message from the decoding worker.
+ *
+ * On DECODING_WORKER_MESSAGE, msg points into the queue and stays valid
+ * until the next call.  The caller may modify the message in place.
+ */
+DecodingWorkerResult
+DecodingWorkerReceive(DecodingWorkerHandle *handle, StringInfo msg,
+					  bool nowait)
+{
+	shm_mq_result res;
+	Size		nbytes;
+	void	   *data;
+
+	res = shm_mq_receive(handle->data_mqh, &nbytes, &data, nowait);
+
+	if (res == SHM_MQ_WOULD_BLOCK)
+		return DECODING_WORKER_EMPTY;
+	if (res == SHM_MQ_DETACHED)
+		return DECODING_WORKER_DETACHED;
+
+	msg->data = data;
+	msg->len = nbytes;
+	msg->maxlen = nbytes;
+	msg->cursor = 0;
+
+	return DECODING_WORKER_MESSAGE;
+}
+
+/*
+ * Relay errors and notices reported by the decoding worker.
+ *
+ * An error raised in the worker is rethrown in the walsender, so it reaches
+ * the client just like an error raised while decoding in the walsender.
+ * The exception is the worker being terminated, which is what the postmaster
+ * does at shutdown, before walsenders are asked to stop: that's only
+ * remembered, see DecodingWorkerTerminated.
+ */
+void
+HandleDecodingWorkerMessages(DecodingWorkerHandle *handle)
+{
+	for (;;)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+		StringInfoData msg;
+		char		msgtype;
+
+		res = shm_mq_receive(handle->error_mqh, &nbytes, &data, true);
+		if (res != SHM_MQ_SUCCESS)
+			break;
+
+		initStringInfo(&msg);
+		appendBinaryStringInfo(&msg, data, nbytes);
+		msgtype = pq_getmsgbyte(&msg);
+
+		if (msgtype == 'E' || msgtype == 'N')
+		{
+			ErrorData	edata;
+
+			pq_parse_errornotice(&msg, &edata);
+
+			if (edata.elevel >= FATAL &&
+				edata.sqlerrcode == ERRCODE_ADMIN_SHUTDOWN)
+			{
+				handle->terminated = true;
+				pfree(msg.data);
+				continue;
+			}
+
+			/* The worker exiting is no reason for the walsender to do so */
+			edata.elevel = Min(edata.elevel, ERROR);
+
+			if (edata.context)
+				edata.context = psprintf("%s\n%s", edata.context,
+										 _("logical decoding worker"));
+			else
+				edata.context = pstrdup(_("logical decoding worker"));
+
+			ThrowErrorData(&edata);
+		}
+
+		/* Anything else the worker sent is of no interest here */
+		pfree(msg.data);
+	}
+}
+
+/*
+ * Has the decoding worker reported that it was terminated?
+ *
+ * Only meaningful once HandleDecodingWorkerMessages has been called after
+ * the worker detached.
+ */
+bool
+DecodingWorkerTerminated(DecodingWorkerHandle *handle)
+{
+	return handle->terminated;
+}
+
+/*
+ * Pass on a flush position confirmed by the client.
+ */
+void
+DecodingWorkerConfirmFlush(DecodingWorkerHandle *handle, XLogRecPtr lsn)
+{
+	DecodingWorkerShared *shared = handle->shared;
+	Latch	   *latch;
+
+	SpinLockAcquire(&shared->mutex);
+	if (lsn > shared->confirmed_flush)
+		shared->confirmed_flush = lsn;
+	latch = shared->worker_latch;
+	SpinLockRelease(&shared->mutex);
+
+	if (latch)
+		SetLatch(latch);
+}
+
+/*
+ * Wake up the decoding worker, because more WAL has been flushed.
+ */
+void
+DecodingWorkerWakeup(DecodingWorkerHandle *handle)
+{
+	DecodingWorkerShared *shared = handle->shared;
+	Latch	   *latch;
+
+	SpinLockAcquire(&shared->mutex);
+	latch = shared->worker_latch;
+	SpinLockRelease(&shared->mutex);
+
+	if (latch)
+		SetLatch(latch);
+}
+
+/*
+ * on_dsm_detach callback of the walsender.
+ */
+static void
+decoding_worker_detach(dsm_segment *seg, Datum arg)
+{
+	DecodingWorkerShared *shared = (DecodingWorkerShared *) DatumGetPointer(arg);
+	Latch	   *latch;
+
+	SpinLockAcquire(&shared->mutex);
+	shared->stop = true;
+	latch = shared->worker_latch;
+	SpinLockRelease(&shared->mutex);
+
+	if (latch)
+		SetLatch(latch);
+}
+
+/*
+ * Entry point of the decoding worker.
+ */
+void
+LogicalDecodingWorkerMain(Datum main_arg)
+{
+	dsm_segment *seg;
+	shm_toc    *toc;
+	shm_mq	   *mq;
+	shm_mq_handle *error_mqh;
+	char	   *guc_space;
+	List	   *options;
+	LogicalDecodingContext *ctx;
+	XLogRecPtr	startptr;
+	uint32		nrecords = 0;
+
+	/* Setup signal handling */
+	pqsignal(SIGHUP, decoding_worker_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	dsm_pin_mapping(seg);
+
+	toc = shm_toc_attach(DECODING_WORKER_MAGIC, dsm_segment_address(seg));
+	if (toc == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("invalid magic number in dynamic shared memory segment")));
+
+	MyDecodingWorker = shm_toc_lookup(toc, DECODING_KEY_SHARED, false);
+
+	/* Send errors and notices to the walsender from here on */
+	mq = shm_toc_lookup(toc, DECODING_KEY_ERROR_QUEUE, false);
+	shm_mq_set_sender(mq, MyProc);
+	error_mqh = shm_mq_attach(mq, seg, NULL);
+	pq_redirect_to_shm_mq(seg, error_mqh);
+
+	mq = shm_toc_lookup(toc, DECODING_KEY_DATA_QUEUE, false);
+	shm_mq_set_sender(mq, MyProc);
+	decoding_data_mqh = shm_mq_attach(mq, seg, NULL);
+
+	SpinLockAcquire(&MyDecodingWorker->mutex);
+	MyDecodingWorker->worker_latch = MyLatch;
+	SpinLockRelease(&MyDecodingWorker->mutex);
+
+	if (decoding_worker_stop_requested())
+		proc_exit(0);
+
+	BackgroundWorkerInitializeConnectionByOid(MyDecodingWorker->database_id,
+											  MyDecodingWorker->authenticated_user_id,
+											  0);
+
+	/* Use the same settings as the walsender */
+	guc_space = shm_toc_lookup(toc, DECODING_KEY_GUC, false);
+	StartTransactionCommand();
+	RestoreGUCState(guc_space);
+	CommitTransactionCommand();
+
+	options = (List *) stringToNode(shm_toc_lookup(toc, DECODING_KEY_OPTIONS,
+												   false));
+
+	initStringInfo(&decoding_msg);
+
+	CheckLogicalDecodingRequirements();
+
+	ReplicationSlotAcquire(NameStr(MyDecodingWorker->slotname), true);
+
+	ctx = CreateDecodingContext(MyDecodingWorker->startpoint, options, false,
+								decoding_worker_read_page,
+								decoding_worker_prepare_write,
+								decoding_worker_write,
+								decoding_worker_update_progress);
+
+	/* Report where the walsender has to start from */
+	resetStringInfo(&decoding_msg);
+	pq_sendbyte(&decoding_msg, DECODING_WORKER_MSG_READY);
+	pq_sendint64(&decoding_msg, MyReplicationSlot->data.restart_lsn);
+	pq_sendint64(&decoding_msg, MyReplicationSlot->data.confirmed_flush);
+	decoding_worker_send(decoding_msg.data, decoding_msg.len);
+
+	/* Start reading WAL from the oldest required WAL. */
+	startptr = MyReplicationSlot->data.restart_lsn;
+
+	for (;;)
+	{
+		XLogRecord *record;
+		char	   *errm;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		decoding_worker_confirm();
+
+		record = XLogReadRecord(ctx->reader, startptr, &errm);
+		startptr = InvalidXLogRecPtr;
+
+		/* xlog record was invalid */
+		if (errm != NULL)
+			elog(ERROR, "%s", errm);
+
+		/* the page read callback only gives up if we're asked to stop */
+		if (record == NULL)
+			break;
+
+		LogicalDecodingProcessRecord(ctx, ctx->reader);
+
+		if (++nrecords % DECODING_WORKER_POSITION_INTERVAL == 0)
+			decoding_worker_send_position(ctx->reader->EndRecPtr, false);
+	}
+
+	FreeDecodingContext(ctx);
+	ReplicationSlotRelease();
+
+	proc_exit(0);
+}
+
+/* SIGHUP: set flag to reload configuration at next convenient time */
+static void
+decoding_worker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+
+	/* Waken anything waiting on the process latch */
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Has the walsender gone away?
+ */
+static bool
+decoding_worker_stop_requested(void)
+{
+	bool		stop;
+
+	SpinLockAcquire(&MyDecodingWorker->mutex);
+	stop = MyDecodingWorker->stop;
+	SpinLockRelease(&MyDecodingWorker->mutex);
+
+	return stop;
+}
+
+/*
+ * Advance the slot to the flush position last confirmed by the client.
+ */
+static void
+decoding_worker_confirm(void)
+{
+	XLogRecPtr	lsn;
+
+	SpinLockAcquire(&MyDecodingWorker->mutex);
+	lsn = MyDecodingWorker->confirmed_flush;
+	SpinLockRelease(&MyDecodingWorker->mutex);
+
+	if (lsn > decoding_confirmed_flush)
+	{
+		LogicalConfirmReceivedLocation(lsn);
+		decoding_confirmed_flush = lsn;
+	}
+}
+
+/*
+ * Queue a message for the walsender, waiting for space if necessary.
+ */
+static void
+decoding_worker_send(const char *data, Size len)
+{
+	shm_mq_result res;
+
+	res = shm_mq_send(decoding_data_mqh, len, data, false);
+
+	/* If the walsender has gone away, nobody is interested in our output */
+	if (res != SHM_MQ_SUCCESS)
+		proc_exit(0);
+}
+
+/*
+ * Tell the walsender that everything up to lsn has been decoded, and whether
+ * we're now waiting for more WAL.
+ */
+static void
+decoding_worker_send_position(XLogRecPtr lsn, bool caught_up)
+{
+	if (XLogRecPtrIsInvalid(lsn))
+		return;
+	if (lsn == decoding_position_sent && caught_up == decoding_caught_up_sent)
+		return;
+
+	resetStringInfo(&decoding_msg);
+	pq_sendbyte(&decoding_msg, DECODING_WORKER_MSG_POSITION);
+	pq_sendint64(&decoding_msg, lsn);
+	pq_sendbyte(&decoding_msg, caught_up ? 1 : 0);
+	decoding_worker_send(decoding_msg.data, decoding_msg.len);
+
+	decoding_position_sent = lsn;
+	decoding_caught_up_sent = caught_up;
+}
+
+/*
+ * read_page callback for the decoding worker.
+ *
+ * Waits on our latch until enough WAL has been flushed; the walsender sets
+ * it when it is woken up for newly flushed WAL.  The actual reading is left
+ * to read_local_xlog_page.
+ */
+static int
+decoding_worker_read_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
+						  int reqLen, XLogRecPtr targetRecPtr, char *cur_page,
+						  TimeLineID *pageTLI)
+{
+	XLogRecPtr	loc = targetPagePtr + reqLen;
+
+	for (;;)
+	{
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/* fail if asked to stop, XLogReadRecord will return NULL */
+		if (decoding_worker_stop_requested())
+			return -1;
+
+		decoding_worker_confirm();
+
+		if (RecoveryInProgress() || loc <= GetFlushRecPtr())
+			break;
+
+		/* Let the walsender know that it has everything we could decode */
+		decoding_worker_send_position(state->EndRecPtr, true);
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 DECODING_WORKER_NAPTIME,
+						 WAIT_EVENT_LOGICAL_DECODING_MAIN);
+	}
+
+	return read_local_xlog_page(state, targetPagePtr, reqLen, targetRecPtr,
+								cur_page, pageTLI);
+}
+
+/*
+ * LogicalDecodingContext 'prepare_write' callback.
+ *
+ * Builds the XLogData message exactly as the walsender would; the walsender
+ * fills in the send time when it sends it out.
+ */
+static void
+decoding_worker_prepare_write(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+							  TransactionId xid, bool last_write)
+{
+	/* can't have sync rep confused by sending the same LSN several times */
+	if (!last_write)
+		lsn = InvalidXLogRecPtr;
+
+	resetStringInfo(ctx->out);
+
+	pq_sendbyte(ctx->out, DECODING_WORKER_MSG_DATA);
+	pq_sendint64(ctx->out, lsn);	/* dataStart */
+	pq_sendint64(ctx->out, lsn);	/* walEnd */
+	pq_sendint64(ctx->out, 0);	/* sendtime */
+}
+
+/*
+ * LogicalDecodingContext 'write' callback.
+ */
+static void
+decoding_worker_write(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+					  TransactionId xid, bool last_write)
+{
+	decoding_worker_send(ctx->out->data, ctx->out->len);
+}
+
+/*
+ * LogicalDecodingContext 'update_progress' callback.
+ *
+ * Passes lag tracking samples to the walsender, at most once a second just
+ * like WalSndUpdateProgress.
+ */
+static void
+decoding_worker_update_progress(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+								TransactionId xid)
+{
+	static TimestampTz sendTime = 0;
+	TimestampTz now = GetCurrentTimestamp();
+
+	if (!TimestampDifferenceExceeds(sendTime, now, 1000))
+		return;
+
+	resetStringInfo(&decoding_msg);
+	pq_sendbyte(&decoding_msg, DECODING_WORKER_MSG_PROGRESS);
+	pq_sendint64(&decoding_msg, lsn);
+	pq_sendint64(&decoding_msg, now);
+	decoding_worker_send(decoding_msg.data, decoding_msg.len);
+
+	sendTime = now;
+}
@@ -412,6 +412,9 @@ retry:
 	TIMESTAMP_NOBEGIN(worker->last_recv_time);
 	worker->reply_lsn = InvalidXLogRecPtr;
 	TIMESTAMP_NOBEGIN(worker->reply_time);
+	worker->insert_conflicts = 0;
+	worker->update_conflicts = 0;
+	worker->delete_conflicts = 0;
 
 	/* Before releasing lock, remember generation for future identification. */
 	generation = worker->generation;
@@ -1096,7 +1099,7 @@ IsLogicalLauncher(void)
 Datum
 pg_stat_get_subscription(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_SUBSCRIPTION_COLS	8
+#define PG_STAT_GET_SUBSCRIPTION_COLS	11
 	Oid			subid = PG_ARGISNULL(0) ? InvalidOid : PG_GETARG_OID(0);
 	int			i;
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
@@ -1141,8 +1144,11 @@ pg_stat_get_subscription(PG_FUNCTION_ARGS)
 		int			worker_pid;
 		LogicalRepWorker worker;
 
+		/* the conflict counters are protected by relmutex */
+		SpinLockAcquire(&LogicalRepCtx->workers[i].relmutex);
 		memcpy(&worker, &LogicalRepCtx->workers[i],
 			   sizeof(LogicalRepWorker));
+		SpinLockRelease(&LogicalRepCtx->workers[i].relmutex);
 		if (!worker.proc || !IsBackendPid(worker.proc->pid))
 			continue;
 
@@ -1180,6 +1186,9 @@ pg_stat_get_subscription(PG_FUNCTION_ARGS)
 			nulls[7] = true;
 		else
 			values[7] = TimestampTzGetDatum(worker.reply_time);
+		values[8] = Int64GetDatum(worker.insert_conflicts);
+		values[9] = Int64GetDatum(worker.update_conflicts);
+		values[10] = Int64GetDatum(worker.delete_conflicts);
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 
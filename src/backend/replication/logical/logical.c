@@ -118,7 +118,8 @@ CheckLogicalDecodingRequirements(void)
  * CreateDecodingContext() performing common tasks.
  */
 static LogicalDecodingContext *
-StartupDecodingContext(List *output_plugin_options,
+StartupDecodingContext(char *plugin,
+					   List *output_plugin_options,
 					   XLogRecPtr start_lsn,
 					   TransactionId xmin_horizon,
 					   bool need_full_snapshot,
@@ -149,7 +150,7 @@ StartupDecodingContext(List *output_plugin_options,
 	 * now.
 	 */
 	if (!fast_forward)
-		LoadOutputPlugin(&ctx->callbacks, NameStr(slot->data.plugin));
+		LoadOutputPlugin(&ctx->callbacks, plugin);
 
 	/*
 	 * Now that the slot's xmin has been set, we can announce ourselves as a
@@ -326,7 +327,8 @@ CreateInitDecodingContext(char *plugin,
 	ReplicationSlotMarkDirty();
 	ReplicationSlotSave();
 
-	ctx = StartupDecodingContext(NIL, restart_lsn, xmin_horizon,
+	ctx = StartupDecodingContext(NameStr(slot->data.plugin), NIL,
+								 restart_lsn, xmin_horizon,
 								 need_full_snapshot, false,
 								 read_page, prepare_write, do_write,
 								 update_progress);
@@ -377,6 +379,31 @@ CreateDecodingContext(XLogRecPtr start_lsn,
 					  LogicalOutputPluginWriterPrepareWrite prepare_write,
 					  LogicalOutputPluginWriterWrite do_write,
 					  LogicalOutputPluginWriterUpdateProgress update_progress)
+{
+	return CreateDecodingContextForPlugin(NULL, start_lsn,
+										  output_plugin_options, fast_forward,
+										  read_page, prepare_write, do_write,
+										  update_progress);
+}
+
+/*
+ * Like CreateDecodingContext, but decode through the output plugin named
+ * 'plugin' instead of the one the slot was created with.  A NULL 'plugin'
+ * means the slot's own plugin.
+ *
+ * This lets the changes retained by a slot be fed to a different output
+ * plugin, e.g. for benchmarking, without creating a new slot.  The slot's
+ * plugin is not changed.
+ */
+LogicalDecodingContext *
+CreateDecodingContextForPlugin(char *plugin,
+							   XLogRecPtr start_lsn,
+							   List *output_plugin_options,
+							   bool fast_forward,
+							   XLogPageReadCB read_page,
+							   LogicalOutputPluginWriterPrepareWrite prepare_write,
+							   LogicalOutputPluginWriterWrite do_write,
+							   LogicalOutputPluginWriterUpdateProgress update_progress)
 {
 	LogicalDecodingContext *ctx;
 	ReplicationSlot *slot;
@@ -424,7 +451,10 @@ CreateDecodingContext(XLogRecPtr start_lsn,
 		start_lsn = slot->data.confirmed_flush;
 	}
 
-	ctx = StartupDecodingContext(output_plugin_options,
+	if (plugin == NULL)
+		plugin = NameStr(slot->data.plugin);
+
+	ctx = StartupDecodingContext(plugin, output_plugin_options,
 								 start_lsn, InvalidTransactionId, false,
 								 fast_forward, read_page, prepare_write,
 								 do_write, update_progress);
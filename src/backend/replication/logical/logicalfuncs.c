@@ -32,6 +32,8 @@
 
 #include "mb/pg_wchar.h"
 
+#include "portability/instr_time.h"
+
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/inval.h"
@@ -105,6 +107,51 @@ LogicalOutputWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xi
 	p->returned_rows++;
 }
 
+/*
+ * Output plugin callbacks measured by pg_logical_slot_decoding_benchmark().
+ * The order is the order of the rows it returns.
+ */
+typedef enum DecodingBenchCallback
+{
+	DECODING_BENCH_STARTUP,
+	DECODING_BENCH_BEGIN,
+	DECODING_BENCH_CHANGE,
+	DECODING_BENCH_TRUNCATE,
+	DECODING_BENCH_MESSAGE,
+	DECODING_BENCH_COMMIT,
+	DECODING_BENCH_FILTER_BY_ORIGIN,
+	DECODING_BENCH_SHUTDOWN,
+	DECODING_BENCH_TOTAL
+} DecodingBenchCallback;
+
+#define NUM_DECODING_BENCH_ROWS (DECODING_BENCH_TOTAL + 1)
+
+static const char *const decoding_bench_names[NUM_DECODING_BENCH_ROWS] = {
+	"startup",
+	"begin",
+	"change",
+	"truncate",
+	"message",
+	"commit",
+	"filter_by_origin",
+	"shutdown",
+	"total"
+};
+
+/* private data of pg_logical_slot_decoding_benchmark() */
+typedef struct DecodingBenchState
+{
+	/* the output plugin's own callbacks, called by our wrappers */
+	OutputPluginCallbacks plugin;
+
+	/* callback currently running, output is attributed to it */
+	DecodingBenchCallback current;
+
+	int64		calls[NUM_DECODING_BENCH_ROWS];
+	instr_time	time[NUM_DECODING_BENCH_ROWS];
+	int64		bytes[NUM_DECODING_BENCH_ROWS];
+} DecodingBenchState;
+
 static void
 check_permissions(void)
 {
@@ -122,6 +169,57 @@ logical_read_local_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
 								targetRecPtr, cur_page, pageTLI);
 }
 
+/*
+ * Deconstruct a text[] of alternating option names and values into a list of
+ * DefElems to be passed to the output plugin.
+ */
+static List *
+decoding_options_from_array(ArrayType *arr)
+{
+	Size		ndim;
+	List	   *options = NIL;
+
+	ndim = ARR_NDIM(arr);
+	if (ndim > 1)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("array must be one-dimensional")));
+	}
+	else if (array_contains_nulls(arr))
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("array must not contain nulls")));
+	}
+	else if (ndim == 1)
+	{
+		int			nelems;
+		Datum	   *datum_opts;
+		int			i;
+
+		Assert(ARR_ELEMTYPE(arr) == TEXTOID);
+
+		deconstruct_array(arr, TEXTOID, -1, false, 'i',
+						  &datum_opts, NULL, &nelems);
+
+		if (nelems % 2 != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("array must have even number of elements")));
+
+		for (i = 0; i < nelems; i += 2)
+		{
+			char	   *name = TextDatumGetCString(datum_opts[i]);
+			char	   *opt = TextDatumGetCString(datum_opts[i + 1]);
+
+			options = lappend(options, makeDefElem(name, (Node *) makeString(opt), -1));
+		}
+	}
+
+	return options;
+}
+
 /*
  * Helper function for the various SQL callable logical decoding functions.
  */
@@ -139,8 +237,7 @@ pg_logical_slot_get_changes_guts(FunctionCallInfo fcinfo, bool confirm, bool bin
 	LogicalDecodingContext *ctx;
 	ResourceOwner old_resowner = CurrentResourceOwner;
 	ArrayType  *arr;
-	Size		ndim;
-	List	   *options = NIL;
+	List	   *options;
 	DecodingOutputState *p;
 
 	check_permissions();
@@ -191,44 +288,7 @@ pg_logical_slot_get_changes_guts(FunctionCallInfo fcinfo, bool confirm, bool bin
 	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
 	oldcontext = MemoryContextSwitchTo(per_query_ctx);
 
-	/* Deconstruct options array */
-	ndim = ARR_NDIM(arr);
-	if (ndim > 1)
-	{
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("array must be one-dimensional")));
-	}
-	else if (array_contains_nulls(arr))
-	{
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("array must not contain nulls")));
-	}
-	else if (ndim == 1)
-	{
-		int			nelems;
-		Datum	   *datum_opts;
-		int			i;
-
-		Assert(ARR_ELEMTYPE(arr) == TEXTOID);
-
-		deconstruct_array(arr, TEXTOID, -1, false, 'i',
-						  &datum_opts, NULL, &nelems);
-
-		if (nelems % 2 != 0)
-			ereport(ERROR,
-					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-					 errmsg("array must have even number of elements")));
-
-		for (i = 0; i < nelems; i += 2)
-		{
-			char	   *name = TextDatumGetCString(datum_opts[i]);
-			char	   *opt = TextDatumGetCString(datum_opts[i + 1]);
-
-			options = lappend(options, makeDefElem(name, (Node *) makeString(opt), -1));
-		}
-	}
+	options = decoding_options_from_array(arr);
 
 	p->tupstore = tuplestore_begin_heap(true, false, work_mem);
 	rsinfo->returnMode = SFRM_Materialize;
@@ -404,6 +464,349 @@ pg_logical_slot_peek_binary_changes(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * Bookkeeping around a call of an output plugin callback in
+ * pg_logical_slot_decoding_benchmark().
+ */
+static inline void
+decoding_bench_enter(DecodingBenchState *state, DecodingBenchCallback cb,
+					 instr_time *start)
+{
+	state->calls[cb]++;
+	state->current = cb;
+	INSTR_TIME_SET_CURRENT(*start);
+}
+
+static inline void
+decoding_bench_leave(DecodingBenchState *state, DecodingBenchCallback cb,
+					 instr_time *start)
+{
+	instr_time	end;
+
+	INSTR_TIME_SET_CURRENT(end);
+	INSTR_TIME_ACCUM_DIFF(state->time[cb], end, *start);
+	state->current = DECODING_BENCH_TOTAL;
+}
+
+static void
+decoding_bench_begin_cb(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_BEGIN, &start);
+	state->plugin.begin_cb(ctx, txn);
+	decoding_bench_leave(state, DECODING_BENCH_BEGIN, &start);
+}
+
+static void
+decoding_bench_change_cb(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						 Relation relation, ReorderBufferChange *change)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_CHANGE, &start);
+	state->plugin.change_cb(ctx, txn, relation, change);
+	decoding_bench_leave(state, DECODING_BENCH_CHANGE, &start);
+}
+
+static void
+decoding_bench_truncate_cb(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						   int nrelations, Relation relations[],
+						   ReorderBufferChange *change)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_TRUNCATE, &start);
+	state->plugin.truncate_cb(ctx, txn, nrelations, relations, change);
+	decoding_bench_leave(state, DECODING_BENCH_TRUNCATE, &start);
+}
+
+static void
+decoding_bench_message_cb(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						  XLogRecPtr message_lsn, bool transactional,
+						  const char *prefix, Size message_size,
+						  const char *message)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_MESSAGE, &start);
+	state->plugin.message_cb(ctx, txn, message_lsn, transactional,
+							 prefix, message_size, message);
+	decoding_bench_leave(state, DECODING_BENCH_MESSAGE, &start);
+}
+
+static void
+decoding_bench_commit_cb(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						 XLogRecPtr commit_lsn)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_COMMIT, &start);
+	state->plugin.commit_cb(ctx, txn, commit_lsn);
+	decoding_bench_leave(state, DECODING_BENCH_COMMIT, &start);
+}
+
+static bool
+decoding_bench_filter_by_origin_cb(LogicalDecodingContext *ctx,
+								   RepOriginId origin_id)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+	bool		result;
+
+	decoding_bench_enter(state, DECODING_BENCH_FILTER_BY_ORIGIN, &start);
+	result = state->plugin.filter_by_origin_cb(ctx, origin_id);
+	decoding_bench_leave(state, DECODING_BENCH_FILTER_BY_ORIGIN, &start);
+
+	return result;
+}
+
+static void
+decoding_bench_shutdown_cb(LogicalDecodingContext *ctx)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+	instr_time	start;
+
+	decoding_bench_enter(state, DECODING_BENCH_SHUTDOWN, &start);
+	state->plugin.shutdown_cb(ctx);
+	decoding_bench_leave(state, DECODING_BENCH_SHUTDOWN, &start);
+}
+
+/*
+ * Output plugin write for pg_logical_slot_decoding_benchmark(): only count
+ * the bytes, and throw the data away.
+ */
+static void
+DecodingBenchWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
+				   bool last_write)
+{
+	DecodingBenchState *state = ctx->output_writer_private;
+
+	state->bytes[state->current] += ctx->out->len;
+	state->bytes[DECODING_BENCH_TOTAL] += ctx->out->len;
+}
+
+/*
+ * SQL function decoding the changes retained by a slot through an output
+ * plugin, reporting how often each of the plugin's callbacks was called, the
+ * time spent in it and the amount of output it produced.  The output itself
+ * is discarded, and the slot is not advanced, so the same range of WAL can
+ * be decoded repeatedly, with different plugins or plugin options.
+ *
+ * The 'startup' row covers setting up the decoding context, including
+ * loading the plugin and its startup callback; the 'total' row covers the
+ * whole run, and counts WAL records instead of calls.
+ */
+Datum
+pg_logical_slot_decoding_benchmark(PG_FUNCTION_ARGS)
+{
+	Name		name;
+	XLogRecPtr	start_lsn;
+	XLogRecPtr	upto_lsn;
+	char	   *plugin;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	XLogRecPtr	end_of_wal;
+	XLogRecPtr	startptr;
+	LogicalDecodingContext *ctx;
+	ResourceOwner old_resowner = CurrentResourceOwner;
+	List	   *options;
+	DecodingBenchState *state;
+	instr_time	start;
+	instr_time	end;
+	int			i;
+
+	check_permissions();
+
+	CheckLogicalDecodingRequirements();
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("slot name must not be null")));
+	name = PG_GETARG_NAME(0);
+
+	if (PG_ARGISNULL(1))
+		start_lsn = InvalidXLogRecPtr;
+	else
+		start_lsn = PG_GETARG_LSN(1);
+
+	if (PG_ARGISNULL(2))
+		upto_lsn = InvalidXLogRecPtr;
+	else
+		upto_lsn = PG_GETARG_LSN(2);
+
+	if (PG_ARGISNULL(3))
+		plugin = NULL;
+	else
+		plugin = pstrdup(NameStr(*PG_GETARG_NAME(3)));
+
+	if (PG_ARGISNULL(4))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("options array must not be null")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	options = decoding_options_from_array(PG_GETARG_ARRAYTYPE_P(4));
+
+	state = palloc0(sizeof(DecodingBenchState));
+	state->current = DECODING_BENCH_TOTAL;
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	/*
+	 * Compute the current end-of-wal and maintain ThisTimeLineID.
+	 * RecoveryInProgress() will update ThisTimeLineID on promotion.
+	 */
+	if (!RecoveryInProgress())
+		end_of_wal = GetFlushRecPtr();
+	else
+		end_of_wal = GetXLogReplayRecPtr(&ThisTimeLineID);
+
+	ReplicationSlotAcquire(NameStr(*name), true);
+
+	PG_TRY();
+	{
+		INSTR_TIME_SET_CURRENT(start);
+
+		state->calls[DECODING_BENCH_STARTUP]++;
+		ctx = CreateDecodingContextForPlugin(plugin,
+											 start_lsn,
+											 options,
+											 false,
+											 logical_read_local_xlog_page,
+											 LogicalOutputPrepareWrite,
+											 DecodingBenchWrite, NULL);
+
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(state->time[DECODING_BENCH_STARTUP], end, start);
+
+		MemoryContextSwitchTo(oldcontext);
+
+		ctx->output_writer_private = state;
+
+		/*
+		 * Interpose our wrappers between the reorder buffer and the plugin.
+		 * Callbacks the plugin doesn't have stay unset, so that decoding
+		 * behaves exactly as it does without us.
+		 */
+		state->plugin = ctx->callbacks;
+		if (state->plugin.begin_cb)
+			ctx->callbacks.begin_cb = decoding_bench_begin_cb;
+		if (state->plugin.change_cb)
+			ctx->callbacks.change_cb = decoding_bench_change_cb;
+		if (state->plugin.truncate_cb)
+			ctx->callbacks.truncate_cb = decoding_bench_truncate_cb;
+		if (state->plugin.message_cb)
+			ctx->callbacks.message_cb = decoding_bench_message_cb;
+		if (state->plugin.commit_cb)
+			ctx->callbacks.commit_cb = decoding_bench_commit_cb;
+		if (state->plugin.filter_by_origin_cb)
+			ctx->callbacks.filter_by_origin_cb = decoding_bench_filter_by_origin_cb;
+		if (state->plugin.shutdown_cb)
+			ctx->callbacks.shutdown_cb = decoding_bench_shutdown_cb;
+
+		startptr = MyReplicationSlot->data.restart_lsn;
+
+		/* invalidate non-timetravel entries */
+		InvalidateSystemCaches();
+
+		/* Decode until we run out of records */
+		while ((startptr != InvalidXLogRecPtr && startptr < end_of_wal) ||
+			   (ctx->reader->EndRecPtr != InvalidXLogRecPtr && ctx->reader->EndRecPtr < end_of_wal))
+		{
+			XLogRecord *record;
+			char	   *errm = NULL;
+
+			record = XLogReadRecord(ctx->reader, startptr, &errm);
+			if (errm)
+				elog(ERROR, "%s", errm);
+
+			startptr = InvalidXLogRecPtr;
+
+			if (record != NULL)
+			{
+				state->calls[DECODING_BENCH_TOTAL]++;
+				LogicalDecodingProcessRecord(ctx, ctx->reader);
+			}
+
+			/* check limits */
+			if (upto_lsn != InvalidXLogRecPtr &&
+				upto_lsn <= ctx->reader->EndRecPtr)
+				break;
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		/*
+		 * Logical decoding could have clobbered CurrentResourceOwner during
+		 * transaction management, so restore the executor's value.
+		 */
+		CurrentResourceOwner = old_resowner;
+
+		/* free context, call shutdown callback; the slot is left alone */
+		FreeDecodingContext(ctx);
+
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(state->time[DECODING_BENCH_TOTAL], end, start);
+
+		ReplicationSlotRelease();
+		InvalidateSystemCaches();
+	}
+	PG_CATCH();
+	{
+		/* clear all timetravel entries */
+		InvalidateSystemCaches();
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	for (i = 0; i < NUM_DECODING_BENCH_ROWS; i++)
+	{
+		Datum		values[4];
+		bool		nulls[4];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(decoding_bench_names[i]);
+		values[1] = Int64GetDatum(state->calls[i]);
+		values[2] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(state->time[i]));
+		values[3] = Int64GetDatum(state->bytes[i]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
 /*
  * SQL function for writing logical decoding message into WAL.
  */
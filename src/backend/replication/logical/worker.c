@@ -23,6 +23,9 @@
 
 #include "postgres.h"
 
+#include "access/commit_ts.h"
+#include "access/relation.h"
+#include "access/sysattr.h"
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/xact.h"
@@ -87,6 +90,26 @@ typedef struct FlushPosition
 
 static dlist_head lsn_mapping = DLIST_STATIC_INIT(lsn_mapping);
 
+/*
+ * Kinds of conflicts detected while applying remote changes.
+ */
+typedef enum ApplyConflictType
+{
+	APPLY_CONFLICT_INSERT_EXISTS,	/* row with the same unique key exists */
+	APPLY_CONFLICT_UPDATE_MISSING,	/* row to be updated not found */
+	APPLY_CONFLICT_UPDATE_DIFFERS,	/* local row is newer than the update */
+	APPLY_CONFLICT_DELETE_MISSING,	/* row to be deleted not found */
+	APPLY_CONFLICT_DELETE_DIFFERS	/* local row is newer than the delete */
+} ApplyConflictType;
+
+static const char *const ApplyConflictTypeNames[] = {
+	"insert_exists",
+	"update_missing",
+	"update_differs",
+	"delete_missing",
+	"delete_differs"
+};
+
 typedef struct SlotErrCallbackArg
 {
 	LogicalRepRelMapEntry *rel;
@@ -106,6 +129,7 @@ bool		in_remote_transaction = false;
 static XLogRecPtr remote_final_lsn = InvalidXLogRecPtr;
 static XLogRecPtr remote_origin_lsn = InvalidXLogRecPtr;
 static RepOriginId remote_origin_id = InvalidRepOriginId;
+static TimestampTz remote_commit_ts = 0;
 
 static void send_feedback(XLogRecPtr recvpos, bool force, bool requestReply);
 
@@ -445,6 +469,7 @@ apply_handle_begin(StringInfo s)
 
 	remote_final_lsn = begin_data.final_lsn;
 	remote_origin_id = InvalidRepOriginId;
+	remote_commit_ts = begin_data.committime;
 
 	elog(DEBUG1, "BEGIN: remote origin: %u ; session origin: %u", remote_origin_id, replorigin_session_origin);
 
@@ -577,6 +602,343 @@ GetRelationIdentityOrPK(Relation rel)
 	return idxoid;
 }
 
+/*
+ * Search for a local row that would make inserting the remote tuple fail
+ * with a unique violation.
+ *
+ * Only unique indexes on plain columns without predicate can be checked,
+ * and a remote tuple with NULL in any key column can't conflict there.  A
+ * violation of any other index is still reported by the insert itself.
+ *
+ * If a row is found, it is locked and stored in localslot.
+ */
+static bool
+find_conflicting_tuple(EState *estate, TupleTableSlot *remoteslot,
+					   TupleTableSlot *localslot)
+{
+	ResultRelInfo *relinfo = estate->es_result_relation_info;
+	int			i;
+
+	for (i = 0; i < relinfo->ri_NumIndices; i++)
+	{
+		IndexInfo  *ii = relinfo->ri_IndexRelationInfo[i];
+		Relation	idxrel = relinfo->ri_IndexRelationDescs[i];
+		bool		usable = true;
+		int			j;
+
+		if (!ii->ii_Unique || !ii->ii_ReadyForInserts ||
+			ii->ii_Expressions != NIL || ii->ii_Predicate != NIL)
+			continue;
+
+		for (j = 0; j < ii->ii_NumIndexKeyAttrs; j++)
+		{
+			AttrNumber	attnum = ii->ii_IndexAttrNumbers[j];
+
+			if (attnum <= 0 || remoteslot->tts_isnull[attnum - 1])
+			{
+				usable = false;
+				break;
+			}
+		}
+
+		if (usable &&
+			RelationFindReplTupleByIndex(relinfo->ri_RelationDesc,
+										 RelationGetRelid(idxrel),
+										 LockTupleExclusive,
+										 remoteslot, localslot))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Compare the contents of two slots of the same relation, in their binary
+ * send format, for an ordering that doesn't depend on any node-local
+ * settings.
+ */
+static int
+compare_slot_contents(TupleTableSlot *slot1, TupleTableSlot *slot2)
+{
+	bytea	   *data1;
+	bytea	   *data2;
+	Size		len1;
+	Size		len2;
+	int			cmp;
+
+	data1 = OidSendFunctionCall(F_RECORD_SEND,
+								ExecFetchSlotHeapTupleDatum(slot1));
+	data2 = OidSendFunctionCall(F_RECORD_SEND,
+								ExecFetchSlotHeapTupleDatum(slot2));
+	len1 = VARSIZE(data1) - VARHDRSZ;
+	len2 = VARSIZE(data2) - VARHDRSZ;
+
+	cmp = memcmp(VARDATA(data1), VARDATA(data2), Min(len1, len2));
+	if (cmp == 0 && len1 != len2)
+		cmp = (len1 < len2) ? -1 : 1;
+
+	pfree(data1);
+	pfree(data2);
+
+	return cmp;
+}
+
+/*
+ * Is the local row newer than the remote transaction being applied?
+ *
+ * Used by last_update_wins.  The commit timestamp of the transaction that
+ * wrote the row is compared with the commit timestamp of the remote
+ * transaction.  Rows written by a replicated transaction carry the commit
+ * timestamp of their origin, so this gives the same answer on every node of
+ * the mesh.  Without track_commit_timestamp there is nothing to compare, and
+ * the remote change always wins.
+ *
+ * When the timestamps are equal, the node that made the remote change is
+ * deciding between the same two versions of the row the other way around,
+ * and neither node knows a global identifier for the other.  So the tie is
+ * broken on the contents of the versions, in binary format, which both
+ * nodes see alike as long as the table has the same columns on both.
+ * remoteslot is the row as the remote change would leave it, or NULL for a
+ * delete, which wins ties; the node that made it will find the row missing
+ * when it applies ours.
+ */
+static bool
+local_tuple_is_newer(TupleTableSlot *localslot, TupleTableSlot *remoteslot)
+{
+	static bool warned = false;
+	TransactionId xmin;
+	TimestampTz local_ts;
+	RepOriginId local_origin;
+	bool		isnull;
+
+	if (!track_commit_timestamp)
+	{
+		if (!warned)
+			ereport(WARNING,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("conflict resolution \"%s\" of subscription \"%s\" requires \"%s\"",
+							"last_update_wins", MySubscription->name,
+							"track_commit_timestamp"),
+					 errdetail("Remote changes will always be applied.")));
+		warned = true;
+		return false;
+	}
+
+	xmin = DatumGetTransactionId(slot_getsysattr(localslot,
+												 MinTransactionIdAttributeNumber,
+												 &isnull));
+	Assert(!isnull);
+
+	/* Rows written by the remote transaction itself are never newer. */
+	if (TransactionIdIsCurrentTransactionId(xmin))
+		return false;
+
+	if (!TransactionIdGetCommitTsData(xmin, &local_ts, &local_origin))
+		return false;
+
+	if (local_ts != remote_commit_ts)
+		return local_ts > remote_commit_ts;
+
+	if (remoteslot == NULL)
+		return false;
+
+	return compare_slot_contents(localslot, remoteslot) > 0;
+}
+
+/*
+ * Convert the contents of a slot to its row literal representation.
+ */
+static char *
+slot_to_cstring(TupleTableSlot *slot)
+{
+	Datum		rowdatum;
+
+	if (slot == NULL || TTS_EMPTY(slot))
+		return NULL;
+
+	rowdatum = ExecFetchSlotHeapTupleDatum(slot);
+
+	return OidOutputFunctionCall(F_RECORD_OUT, rowdatum);
+}
+
+/*
+ * Insert a row describing an apply conflict into the conflict table of the
+ * subscription.
+ *
+ * Columns are matched by name, and filled through the input function of
+ * their type, so the table is free to use e.g. text or regclass for relname.
+ * Columns we don't know about get their default.  Recognized columns are:
+ * subname, relname, conflict_type, resolution, local_tuple, remote_tuple,
+ * remote_origin, remote_commit_ts and remote_commit_lsn.
+ *
+ * The subscription depends on its conflict table, so the table can't
+ * normally be dropped under us; but if it is gone anyway we only warn, since
+ * the conflict has already been reported in the server log, rather than
+ * erroring out and having the apply worker restart over and over.
+ */
+static void
+log_apply_conflict(LogicalRepRelMapEntry *rel, ApplyConflictType type,
+				   const char *resolution, const char *local_tuple,
+				   const char *remote_tuple)
+{
+	Relation	logrel;
+	EState	   *estate;
+	ExprContext *econtext;
+	TupleTableSlot *slot;
+	TupleDesc	desc;
+	char	   *origin = NULL;
+	int			i;
+
+	logrel = try_relation_open(MySubscription->conflictrelid,
+							   RowExclusiveLock);
+	if (logrel == NULL || logrel->rd_rel->relkind != RELKIND_RELATION)
+	{
+		if (logrel != NULL)
+			relation_close(logrel, RowExclusiveLock);
+		ereport(WARNING,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("conflict table of logical replication subscription \"%s\" does not exist",
+						MySubscription->name),
+				 errdetail("Conflict %s in relation \"%s.%s\" was not logged to the conflict table.",
+						   ApplyConflictTypeNames[type],
+						   rel->remoterel.nspname, rel->remoterel.relname)));
+		return;
+	}
+	desc = RelationGetDescr(logrel);
+
+	estate = create_estate_for_relation(logrel);
+	econtext = GetPerTupleExprContext(estate);
+	slot = ExecInitExtraTupleSlot(estate, desc, &TTSOpsVirtual);
+	ExecClearTuple(slot);
+
+	if (remote_origin_id != InvalidRepOriginId)
+		replorigin_by_oid(remote_origin_id, true, &origin);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, i);
+		const char *attname = NameStr(att->attname);
+		const char *value = NULL;
+		bool		known = true;
+
+		slot->tts_values[i] = (Datum) 0;
+		slot->tts_isnull[i] = true;
+
+		if (att->attisdropped || att->attgenerated)
+			continue;
+
+		if (strcmp(attname, "subname") == 0)
+			value = MySubscription->name;
+		else if (strcmp(attname, "relname") == 0)
+			value = quote_qualified_identifier(rel->remoterel.nspname,
+											   rel->remoterel.relname);
+		else if (strcmp(attname, "conflict_type") == 0)
+			value = ApplyConflictTypeNames[type];
+		else if (strcmp(attname, "resolution") == 0)
+			value = resolution;
+		else if (strcmp(attname, "local_tuple") == 0)
+			value = local_tuple;
+		else if (strcmp(attname, "remote_tuple") == 0)
+			value = remote_tuple;
+		else if (strcmp(attname, "remote_origin") == 0)
+			value = origin;
+		else if (strcmp(attname, "remote_commit_ts") == 0)
+			value = timestamptz_to_str(remote_commit_ts);
+		else if (strcmp(attname, "remote_commit_lsn") == 0)
+			value = psprintf("%X/%X", (uint32) (remote_final_lsn >> 32),
+							 (uint32) remote_final_lsn);
+		else
+			known = false;
+
+		if (known)
+		{
+			if (value != NULL)
+			{
+				Oid			typinput;
+				Oid			typioparam;
+
+				getTypeInputInfo(att->atttypid, &typinput, &typioparam);
+				slot->tts_values[i] = OidInputFunctionCall(typinput,
+														   (char *) value,
+														   typioparam,
+														   att->atttypmod);
+				slot->tts_isnull[i] = false;
+			}
+		}
+		else
+		{
+			Expr	   *defexpr;
+
+			defexpr = (Expr *) build_column_default(logrel, i + 1);
+			if (defexpr != NULL)
+			{
+				ExprState  *defstate;
+
+				defstate = ExecInitExpr(expression_planner(defexpr), NULL);
+				slot->tts_values[i] = ExecEvalExpr(defstate, econtext,
+												   &slot->tts_isnull[i]);
+			}
+		}
+	}
+	ExecStoreVirtualTuple(slot);
+
+	ExecOpenIndices(estate->es_result_relation_info, false);
+	ExecSimpleRelationInsert(estate, slot);
+	ExecCloseIndices(estate->es_result_relation_info);
+
+	AfterTriggerEndQuery(estate);
+
+	ExecResetTupleTable(estate->es_tupleTable, false);
+	FreeExecutorState(estate);
+
+	table_close(logrel, NoLock);
+}
+
+/*
+ * Report a conflict detected while applying a remote change.
+ *
+ * Bumps the conflict counters shown in pg_stat_subscription, logs the
+ * conflict, and with conflict_resolution = log also records it in the
+ * conflict table.  The caller is responsible for actually resolving it.
+ */
+static void
+report_apply_conflict(LogicalRepRelMapEntry *rel, ApplyConflictType type,
+					  const char *resolution, TupleTableSlot *localslot,
+					  TupleTableSlot *remoteslot)
+{
+	char	   *local_tuple = slot_to_cstring(localslot);
+	char	   *remote_tuple = slot_to_cstring(remoteslot);
+
+	SpinLockAcquire(&MyLogicalRepWorker->relmutex);
+	switch (type)
+	{
+		case APPLY_CONFLICT_INSERT_EXISTS:
+			MyLogicalRepWorker->insert_conflicts++;
+			break;
+		case APPLY_CONFLICT_UPDATE_MISSING:
+		case APPLY_CONFLICT_UPDATE_DIFFERS:
+			MyLogicalRepWorker->update_conflicts++;
+			break;
+		case APPLY_CONFLICT_DELETE_MISSING:
+		case APPLY_CONFLICT_DELETE_DIFFERS:
+			MyLogicalRepWorker->delete_conflicts++;
+			break;
+	}
+	SpinLockRelease(&MyLogicalRepWorker->relmutex);
+
+	ereport(LOG,
+			(errmsg("logical replication conflict %s in relation \"%s.%s\" resolved by %s",
+					ApplyConflictTypeNames[type],
+					rel->remoterel.nspname, rel->remoterel.relname,
+					resolution),
+			 local_tuple ? errdetail("Local tuple: %s, remote tuple: %s.",
+									 local_tuple,
+									 remote_tuple ? remote_tuple : "NULL") : 0));
+
+	if (MySubscription->conflictres == SUBCONFLICT_LOG)
+		log_apply_conflict(rel, type, resolution, local_tuple, remote_tuple);
+}
+
 /*
  * Handle INSERT message.
  */
@@ -588,6 +950,7 @@ apply_handle_insert(StringInfo s)
 	LogicalRepRelId relid;
 	EState	   *estate;
 	TupleTableSlot *remoteslot;
+	TupleTableSlot *localslot = NULL;
 	MemoryContext oldctx;
 
 	elog(DEBUG1, "INSERT: remote origin: %u ; session origin: %u", remote_origin_id, replorigin_session_origin);
@@ -623,8 +986,40 @@ apply_handle_insert(StringInfo s)
 
 	ExecOpenIndices(estate->es_result_relation_info, false);
 
-	/* Do the insert. */
-	ExecSimpleRelationInsert(estate, remoteslot);
+	/*
+	 * Unless conflicts are left to the unique indexes, look for a local row
+	 * the remote one clashes with before trying to insert it.
+	 */
+	if (MySubscription->conflictres != SUBCONFLICT_ERROR)
+	{
+		localslot = table_slot_create(rel->localrel,
+									  &estate->es_tupleTable);
+		if (!find_conflicting_tuple(estate, remoteslot, localslot))
+			ExecClearTuple(localslot);
+	}
+
+	if (localslot == NULL || TTS_EMPTY(localslot))
+	{
+		/* Do the insert. */
+		ExecSimpleRelationInsert(estate, remoteslot);
+	}
+	else if (MySubscription->conflictres == SUBCONFLICT_LAST_UPDATE_WINS &&
+			 !local_tuple_is_newer(localslot, remoteslot))
+	{
+		EPQState	epqstate;
+
+		report_apply_conflict(rel, APPLY_CONFLICT_INSERT_EXISTS,
+							  "apply_remote", localslot, remoteslot);
+
+		/* The remote row is newer, so it replaces the local one. */
+		EvalPlanQualInit(&epqstate, estate, NULL, NIL, -1);
+		EvalPlanQualSetSlot(&epqstate, remoteslot);
+		ExecSimpleRelationUpdate(estate, &epqstate, localslot, remoteslot);
+		EvalPlanQualEnd(&epqstate);
+	}
+	else
+		report_apply_conflict(rel, APPLY_CONFLICT_INSERT_EXISTS,
+							  "skip", localslot, remoteslot);
 
 	/* Cleanup. */
 	ExecCloseIndices(estate->es_result_relation_info);
@@ -751,11 +1146,6 @@ apply_handle_update(StringInfo s)
 
 	ExecClearTuple(remoteslot);
 
-	/*
-	 * Tuple found.
-	 *
-	 * Note this will fail if there are other conflicting unique indexes.
-	 */
 	if (found)
 	{
 		/* Process and store remote tuple in the slot */
@@ -763,12 +1153,38 @@ apply_handle_update(StringInfo s)
 		ExecCopySlot(remoteslot, localslot);
 		slot_modify_cstrings(remoteslot, rel, newtup.values, newtup.changed);
 		MemoryContextSwitchTo(oldctx);
+	}
 
+	/* With last_update_wins, a newer local row is kept as is. */
+	if (found &&
+		MySubscription->conflictres == SUBCONFLICT_LAST_UPDATE_WINS &&
+		local_tuple_is_newer(localslot, remoteslot))
+	{
+		report_apply_conflict(rel, APPLY_CONFLICT_UPDATE_DIFFERS,
+							  "keep_local", localslot, remoteslot);
+	}
+
+	/*
+	 * Tuple found.
+	 *
+	 * Note this will fail if there are other conflicting unique indexes.
+	 */
+	else if (found)
+	{
 		EvalPlanQualSetSlot(&epqstate, remoteslot);
 
 		/* Do the actual update. */
 		ExecSimpleRelationUpdate(estate, &epqstate, localslot, remoteslot);
 	}
+	else if (MySubscription->conflictres != SUBCONFLICT_ERROR)
+	{
+		/*
+		 * The tuple to be updated could not be found.  There is no way to
+		 * rebuild it from the changed columns alone, so it's always skipped.
+		 */
+		report_apply_conflict(rel, APPLY_CONFLICT_UPDATE_MISSING,
+							  "skip", NULL, NULL);
+	}
 	else
 	{
 		/*
@@ -868,14 +1284,28 @@ apply_handle_delete(StringInfo s)
 	else
 		found = RelationFindReplTupleSeq(rel->localrel, LockTupleExclusive,
 										 remoteslot, localslot);
+	/* With last_update_wins, a newer local row survives the delete. */
+	if (found &&
+		MySubscription->conflictres == SUBCONFLICT_LAST_UPDATE_WINS &&
+		local_tuple_is_newer(localslot, NULL))
+	{
+		report_apply_conflict(rel, APPLY_CONFLICT_DELETE_DIFFERS,
+							  "keep_local", localslot, NULL);
+	}
 	/* If found delete it. */
-	if (found)
+	else if (found)
 	{
 		EvalPlanQualSetSlot(&epqstate, localslot);
 
 		/* Do the actual delete. */
 		ExecSimpleRelationDelete(estate, &epqstate, localslot);
 	}
+	else if (MySubscription->conflictres != SUBCONFLICT_ERROR)
+	{
+		/* The tuple to be deleted could not be found. */
+		report_apply_conflict(rel, APPLY_CONFLICT_DELETE_MISSING,
+							  "skip", NULL, remoteslot);
+	}
 	else
 	{
 		/* The tuple to be deleted could not be found. */
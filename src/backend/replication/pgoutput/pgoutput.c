@@ -28,6 +28,7 @@
 #include "replication/logicalrelation.h"
 #include "replication/origin.h"
 #include "replication/pgoutput.h"
+#include "replication/walsender.h"
 
 #include "utils/builtins.h"
 #include "utils/inval.h"
@@ -59,11 +60,27 @@ static bool pgoutput_origin_filter(LogicalDecodingContext *ctx,
 
 static bool publications_valid;
 
+/*
+ * PUBLICATIONOID syscache hash values of the currently loaded publications,
+ * so that invalidations of unrelated publications can be ignored.
+ */
+static List *publication_hashes = NIL;
+
 static List *LoadPublications(List *pubnames);
 static void publication_invalidation_cb(Datum arg, int cacheid,
 										uint32 hashvalue);
 
-/* Entry in the map used to remember which relation schemas we sent. */
+/*
+ * Entry in the map used to remember which relation schemas we sent.
+ *
+ * Besides the publication info, each entry remembers the syscache hash
+ * values it was built from: pub_hashes holds the PUBLICATIONOID hashes of
+ * the publications that contributed to pubactions, and map_hashes holds the
+ * PUBLICATIONRELMAP hashes of (relid, pubid) for every requested
+ * publication.  Invalidation callbacks use them to only mark the affected
+ * entries as invalid instead of the whole cache.  A hash collision merely
+ * causes a spurious rebuild.
+ */
 typedef struct RelationSyncEntry
 {
 	Oid			relid;			/* relation oid */
@@ -71,6 +88,8 @@ typedef struct RelationSyncEntry
 	bool		replicate_valid;
 	PublicationActions pubactions;
 	List		*row_filter;
+	List		*pub_hashes;	/* PUBLICATIONOID hash values */
+	List		*map_hashes;	/* PUBLICATIONRELMAP hash values */
 } RelationSyncEntry;
 
 /* Map used to remember which relation schemas we sent. */
@@ -639,10 +658,18 @@ LoadPublications(List *pubnames)
 
 /*
  * Publication cache invalidation callback.
+ *
+ * A hash value of zero means the whole syscache was reset, so we can't tell
+ * which publication changed.  Otherwise only care about the publications we
+ * have loaded; changes to other publications can't affect this session.
  */
 static void
 publication_invalidation_cb(Datum arg, int cacheid, uint32 hashvalue)
 {
+	if (hashvalue != 0 && publications_valid &&
+		!list_member_int(publication_hashes, (int) hashvalue))
+		return;
+
 	publications_valid = false;
 
 	/*
@@ -708,24 +735,59 @@ get_rel_sync_entry(PGOutputData *data, Oid relid)
 	MemoryContextSwitchTo(oldctx);
 	Assert(entry != NULL);
 
+	if (!found)
+	{
+		entry->replicate_valid = false;
+		entry->row_filter = NIL;
+		entry->pub_hashes = NIL;
+		entry->map_hashes = NIL;
+	}
+
 	/* Not found means schema wasn't sent */
 	if (!found || !entry->replicate_valid)
 	{
 		List	   *pubids = GetRelationPublications(relid);
 		ListCell   *lc;
+		int64		npubreloads = 0;
 
 		/* Reload publications if needed before use. */
 		if (!publications_valid)
 		{
 			oldctx = MemoryContextSwitchTo(CacheMemoryContext);
 			if (data->publications)
+			{
 				list_free_deep(data->publications);
+				npubreloads++;
+			}
+			list_free(publication_hashes);
+			publication_hashes = NIL;
 
 			data->publications = LoadPublications(data->publication_names);
+			foreach(lc, data->publications)
+			{
+				Publication *pub = lfirst(lc);
+
+				publication_hashes =
+					lappend_int(publication_hashes,
+								(int) GetSysCacheHashValue1(PUBLICATIONOID,
+															ObjectIdGetDatum(pub->oid)));
+			}
 			MemoryContextSwitchTo(oldctx);
 			publications_valid = true;
 		}
 
+		/*
+		 * Release what a previous build left behind.  This is not done by the
+		 * invalidation callbacks, as those can fire while the old lists are
+		 * still being used, e.g. while evaluating a row filter.
+		 */
+		list_free(entry->row_filter);
+		list_free(entry->pub_hashes);
+		list_free(entry->map_hashes);
+
+		if (found || npubreloads > 0)
+			WalSndReportCacheRebuild(found ? 1 : 0, npubreloads);
+
 		/*
 		 * Build publication cache. We can't use one provided by relcache as
 		 * relcache considers all publications given relation is in, but here
@@ -734,6 +796,8 @@ get_rel_sync_entry(PGOutputData *data, Oid relid)
 		entry->pubactions.pubinsert = entry->pubactions.pubupdate =
 			entry->pubactions.pubdelete = entry->pubactions.pubtruncate = false;
 		entry->row_filter = NIL;
+		entry->pub_hashes = NIL;
+		entry->map_hashes = NIL;
 
 		foreach(lc, data->publications)
 		{
@@ -742,13 +806,26 @@ get_rel_sync_entry(PGOutputData *data, Oid relid)
 			Datum		rf_datum;
 			bool		rf_isnull;
 
+			oldctx = MemoryContextSwitchTo(CacheMemoryContext);
+			entry->map_hashes =
+				lappend_int(entry->map_hashes,
+							(int) GetSysCacheHashValue2(PUBLICATIONRELMAP,
+														ObjectIdGetDatum(relid),
+														ObjectIdGetDatum(pub->oid)));
+
 			if (pub->alltables || list_member_oid(pubids, pub->oid))
 			{
 				entry->pubactions.pubinsert |= pub->pubactions.pubinsert;
 				entry->pubactions.pubupdate |= pub->pubactions.pubupdate;
 				entry->pubactions.pubdelete |= pub->pubactions.pubdelete;
 				entry->pubactions.pubtruncate |= pub->pubactions.pubtruncate;
+
+				entry->pub_hashes =
+					lappend_int(entry->pub_hashes,
+								(int) GetSysCacheHashValue1(PUBLICATIONOID,
+															ObjectIdGetDatum(pub->oid)));
 			}
+			MemoryContextSwitchTo(oldctx);
 
 			/* Cache row filters, if available */
 			rf_tuple = SearchSysCache2(PUBLICATIONRELMAP, ObjectIdGetDatum(relid), ObjectIdGetDatum(pub->oid));
@@ -823,6 +900,10 @@ rel_sync_cache_relation_cb(Datum arg, Oid relid)
 
 /*
  * Publication relation map syscache invalidation callback
+ *
+ * Also used for publication invalidations, in which case cacheid is
+ * PUBLICATIONOID and the hash value is matched against the publications
+ * each entry was built from.
  */
 static void
 rel_sync_cache_publication_cb(Datum arg, int cacheid, uint32 hashvalue)
@@ -839,15 +920,25 @@ rel_sync_cache_publication_cb(Datum arg, int cacheid, uint32 hashvalue)
 		return;
 
 	/*
-	 * There is no way to find which entry in our cache the hash belongs to so
-	 * mark the whole cache as invalid.
+	 * The hash value can't be mapped back to a relation, so check it against
+	 * the hash values remembered by each entry.  A zero hash value means all
+	 * entries must go.  Entries are only marked invalid here; the old lists
+	 * are freed on rebuild, see get_rel_sync_entry.
 	 */
 	hash_seq_init(&status, RelationSyncCache);
 	while ((entry = (RelationSyncEntry *) hash_seq_search(&status)) != NULL)
 	{
-		entry->replicate_valid = false;
-		if (list_length(entry->row_filter) > 0)
-			list_free(entry->row_filter);
-		entry->row_filter = NIL;
+		List	   *hashes;
+
+		if (!entry->replicate_valid || hashvalue == 0)
+		{
+			entry->replicate_valid = false;
+			continue;
+		}
+
+		hashes = (cacheid == PUBLICATIONOID) ?
+			entry->pub_hashes : entry->map_hashes;
+		if (list_member_int(hashes, (int) hashvalue))
+			entry->replicate_valid = false;
 	}
 }
@@ -68,6 +68,7 @@
 #include "pgstat.h"
 #include "replication/basebackup.h"
 #include "replication/decode.h"
+#include "replication/decodeworker.h"
 #include "replication/logical.h"
 #include "replication/logicalfuncs.h"
 #include "replication/slot.h"
@@ -122,6 +123,7 @@ int			max_wal_senders = 0;	/* the maximum number of concurrent
 int			wal_sender_timeout = 60 * 1000; /* maximum time to send one WAL
 											 * data message */
 bool		log_replication_commands = false;
+bool		logical_decoding_pipeline = false;
 
 /*
  * State for WalSndWakeupRequest
@@ -200,6 +202,14 @@ static volatile sig_atomic_t replication_active = false;
 static LogicalDecodingContext *logical_decoding_ctx = NULL;
 static XLogRecPtr logical_startptr = InvalidXLogRecPtr;
 
+/*
+ * Background worker doing the decoding for us, if logical_decoding_pipeline
+ * is enabled.
+ */
+static DecodingWorkerHandle *decoding_worker = NULL;
+static XLogRecPtr decoding_worker_flush = InvalidXLogRecPtr;
+static bool decoding_worker_caught_up = false;
+
 /* A sample associating a WAL location with the time it was written. */
 typedef struct
 {
@@ -233,6 +243,9 @@ static void WalSndKill(int code, Datum arg);
 static void WalSndShutdown(void) pg_attribute_noreturn();
 static void XLogSendPhysical(void);
 static void XLogSendLogical(void);
+static void XLogSendLogicalPipelined(void);
+static void WaitForDecodingWorkerStartup(XLogRecPtr *restart_lsn,
+										 XLogRecPtr *confirmed_flush);
 static void WalSndDone(WalSndSendDataCallback send_data);
 static XLogRecPtr GetStandbyFlushRecPtr(void);
 static void IdentifySystem(void);
@@ -307,6 +320,12 @@ WalSndErrorCleanup(void)
 		sendFile = -1;
 	}
 
+	if (decoding_worker != NULL)
+	{
+		StopDecodingWorker(decoding_worker);
+		decoding_worker = NULL;
+	}
+
 	if (MyReplicationSlot != NULL)
 		ReplicationSlotRelease();
 
@@ -1063,13 +1082,33 @@ static void
 StartLogicalReplication(StartReplicationCmd *cmd)
 {
 	StringInfoData buf;
+	XLogRecPtr	restart_lsn;
+	XLogRecPtr	confirmed_flush;
 
 	/* make sure that our requirements are still fulfilled */
 	CheckLogicalDecodingRequirements();
 
 	Assert(!MyReplicationSlot);
+	Assert(decoding_worker == NULL);
 
-	ReplicationSlotAcquire(cmd->slotname, true);
+	/*
+	 * If requested, have a background worker acquire the slot and do the
+	 * decoding, while we only pass its output on to the client.  If no
+	 * worker can be started, decode by ourselves.
+	 */
+	if (logical_decoding_pipeline)
+	{
+		decoding_worker = StartDecodingWorker(cmd->slotname, cmd->startpoint,
+											  cmd->options);
+		if (decoding_worker == NULL)
+			ereport(WARNING,
+					(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+					 errmsg("could not start logical decoding worker, decoding in walsender instead"),
+					 errhint("You might need to increase max_worker_processes.")));
+	}
+
+	if (decoding_worker == NULL)
+		ReplicationSlotAcquire(cmd->slotname, true);
 
 	/*
 	 * Force a disconnect, so that the decoding code doesn't need to care
@@ -1090,12 +1129,19 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 	 * Do this before sending a CopyBothResponse message, so that any errors
 	 * are reported early.
 	 */
-	logical_decoding_ctx =
-		CreateDecodingContext(cmd->startpoint, cmd->options, false,
-							  logical_read_xlog_page,
-							  WalSndPrepareWrite, WalSndWriteData,
-							  WalSndUpdateProgress);
+	if (decoding_worker != NULL)
+		WaitForDecodingWorkerStartup(&restart_lsn, &confirmed_flush);
+	else
+	{
+		logical_decoding_ctx =
+			CreateDecodingContext(cmd->startpoint, cmd->options, false,
+								  logical_read_xlog_page,
+								  WalSndPrepareWrite, WalSndWriteData,
+								  WalSndUpdateProgress);
 
+		restart_lsn = MyReplicationSlot->data.restart_lsn;
+		confirmed_flush = MyReplicationSlot->data.confirmed_flush;
+	}
 
 	WalSndSetState(WALSNDSTATE_CATCHUP);
 
@@ -1108,17 +1154,17 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 
 
 	/* Start reading WAL from the oldest required WAL. */
-	logical_startptr = MyReplicationSlot->data.restart_lsn;
+	logical_startptr = restart_lsn;
 
 	/*
 	 * Report the location after which we'll send out further commits as the
 	 * current sentPtr.
 	 */
-	sentPtr = MyReplicationSlot->data.confirmed_flush;
+	sentPtr = confirmed_flush;
 
 	/* Also update the sent position status in shared memory */
 	SpinLockAcquire(&MyWalSnd->mutex);
-	MyWalSnd->sentPtr = MyReplicationSlot->data.restart_lsn;
+	MyWalSnd->sentPtr = restart_lsn;
 	SpinLockRelease(&MyWalSnd->mutex);
 
 	replication_active = true;
@@ -1126,10 +1172,20 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 	SyncRepInitConfig();
 
 	/* Main loop of walsender */
-	WalSndLoop(XLogSendLogical);
+	if (decoding_worker != NULL)
+	{
+		WalSndLoop(XLogSendLogicalPipelined);
 
-	FreeDecodingContext(logical_decoding_ctx);
-	ReplicationSlotRelease();
+		StopDecodingWorker(decoding_worker);
+		decoding_worker = NULL;
+	}
+	else
+	{
+		WalSndLoop(XLogSendLogical);
+
+		FreeDecodingContext(logical_decoding_ctx);
+		ReplicationSlotRelease();
+	}
 
 	replication_active = false;
 	if (got_STOPPING)
@@ -1866,6 +1922,8 @@ ProcessStandbyReplyMessage(void)
 		else
 			PhysicalConfirmReceivedLocation(flushPtr);
 	}
+	else if (decoding_worker != NULL && flushPtr != InvalidXLogRecPtr)
+		DecodingWorkerConfirmFlush(decoding_worker, flushPtr);
 }
 
 /* compute new replication slot xmin horizon if needed */
@@ -2057,11 +2115,24 @@ ProcessStandbyHSFeedbackMessage(void)
 		PhysicalReplicationSlotNewXmin(feedbackXmin, feedbackCatalogXmin);
 	else
 	{
+		TransactionId oldXmin = MyPgXact->xmin;
+		TransactionId newXmin;
+
 		if (TransactionIdIsNormal(feedbackCatalogXmin)
 			&& TransactionIdPrecedes(feedbackCatalogXmin, feedbackXmin))
-			MyPgXact->xmin = feedbackCatalogXmin;
+			newXmin = feedbackCatalogXmin;
 		else
-			MyPgXact->xmin = feedbackXmin;
+			newXmin = feedbackXmin;
+		MyPgXact->xmin = newXmin;
+
+		/*
+		 * Backends reusing a snapshot would go on using the horizons computed
+		 * with it, so make them notice if we're moving our xmin backwards.
+		 */
+		if (TransactionIdIsNormal(newXmin) &&
+			(!TransactionIdIsValid(oldXmin) ||
+			 TransactionIdPrecedes(newXmin, oldXmin)))
+			ProcArrayInvalidateSnapshots();
 	}
 }
 
@@ -2216,7 +2287,8 @@ WalSndLoop(WalSndSendDataCallback send_data)
 			 * important for synchronous replication, since commits that
 			 * started to wait at that point might wait for some time.
 			 */
-			if (MyWalSnd->state == WALSNDSTATE_CATCHUP)
+			if (MyWalSnd->state == WALSNDSTATE_CATCHUP &&
+				(decoding_worker == NULL || decoding_worker_caught_up))
 			{
 				ereport(DEBUG1,
 						(errmsg("\"%s\" has now caught up with upstream server",
@@ -2319,6 +2391,8 @@ InitWalSenderSlot(void)
 			walsnd->state = WALSNDSTATE_STARTUP;
 			walsnd->latch = &MyProc->procLatch;
 			walsnd->replyTime = 0;
+			walsnd->pubrelRebuilds = 0;
+			walsnd->pubReloads = 0;
 			SpinLockRelease(&walsnd->mutex);
 			/* don't need the lock anymore */
 			MyWalSnd = (WalSnd *) walsnd;
@@ -2869,6 +2943,179 @@ XLogSendLogical(void)
 	}
 }
 
+/*
+ * Wait for the decoding worker to acquire the slot and report where
+ * streaming starts.
+ */
+static void
+WaitForDecodingWorkerStartup(XLogRecPtr *restart_lsn,
+							 XLogRecPtr *confirmed_flush)
+{
+	StringInfoData msg;
+
+	if (DecodingWorkerReceive(decoding_worker, &msg, false) !=
+		DECODING_WORKER_MESSAGE)
+	{
+		/* Rethrow the error that made the worker exit, if any */
+		HandleDecodingWorkerMessages(decoding_worker);
+		if (DecodingWorkerTerminated(decoding_worker))
+			ereport(ERROR,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("logical decoding worker was terminated")));
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical decoding worker exited unexpectedly")));
+	}
+
+	HandleDecodingWorkerMessages(decoding_worker);
+
+	if (pq_getmsgbyte(&msg) != DECODING_WORKER_MSG_READY)
+		elog(ERROR, "unexpected message from logical decoding worker");
+
+	*restart_lsn = pq_getmsgint64(&msg);
+	*confirmed_flush = pq_getmsgint64(&msg);
+
+	decoding_worker_flush = InvalidXLogRecPtr;
+	decoding_worker_caught_up = false;
+}
+
+/*
+ * Stream out data logically decoded by our decoding worker.
+ *
+ * Moves the messages queued by the worker to the output buffer, until the
+ * queue is empty or about MAX_SEND_SIZE bytes have been queued, so that
+ * small messages are sent out in batches.
+ */
+static void
+XLogSendLogicalPipelined(void)
+{
+	XLogRecPtr	flushPtr;
+	Size		nbytes = 0;
+
+	/* Relay errors and notices reported by the worker */
+	HandleDecodingWorkerMessages(decoding_worker);
+
+	/*
+	 * The worker waits on its latch for WAL to be flushed, but only
+	 * walsenders get woken up when that happens, so pass it on.
+	 */
+	flushPtr = GetFlushRecPtr();
+	if (flushPtr > decoding_worker_flush)
+	{
+		decoding_worker_flush = flushPtr;
+		DecodingWorkerWakeup(decoding_worker);
+	}
+
+	WalSndCaughtUp = false;
+
+	while (nbytes < MAX_SEND_SIZE)
+	{
+		StringInfoData msg;
+		DecodingWorkerResult res;
+		XLogRecPtr	lsn;
+		TimestampTz time;
+
+		res = DecodingWorkerReceive(decoding_worker, &msg, true);
+
+		if (res == DECODING_WORKER_EMPTY)
+		{
+			/* the worker will set our latch when it queues more */
+			WalSndCaughtUp = true;
+			break;
+		}
+
+		if (res == DECODING_WORKER_DETACHED)
+		{
+			HandleDecodingWorkerMessages(decoding_worker);
+
+			/*
+			 * At shutdown, the postmaster terminates background workers
+			 * before walsenders are asked to stop.  If the worker was
+			 * terminated, for that reason or any other, we've sent out
+			 * everything it decoded, so end streaming in an orderly manner
+			 * just as if we'd been asked to stop.  The client will reconnect
+			 * if the server is still up.
+			 */
+			if (!got_STOPPING)
+			{
+				if (!DecodingWorkerTerminated(decoding_worker))
+					ereport(ERROR,
+							(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+							 errmsg("logical decoding worker exited unexpectedly")));
+
+				ereport(LOG,
+						(errmsg("logical decoding worker was terminated, stopping streaming")));
+				got_STOPPING = true;
+			}
+			WalSndCaughtUp = true;
+			break;
+		}
+
+		switch (msg.data[0])
+		{
+			case DECODING_WORKER_MSG_DATA:
+
+				/* Fill in the send timestamp, like WalSndWriteData does */
+				resetStringInfo(&tmpbuf);
+				pq_sendint64(&tmpbuf, GetCurrentTimestamp());
+				memcpy(&msg.data[1 + sizeof(int64) + sizeof(int64)],
+					   tmpbuf.data, sizeof(int64));
+
+				pq_putmessage_noblock('d', msg.data, msg.len);
+				nbytes += msg.len;
+				break;
+
+			case DECODING_WORKER_MSG_PROGRESS:
+				msg.cursor = 1;
+				lsn = pq_getmsgint64(&msg);
+				time = pq_getmsgint64(&msg);
+				LagTrackerWrite(lsn, time);
+				break;
+
+			case DECODING_WORKER_MSG_POSITION:
+				msg.cursor = 1;
+				sentPtr = pq_getmsgint64(&msg);
+				decoding_worker_caught_up = (pq_getmsgbyte(&msg) != 0);
+				break;
+
+			default:
+				elog(ERROR, "unexpected message type \"%c\" from logical decoding worker",
+					 msg.data[0]);
+		}
+	}
+
+	/*
+	 * As in WalSndWaitForWal, when the worker is waiting for WAL, send a ping
+	 * containing the position it has decoded up to, since synchronous
+	 * replication and walsender shutdown possibly are waiting for it.
+	 */
+	if (WalSndCaughtUp && decoding_worker_caught_up &&
+		MyWalSnd->flush < sentPtr &&
+		MyWalSnd->write < sentPtr &&
+		!waiting_for_ping_response)
+	{
+		WalSndKeepalive(false);
+		waiting_for_ping_response = true;
+	}
+
+	/*
+	 * If we're caught up and have been requested to stop, have WalSndLoop()
+	 * terminate the connection in an orderly manner, after writing out all
+	 * the pending data.
+	 */
+	if (WalSndCaughtUp && got_STOPPING)
+		got_SIGUSR2 = true;
+
+	/* Update shared memory status */
+	{
+		WalSnd	   *walsnd = MyWalSnd;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->sentPtr = sentPtr;
+		SpinLockRelease(&walsnd->mutex);
+	}
+}
+
 /*
  * Shutdown if the sender is caught up.
  *
@@ -2968,6 +3215,27 @@ WalSndRqstFileReload(void)
 	}
 }
 
+/*
+ * Report that the output plugin rebuilt some of its cached publication
+ * information, for display in pg_stat_replication.
+ *
+ * This is a no-op outside of a walsender, e.g. when the plugin is used via
+ * the SQL decoding functions.
+ */
+void
+WalSndReportCacheRebuild(int64 nrelations, int64 npublications)
+{
+	WalSnd	   *walsnd = MyWalSnd;
+
+	if (walsnd == NULL)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->pubrelRebuilds += nrelations;
+	walsnd->pubReloads += npublications;
+	SpinLockRelease(&walsnd->mutex);
+}
+
 /*
  * Handle PROCSIG_WALSND_INIT_STOPPING signal.
  */
@@ -3219,7 +3487,7 @@ offset_to_interval(TimeOffset offset)
 Datum
 pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_SENDERS_COLS	12
+#define PG_STAT_GET_WAL_SENDERS_COLS	14
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
 	Tuplestorestate *tupstore;
@@ -3274,6 +3542,8 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		int			pid;
 		WalSndState state;
 		TimestampTz replyTime;
+		int64		pubrelRebuilds;
+		int64		pubReloads;
 		Datum		values[PG_STAT_GET_WAL_SENDERS_COLS];
 		bool		nulls[PG_STAT_GET_WAL_SENDERS_COLS];
 
@@ -3294,6 +3564,8 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		applyLag = walsnd->applyLag;
 		priority = walsnd->sync_standby_priority;
 		replyTime = walsnd->replyTime;
+		pubrelRebuilds = walsnd->pubrelRebuilds;
+		pubReloads = walsnd->pubReloads;
 		SpinLockRelease(&walsnd->mutex);
 
 		memset(nulls, 0, sizeof(nulls));
@@ -3375,6 +3647,9 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 				nulls[11] = true;
 			else
 				values[11] = TimestampTzGetDatum(replyTime);
+
+			values[12] = Int64GetDatum(pubrelRebuilds);
+			values[13] = Int64GetDatum(pubReloads);
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -111,6 +111,7 @@ int			bgwriter_lru_maxpages = 100;
 double		bgwriter_lru_multiplier = 2.0;
 bool		track_io_timing = false;
 int			effective_io_concurrency = 0;
+int			io_combine_limit = DEFAULT_IO_COMBINE_LIMIT;
 
 /*
  * GUC variables about triggering kernel writeback for buffers written; OS
@@ -129,9 +130,17 @@ int			backend_flush_after = 0;
  */
 int			target_prefetch_pages = 0;
 
-/* local state for StartBufferIO and related functions */
-static BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+/*
+ * local state for StartBufferIO and related functions
+ *
+ * ReadBufferRange holds I/O on a run of buffers while reading them, and may
+ * write out one more victim buffer meanwhile.
+ */
+#define MAX_IN_PROGRESS_IO	(MAX_IO_COMBINE_LIMIT + 1)
+
+static BufferDesc *InProgressBufs[MAX_IN_PROGRESS_IO];
+static bool InProgressForInput[MAX_IN_PROGRESS_IO];
+static int	NumInProgressBufs = 0;
 
 /* local state for LockBufferForCleanup */
 static BufferDesc *PinCountWaitBuf = NULL;
@@ -440,6 +449,9 @@ static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *flush_context);
 static void WaitIO(BufferDesc *buf);
+static void ReadBufferRun(SMgrRelation smgr, ForkNumber forkNum,
+						  BlockNumber blockNum, BufferDesc **bufHdrs,
+						  int nblocks, bool isLocalBuf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
 							  uint32 set_flag_bits);
@@ -548,42 +560,65 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
 	}
 	else
-	{
-		BufferTag	newTag;		/* identity of requested block */
-		uint32		newHash;	/* hash value for newTag */
-		LWLock	   *newPartitionLock;	/* buffer partition lock for it */
-		int			buf_id;
-
-		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
-
-		/* determine its hash code and partition lock ID */
-		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
-
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
-		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
+		(void) PrefetchSharedBuffer(reln->rd_smgr, forkNum, blockNum);
+#endif							/* USE_PREFETCH */
+}
 
-		/* If not in buffers, initiate prefetch */
-		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
+/*
+ * PrefetchSharedBuffer -- initiate asynchronous read of a block of a
+ *		relation using shared buffers, without a relcache entry
+ *
+ * Returns PREFETCH_BUFFER_IO if a read-ahead was issued, PREFETCH_BUFFER_HIT
+ * if the block is in the buffer pool already (or prefetching isn't compiled
+ * in), and PREFETCH_BUFFER_MISSING if the block's file turned out not to
+ * exist, which can happen in recovery only.
+ */
+PrefetchBufferResult
+PrefetchSharedBuffer(SMgrRelation smgr_reln, ForkNumber forkNum,
+					 BlockNumber blockNum)
+{
+#ifdef USE_PREFETCH
+	BufferTag	newTag;			/* identity of requested block */
+	uint32		newHash;		/* hash value for newTag */
+	LWLock	   *newPartitionLock;	/* buffer partition lock for it */
+	int			buf_id;
 
-		/*
-		 * If the block *is* in buffers, we do nothing.  This is not really
-		 * ideal: the block might be just about to be evicted, which would be
-		 * stupid since we know we are going to need it soon.  But the only
-		 * easy answer is to bump the usage_count, which does not seem like a
-		 * great solution: when the caller does ultimately touch the block,
-		 * usage_count would get bumped again, resulting in too much
-		 * favoritism for blocks that are involved in a prefetch sequence. A
-		 * real fix would involve some additional per-buffer state, and it's
-		 * not clear that there's enough of a problem to justify that.
-		 */
+	Assert(BlockNumberIsValid(blockNum));
+
+	/* create a tag so we can lookup the buffer */
+	INIT_BUFFERTAG(newTag, smgr_reln->smgr_rnode.node, forkNum, blockNum);
+
+	/* determine its hash code and partition lock ID */
+	newHash = BufTableHashCode(&newTag);
+	newPartitionLock = BufMappingPartitionLock(newHash);
+
+	/* see if the block is in the buffer pool already */
+	LWLockAcquire(newPartitionLock, LW_SHARED);
+	buf_id = BufTableLookup(&newTag, newHash);
+	LWLockRelease(newPartitionLock);
+
+	/* If not in buffers, initiate prefetch */
+	if (buf_id < 0)
+	{
+		if (!smgrprefetch(smgr_reln, forkNum, blockNum))
+			return PREFETCH_BUFFER_MISSING;
+		return PREFETCH_BUFFER_IO;
 	}
+
+	/*
+	 * If the block *is* in buffers, we do nothing.  This is not really ideal:
+	 * the block might be just about to be evicted, which would be stupid
+	 * since we know we are going to need it soon.  But the only easy answer
+	 * is to bump the usage_count, which does not seem like a great solution:
+	 * when the caller does ultimately touch the block, usage_count would get
+	 * bumped again, resulting in too much favoritism for blocks that are
+	 * involved in a prefetch sequence. A real fix would involve some
+	 * additional per-buffer state, and it's not clear that there's enough of
+	 * a problem to justify that.
+	 */
 #endif							/* USE_PREFETCH */
+
+	return PREFETCH_BUFFER_HIT;
 }
 
 
@@ -695,6 +730,200 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 }
 
 
+/*
+ * ReadBufferRange -- pins the consecutive blocks blockNum .. blockNum +
+ *		nblocks - 1 of a relation, returning their buffers in buffers[].
+ *
+ * This has the same effect as calling ReadBufferExtended() in RBM_NORMAL mode
+ * for each block, but the blocks that are not in the buffer pool yet are read
+ * with as few smgrreadv() calls as possible.  nblocks must not exceed
+ * MAX_IO_COMBINE_LIMIT.
+ *
+ * Blocks missing from the buffer pool are marked IO_IN_PROGRESS as they are
+ * pinned, and stay so until the run of missing blocks ends, at the end of
+ * the range or at a block found valid.  As the blocks are visited in
+ * ascending order, that can't deadlock against another reader.
+ */
+void
+ReadBufferRange(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+				int nblocks, BufferAccessStrategy strategy, Buffer *buffers)
+{
+	SMgrRelation smgr;
+	bool		isLocalBuf;
+	BufferDesc *missing[MAX_IO_COMBINE_LIMIT];
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= MAX_IO_COMBINE_LIMIT);
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	/* see comments in ReadBufferExtended */
+	if (RELATION_IS_OTHER_TEMP(reln))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot access temporary tables of other sessions")));
+
+	smgr = reln->rd_smgr;
+	isLocalBuf = SmgrIsTemp(smgr);
+
+	i = 0;
+	while (i < nblocks)
+	{
+		BlockNumber firstMissing = blockNum + i;
+		int			nmissing = 0;
+
+		/* pin buffers until one is found valid already */
+		while (i < nblocks)
+		{
+			BufferDesc *bufHdr;
+			bool		found;
+
+			/* Make sure we will have room to remember the buffer pin */
+			ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+			TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNum + i,
+											   smgr->smgr_rnode.node.spcNode,
+											   smgr->smgr_rnode.node.dbNode,
+											   smgr->smgr_rnode.node.relNode,
+											   smgr->smgr_rnode.backend,
+											   false);
+
+			pgstat_count_buffer_read(reln);
+			if (isLocalBuf)
+			{
+				bufHdr = LocalBufferAlloc(smgr, forkNum, blockNum + i, &found);
+				if (found)
+					pgBufferUsage.local_blks_hit++;
+				else
+					pgBufferUsage.local_blks_read++;
+			}
+			else
+			{
+				bufHdr = BufferAlloc(smgr, reln->rd_rel->relpersistence,
+									 forkNum, blockNum + i, strategy, &found);
+				if (found)
+					pgBufferUsage.shared_blks_hit++;
+				else
+					pgBufferUsage.shared_blks_read++;
+			}
+
+			buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+
+			if (found)
+			{
+				pgstat_count_buffer_hit(reln);
+				VacuumPageHit++;
+				if (VacuumCostActive)
+					VacuumCostBalance += VacuumCostPageHit;
+
+				TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum + i,
+												  smgr->smgr_rnode.node.spcNode,
+												  smgr->smgr_rnode.node.dbNode,
+												  smgr->smgr_rnode.node.relNode,
+												  smgr->smgr_rnode.backend,
+												  false,
+												  true);
+				i++;
+				break;
+			}
+
+			missing[nmissing++] = bufHdr;
+			i++;
+		}
+
+		if (nmissing > 0)
+			ReadBufferRun(smgr, forkNum, firstMissing, missing, nmissing,
+						  isLocalBuf);
+	}
+}
+
+/*
+ * ReadBufferRun -- subroutine for ReadBufferRange.  Reads a run of
+ *		consecutive blocks into the buffers allocated for them, and marks
+ *		the buffers valid.
+ */
+static void
+ReadBufferRun(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
+			  BufferDesc **bufHdrs, int nblocks, bool isLocalBuf)
+{
+	char	   *blocks[MAX_IO_COMBINE_LIMIT];
+	instr_time	io_start,
+				io_time;
+	int			i;
+
+	for (i = 0; i < nblocks; i++)
+	{
+		Assert(!(pg_atomic_read_u32(&bufHdrs[i]->state) & BM_VALID));
+		blocks[i] = (char *) (isLocalBuf ? LocalBufHdrGetBlock(bufHdrs[i]) :
+							  BufHdrGetBlock(bufHdrs[i]));
+	}
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	smgrreadv(smgr, forkNum, blockNum, blocks, nblocks);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+	}
+
+	for (i = 0; i < nblocks; i++)
+	{
+		BufferDesc *bufHdr = bufHdrs[i];
+
+		/* check for garbage data, as in ReadBuffer_common */
+		if (!PageIsVerified((Page) blocks[i], blockNum + i))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blockNum + i,
+								relpath(smgr->smgr_rnode, forkNum))));
+				MemSet(blocks[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blockNum + i,
+								relpath(smgr->smgr_rnode, forkNum))));
+		}
+
+		if (isLocalBuf)
+		{
+			/* Only need to adjust flags */
+			uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+			buf_state |= BM_VALID;
+			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+		}
+		else
+		{
+			/* Set BM_VALID, terminate IO, and wake up any waiters */
+			TerminateBufferIO(bufHdr, false, BM_VALID);
+		}
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum + i,
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  false);
+	}
+}
+
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
  *
@@ -3899,7 +4128,8 @@ WaitIO(BufferDesc *buf)
 /*
  * StartBufferIO: begin I/O on this buffer
  *	(Assumptions)
- *	My process is executing no IO
+ *	My process is executing no IO on this buffer, and fewer than
+ *	MAX_IN_PROGRESS_IO I/Os in total
  *	The buffer is Pinned
  *
  * In some scenarios there are race conditions in which multiple backends
@@ -3919,7 +4149,7 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 {
 	uint32		buf_state;
 
-	Assert(!InProgressBuf);
+	Assert(NumInProgressBufs < MAX_IN_PROGRESS_IO);
 
 	for (;;)
 	{
@@ -3958,8 +4188,9 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	buf_state |= BM_IO_IN_PROGRESS;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBufs[NumInProgressBufs] = buf;
+	InProgressForInput[NumInProgressBufs] = forInput;
+	NumInProgressBufs++;
 
 	return true;
 }
@@ -3985,8 +4216,18 @@ static void
 TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 {
 	uint32		buf_state;
+	int			i;
 
-	Assert(buf == InProgressBuf);
+	/* forget about the buffer, moving the last entry into its place */
+	for (i = NumInProgressBufs - 1; i >= 0; i--)
+	{
+		if (InProgressBufs[i] == buf)
+			break;
+	}
+	Assert(i >= 0);
+	NumInProgressBufs--;
+	InProgressBufs[i] = InProgressBufs[NumInProgressBufs];
+	InProgressForInput[i] = InProgressForInput[NumInProgressBufs];
 
 	buf_state = LockBufHdr(buf);
 
@@ -3999,16 +4240,14 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 	buf_state |= set_flag_bits;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = NULL;
-
 	LWLockRelease(BufferDescriptorGetIOLock(buf));
 }
 
 /*
- * AbortBufferIO: Clean up any active buffer I/O after an error.
+ * AbortBufferIO: Clean up any active buffer I/Os after an error.
  *
  *	All LWLocks we might have held have been released,
- *	but we haven't yet released buffer pins, so the buffer is still pinned.
+ *	but we haven't yet released buffer pins, so the buffers are still pinned.
  *
  *	If I/O was in progress, we always set BM_IO_ERROR, even though it's
  *	possible the error condition wasn't related to the I/O.
@@ -4016,10 +4255,10 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 void
 AbortBufferIO(void)
 {
-	BufferDesc *buf = InProgressBuf;
-
-	if (buf)
+	while (NumInProgressBufs > 0)
 	{
+		BufferDesc *buf = InProgressBufs[NumInProgressBufs - 1];
+		bool		isForInput = InProgressForInput[NumInProgressBufs - 1];
 		uint32		buf_state;
 
 		/*
@@ -4032,7 +4271,7 @@ AbortBufferIO(void)
 
 		buf_state = LockBufHdr(buf);
 		Assert(buf_state & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (isForInput)
 		{
 			Assert(!(buf_state & BM_DIRTY));
 
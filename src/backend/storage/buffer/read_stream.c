@@ -0,0 +1,247 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.c
+ *	  Reading a sequence of relation blocks ahead of their use.
+ *
+ * A read stream is given the block numbers a scan is going to need by a
+ * callback, and hands out pinned buffers for them in the same order.
+ * Meanwhile it looks ahead in the sequence:
+ *
+ * - Runs of consecutive blocks are read with a single ReadBufferRange()
+ *	 call, which reads the blocks missing from the buffer pool with as few
+ *	 vectored reads as possible, up to io_combine_limit blocks at a time.
+ *
+ * - Other blocks are announced to the kernel with PrefetchBuffer() as soon
+ *	 as they enter the look-ahead queue, keeping up to effective_io_concurrency
+ *	 of them in flight.  Sequential runs are left to the kernel's own
+ *	 read-ahead, which handles them well.
+ *
+ * Only the buffers of the run being handed out are kept pinned, so a stream
+ * holds no more than io_combine_limit pins.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/read_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "storage/proc.h"
+#include "storage/read_stream.h"
+#include "utils/guc.h"
+#include "utils/rel.h"
+#include "utils/spccache.h"
+
+struct ReadStream
+{
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+	ReadStreamBlockNumberCB callback;
+	void	   *callback_private_data;
+
+	int			combine_limit;	/* maximum number of blocks per read */
+	int			max_ios;		/* prefetches to keep in flight */
+	bool		callback_done;	/* has the callback returned the end? */
+	BlockNumber last_block;		/* block last added to the queue */
+
+	/*
+	 * Circular queue of the blocks to be returned next.  The buffers of the
+	 * blocks read already are valid, and precede those of the others.
+	 */
+	int			queue_size;
+	int			head;			/* index of the next block to return */
+	int			count;			/* number of blocks in the queue */
+	BlockNumber *blocks;
+	Buffer	   *buffers;
+};
+
+/*
+ * Create a stream reading the blocks of fork 'forknum' of 'rel' that
+ * 'callback' returns, using buffer access strategy 'strategy'.
+ */
+ReadStream *
+read_stream_begin_relation(Relation rel,
+						   ForkNumber forknum,
+						   BufferAccessStrategy strategy,
+						   ReadStreamBlockNumberCB callback,
+						   void *callback_private_data)
+{
+	ReadStream *stream;
+	int			max_pins;
+	int			i;
+
+	stream = (ReadStream *) palloc(sizeof(ReadStream));
+	stream->rel = rel;
+	stream->forknum = forknum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private_data = callback_private_data;
+
+	/*
+	 * Don't let the stream pin more than its fair share of the buffer pool,
+	 * or of the local buffers.
+	 */
+	if (RelationUsesLocalBuffers(rel))
+		max_pins = num_temp_buffers / 4;
+	else
+		max_pins = NBuffers / (MaxBackends + NUM_AUXILIARY_PROCS);
+	stream->combine_limit = Max(1, Min(io_combine_limit, max_pins));
+
+#ifdef USE_PREFETCH
+	stream->max_ios = get_tablespace_io_concurrency(rel->rd_rel->reltablespace);
+#else
+	stream->max_ios = 0;
+#endif
+
+	/*
+	 * Look far enough ahead to combine whole runs of blocks, and to keep
+	 * max_ios prefetches going.
+	 */
+	stream->queue_size = Max(stream->combine_limit, stream->max_ios);
+	stream->blocks = (BlockNumber *)
+		palloc(stream->queue_size * sizeof(BlockNumber));
+	stream->buffers = (Buffer *) palloc(stream->queue_size * sizeof(Buffer));
+	for (i = 0; i < stream->queue_size; i++)
+		stream->buffers[i] = InvalidBuffer;
+
+	stream->callback_done = false;
+	stream->last_block = InvalidBlockNumber;
+	stream->head = 0;
+	stream->count = 0;
+
+	return stream;
+}
+
+/*
+ * Fill the look-ahead queue from the callback, issuing prefetches for the
+ * blocks that don't follow their predecessor.
+ */
+static void
+read_stream_fill(ReadStream *stream)
+{
+	while (!stream->callback_done && stream->count < stream->queue_size)
+	{
+		BlockNumber blocknum;
+		int			tail;
+
+		blocknum = stream->callback(stream, stream->callback_private_data);
+		if (blocknum == InvalidBlockNumber)
+		{
+			stream->callback_done = true;
+			break;
+		}
+
+		if (stream->max_ios > 0 && blocknum != stream->last_block + 1)
+			PrefetchBuffer(stream->rel, stream->forknum, blocknum);
+
+		tail = (stream->head + stream->count) % stream->queue_size;
+		stream->blocks[tail] = blocknum;
+		Assert(!BufferIsValid(stream->buffers[tail]));
+		stream->count++;
+		stream->last_block = blocknum;
+	}
+}
+
+/*
+ * Read the run of consecutive blocks at the head of the queue.
+ */
+static void
+read_stream_read_run(ReadStream *stream)
+{
+	Buffer		buffers[MAX_IO_COMBINE_LIMIT];
+	BlockNumber first = stream->blocks[stream->head];
+	int			nblocks = 1;
+	int			i;
+
+	while (nblocks < stream->count && nblocks < stream->combine_limit &&
+		   stream->blocks[(stream->head + nblocks) % stream->queue_size] ==
+		   first + nblocks)
+		nblocks++;
+
+	ReadBufferRange(stream->rel, stream->forknum, first, nblocks,
+					stream->strategy, buffers);
+
+	for (i = 0; i < nblocks; i++)
+		stream->buffers[(stream->head + i) % stream->queue_size] = buffers[i];
+}
+
+/*
+ * Return the block number of the buffer read_stream_next_buffer() will
+ * return next, or InvalidBlockNumber at the end of the stream.
+ */
+BlockNumber
+read_stream_peek_block(ReadStream *stream)
+{
+	read_stream_fill(stream);
+
+	if (stream->count == 0)
+		return InvalidBlockNumber;
+	return stream->blocks[stream->head];
+}
+
+/*
+ * Return the pinned buffer of the next block, or InvalidBuffer at the end of
+ * the stream.  The caller is responsible for releasing the buffer.
+ */
+Buffer
+read_stream_next_buffer(ReadStream *stream)
+{
+	Buffer		buffer;
+
+	read_stream_fill(stream);
+
+	if (stream->count == 0)
+		return InvalidBuffer;
+
+	if (!BufferIsValid(stream->buffers[stream->head]))
+		read_stream_read_run(stream);
+
+	buffer = stream->buffers[stream->head];
+	stream->buffers[stream->head] = InvalidBuffer;
+	stream->head = (stream->head + 1) % stream->queue_size;
+	stream->count--;
+
+	return buffer;
+}
+
+/*
+ * Release the buffers read ahead, and start over asking the callback for
+ * block numbers.
+ */
+void
+read_stream_reset(ReadStream *stream)
+{
+	while (stream->count > 0)
+	{
+		Buffer		buffer = stream->buffers[stream->head];
+
+		if (BufferIsValid(buffer))
+		{
+			ReleaseBuffer(buffer);
+			stream->buffers[stream->head] = InvalidBuffer;
+		}
+		stream->head = (stream->head + 1) % stream->queue_size;
+		stream->count--;
+	}
+
+	stream->callback_done = false;
+	stream->last_block = InvalidBlockNumber;
+}
+
+/*
+ * Release the buffers read ahead, and free the stream.
+ */
+void
+read_stream_end(ReadStream *stream)
+{
+	read_stream_reset(stream);
+	pfree(stream->blocks);
+	pfree(stream->buffers);
+	pfree(stream);
+}
@@ -36,18 +36,41 @@
  * other backends, as infrastructure for parallel execution.  Such files need
  * to be created as a member of a SharedFileSet that all participants are
  * attached to.
+ *
+ * If temp_file_compression is set when a BufFile is created, its data is
+ * compressed a block at a time.  The logical file, as seen by callers of
+ * BufFileSeek and BufFileTell, is still divided into BLCKSZ-sized blocks
+ * and MAX_PHYSICAL_FILESIZE-sized segments, but the physical segment files
+ * hold a sequence of variable-length chunks, each holding one compressed
+ * block, and an in-memory index maps each logical block to its chunk so
+ * that seeks keep working.  The buffer of a compressed BufFile always holds
+ * one whole logical block.  A block that is rewritten is put back in its
+ * old chunk if it still fits, else in a free chunk that is large enough or
+ * a new chunk at the physical end of the file; its old chunk is then free.
+ * Chunk sizes are rounded up to BUFFILE_SLOT_UNIT, which makes both cases
+ * more likely, so files whose blocks get recycled, like logtape.c's, don't
+ * keep growing.  A backend opening a compressed shared BufFile rebuilds the
+ * index from the chunk headers; all participants in a parallel operation
+ * see the same temp_file_compression setting, so they agree on whether the
+ * files are compressed.
+ *
+ * The block index takes 8 bytes per logical block, that is 1MB per GB of
+ * logical data with the default BLCKSZ, allocated a segment at a time.  It
+ * is not charged to work_mem, like the other in-memory state of a BufFile.
  *-------------------------------------------------------------------------
  */
 
 #include "postgres.h"
 
 #include "commands/tablespace.h"
+#include "common/compression.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/fd.h"
 #include "storage/buffile.h"
 #include "storage/buf_internals.h"
+#include "utils/memutils.h"
 #include "utils/resowner.h"
 
 /*
@@ -58,6 +81,63 @@
 #define MAX_PHYSICAL_FILESIZE	0x40000000
 #define BUFFILE_SEG_SIZE		(MAX_PHYSICAL_FILESIZE / BLCKSZ)
 
+/*
+ * Each block of a compressed BufFile is stored as a chunk made of this
+ * header followed by datalen bytes of data: the compressed block, or the
+ * block as-is if datalen equals rawlen.  slotlen is the space reserved for
+ * the data; when a block is rewritten in place, any bytes past the new
+ * datalen are junk.  A chunk that no longer holds a block has blkno -1 in
+ * shared files, whose index other backends rebuild from the headers; other
+ * files don't bother to mark free chunks on disk.
+ */
+typedef struct BufFileChunkHeader
+{
+	int64		blkno;			/* logical block number, or -1 if free */
+	int32		slotlen;		/* bytes reserved for data after header */
+	uint16		rawlen;			/* # of valid bytes in the block */
+	uint16		datalen;		/* # of bytes of data stored */
+} BufFileChunkHeader;
+
+#define BUFFILE_CHUNK_HDRSZ		((int) sizeof(BufFileChunkHeader))
+
+/*
+ * Chunks reserve a multiple of this many bytes for their data, so that
+ * free chunks can be kept in a free list per size class.
+ */
+#define BUFFILE_SLOT_UNIT		512
+#define BUFFILE_SLOT_CLASSES	(BLCKSZ / BUFFILE_SLOT_UNIT)
+
+/*
+ * Block index entry of a compressed BufFile.  The upper 48 bits hold the
+ * position of the block's chunk counting across all segments, that is
+ * segment number times MAX_PHYSICAL_FILESIZE plus offset, and the lower 16
+ * bits its slotlen, which is never zero.  0 means the block has no chunk.
+ *
+ * The index is split into one array per logical segment, so that it never
+ * has to be copied as a whole when it grows.  Only the last array can be
+ * shorter than BUFFILE_SEG_SIZE.
+ */
+typedef uint64 BufFileBlock;
+
+#define BUFFILE_NO_CHUNK		((BufFileBlock) 0)
+#define BufFileMakeBlock(chunkpos, slotlen) \
+	(((uint64) (chunkpos) << 16) | (uint64) (slotlen))
+#define BufFileBlockPos(block)		((int64) ((block) >> 16))
+#define BufFileBlockSlotLen(block)	((int32) ((block) & 0xFFFF))
+
+/*
+ * Free chunks of one size class of a compressed BufFile.
+ */
+typedef struct BufFileFreeList
+{
+	int64	   *chunkpos;		/* palloc'd array of chunk positions */
+	int			nfree;			/* # of entries in use */
+	int			maxfree;		/* allocated length */
+} BufFileFreeList;
+
+/* GUC variable */
+int			temp_file_compression = TEMP_FILE_COMPRESSION_NONE;
+
 /*
  * This data structure represents a buffered file that consists of one or
  * more physical files (each accessed through a virtual file descriptor
@@ -79,7 +159,8 @@ struct BufFile
 	/*
 	 * resowner is the ResourceOwner to use for underlying temp files.  (We
 	 * don't need to remember the memory context we're using explicitly,
-	 * because after creation we only repalloc our arrays larger.)
+	 * because after creation we only repalloc our arrays larger, or allocate
+	 * in the context of the BufFile itself.)
 	 */
 	ResourceOwner resowner;
 
@@ -91,6 +172,24 @@ struct BufFile
 	off_t		curOffset;		/* offset part of current pos */
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
+
+	/*
+	 * Compression state.  If compressed is false, the fields below are
+	 * unused and the logical and physical files are one and the same.
+	 */
+	bool		compressed;		/* are blocks stored compressed? */
+	PgCompressionMethod cmethod;	/* how they are compressed */
+	BufFileBlock **blockmaps;	/* palloc'd block index, per segment */
+	int			nblockmaps;		/* # of arrays in blockmaps[] */
+	int			maxblockmaps;	/* allocated length of blockmaps[] */
+	int			lastmapsize;	/* allocated length of the last array */
+	long		nblocks;		/* # of blocks in the index */
+	int			lastBlockLen;	/* # of valid bytes in block nblocks - 1 */
+	BufFileFreeList freelists[BUFFILE_SLOT_CLASSES];	/* free chunks */
+	int			physFile;		/* file index where next chunk goes */
+	off_t		physOffset;		/* offset within it */
+	char	   *cbuffer;		/* chunk header and compressed data */
+
 	PGAlignedBlock buffer;
 };
 
@@ -101,6 +200,37 @@ static void BufFileLoadBuffer(BufFile *file);
 static void BufFileDumpBuffer(BufFile *file);
 static int	BufFileFlush(BufFile *file);
 static File MakeNewSharedSegment(BufFile *file, int segment);
+static void BufFileExtendBlocks(BufFile *file, long nblocks);
+static void BufFileFreeChunk(BufFile *file, int64 chunkpos, int32 slotlen);
+static bool BufFileMarkChunkFree(BufFile *file, int64 chunkpos, int32 slotlen);
+static int64 BufFileAllocChunk(BufFile *file, int32 *slotlen);
+static void BufFileReadChunkHeaders(BufFile *file);
+static void BufFileLoadBlock(BufFile *file);
+static void BufFileDumpBlock(BufFile *file);
+static bool BufFileNextBlock(BufFile *file);
+static int	BufFileSeekCompressed(BufFile *file, int newFile, off_t newOffset);
+static int64 BufFileLogicalSize(BufFile *file);
+
+/*
+ * Logical block number of the start of the buffer.
+ */
+static inline long
+BufFileCurBlock(BufFile *file)
+{
+	return (long) file->curFile * BUFFILE_SEG_SIZE +
+		(long) (file->curOffset / BLCKSZ);
+}
+
+/*
+ * Block index entry of a logical block of a compressed BufFile, which must
+ * be less than nblocks.
+ */
+static inline BufFileBlock *
+BufFileGetBlock(BufFile *file, long blkno)
+{
+	Assert(blkno >= 0 && blkno < file->nblocks);
+	return &file->blockmaps[blkno / BUFFILE_SEG_SIZE][blkno % BUFFILE_SEG_SIZE];
+}
 
 /*
  * Create BufFile and perform the common initialization.
@@ -119,6 +249,29 @@ makeBufFileCommon(int nfiles)
 	file->pos = 0;
 	file->nbytes = 0;
 
+	/* Compression is decided once and for all when the file is made */
+	file->compressed = (temp_file_compression != TEMP_FILE_COMPRESSION_NONE);
+	file->cmethod = (temp_file_compression == TEMP_FILE_COMPRESSION_LZ4) ?
+		PG_COMPRESSION_LZ4 : PG_COMPRESSION_PGLZ;
+	file->blockmaps = NULL;
+	file->nblockmaps = 0;
+	file->maxblockmaps = 0;
+	file->lastmapsize = 0;
+	file->nblocks = 0;
+	file->lastBlockLen = 0;
+	memset(file->freelists, 0, sizeof(file->freelists));
+	file->physFile = 0;
+	file->physOffset = 0L;
+	file->cbuffer = NULL;
+	if (file->compressed)
+	{
+		file->maxblockmaps = 4;
+		file->blockmaps = (BufFileBlock **)
+			palloc(sizeof(BufFileBlock *) * file->maxblockmaps);
+		file->cbuffer = (char *)
+			palloc(BUFFILE_CHUNK_HDRSZ + PG_COMPRESS_MAX_OUTPUT(BLCKSZ));
+	}
+
 	return file;
 }
 
@@ -325,6 +478,12 @@ BufFileOpenShared(SharedFileSet *fileset, const char *name)
 	file->fileset = fileset;
 	file->name = pstrdup(name);
 
+	if (file->compressed)
+	{
+		BufFileReadChunkHeaders(file);
+		BufFileLoadBlock(file);
+	}
+
 	return file;
 }
 
@@ -399,6 +558,18 @@ BufFileClose(BufFile *file)
 		FileClose(file->files[i]);
 	/* release the buffer space */
 	pfree(file->files);
+	if (file->compressed)
+	{
+		for (i = 0; i < file->nblockmaps; i++)
+			pfree(file->blockmaps[i]);
+		pfree(file->blockmaps);
+		for (i = 0; i < BUFFILE_SLOT_CLASSES; i++)
+		{
+			if (file->freelists[i].chunkpos)
+				pfree(file->freelists[i].chunkpos);
+		}
+		pfree(file->cbuffer);
+	}
 	pfree(file);
 }
 
@@ -519,6 +690,406 @@ BufFileDumpBuffer(BufFile *file)
 	file->nbytes = 0;
 }
 
+/*
+ * BufFileExtendBlocks
+ *
+ * Make sure a compressed BufFile's block index has at least nblocks
+ * entries.  New entries are marked as having no chunk.
+ */
+static void
+BufFileExtendBlocks(BufFile *file, long nblocks)
+{
+	MemoryContext cxt = GetMemoryChunkContext(file);
+
+	while (file->nblocks < nblocks)
+	{
+		long		mapno = file->nblocks / BUFFILE_SEG_SIZE;
+		long		mapoff = file->nblocks % BUFFILE_SEG_SIZE;
+		long		n;
+
+		if (mapoff == 0 && mapno == file->nblockmaps)
+		{
+			/* Start the array for a new segment, small at first */
+			if (file->nblockmaps == file->maxblockmaps)
+			{
+				file->maxblockmaps *= 2;
+				file->blockmaps = (BufFileBlock **)
+					repalloc(file->blockmaps,
+							 sizeof(BufFileBlock *) * file->maxblockmaps);
+			}
+			file->lastmapsize = Min(64, BUFFILE_SEG_SIZE);
+			file->blockmaps[file->nblockmaps++] = (BufFileBlock *)
+				MemoryContextAlloc(cxt, sizeof(BufFileBlock) * file->lastmapsize);
+		}
+		else if (mapoff == file->lastmapsize)
+		{
+			/* Enlarge the last array, up to a whole segment */
+			file->lastmapsize = Min(file->lastmapsize * 2, BUFFILE_SEG_SIZE);
+			file->blockmaps[mapno] = (BufFileBlock *)
+				repalloc(file->blockmaps[mapno],
+						 sizeof(BufFileBlock) * file->lastmapsize);
+		}
+
+		/* Initialize as many new entries as fit in the last array */
+		n = Min(nblocks - file->nblocks, file->lastmapsize - mapoff);
+		memset(&file->blockmaps[mapno][mapoff], 0, sizeof(BufFileBlock) * n);
+		file->nblocks += n;
+		file->lastBlockLen = 0;
+	}
+}
+
+/*
+ * BufFileFreeChunk
+ *
+ * Remember that a chunk of a compressed BufFile no longer holds a block, so
+ * that BufFileAllocChunk can hand it out again.
+ */
+static void
+BufFileFreeChunk(BufFile *file, int64 chunkpos, int32 slotlen)
+{
+	BufFileFreeList *list = &file->freelists[slotlen / BUFFILE_SLOT_UNIT - 1];
+
+	Assert(slotlen % BUFFILE_SLOT_UNIT == 0);
+
+	if (list->nfree == list->maxfree)
+	{
+		if (list->chunkpos == NULL)
+		{
+			list->maxfree = 16;
+			list->chunkpos = (int64 *)
+				MemoryContextAlloc(GetMemoryChunkContext(file),
+								   sizeof(int64) * list->maxfree);
+		}
+		else
+		{
+			list->maxfree *= 2;
+			list->chunkpos = (int64 *)
+				repalloc_huge(list->chunkpos, sizeof(int64) * list->maxfree);
+		}
+	}
+	list->chunkpos[list->nfree++] = chunkpos;
+}
+
+/*
+ * BufFileMarkChunkFree
+ *
+ * Mark a chunk of a compressed shared BufFile free on disk, so that backends
+ * rebuilding the index from the chunk headers don't take its stale contents
+ * for the block it used to hold.  Returns false if that fails.
+ */
+static bool
+BufFileMarkChunkFree(BufFile *file, int64 chunkpos, int32 slotlen)
+{
+	BufFileChunkHeader hdr;
+
+	hdr.blkno = -1;
+	hdr.slotlen = slotlen;
+	hdr.rawlen = 0;
+	hdr.datalen = 0;
+
+	return FileWrite(file->files[chunkpos / MAX_PHYSICAL_FILESIZE],
+					 (char *) &hdr, BUFFILE_CHUNK_HDRSZ,
+					 chunkpos % MAX_PHYSICAL_FILESIZE,
+					 WAIT_EVENT_BUFFILE_WRITE) == BUFFILE_CHUNK_HDRSZ;
+}
+
+/*
+ * BufFileAllocChunk
+ *
+ * Find room for a chunk whose data is *slotlen bytes long, rounded up to
+ * BUFFILE_SLOT_UNIT: a free chunk of the smallest size class that can hold
+ * it, else a new chunk at the physical end of the file.  On return,
+ * *slotlen is the size actually reserved.  Returns the chunk's position.
+ */
+static int64
+BufFileAllocChunk(BufFile *file, int32 *slotlen)
+{
+	int			class;
+	int64		chunkpos;
+
+	*slotlen = TYPEALIGN(BUFFILE_SLOT_UNIT, *slotlen);
+
+	for (class = *slotlen / BUFFILE_SLOT_UNIT - 1;
+		 class < BUFFILE_SLOT_CLASSES; class++)
+	{
+		BufFileFreeList *list = &file->freelists[class];
+
+		if (list->nfree > 0)
+		{
+			*slotlen = (class + 1) * BUFFILE_SLOT_UNIT;
+			return list->chunkpos[--list->nfree];
+		}
+	}
+
+	/*
+	 * Add a new chunk.  Chunks never cross a segment boundary, so move to a
+	 * new segment if this one can't hold it.
+	 */
+	if (file->physOffset + BUFFILE_CHUNK_HDRSZ + *slotlen >
+		MAX_PHYSICAL_FILESIZE)
+	{
+		file->physFile++;
+		file->physOffset = 0L;
+	}
+	while (file->physFile >= file->numFiles)
+		extendBufFile(file);
+	chunkpos = (int64) file->physFile * MAX_PHYSICAL_FILESIZE +
+		file->physOffset;
+	file->physOffset += BUFFILE_CHUNK_HDRSZ + *slotlen;
+
+	return chunkpos;
+}
+
+/*
+ * BufFileReadChunkHeaders
+ *
+ * Build the block index of a compressed BufFile that was written by another
+ * backend, by reading the chunk headers in each segment in turn.  The writer
+ * marks the chunks it frees, so each block has exactly one chunk; the free
+ * chunks go on our free lists, in case we are the target of BufFileAppend.
+ */
+static void
+BufFileReadChunkHeaders(BufFile *file)
+{
+	int			seg;
+	off_t		offset = 0L;
+
+	for (seg = 0; seg < file->numFiles; seg++)
+	{
+		offset = 0L;
+		for (;;)
+		{
+			BufFileChunkHeader hdr;
+			int			nread;
+
+			nread = FileRead(file->files[seg], (char *) &hdr,
+							 BUFFILE_CHUNK_HDRSZ, offset,
+							 WAIT_EVENT_BUFFILE_READ);
+			if (nread == 0)
+				break;			/* end of this segment */
+			if (nread < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read temporary file \"%s\" from BufFile \"%s\": %m",
+								FilePathName(file->files[seg]), file->name)));
+			if (nread != BUFFILE_CHUNK_HDRSZ || hdr.blkno < -1 ||
+				hdr.rawlen > BLCKSZ || hdr.datalen > hdr.rawlen ||
+				hdr.slotlen < hdr.datalen || hdr.slotlen > BLCKSZ ||
+				hdr.slotlen <= 0 || hdr.slotlen % BUFFILE_SLOT_UNIT != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid chunk header at offset %ld in temporary file \"%s\" from BufFile \"%s\"",
+								(long) offset, FilePathName(file->files[seg]),
+								file->name)));
+
+			if (hdr.blkno < 0)
+				BufFileFreeChunk(file,
+								 (int64) seg * MAX_PHYSICAL_FILESIZE + offset,
+								 hdr.slotlen);
+			else
+			{
+				BufFileExtendBlocks(file, (long) hdr.blkno + 1);
+				*BufFileGetBlock(file, (long) hdr.blkno) =
+					BufFileMakeBlock((int64) seg * MAX_PHYSICAL_FILESIZE + offset,
+									 hdr.slotlen);
+				if (hdr.blkno == file->nblocks - 1)
+					file->lastBlockLen = hdr.rawlen;
+			}
+
+			offset += BUFFILE_CHUNK_HDRSZ + hdr.slotlen;
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	file->physFile = file->numFiles - 1;
+	file->physOffset = offset;
+}
+
+/*
+ * BufFileLoadBlock
+ *
+ * Counterpart of BufFileLoadBuffer for compressed files: load the logical
+ * block starting at curOffset, decompressing it.  At call, must have
+ * dirty = false.  On exit, nbytes is the number of valid bytes in the block,
+ * which is zero if it has never been written; pos is unchanged.
+ */
+static void
+BufFileLoadBlock(BufFile *file)
+{
+	long		blkno = BufFileCurBlock(file);
+	BufFileChunkHeader *hdr = (BufFileChunkHeader *) file->cbuffer;
+	char	   *data = file->cbuffer + BUFFILE_CHUNK_HDRSZ;
+	BufFileBlock block;
+	int64		chunkpos;
+	int32		slotlen;
+	File		thisfile;
+	int			nread;
+
+	Assert(file->compressed);
+	Assert(!file->dirty);
+
+	file->nbytes = 0;
+
+	if (blkno >= file->nblocks)
+		return;					/* block not written yet */
+	block = *BufFileGetBlock(file, blkno);
+	if (block == BUFFILE_NO_CHUNK)
+		return;
+	chunkpos = BufFileBlockPos(block);
+	slotlen = BufFileBlockSlotLen(block);
+
+	thisfile = file->files[chunkpos / MAX_PHYSICAL_FILESIZE];
+	/*
+	 * Only the header and datalen bytes of data are ever written, so a chunk
+	 * at the physical end of a segment can be shorter than its slot.
+	 */
+	nread = FileRead(thisfile,
+					 file->cbuffer,
+					 BUFFILE_CHUNK_HDRSZ + slotlen,
+					 chunkpos % MAX_PHYSICAL_FILESIZE,
+					 WAIT_EVENT_BUFFILE_READ);
+	if (nread < BUFFILE_CHUNK_HDRSZ)
+		return;					/* failed to read */
+
+	/*
+	 * The header's block number isn't checked: it is relative to the source
+	 * file if the block came in through BufFileAppend.
+	 */
+	if (hdr->blkno < 0 || hdr->slotlen != slotlen ||
+		hdr->rawlen == 0 || hdr->rawlen > BLCKSZ ||
+		hdr->datalen > hdr->rawlen || hdr->datalen > slotlen ||
+		nread < BUFFILE_CHUNK_HDRSZ + hdr->datalen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid chunk header for block %ld in temporary file \"%s\"",
+						blkno, FilePathName(thisfile))));
+
+	if (hdr->datalen == hdr->rawlen)
+		memcpy(file->buffer.data, data, hdr->rawlen);
+	else if (pg_decompress(file->cmethod, data, hdr->datalen,
+						   file->buffer.data, hdr->rawlen, true) != hdr->rawlen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("compressed data is corrupt in block %ld of temporary file \"%s\"",
+						blkno, FilePathName(thisfile))));
+	file->nbytes = hdr->rawlen;
+
+	pgBufferUsage.temp_blks_read++;
+}
+
+/*
+ * BufFileDumpBlock
+ *
+ * Counterpart of BufFileDumpBuffer for compressed files: store the buffer
+ * as the logical block starting at curOffset.  The chunk overwrites the
+ * block's previous chunk if it fits there, else it goes in a free chunk or at
+ * the physical end of the file, and the previous chunk becomes free.  At
+ * call, should have dirty = true, nbytes > 0.  On exit,
+ * dirty is cleared if successful write.  Unlike BufFileDumpBuffer, the
+ * buffer and position are left alone, since the block remains valid.
+ */
+static void
+BufFileDumpBlock(BufFile *file)
+{
+	long		blkno = BufFileCurBlock(file);
+	BufFileChunkHeader *hdr = (BufFileChunkHeader *) file->cbuffer;
+	char	   *data = file->cbuffer + BUFFILE_CHUNK_HDRSZ;
+	BufFileBlock *block;
+	int32		datalen;
+	int32		slotlen;
+	int64		chunkpos;
+	int64		oldchunkpos = -1;
+	int32		oldslotlen = 0;
+	int			nwritten;
+
+	Assert(file->compressed);
+	Assert(file->dirty && file->nbytes > 0);
+
+	datalen = pg_compress(file->cmethod, file->buffer.data, file->nbytes,
+						  data);
+	if (datalen < 0 || datalen >= file->nbytes)
+	{
+		/* Not compressible, so store it as-is */
+		memcpy(data, file->buffer.data, file->nbytes);
+		datalen = file->nbytes;
+	}
+
+	BufFileExtendBlocks(file, blkno + 1);
+	block = BufFileGetBlock(file, blkno);
+
+	if (*block != BUFFILE_NO_CHUNK && datalen <= BufFileBlockSlotLen(*block))
+	{
+		/* Reuse the existing chunk */
+		chunkpos = BufFileBlockPos(*block);
+		slotlen = BufFileBlockSlotLen(*block);
+	}
+	else
+	{
+		if (*block != BUFFILE_NO_CHUNK)
+		{
+			oldchunkpos = BufFileBlockPos(*block);
+			oldslotlen = BufFileBlockSlotLen(*block);
+		}
+		slotlen = datalen;
+		chunkpos = BufFileAllocChunk(file, &slotlen);
+	}
+
+	hdr->blkno = blkno;
+	hdr->slotlen = slotlen;
+	hdr->rawlen = (uint16) file->nbytes;
+	hdr->datalen = (uint16) datalen;
+
+	nwritten = FileWrite(file->files[chunkpos / MAX_PHYSICAL_FILESIZE],
+						 file->cbuffer,
+						 BUFFILE_CHUNK_HDRSZ + datalen,
+						 chunkpos % MAX_PHYSICAL_FILESIZE,
+						 WAIT_EVENT_BUFFILE_WRITE);
+	if (nwritten != BUFFILE_CHUNK_HDRSZ + datalen)
+		return;					/* failed to write */
+	if (oldchunkpos >= 0 && file->fileset != NULL &&
+		!BufFileMarkChunkFree(file, oldchunkpos, oldslotlen))
+		return;					/* failed to write */
+
+	*block = BufFileMakeBlock(chunkpos, slotlen);
+	if (blkno == file->nblocks - 1)
+		file->lastBlockLen = file->nbytes;
+	if (oldchunkpos >= 0)
+		BufFileFreeChunk(file, oldchunkpos, oldslotlen);
+	file->dirty = false;
+
+	pgBufferUsage.temp_blks_written++;
+}
+
+/*
+ * BufFileNextBlock
+ *
+ * Move the buffer of a compressed BufFile on to the next logical block,
+ * writing out the current one first if it's dirty.  Returns false if that
+ * fails.
+ */
+static bool
+BufFileNextBlock(BufFile *file)
+{
+	if (file->dirty)
+	{
+		BufFileDumpBlock(file);
+		if (file->dirty)
+			return false;
+	}
+
+	file->curOffset += BLCKSZ;
+	if (file->curOffset >= MAX_PHYSICAL_FILESIZE)
+	{
+		file->curFile++;
+		file->curOffset = 0L;
+	}
+	file->pos = 0;
+	BufFileLoadBlock(file);
+
+	return true;
+}
+
 /*
  * BufFileRead
  *
@@ -530,7 +1101,11 @@ BufFileRead(BufFile *file, void *ptr, size_t size)
 	size_t		nread = 0;
 	size_t		nthistime;
 
-	if (file->dirty)
+	/*
+	 * The buffer of a compressed file holds a whole block, which stays valid
+	 * while dirty, so there's no need to flush it before reading.
+	 */
+	if (file->dirty && !file->compressed)
 	{
 		if (BufFileFlush(file) != 0)
 			return 0;			/* could not flush... */
@@ -541,13 +1116,23 @@ BufFileRead(BufFile *file, void *ptr, size_t size)
 	{
 		if (file->pos >= file->nbytes)
 		{
-			/* Try to load more data into buffer. */
-			file->curOffset += file->pos;
-			file->pos = 0;
-			file->nbytes = 0;
-			BufFileLoadBuffer(file);
-			if (file->nbytes <= 0)
-				break;			/* no more data available */
+			if (file->compressed)
+			{
+				/* Only the last block can be partially filled */
+				if (file->nbytes < BLCKSZ || !BufFileNextBlock(file) ||
+					file->nbytes <= 0)
+					break;		/* no more data available */
+			}
+			else
+			{
+				/* Try to load more data into buffer. */
+				file->curOffset += file->pos;
+				file->pos = 0;
+				file->nbytes = 0;
+				BufFileLoadBuffer(file);
+				if (file->nbytes <= 0)
+					break;		/* no more data available */
+			}
 		}
 
 		nthistime = file->nbytes - file->pos;
@@ -583,8 +1168,14 @@ BufFileWrite(BufFile *file, void *ptr, size_t size)
 	{
 		if (file->pos >= BLCKSZ)
 		{
+			if (file->compressed)
+			{
+				/* Buffer full, move on to the next block */
+				if (!BufFileNextBlock(file))
+					break;		/* I/O error */
+			}
 			/* Buffer full, dump it out */
-			if (file->dirty)
+			else if (file->dirty)
 			{
 				BufFileDumpBuffer(file);
 				if (file->dirty)
@@ -628,7 +1219,10 @@ BufFileFlush(BufFile *file)
 {
 	if (file->dirty)
 	{
-		BufFileDumpBuffer(file);
+		if (file->compressed)
+			BufFileDumpBlock(file);
+		else
+			BufFileDumpBuffer(file);
 		if (file->dirty)
 			return EOF;
 	}
@@ -685,6 +1279,8 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 			return EOF;
 		newOffset += MAX_PHYSICAL_FILESIZE;
 	}
+	if (file->compressed)
+		return BufFileSeekCompressed(file, newFile, newOffset);
 	if (newFile == file->curFile &&
 		newOffset >= file->curOffset &&
 		newOffset <= file->curOffset + file->nbytes)
@@ -730,6 +1326,53 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 	return 0;
 }
 
+/*
+ * BufFileSeekCompressed
+ *
+ * The rest of BufFileSeek for compressed files.  Segment numbers are then
+ * logical, so the target is checked against the amount of data written
+ * rather than against the physical segments, and the buffer is reloaded
+ * with the block containing it.
+ */
+static int
+BufFileSeekCompressed(BufFile *file, int newFile, off_t newOffset)
+{
+	int64		target = (int64) newFile * MAX_PHYSICAL_FILESIZE + newOffset;
+	long		blkno = (long) (target / BLCKSZ);
+
+	if (target > BufFileLogicalSize(file))
+		return EOF;
+
+	if (blkno != BufFileCurBlock(file))
+	{
+		if (BufFileFlush(file) != 0)
+			return EOF;
+		file->curFile = (int) (blkno / BUFFILE_SEG_SIZE);
+		file->curOffset = (off_t) (blkno % BUFFILE_SEG_SIZE) * BLCKSZ;
+		BufFileLoadBlock(file);
+	}
+	file->pos = (int) (target - (int64) blkno * BLCKSZ);
+	return 0;
+}
+
+/*
+ * BufFileLogicalSize
+ *
+ * Amount of data in a compressed BufFile, including any not yet written out.
+ */
+static int64
+BufFileLogicalSize(BufFile *file)
+{
+	int64		size = 0;
+
+	if (file->nblocks > 0)
+		size = (int64) (file->nblocks - 1) * BLCKSZ + file->lastBlockLen;
+	if (file->nbytes > 0)
+		size = Max(size, (int64) BufFileCurBlock(file) * BLCKSZ + file->nbytes);
+
+	return size;
+}
+
 void
 BufFileTell(BufFile *file, int *fileno, off_t *offset)
 {
@@ -788,6 +1431,10 @@ BufFileSize(BufFile *file)
 
 	Assert(file->fileset != NULL);
 
+	/* A compressed file's physical size says nothing about its contents */
+	if (file->compressed)
+		return BufFileLogicalSize(file);
+
 	/* Get the size of the last physical file. */
 	lastFileSize = FileSize(file->files[file->numFiles - 1]);
 	if (lastFileSize < 0)
@@ -819,6 +1466,11 @@ BufFileSize(BufFile *file)
  * Returns the block number within target where the contents of source
  * begins.  Caller should apply this as an offset when working off block
  * positions that are in terms of the original BufFile space.
+ *
+ * For compressed files, the source's blocks are instead numbered on from
+ * the target's last block, so no holes are created; the chunk positions in
+ * the source's block index and free lists are shifted along with its
+ * segments.
  */
 long
 BufFileAppend(BufFile *target, BufFile *source)
@@ -834,6 +1486,41 @@ BufFileAppend(BufFile *target, BufFile *source)
 
 	if (target->resowner != source->resowner)
 		elog(ERROR, "could not append BufFile with non-matching resource owner");
+	if (target->compressed != source->compressed)
+		elog(ERROR, "could not append BufFile with non-matching compression");
+
+	if (target->compressed)
+	{
+		int64		physshift = (int64) target->numFiles * MAX_PHYSICAL_FILESIZE;
+		long		blkno;
+		int			class;
+
+		startBlock = target->nblocks;
+		BufFileExtendBlocks(target, startBlock + source->nblocks);
+		for (blkno = 0; blkno < source->nblocks; blkno++)
+		{
+			BufFileBlock block = *BufFileGetBlock(source, blkno);
+
+			if (block != BUFFILE_NO_CHUNK)
+				block = BufFileMakeBlock(BufFileBlockPos(block) + physshift,
+										 BufFileBlockSlotLen(block));
+			*BufFileGetBlock(target, startBlock + blkno) = block;
+		}
+		if (source->nblocks > 0)
+			target->lastBlockLen = source->lastBlockLen;
+
+		for (class = 0; class < BUFFILE_SLOT_CLASSES; class++)
+		{
+			BufFileFreeList *list = &source->freelists[class];
+			int			i;
+
+			for (i = 0; i < list->nfree; i++)
+				BufFileFreeChunk(target, list->chunkpos[i] + physshift,
+								 (class + 1) * BUFFILE_SLOT_UNIT);
+		}
+		target->physFile = target->numFiles + source->physFile;
+		target->physOffset = source->physOffset;
+	}
 
 	target->files = (File *)
 		repalloc(target->files, sizeof(File) * newNumFiles);
@@ -78,6 +78,9 @@
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>		/* for getrlimit */
 #endif
+#ifdef HAVE_PREADV
+#include <sys/uio.h>			/* for preadv */
+#endif
 
 #include "miscadmin.h"
 #include "access/xact.h"
@@ -101,6 +104,9 @@
 #define PG_FLUSH_DATA_WORKS 1
 #endif
 
+/* Maximum number of buffers FileReadV() reads with a single preadv() */
+#define FILE_READV_MAX_BUFFERS	64
+
 /*
  * We must leave some file descriptors free for system(), the dynamic loader,
  * and other code that tries to open files without consulting fd.c.  This
@@ -1912,6 +1918,74 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileReadV - read nbuffers * buflen consecutive bytes of the file, starting
+ * at offset, into nbuffers buffers of buflen bytes each.
+ *
+ * This is done with a single preadv() where available.  Like FileRead(),
+ * this returns the number of bytes read, which may be less than requested,
+ * or -1 with errno set.
+ */
+int
+FileReadV(File file, char **buffers, int nbuffers, int buflen, off_t offset,
+		  uint32 wait_event_info)
+{
+	int			returnCode;
+	int			total = 0;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d*%d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   nbuffers, buflen));
+
+#ifdef HAVE_PREADV
+	if (nbuffers > 1 && nbuffers <= FILE_READV_MAX_BUFFERS)
+	{
+		struct iovec iov[FILE_READV_MAX_BUFFERS];
+		int			i;
+
+		returnCode = FileAccess(file);
+		if (returnCode < 0)
+			return returnCode;
+
+		for (i = 0; i < nbuffers; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = buflen;
+		}
+
+retry:
+		pgstat_report_wait_start(wait_event_info);
+		returnCode = preadv(VfdCache[file].fd, iov, nbuffers, offset);
+		pgstat_report_wait_end();
+
+		/* OK to retry if interrupted */
+		if (returnCode < 0 && errno == EINTR)
+			goto retry;
+
+		return returnCode;
+	}
+#endif
+
+	/* read the buffers one at a time */
+	while (nbuffers-- > 0)
+	{
+		returnCode = FileRead(file, *buffers++, buflen, offset,
+							  wait_event_info);
+		if (returnCode < 0)
+			return total > 0 ? total : returnCode;
+		total += returnCode;
+		if (returnCode < buflen)
+			break;
+		offset += buflen;
+	}
+
+	return total;
+}
+
 int
 FileWrite(File file, char *buffer, int amount, off_t offset,
 		  uint32 wait_event_info)
@@ -12,6 +12,14 @@
  * hold the correct locks while setting or clearing its MyPgXact->xid field.
  * See notes in src/backend/access/transam/README.
  *
+ * The XIDs of the procs in the array are also kept in ProcGlobal->xids, a
+ * dense array in the same order as pgprocnos[], so that GetSnapshotData()
+ * can find the running transactions without touching the PGXACT of every
+ * backend.  A proc's position in it is its pgxactoff.  Positions only change
+ * in ProcArrayAdd() and ProcArrayRemove(), which hold both ProcArrayLock and
+ * XidGenLock, so a backend may store its own entry while holding either of
+ * them.
+ *
  * The process arrays now also include structures representing prepared
  * transactions.  The xid and subxids fields of these are valid, as are the
  * myProcLocks lists.  They can be distinguished from regular backend PGPROCs
@@ -171,6 +179,8 @@ static void KnownAssignedXidsDisplay(int trace_level);
 static void KnownAssignedXidsReset(void);
 static inline void ProcArrayEndTransactionInternal(PGPROC *proc,
 												   PGXACT *pgxact, TransactionId latestXid);
+static bool GetSnapshotDataReuse(Snapshot snapshot);
+static void GetSnapshotDataInitOldSnapshot(Snapshot snapshot);
 static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
 
 /*
@@ -246,6 +256,9 @@ CreateSharedProcArray(void)
 		procArray->lastOverflowedXid = InvalidTransactionId;
 		procArray->replication_slot_xmin = InvalidTransactionId;
 		procArray->replication_slot_catalog_xmin = InvalidTransactionId;
+
+		/* zero means "unknown" to GetSnapshotDataReuse(), so start at 1 */
+		ShmemVariableCache->xactCompletionCount = 1;
 	}
 
 	allProcs = ProcGlobal->allProcs;
@@ -280,6 +293,12 @@ ProcArrayAdd(PGPROC *proc)
 
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 
+	/*
+	 * We are going to move entries of ProcGlobal->xids around, so keep
+	 * backends from storing a new XID in there meanwhile.
+	 */
+	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
+
 	if (arrayP->numProcs >= arrayP->maxProcs)
 	{
 		/*
@@ -287,6 +306,7 @@ ProcArrayAdd(PGPROC *proc)
 		 * fixed supply of PGPROC structs too, and so we should have failed
 		 * earlier.)
 		 */
+		LWLockRelease(XidGenLock);
 		LWLockRelease(ProcArrayLock);
 		ereport(FATAL,
 				(errcode(ERRCODE_TOO_MANY_CONNECTIONS),
@@ -314,9 +334,17 @@ ProcArrayAdd(PGPROC *proc)
 
 	memmove(&arrayP->pgprocnos[index + 1], &arrayP->pgprocnos[index],
 			(arrayP->numProcs - index) * sizeof(int));
+	memmove(&ProcGlobal->xids[index + 1], &ProcGlobal->xids[index],
+			(arrayP->numProcs - index) * sizeof(TransactionId));
 	arrayP->pgprocnos[index] = proc->pgprocno;
+	ProcGlobal->xids[index] = allPgXact[proc->pgprocno].xid;
 	arrayP->numProcs++;
 
+	/* Tell the procs we moved, and the new one, where their XID is now */
+	for (; index < arrayP->numProcs; index++)
+		allProcs[arrayP->pgprocnos[index]].pgxactoff = index;
+
+	LWLockRelease(XidGenLock);
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -343,6 +371,8 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 #endif
 
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	/* See ProcArrayAdd() */
+	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
 
 	if (TransactionIdIsValid(latestXid))
 	{
@@ -352,6 +382,9 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		/* Same as ProcArrayEndTransactionInternal() */
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -363,17 +396,29 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 	{
 		if (arrayP->pgprocnos[index] == proc->pgprocno)
 		{
+			Assert(proc->pgxactoff == index);
+
 			/* Keep the PGPROC array sorted. See notes above */
 			memmove(&arrayP->pgprocnos[index], &arrayP->pgprocnos[index + 1],
 					(arrayP->numProcs - index - 1) * sizeof(int));
+			memmove(&ProcGlobal->xids[index], &ProcGlobal->xids[index + 1],
+					(arrayP->numProcs - index - 1) * sizeof(TransactionId));
 			arrayP->pgprocnos[arrayP->numProcs - 1] = -1;	/* for debugging */
+			ProcGlobal->xids[arrayP->numProcs - 1] = InvalidTransactionId;
 			arrayP->numProcs--;
+
+			for (; index < arrayP->numProcs; index++)
+				allProcs[arrayP->pgprocnos[index]].pgxactoff = index;
+			proc->pgxactoff = -1;
+
+			LWLockRelease(XidGenLock);
 			LWLockRelease(ProcArrayLock);
 			return;
 		}
 	}
 
 	/* Oops */
+	LWLockRelease(XidGenLock);
 	LWLockRelease(ProcArrayLock);
 
 	elog(LOG, "failed to find proc %p in ProcArray", proc);
@@ -451,7 +496,10 @@ static inline void
 ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
 								TransactionId latestXid)
 {
+	Assert(ProcGlobal->xids[proc->pgxactoff] == pgxact->xid);
+
 	pgxact->xid = InvalidTransactionId;
+	ProcGlobal->xids[proc->pgxactoff] = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
 	/* must be cleared with xid/xmin: */
@@ -467,6 +515,9 @@ ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
 	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
+
+	/* Snapshots taken before this are now out of date */
+	ShmemVariableCache->xactCompletionCount++;
 }
 
 /*
@@ -602,12 +653,16 @@ ProcArrayClearTransaction(PGPROC *proc)
 	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But we need a lock to keep our
+	 * entry in ProcGlobal->xids from moving while we clear it.  Preparing a
+	 * transaction is rare enough that the exclusive lock doesn't matter.
 	 */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
 	pgxact->xid = InvalidTransactionId;
+	ProcGlobal->xids[proc->pgxactoff] = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
 	proc->recoveryConflictPending = false;
@@ -619,6 +674,8 @@ ProcArrayClearTransaction(PGPROC *proc)
 	/* Clear the subtransaction-XID cache too */
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+
+	LWLockRelease(ProcArrayLock);
 }
 
 /*
@@ -1498,6 +1555,11 @@ GetMaxSnapshotSubxidCount(void)
  *		RecentGlobalDataXmin: the global xmin for non-catalog tables
  *			>= RecentGlobalXmin
  *
+ * If no transaction has completed since the snapshot passed in was last
+ * filled, its contents are still correct, and we return it after updating
+ * just the per-call fields; see GetSnapshotDataReuse().  The global xmin
+ * variables are then left as they were.
+ *
  * Note: this function should probably not be called with an argument that's
  * not statically allocated (see xip allocation below).
  */
@@ -1512,6 +1574,7 @@ GetSnapshotData(Snapshot snapshot)
 	int			count = 0;
 	int			subcount = 0;
 	bool		suboverflowed = false;
+	uint64		curXactCompletionCount;
 	TransactionId replication_slot_xmin = InvalidTransactionId;
 	TransactionId replication_slot_catalog_xmin = InvalidTransactionId;
 
@@ -1555,6 +1618,14 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	LWLockAcquire(ProcArrayLock, LW_SHARED);
 
+	if (GetSnapshotDataReuse(snapshot))
+	{
+		LWLockRelease(ProcArrayLock);
+		return snapshot;
+	}
+
+	curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
 	/* xmax is always latestCompletedXid + 1 */
 	xmax = ShmemVariableCache->latestCompletedXid;
 	Assert(TransactionIdIsNormal(xmax));
@@ -1568,36 +1639,24 @@ GetSnapshotData(Snapshot snapshot)
 	if (!snapshot->takenDuringRecovery)
 	{
 		int		   *pgprocnos = arrayP->pgprocnos;
+		TransactionId *other_xids = ProcGlobal->xids;
 		int			numProcs;
 
 		/*
-		 * Spin over procArray checking xid, xmin, and subxids.  The goal is
-		 * to gather all active xids, find the lowest xmin, and try to record
-		 * subxids.
+		 * Spin over the XIDs of the procArray entries, gathering all active
+		 * xids and subxids and finding the oldest of them.  The dense copy
+		 * of the XIDs in ProcGlobal->xids lets us skip backends without an
+		 * XID, usually the vast majority, without looking at their PGXACT.
 		 */
 		numProcs = arrayP->numProcs;
 		for (index = 0; index < numProcs; index++)
 		{
-			int			pgprocno = pgprocnos[index];
-			PGXACT	   *pgxact = &allPgXact[pgprocno];
+			int			pgprocno;
+			PGXACT	   *pgxact;
 			TransactionId xid;
 
-			/*
-			 * Skip over backends doing logical decoding which manages xmin
-			 * separately (check below) and ones running LAZY VACUUM.
-			 */
-			if (pgxact->vacuumFlags &
-				(PROC_IN_LOGICAL_DECODING | PROC_IN_VACUUM))
-				continue;
-
-			/* Update globalxmin to be the smallest valid xmin */
-			xid = UINT32_ACCESS_ONCE(pgxact->xmin);
-			if (TransactionIdIsNormal(xid) &&
-				NormalTransactionIdPrecedes(xid, globalxmin))
-				globalxmin = xid;
-
 			/* Fetch xid just once - see GetNewTransactionId */
-			xid = UINT32_ACCESS_ONCE(pgxact->xid);
+			xid = UINT32_ACCESS_ONCE(other_xids[index]);
 
 			/*
 			 * If the transaction has no XID assigned, we can skip it; it
@@ -1605,10 +1664,23 @@ GetSnapshotData(Snapshot snapshot)
 			 * skip it; such transactions will be treated as running anyway
 			 * (and any sub-XIDs will also be >= xmax).
 			 */
+			if (likely(xid == InvalidTransactionId))
+				continue;
 			if (!TransactionIdIsNormal(xid)
 				|| !NormalTransactionIdPrecedes(xid, xmax))
 				continue;
 
+			pgprocno = pgprocnos[index];
+			pgxact = &allPgXact[pgprocno];
+
+			/*
+			 * Skip over backends doing logical decoding which manages xmin
+			 * separately (check below) and ones running LAZY VACUUM.
+			 */
+			if (pgxact->vacuumFlags &
+				(PROC_IN_LOGICAL_DECODING | PROC_IN_VACUUM))
+				continue;
+
 			/*
 			 * We don't include our own XIDs (if any) in the snapshot, but we
 			 * must include them in xmin.
@@ -1658,6 +1730,29 @@ GetSnapshotData(Snapshot snapshot)
 				}
 			}
 		}
+
+		/*
+		 * The global xmin also depends on the xmins of all backends, which
+		 * requires a look at every PGXACT.  This can't be skipped: a backend
+		 * can lower its xmin at any time, e.g. a walsender relaying a
+		 * standby's hot_standby_feedback.
+		 */
+		for (index = 0; index < numProcs; index++)
+		{
+			PGXACT	   *pgxact = &allPgXact[pgprocnos[index]];
+			TransactionId xid;
+
+			/* Skip the same backends as above */
+			if (pgxact->vacuumFlags &
+				(PROC_IN_LOGICAL_DECODING | PROC_IN_VACUUM))
+				continue;
+
+			/* Update globalxmin to be the smallest valid xmin */
+			xid = UINT32_ACCESS_ONCE(pgxact->xmin);
+			if (TransactionIdIsNormal(xid) &&
+				NormalTransactionIdPrecedes(xid, globalxmin))
+				globalxmin = xid;
+		}
 	}
 	else
 	{
@@ -1747,6 +1842,7 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->xcnt = count;
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
+	snapshot->snapXactCompletionCount = curXactCompletionCount;
 
 	snapshot->curcid = GetCurrentCommandId(false);
 
@@ -1758,6 +1854,74 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->regd_count = 0;
 	snapshot->copied = false;
 
+	GetSnapshotDataInitOldSnapshot(snapshot);
+
+	return snapshot;
+}
+
+/*
+ * GetSnapshotDataReuse -- try to reuse the previous contents of a snapshot
+ *
+ * The contents of a snapshot only change when a transaction that has an XID
+ * ends (or a subtransaction aborts), which is counted by
+ * ShmemVariableCache->xactCompletionCount.  New XIDs don't matter, as they
+ * are always >= xmax.  So if the counter is still where it was when the
+ * snapshot was built, recomputing it would give the same result, and we can
+ * skip the scan of the procArray, whose cost grows with the number of
+ * connections.
+ *
+ * RecentGlobalXmin and RecentGlobalDataXmin keep the values computed along
+ * with the snapshot.  Those horizons only move backwards when a walsender
+ * installs an older xmin on behalf of a standby, and that bumps the counter
+ * too, see ProcArrayInvalidateSnapshots().
+ *
+ * Caller must hold ProcArrayLock in shared mode, like for building the
+ * snapshot.  Snapshots taken during recovery are not reused; they depend on
+ * KnownAssignedXids, which does not maintain the counter.
+ */
+static bool
+GetSnapshotDataReuse(Snapshot snapshot)
+{
+	Assert(LWLockHeldByMe(ProcArrayLock));
+
+	if (unlikely(snapshot->snapXactCompletionCount == 0))
+		return false;
+
+	if (snapshot->takenDuringRecovery)
+		return false;
+
+	if (snapshot->snapXactCompletionCount !=
+		ShmemVariableCache->xactCompletionCount)
+		return false;
+
+	/*
+	 * The snapshot's xmin can still be advertised as our xmin: since no
+	 * transaction has completed, it's either the oldest running XID or
+	 * latestCompletedXid + 1, and nobody can have computed a newer horizon
+	 * than that in the meantime.
+	 */
+	if (!TransactionIdIsValid(MyPgXact->xmin))
+		MyPgXact->xmin = TransactionXmin = snapshot->xmin;
+
+	RecentXmin = snapshot->xmin;
+	Assert(TransactionIdPrecedesOrEquals(TransactionXmin, RecentXmin));
+
+	snapshot->curcid = GetCurrentCommandId(false);
+	snapshot->active_count = 0;
+	snapshot->regd_count = 0;
+	snapshot->copied = false;
+
+	GetSnapshotDataInitOldSnapshot(snapshot);
+
+	return true;
+}
+
+/*
+ * Fill in the "snapshot too old" fields of a snapshot.
+ */
+static void
+GetSnapshotDataInitOldSnapshot(Snapshot snapshot)
+{
 	if (old_snapshot_threshold < 0)
 	{
 		/*
@@ -1776,10 +1940,8 @@ GetSnapshotData(Snapshot snapshot)
 		 */
 		snapshot->lsn = GetXLogInsertRecPtr();
 		snapshot->whenTaken = GetSnapshotCurrentTimestamp();
-		MaintainOldSnapshotTimeMapping(snapshot->whenTaken, xmin);
+		MaintainOldSnapshotTimeMapping(snapshot->whenTaken, snapshot->xmin);
 	}
-
-	return snapshot;
 }
 
 /*
@@ -2988,6 +3150,16 @@ ProcArraySetReplicationSlotXmin(TransactionId xmin, TransactionId catalog_xmin,
 	if (!already_locked)
 		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 
+	/* If a limit moves backwards, reused snapshots must not ignore it */
+	if ((TransactionIdIsValid(xmin) &&
+		 (!TransactionIdIsValid(procArray->replication_slot_xmin) ||
+		  TransactionIdPrecedes(xmin, procArray->replication_slot_xmin))) ||
+		(TransactionIdIsValid(catalog_xmin) &&
+		 (!TransactionIdIsValid(procArray->replication_slot_catalog_xmin) ||
+		  TransactionIdPrecedes(catalog_xmin,
+								procArray->replication_slot_catalog_xmin))))
+		ShmemVariableCache->xactCompletionCount++;
+
 	procArray->replication_slot_xmin = xmin;
 	procArray->replication_slot_catalog_xmin = catalog_xmin;
 
@@ -2995,6 +3167,22 @@ ProcArraySetReplicationSlotXmin(TransactionId xmin, TransactionId catalog_xmin,
 		LWLockRelease(ProcArrayLock);
 }
 
+/*
+ * ProcArrayInvalidateSnapshots
+ *
+ * Make every backend build its next snapshot, and the xmin horizons that go
+ * with it, from scratch instead of reusing the previous one.  Must be called
+ * after lowering an xmin other than through GetSnapshotData(), since a
+ * reused snapshot keeps the horizons computed along with it.
+ */
+void
+ProcArrayInvalidateSnapshots(void)
+{
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	ShmemVariableCache->xactCompletionCount++;
+	LWLockRelease(ProcArrayLock);
+}
+
 /*
  * ProcArrayGetReplicationSlotXmin
  *
@@ -3102,6 +3290,9 @@ XidCacheRemoveRunningXids(TransactionId xid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
 
+	/* The aborted subtransactions no longer appear in snapshots */
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
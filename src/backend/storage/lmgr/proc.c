@@ -94,6 +94,7 @@ static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
+static Size FastPathLockShmemSize(void);
 
 
 /*
@@ -119,9 +120,33 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGXACT)));
 	size = add_size(size, mul_size(max_prepared_xacts, sizeof(PGXACT)));
 
+	/* ProcGlobal->xids */
+	size = add_size(size, mul_size(MaxBackends, sizeof(TransactionId)));
+	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(TransactionId)));
+	size = add_size(size, mul_size(max_prepared_xacts, sizeof(TransactionId)));
+
+	/* fast-path lock arrays */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts,
+								   FastPathLockShmemSize()));
+
 	return size;
 }
 
+/*
+ * Report the size of the fast-path lock arrays of one PGPROC.
+ *
+ * The arrays are sized at startup, so they can't be embedded in PGPROC;
+ * InitProcGlobal() carves them out of one chunk following the PGPROCs.
+ */
+static Size
+FastPathLockShmemSize(void)
+{
+	Assert(FastPathLockGroupsPerBackend > 0);
+
+	return MAXALIGN(mul_size(FastPathLockGroupsPerBackend, sizeof(uint64))) +
+		MAXALIGN(mul_size(FastPathLockSlotsPerBackend(), sizeof(Oid)));
+}
+
 /*
  * Report number of semaphores needed by InitProcGlobal.
  */
@@ -165,6 +190,9 @@ InitProcGlobal(void)
 {
 	PGPROC	   *procs;
 	PGXACT	   *pgxacts;
+	char	   *fpPtr;
+	Size		fpLockBitsSize,
+				fpRelIdSize;
 	int			i,
 				j;
 	bool		found;
@@ -217,10 +245,35 @@ InitProcGlobal(void)
 	MemSet(pgxacts, 0, TotalProcs * sizeof(PGXACT));
 	ProcGlobal->allPgXact = pgxacts;
 
+	/*
+	 * And the dense copy of the XIDs of the procs in the ProcArray, which
+	 * lets GetSnapshotData() skip over the many backends that have none.
+	 */
+	ProcGlobal->xids =
+		(TransactionId *) ShmemAlloc(TotalProcs * sizeof(TransactionId));
+	MemSet(ProcGlobal->xids, 0, TotalProcs * sizeof(TransactionId));
+
+	/*
+	 * And the fast-path lock arrays of all the PGPROCs, whose size depends on
+	 * FastPathLockGroupsPerBackend.
+	 */
+	fpLockBitsSize = MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64));
+	fpRelIdSize = MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+	Assert(fpLockBitsSize + fpRelIdSize == FastPathLockShmemSize());
+
+	fpPtr = ShmemAlloc(TotalProcs * (fpLockBitsSize + fpRelIdSize));
+	MemSet(fpPtr, 0, TotalProcs * (fpLockBitsSize + fpRelIdSize));
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
 
+		/* Point the PGPROC at its fast-path lock arrays. */
+		procs[i].fpLockBits = (uint64 *) fpPtr;
+		fpPtr += fpLockBitsSize;
+		procs[i].fpRelId = (Oid *) fpPtr;
+		fpPtr += fpRelIdSize;
+
 		/*
 		 * Set up per-PGPROC semaphore, latch, and backendLock. Prepared xact
 		 * dummy PGPROCs don't need these though - they're never associated
@@ -233,6 +286,7 @@ InitProcGlobal(void)
 			LWLockInitialize(&(procs[i].backendLock), LWTRANCHE_PROC);
 		}
 		procs[i].pgprocno = i;
+		procs[i].pgxactoff = -1;
 
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
@@ -507,15 +507,21 @@ mdclose(SMgrRelation reln, ForkNumber forknum)
 
 /*
  *	mdprefetch() -- Initiate asynchronous read of the specified block of a relation
+ *
+ * In recovery, WAL may reference relations dropped or truncated later on, so
+ * a missing segment isn't an error there; false is returned instead.
  */
-void
+bool
 mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 {
 #ifdef USE_PREFETCH
 	off_t		seekpos;
 	MdfdVec    *v;
 
-	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+	v = _mdfd_getseg(reln, forknum, blocknum, false,
+					 InRecovery ? EXTENSION_RETURN_NULL : EXTENSION_FAIL);
+	if (v == NULL)
+		return false;
 
 	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
 
@@ -523,6 +529,8 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 
 	(void) FilePrefetch(v->mdfd_vfd, seekpos, BLCKSZ, WAIT_EVENT_DATA_FILE_PREFETCH);
 #endif							/* USE_PREFETCH */
+
+	return true;
 }
 
 /*
@@ -638,6 +646,85 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdreadv() -- Read a run of consecutive blocks from a relation.
+ *
+ * The blocks within each segment file are read with a single FileReadV
+ * call, if the kernel returns them all at once.  Reading past EOF is
+ * handled as in mdread().
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		BlockNumber nthis;
+		BlockNumber ndone;
+		MdfdVec    *v;
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode,
+											reln->smgr_rnode.backend);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		/* don't read across the end of the segment */
+		nthis = Min(nblocks,
+					RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+
+		nbytes = FileReadV(v->mdfd_vfd, buffers, nthis, BLCKSZ, seekpos,
+						   WAIT_EVENT_DATA_FILE_READ);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode,
+										   reln->smgr_rnode.backend,
+										   nbytes,
+										   BLCKSZ * nthis);
+
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+							blocknum, blocknum + nthis - 1,
+							FilePathName(v->mdfd_vfd))));
+
+		/*
+		 * The kernel may return fewer bytes than requested.  Carry on after
+		 * the last complete block; but if not even the first block could be
+		 * read in full, we are at or past EOF, see mdread().
+		 */
+		ndone = nbytes / BLCKSZ;
+		if (ndone == 0)
+		{
+			if (zero_damaged_pages || InRecovery)
+				MemSet(buffers[0], 0, BLCKSZ);
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								blocknum, FilePathName(v->mdfd_vfd),
+								nbytes, BLCKSZ)));
+			ndone = 1;
+		}
+
+		buffers += ndone;
+		blocknum += ndone;
+		nblocks -= ndone;
+	}
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -3831,8 +3831,12 @@ PostgresMain(int argc, char *argv[],
 		/* read control file (error checking and contains config ) */
 		LocalProcessControlFile(false);
 
-		/* Initialize MaxBackends (if under postmaster, was done already) */
+		/*
+		 * Initialize MaxBackends and the fast-path lock array size (if under
+		 * postmaster, was done already)
+		 */
 		InitializeMaxBackends();
+		InitializeFastPathLocks();
 	}
 
 	/* Early initialization */
@@ -538,6 +538,29 @@ InitializeMaxBackends(void)
 		elog(ERROR, "too many backends configured");
 }
 
+/*
+ * Initialize the number of fast-path lock groups from max_locks_per_transaction.
+ *
+ * Each backend gets enough fast-path slots for the max_locks_per_transaction
+ * locks it is expected to hold, rounded up to a power of two number of
+ * groups, so that workloads that raise the setting because they touch many
+ * relations also get to lock those relations without going through the
+ * shared lock table.
+ *
+ * This must be called before shared memory size is determined, under the
+ * same rules as InitializeMaxBackends().
+ */
+void
+InitializeFastPathLocks(void)
+{
+	Assert(FastPathLockGroupsPerBackend == 0);
+
+	FastPathLockGroupsPerBackend = 1;
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX &&
+		   FastPathLockSlotsPerBackend() < max_locks_per_xact)
+		FastPathLockGroupsPerBackend *= 2;
+}
+
 /*
  * Early initialization of a backend (either standalone or under postmaster).
  * This happens even before InitPostgres.
@@ -690,8 +713,14 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 
 	/* Initialize stats collection --- must happen before first xact */
 	if (!bootstrap)
+	{
 		pgstat_initialize();
 
+		/* A standalone backend saves the statistics itself at exit */
+		if (!IsUnderPostmaster)
+			before_shmem_exit(pgstat_before_server_shutdown, 0);
+	}
+
 	/*
 	 * Load relcache entries for the shared system catalogs.  This must create
 	 * at least entries for pg_database and catalogs used for authentication.
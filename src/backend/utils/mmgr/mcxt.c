@@ -462,6 +462,35 @@ MemoryContextIsEmpty(MemoryContext context)
 	return context->methods->is_empty(context);
 }
 
+/*
+ * MemoryContextMemAllocated
+ *		Memory allocated from the system by a context, and optionally by
+ *		all its descendants.
+ *
+ * This counts the blocks the context obtained from malloc(), not the
+ * chunks handed out by palloc(), so it includes free space within the
+ * blocks.  It is cheap to compute for a single context.
+ */
+Size
+MemoryContextMemAllocated(MemoryContext context, bool recurse)
+{
+	Size		total = context->mem_allocated;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	if (recurse)
+	{
+		MemoryContext child;
+
+		for (child = context->firstchild;
+			 child != NULL;
+			 child = child->nextchild)
+			total += MemoryContextMemAllocated(child, true);
+	}
+
+	return total;
+}
+
 /*
  * MemoryContextStats
  *		Print statistics about the named context and all its descendants.
@@ -733,6 +762,7 @@ MemoryContextCreate(MemoryContext node,
 	/* Initialize all standard fields of memory context header */
 	node->type = tag;
 	node->isReset = true;
+	node->mem_allocated = 0;
 	node->methods = methods;
 	node->parent = parent;
 	node->firstchild = NULL;
@@ -53,6 +53,22 @@ print <<'EOM';
 EOM
 emit_qsort_implementation();
 
+$SUFFIX      = 'int32';
+$EXTRAARGS   = ', Tuplesortstate *state';
+$EXTRAPARAMS = ', state';
+$CMPPARAMS   = ', state';
+emit_qsort_implementation();
+
+$SUFFIX = 'signed';
+print <<'EOM';
+
+#ifdef USE_FLOAT8_BYVAL
+EOM
+emit_qsort_implementation();
+print <<'EOM';
+#endif							/* USE_FLOAT8_BYVAL */
+EOM
+
 sub emit_qsort_boilerplate
 {
 	print <<'EOM';
@@ -419,6 +419,14 @@ struct Tuplesortstate
 	 */
 	SortSupport onlyKey;
 
+	/*
+	 * Does SortTuple.datum1/isnull1 hold the leading sort key?  True in every
+	 * case except the hash index case and CLUSTER on an expression index.
+	 * When it does, tuplesort_sort_memtuples() can use the qsort variants
+	 * that compare datum1 with an inlined comparator.
+	 */
+	bool		haveDatum1;
+
 	/*
 	 * Additional state for managing "abbreviated key" sortsupport routines
 	 * (which currently may be used by all cases except the hash index case).
@@ -648,12 +656,49 @@ static void worker_nomergeruns(Tuplesortstate *state);
 static void leader_takeover_tapes(Tuplesortstate *state);
 static void free_sort_tuple(Tuplesortstate *state, SortTuple *stup);
 
+/*
+ * Comparators used by the qsort_int32() and qsort_signed() specializations.
+ * The leading key is compared with the comparison inlined; only ties fall
+ * back to the full comparetup routine, unless there's just the one key.
+ */
+static inline int
+cmp_int32(SortTuple *a, SortTuple *b, Tuplesortstate *state)
+{
+	int			compare;
+
+	compare = ApplyInt32SortComparator(a->datum1, a->isnull1,
+									   b->datum1, b->isnull1,
+									   &state->sortKeys[0]);
+	if (compare != 0 || state->onlyKey != NULL)
+		return compare;
+
+	return state->comparetup(a, b, state);
+}
+
+#ifdef USE_FLOAT8_BYVAL
+static inline int
+cmp_signed(SortTuple *a, SortTuple *b, Tuplesortstate *state)
+{
+	int			compare;
+
+	compare = ApplySignedSortComparator(a->datum1, a->isnull1,
+										b->datum1, b->isnull1,
+										&state->sortKeys[0]);
+	if (compare != 0 || state->onlyKey != NULL)
+		return compare;
+
+	return state->comparetup(a, b, state);
+}
+#endif
+
 /*
  * Special versions of qsort just for SortTuple objects.  qsort_tuple() sorts
  * any variant of SortTuples, using the appropriate comparetup function.
  * qsort_ssup() is specialized for the case where the comparetup function
  * reduces to ApplySortComparator(), that is single-key MinimalTuple sorts
- * and Datum sorts.
+ * and Datum sorts.  qsort_int32() and qsort_signed() are specialized for a
+ * leading key whose comparator is ssup_datum_int32_cmp() or
+ * ssup_datum_signed_cmp() respectively.
  */
 #include "qsort_tuple.c"
 
@@ -871,6 +916,8 @@ tuplesort_begin_heap(TupleDesc tupDesc,
 	if (nkeys == 1 && !state->sortKeys->abbrev_converter)
 		state->onlyKey = state->sortKeys;
 
+	state->haveDatum1 = true;
+
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
@@ -966,6 +1013,9 @@ tuplesort_begin_cluster(TupleDesc tupDesc,
 
 	pfree(indexScanKey);
 
+	/* copytup_cluster() sets datum1 only if the leading key is a column */
+	state->haveDatum1 = (state->indexInfo->ii_IndexAttrNumbers[0] != 0);
+
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
@@ -1044,6 +1094,8 @@ tuplesort_begin_index_btree(Relation heapRel,
 
 	pfree(indexScanKey);
 
+	state->haveDatum1 = true;
+
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
@@ -1165,6 +1217,8 @@ tuplesort_begin_datum(Oid datumType, Oid sortOperator, Oid sortCollation,
 	if (!state->sortKeys->abbrev_converter)
 		state->onlyKey = state->sortKeys;
 
+	state->haveDatum1 = true;
+
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
@@ -3312,6 +3366,27 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 
 	if (state->memtupcount > 1)
 	{
+		/*
+		 * Do we have a specialization for the leading key's comparator?  If
+		 * abbreviation is in use, the comparator is the abbreviated one and
+		 * won't match.
+		 */
+		if (state->haveDatum1 && state->sortKeys != NULL)
+		{
+			if (state->sortKeys[0].comparator == ssup_datum_int32_cmp)
+			{
+				qsort_int32(state->memtuples, state->memtupcount, state);
+				return;
+			}
+#ifdef USE_FLOAT8_BYVAL
+			if (state->sortKeys[0].comparator == ssup_datum_signed_cmp)
+			{
+				qsort_signed(state->memtuples, state->memtupcount, state);
+				return;
+			}
+#endif
+		}
+
 		/* Can we use the single-key sort function? */
 		if (state->onlyKey != NULL)
 			qsort_ssup(state->memtuples, state->memtupcount,
@@ -4588,3 +4663,38 @@ free_sort_tuple(Tuplesortstate *state, SortTuple *stup)
 	FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
 	pfree(stup->tuple);
 }
+
+/*
+ * Sortsupport comparators for datatypes that are compared as plain integers.
+ * tuplesort_sort_memtuples() recognizes these and uses a qsort variant with
+ * the comparison inlined; elsewhere they're called like any other comparator.
+ */
+int
+ssup_datum_int32_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	int32		a = DatumGetInt32(x);
+	int32		b = DatumGetInt32(y);
+
+	if (a < b)
+		return -1;
+	else if (a > b)
+		return 1;
+	else
+		return 0;
+}
+
+#ifdef USE_FLOAT8_BYVAL
+int
+ssup_datum_signed_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	int64		a = DatumGetInt64(x);
+	int64		b = DatumGetInt64(y);
+
+	if (a < b)
+		return -1;
+	else if (a > b)
+		return 1;
+	else
+		return 0;
+}
+#endif
@@ -141,6 +141,8 @@ typedef struct _dumpOptions
 	bool		aclsSkip;
 	const char *lockWaitTimeout;
 	int			dump_inserts;	/* 0 = COPY, otherwise rows per INSERT */
+	int			table_chunk_pages;	/* 0 = dump each table's data in one
+									 * piece, otherwise pages per chunk */
 
 	/* flags for various command-line long options */
 	int			disable_dollar_quoting;
@@ -1855,8 +1855,13 @@ buildTocEntryArrays(ArchiveHandle *AH)
 		/*
 		 * tableDataId provides the TABLE DATA item's dump ID for each TABLE
 		 * TOC entry that has a DATA item.  We compute this by reversing the
-		 * TABLE DATA item's dependency, knowing that a TABLE DATA item has
-		 * just one dependency and it is the TABLE item.
+		 * TABLE DATA item's dependency, knowing that the first dependency of
+		 * a TABLE DATA item is the TABLE item.
+		 *
+		 * Since K_VERS_1_15, a table's data may have been dumped in chunks,
+		 * one TABLE DATA item each.  The chunk that depends on all the
+		 * others, and so will be restored last, is the one that stands for
+		 * the table's data.
 		 */
 		if (strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
 		{
@@ -1870,6 +1875,16 @@ buildTocEntryArrays(ArchiveHandle *AH)
 			if (tableId <= 0 || tableId > maxDumpId)
 				fatal("bad table dumpId for TABLE DATA item");
 
+			if (AH->tableDataId[tableId] != 0 && AH->version >= K_VERS_1_15)
+			{
+				TocEntry   *otherte = AH->tocsByDumpId[AH->tableDataId[tableId]];
+
+				otherte->dataChunked = true;
+				te->dataChunked = true;
+				if (otherte->nDeps > te->nDeps)
+					continue;
+			}
+
 			AH->tableDataId[tableId] = te->dumpId;
 		}
 	}
@@ -4780,7 +4795,13 @@ mark_create_done(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->created = true;
+		/*
+		 * The TRUNCATE that restore_toc_entry issues for a freshly created
+		 * table would wipe out chunks of its data restored before, so don't
+		 * do that if the data was dumped in chunks.
+		 */
+		if (!ted->dataChunked)
+			ted->created = true;
 	}
 }
 
@@ -4799,6 +4820,20 @@ inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
 		ted->reqs = 0;
+
+		/* If the data was dumped in chunks, skip all of them */
+		if (ted->dataChunked)
+		{
+			TocEntry   *otherte;
+
+			for (otherte = AH->toc->next; otherte != AH->toc;
+				 otherte = otherte->next)
+			{
+				if (otherte->dataChunked &&
+					otherte->dependencies[0] == te->dumpId)
+					otherte->reqs = 0;
+			}
+		}
 	}
 }
 
@@ -165,6 +165,9 @@ static void expand_table_name_patterns(Archive *fout,
 									   bool strict_names);
 static NamespaceInfo *findNamespace(Archive *fout, Oid nsoid);
 static void dumpTableData(Archive *fout, TableDataInfo *tdinfo);
+static DumpId *dumpTableDataChunks(Archive *fout, TableDataInfo *tdinfo,
+								   const char *copyStmt, int *nDeps,
+								   BlockNumber *dataLength);
 static void refreshMatViewData(Archive *fout, TableDataInfo *tdinfo);
 static void guessConstraintInheritance(TableInfo *tblinfo, int numTables);
 static void dumpComment(Archive *fout, const char *type, const char *name,
@@ -294,6 +297,7 @@ static bool nonemptyReloptions(const char *reloptions);
 static void appendReloptionsArrayAH(PQExpBuffer buffer, const char *reloptions,
 									const char *prefix, Archive *fout);
 static char *get_synchronized_snapshot(Archive *fout);
+static bool server_has_tidrangescan(Archive *fout);
 static void setupDumpWorker(Archive *AHX);
 static TableInfo *getRootTableInfo(TableInfo *tbinfo);
 
@@ -319,6 +323,7 @@ main(int argc, char **argv)
 	const char *dumpsnapshot = NULL;
 	char	   *use_role = NULL;
 	long		rowsPerInsert;
+	long		tableChunkSize;
 	int			numWorkers = 1;
 	trivalue	prompt_password = TRI_DEFAULT;
 	int			compressLevel = -1;
@@ -391,6 +396,7 @@ main(int argc, char **argv)
 		{"no-sync", no_argument, NULL, 7},
 		{"on-conflict-do-nothing", no_argument, &dopt.do_nothing, 1},
 		{"rows-per-insert", required_argument, NULL, 10},
+		{"table-chunk-size", required_argument, NULL, 11},
 
 		{NULL, 0, NULL, 0}
 	};
@@ -607,6 +613,22 @@ main(int argc, char **argv)
 				dopt.dump_inserts = (int) rowsPerInsert;
 				break;
 
+			case 11:			/* table chunk size, in megabytes */
+				errno = 0;
+				tableChunkSize = strtol(optarg, &endptr, 10);
+
+				if (endptr == optarg || *endptr != '\0' ||
+					tableChunkSize <= 0 ||
+					tableChunkSize > INT_MAX / (1024 * 1024 / BLCKSZ) ||
+					errno == ERANGE)
+				{
+					pg_log_error("table-chunk-size must be in range %d..%d",
+								 1, INT_MAX / (1024 * 1024 / BLCKSZ));
+					exit_nicely(1);
+				}
+				dopt.table_chunk_pages = (int) (tableChunkSize * (1024 * 1024 / BLCKSZ));
+				break;
+
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit_nicely(1);
@@ -772,6 +794,16 @@ main(int argc, char **argv)
 	if (dumpsnapshot && fout->remoteVersion < 90200)
 		fatal("Exported snapshots are not supported by this server version.");
 
+	/*
+	 * Without TID range scans, every chunk of a table would read the whole
+	 * table, so dump each table in one piece instead.
+	 */
+	if (dopt.table_chunk_pages > 0 && !server_has_tidrangescan(fout))
+	{
+		pg_log_warning("server does not support TID range scans, ignoring --table-chunk-size");
+		dopt.table_chunk_pages = 0;
+	}
+
 	/*
 	 * Find the last built-in OID, if needed (prior to 8.1)
 	 *
@@ -1035,6 +1067,7 @@ help(const char *progname)
 	printf(_("  --snapshot=SNAPSHOT          use given snapshot for the dump\n"));
 	printf(_("  --strict-names               require table and/or schema include patterns to\n"
 			 "                               match at least one entity each\n"));
+	printf(_("  --table-chunk-size=MB        dump data of larger tables in chunks of this size\n"));
 	printf(_("  --use-set-session-authorization\n"
 			 "                               use SET SESSION AUTHORIZATION commands instead of\n"
 			 "                               ALTER OWNER commands to set ownership\n"));
@@ -1254,6 +1287,38 @@ get_synchronized_snapshot(Archive *fout)
 	return result;
 }
 
+/*
+ * Check whether the server can scan just a range of a table's pages, as
+ * needed to dump table data in chunks.  The server version doesn't tell,
+ * so see whether the planner comes up with a TID range scan for a ctid
+ * inequality.
+ */
+static bool
+server_has_tidrangescan(Archive *fout)
+{
+	PGresult   *res;
+	bool		result = false;
+	int			i;
+
+	if (fout->remoteVersion < 120000)
+		return false;
+
+	ExecuteSqlStatement(fout, "SET enable_seqscan = off");
+	res = ExecuteSqlQuery(fout,
+						  "EXPLAIN (COSTS OFF) SELECT FROM pg_catalog.pg_class "
+						  "WHERE ctid < '(1,0)'::pg_catalog.tid",
+						  PGRES_TUPLES_OK);
+	for (i = 0; i < PQntuples(res); i++)
+	{
+		if (strstr(PQgetvalue(res, i, 0), "Tid Range Scan") != NULL)
+			result = true;
+	}
+	PQclear(res);
+	ExecuteSqlStatement(fout, "RESET enable_seqscan");
+
+	return result;
+}
+
 static ArchiveFormat
 parseArchiveFormat(const char *format, ArchiveMode *mode)
 {
@@ -1812,7 +1877,7 @@ dumpTableData_copy(Archive *fout, void *dcontext)
 	 */
 	column_list = fmtCopyColumnList(tbinfo, clistBuf);
 
-	if (tdinfo->filtercond)
+	if (tdinfo->filtercond || tdinfo->chunkcond)
 	{
 		/* Note: this syntax is only supported in 8.2 and up */
 		appendPQExpBufferStr(q, "COPY (SELECT ");
@@ -1824,9 +1889,14 @@ dumpTableData_copy(Archive *fout, void *dcontext)
 		}
 		else
 			appendPQExpBufferStr(q, "* ");
-		appendPQExpBuffer(q, "FROM %s %s) TO stdout;",
-						  fmtQualifiedDumpable(tbinfo),
-						  tdinfo->filtercond);
+		if (tdinfo->chunkcond)
+			appendPQExpBuffer(q, "FROM ONLY %s %s) TO stdout;",
+							  fmtQualifiedDumpable(tbinfo),
+							  tdinfo->chunkcond);
+		else
+			appendPQExpBuffer(q, "FROM %s %s) TO stdout;",
+							  fmtQualifiedDumpable(tbinfo),
+							  tdinfo->filtercond);
 	}
 	else
 	{
@@ -2237,6 +2307,32 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 	if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
 	{
 		TocEntry   *te;
+		DumpId	   *deps = &(tbinfo->dobj.dumpId);
+		int			nDeps = 1;
+		BlockNumber dataLength;
+
+		/*
+		 * Set the TocEntry's dataLength in case we are doing a parallel dump
+		 * and want to order dump jobs by table size.  We choose to measure
+		 * dataLength in table pages during dump, so no scaling is needed.
+		 * However, relpages is declared as "integer" in pg_class, and hence
+		 * also in TableInfo, but it's really BlockNumber a/k/a unsigned int.
+		 * Cast so that we get the right interpretation of table sizes
+		 * exceeding INT_MAX pages.
+		 */
+		dataLength = (BlockNumber) tbinfo->relpages;
+
+		/*
+		 * If asked to, split the data of a large table into chunks, so that
+		 * parallel dump and restore can work on them concurrently.  The
+		 * filtered data of extension config tables is never split.
+		 */
+		if (dopt->table_chunk_pages > 0 && dumpFn == dumpTableData_copy &&
+			tbinfo->relkind == RELKIND_RELATION &&
+			tdinfo->filtercond == NULL &&
+			dataLength > (BlockNumber) dopt->table_chunk_pages)
+			deps = dumpTableDataChunks(fout, tdinfo, copyStmt,
+									   &nDeps, &dataLength);
 
 		te = ArchiveEntry(fout, tdinfo->dobj.catId, tdinfo->dobj.dumpId,
 						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
@@ -2245,27 +2341,90 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 									   .description = "TABLE DATA",
 									   .section = SECTION_DATA,
 									   .copyStmt = copyStmt,
-									   .deps = &(tbinfo->dobj.dumpId),
-									   .nDeps = 1,
+									   .deps = deps,
+									   .nDeps = nDeps,
 									   .dumpFn = dumpFn,
 									   .dumpArg = tdinfo));
 
-		/*
-		 * Set the TocEntry's dataLength in case we are doing a parallel dump
-		 * and want to order dump jobs by table size.  We choose to measure
-		 * dataLength in table pages during dump, so no scaling is needed.
-		 * However, relpages is declared as "integer" in pg_class, and hence
-		 * also in TableInfo, but it's really BlockNumber a/k/a unsigned int.
-		 * Cast so that we get the right interpretation of table sizes
-		 * exceeding INT_MAX pages.
-		 */
-		te->dataLength = (BlockNumber) tbinfo->relpages;
+		te->dataLength = dataLength;
 	}
 
 	destroyPQExpBuffer(copyBuf);
 	destroyPQExpBuffer(clistBuf);
 }
 
+/*
+ * dumpTableDataChunks -
+ *	  make ArchiveEntries for all but the last chunk of a table's data
+ *
+ * The table is split into ranges of dopt->table_chunk_pages pages, which
+ * are dumped by COPYing the rows whose ctid falls in the range; the server
+ * reads just those pages with a TID range scan.  Every chunk but the last
+ * gets a TABLE DATA entry of its own, while the last one, which has no upper
+ * bound so that rows beyond the pg_class.relpages estimate are not missed,
+ * is left for the caller to dump under the table's own TABLE DATA entry.
+ * That entry is made to depend on all the other chunks, so that the objects
+ * that pg_restore makes wait for the table's data wait for all of it.
+ *
+ * Returns the dependency array for the table's own entry, and sets *nDeps
+ * and *dataLength (the size of the last chunk) to go with it.
+ */
+static DumpId *
+dumpTableDataChunks(Archive *fout, TableDataInfo *tdinfo,
+					const char *copyStmt, int *nDeps,
+					BlockNumber *dataLength)
+{
+	TableInfo  *tbinfo = tdinfo->tdtable;
+	BlockNumber relpages = *dataLength;
+	BlockNumber chunkpages = (BlockNumber) fout->dopt->table_chunk_pages;
+	BlockNumber startpage;
+	DumpId	   *deps;
+	int			ndeps = 0;
+
+	deps = (DumpId *) pg_malloc((relpages / chunkpages + 1) * sizeof(DumpId));
+	deps[ndeps++] = tbinfo->dobj.dumpId;
+
+	for (startpage = 0; relpages - startpage > chunkpages;
+		 startpage += chunkpages)
+	{
+		TableDataInfo *chunk;
+		TocEntry   *te;
+
+		chunk = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+		memcpy(chunk, tdinfo, sizeof(TableDataInfo));
+		if (startpage == 0)
+			chunk->chunkcond = psprintf("WHERE ctid < '(%u,0)'::pg_catalog.tid",
+										startpage + chunkpages);
+		else
+			chunk->chunkcond = psprintf("WHERE ctid >= '(%u,0)'::pg_catalog.tid"
+										" AND ctid < '(%u,0)'::pg_catalog.tid",
+										startpage, startpage + chunkpages);
+
+		deps[ndeps] = createDumpId();
+		te = ArchiveEntry(fout, tdinfo->dobj.catId, deps[ndeps],
+						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+									   .namespace = tbinfo->dobj.namespace->dobj.name,
+									   .owner = tbinfo->rolname,
+									   .description = "TABLE DATA",
+									   .section = SECTION_DATA,
+									   .copyStmt = copyStmt,
+									   .deps = &(tbinfo->dobj.dumpId),
+									   .nDeps = 1,
+									   .dumpFn = dumpTableData_copy,
+									   .dumpArg = chunk));
+		te->dataLength = chunkpages;
+		ndeps++;
+	}
+
+	/* The last chunk, dumped by the table's own entry, is open-ended */
+	tdinfo->chunkcond = psprintf("WHERE ctid >= '(%u,0)'::pg_catalog.tid",
+								 startpage);
+
+	*nDeps = ndeps;
+	*dataLength = relpages - startpage;
+	return deps;
+}
+
 /*
  * refreshMatViewData -
  *	  load or refresh the contents of a single materialized view
@@ -2380,6 +2539,7 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo)
 	tdinfo->dobj.namespace = tbinfo->dobj.namespace;
 	tdinfo->tdtable = tbinfo;
 	tdinfo->filtercond = NULL;	/* might get set later */
+	tdinfo->chunkcond = NULL;	/* might get set later */
 	addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
 
 	tbinfo->dataObj = tdinfo;
@@ -4112,6 +4272,9 @@ getSubscriptions(Archive *fout)
 	int			i_subslotname;
 	int			i_subsynccommit;
 	int			i_subpublications;
+	int			i_subconflictres;
+	int			i_subconflicttable;
+	bool		has_conflict_columns;
 	int			i,
 				ntups;
 
@@ -4136,6 +4299,18 @@ getSubscriptions(Archive *fout)
 
 	query = createPQExpBuffer();
 
+	/*
+	 * Conflict resolution settings only exist in KrahoDB servers, so check
+	 * for them rather than relying on the server version.
+	 */
+	res = ExecuteSqlQuery(fout,
+						  "SELECT 1 FROM pg_catalog.pg_attribute "
+						  "WHERE attrelid = 'pg_catalog.pg_subscription'::pg_catalog.regclass "
+						  "AND attname = 'subconflictres'",
+						  PGRES_TUPLES_OK);
+	has_conflict_columns = (PQntuples(res) > 0);
+	PQclear(res);
+
 	resetPQExpBuffer(query);
 
 	/* Get the subscriptions in current database. */
@@ -4143,11 +4318,24 @@ getSubscriptions(Archive *fout)
 					  "SELECT s.tableoid, s.oid, s.subname,"
 					  "(%s s.subowner) AS rolname, "
 					  " s.subconninfo, s.subslotname, s.subsynccommit, "
-					  " s.subpublications "
-					  "FROM pg_subscription s "
-					  "WHERE s.subdbid = (SELECT oid FROM pg_database"
-					  "                   WHERE datname = current_database())",
+					  " s.subpublications, ",
 					  username_subquery);
+
+	if (has_conflict_columns)
+		appendPQExpBufferStr(query,
+							 " s.subconflictres, "
+							 " CASE WHEN s.subconflictrelid <> 0 "
+							 " THEN s.subconflictrelid::pg_catalog.regclass::pg_catalog.text "
+							 " END AS subconflicttable ");
+	else
+		appendPQExpBufferStr(query,
+							 " 'e' AS subconflictres, "
+							 " NULL AS subconflicttable ");
+
+	appendPQExpBufferStr(query,
+						 "FROM pg_subscription s "
+						 "WHERE s.subdbid = (SELECT oid FROM pg_database"
+						 "                   WHERE datname = current_database())");
 	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
 
 	ntups = PQntuples(res);
@@ -4160,6 +4348,8 @@ getSubscriptions(Archive *fout)
 	i_subslotname = PQfnumber(res, "subslotname");
 	i_subsynccommit = PQfnumber(res, "subsynccommit");
 	i_subpublications = PQfnumber(res, "subpublications");
+	i_subconflictres = PQfnumber(res, "subconflictres");
+	i_subconflicttable = PQfnumber(res, "subconflicttable");
 
 	subinfo = pg_malloc(ntups * sizeof(SubscriptionInfo));
 
@@ -4181,6 +4371,13 @@ getSubscriptions(Archive *fout)
 			pg_strdup(PQgetvalue(res, i, i_subsynccommit));
 		subinfo[i].subpublications =
 			pg_strdup(PQgetvalue(res, i, i_subpublications));
+		subinfo[i].subconflictres =
+			pg_strdup(PQgetvalue(res, i, i_subconflictres));
+		if (PQgetisnull(res, i, i_subconflicttable))
+			subinfo[i].subconflicttable = NULL;
+		else
+			subinfo[i].subconflicttable =
+				pg_strdup(PQgetvalue(res, i, i_subconflicttable));
 
 		if (strlen(subinfo[i].rolname) == 0)
 			pg_log_warning("owner of subscription \"%s\" appears to be invalid",
@@ -4252,6 +4449,27 @@ dumpSubscription(Archive *fout, SubscriptionInfo *subinfo)
 	if (strcmp(subinfo->subsynccommit, "off") != 0)
 		appendPQExpBuffer(query, ", synchronous_commit = %s", fmtId(subinfo->subsynccommit));
 
+	switch (subinfo->subconflictres[0])
+	{
+		case 's':
+			appendPQExpBufferStr(query, ", conflict_resolution = skip");
+			break;
+		case 'u':
+			appendPQExpBufferStr(query, ", conflict_resolution = last_update_wins");
+			break;
+		case 'l':
+			appendPQExpBufferStr(query, ", conflict_resolution = log");
+			break;
+		default:
+			break;
+	}
+
+	if (subinfo->subconflicttable)
+	{
+		appendPQExpBufferStr(query, ", conflict_table = ");
+		appendStringLiteralAH(query, subinfo->subconflicttable, fout);
+	}
+
 	appendPQExpBufferStr(query, ");\n");
 
 	ArchiveEntry(fout, subinfo->dobj.catId, subinfo->dobj.dumpId,
@@ -353,6 +353,8 @@ typedef struct _tableDataInfo
 	DumpableObject dobj;
 	TableInfo  *tdtable;		/* link to table to dump */
 	char	   *filtercond;		/* WHERE condition to limit rows dumped */
+	char	   *chunkcond;		/* WHERE condition selecting the ctid range
+								 * of one chunk of the table's data */
 } TableDataInfo;
 
 typedef struct _indxInfo
@@ -628,6 +630,8 @@ typedef struct _SubscriptionInfo
 	char	   *subslotname;
 	char	   *subsynccommit;
 	char	   *subpublications;
+	char	   *subconflictres;
+	char	   *subconflicttable;
 } SubscriptionInfo;
 
 /*
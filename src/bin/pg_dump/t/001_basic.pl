@@ -4,7 +4,7 @@ use warnings;
 use Config;
 use PostgresNode;
 use TestLib;
-use Test::More tests => 74;
+use Test::More tests => 76;
 
 my $tempdir       = TestLib::tempdir;
 my $tempdir_short = TestLib::tempdir_short;
@@ -127,6 +127,11 @@ command_fails_like(
 	'pg_dump: --on-conflict-do-nothing requires --inserts, --rows-per-insert, --column-inserts'
 );
 
+command_fails_like(
+	[ 'pg_dump', '--table-chunk-size', '0' ],
+	qr/\Qpg_dump: error: table-chunk-size must be in range 1..\E/,
+	'pg_dump: table-chunk-size must be positive');
+
 # pg_dumpall command-line argument checks
 command_fails_like(
 	[ 'pg_dumpall', '-g', '-r' ],
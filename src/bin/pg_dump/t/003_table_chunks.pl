@@ -0,0 +1,53 @@
+#
+# Test dumping and restoring the data of a table in chunks
+#
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 6;
+
+my $tempdir = TestLib::tempdir;
+
+my $node = get_new_node('main');
+$node->init;
+$node->start;
+
+# A table of several megabytes, so that it's split into 1MB chunks.  The
+# child table makes sure the chunks of the parent don't pick up its rows.
+$node->safe_psql(
+	'postgres', qq{
+	CREATE TABLE big (id int PRIMARY KEY, filler text);
+	INSERT INTO big SELECT i, repeat('x', 200) FROM generate_series(1, 20000) i;
+	CREATE TABLE big_child () INHERITS (big);
+	INSERT INTO big_child VALUES (0, 'child');
+	CREATE TABLE small (id int);
+	INSERT INTO small VALUES (1), (2);
+	VACUUM ANALYZE;
+});
+
+$node->command_ok(
+	[
+		'pg_dump', '-Fd', '-j', '2', '--table-chunk-size', '1',
+		'-f', "$tempdir/chunked", 'postgres'
+	],
+	'parallel dump with table chunks');
+
+my ($toc, $stderr) = run_command([ 'pg_restore', '-l', "$tempdir/chunked" ]);
+my $nbig   = () = $toc =~ /TABLE DATA public big /g;
+my $nsmall = () = $toc =~ /TABLE DATA public small /g;
+cmp_ok($nbig, '>', 1, 'data of large table is dumped in several chunks');
+is($nsmall, 1, 'data of small table is dumped in one piece');
+
+$node->safe_psql('postgres', 'CREATE DATABASE restored');
+$node->command_ok(
+	[ 'pg_restore', '-j', '2', '-d', 'restored', "$tempdir/chunked" ],
+	'parallel restore of table chunks');
+
+is( $node->safe_psql(
+		'restored', 'SELECT count(*), sum(id) FROM ONLY big'),
+	'20000|200010000',
+	'all rows of the chunked table are restored once');
+is($node->safe_psql('restored', 'SELECT count(*) FROM big_child'),
+	'1', 'child table rows are restored once');
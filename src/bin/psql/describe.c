@@ -5883,7 +5883,7 @@ describeSubscriptions(const char *pattern, bool verbose)
 	PGresult   *res;
 	printQueryOpt myopt = pset.popt;
 	static const bool translate_columns[] = {false, false, false, false,
-	false, false, false, false};
+	false, false, false, false, false, false};
 
 	if (pset.sversion < 100000)
 	{
@@ -5913,11 +5913,20 @@ describeSubscriptions(const char *pattern, bool verbose)
 						  ",  subsynccommit AS \"%s\"\n"
 						  ",  subconninfo AS \"%s\"\n"
 						  ",  subroident AS \"%s\"\n"
-						  ",  subfilterorigins AS \"%s\"\n",
+						  ",  subfilterorigins AS \"%s\"\n"
+						  ",  CASE subconflictres\n"
+						  "     WHEN 'e' THEN 'error'\n"
+						  "     WHEN 's' THEN 'skip'\n"
+						  "     WHEN 'u' THEN 'last_update_wins'\n"
+						  "     WHEN 'l' THEN 'log'\n"
+						  "   END AS \"%s\"\n"
+						  ",  NULLIF(subconflictrelid, 0)::pg_catalog.regclass AS \"%s\"\n",
 						  gettext_noop("Synchronous commit"),
 						  gettext_noop("Conninfo"),
 						  gettext_noop("Origin ID"),
-						  gettext_noop("Filter Origins"));
+						  gettext_noop("Filter Origins"),
+						  gettext_noop("Conflict resolution"),
+						  gettext_noop("Conflict table"));
 	}
 
 	/* Only display subscriptions in current database. */
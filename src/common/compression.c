@@ -0,0 +1,109 @@
+/*-------------------------------------------------------------------------
+ * compression.c
+ *		Shared frontend/backend dispatch over the builtin compression methods
+ *
+ * TOAST and full-page images record which method compressed each datum or
+ * image, so that data written with any method stays readable whatever the
+ * current settings.  This module maps those method numbers to the codecs.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/common/compression.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "common/compression.h"
+#include "common/pg_lz4.h"
+
+static const char *const compression_method_names[] = {
+	"pglz",						/* PG_COMPRESSION_PGLZ */
+	"lz4"						/* PG_COMPRESSION_LZ4 */
+};
+
+/*
+ * Compress slen bytes at source into dest, which must have room for
+ * PG_COMPRESS_MAX_OUTPUT(slen) bytes.
+ *
+ * Returns the compressed length, or -1 if the data did not compress well
+ * enough to be worth storing compressed.
+ */
+int32
+pg_compress(PgCompressionMethod method, const char *source, int32 slen,
+			char *dest)
+{
+	switch (method)
+	{
+		case PG_COMPRESSION_PGLZ:
+			return pglz_compress(source, slen, dest, PGLZ_strategy_default);
+		case PG_COMPRESSION_LZ4:
+			/* insist on some savings, as pglz does */
+			return pg_lz4_compress(source, slen, dest, slen - 1);
+	}
+
+	return -1;
+}
+
+/*
+ * Decompress data written by pg_compress() with the given method.
+ *
+ * The arguments and result are as for pglz_decompress(); an unknown method
+ * is reported as corrupt data.
+ */
+int32
+pg_decompress(PgCompressionMethod method, const char *source, int32 slen,
+			  char *dest, int32 rawsize, bool check_complete)
+{
+	switch (method)
+	{
+		case PG_COMPRESSION_PGLZ:
+			return pglz_decompress(source, slen, dest, rawsize,
+								   check_complete);
+		case PG_COMPRESSION_LZ4:
+			return pg_lz4_decompress(source, slen, dest, rawsize,
+									 check_complete);
+	}
+
+	return -1;
+}
+
+/*
+ * Return the user-visible name of a compression method.
+ */
+const char *
+get_compression_method_name(PgCompressionMethod method)
+{
+	StaticAssertStmt(lengthof(compression_method_names) == PG_COMPRESSION_MAX_METHOD + 1,
+					 "compression_method_names[] is out of sync");
+
+	if (method < 0 || method > PG_COMPRESSION_MAX_METHOD)
+		return "???";
+	return compression_method_names[method];
+}
+
+/*
+ * Look up a compression method by name.  Returns false if there's none.
+ */
+bool
+get_compression_method_by_name(const char *name, PgCompressionMethod *method)
+{
+	int			i;
+
+	for (i = 0; i <= PG_COMPRESSION_MAX_METHOD; i++)
+	{
+		if (pg_strcasecmp(name, compression_method_names[i]) == 0)
+		{
+			*method = (PgCompressionMethod) i;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,372 @@
+/* ----------
+ * pg_lz4.c -
+ *
+ *		This is an implementation of the LZ4 block format for PostgreSQL.
+ *		Compared with pg_lzcompress.c it trades a little compression ratio
+ *		for much faster compression and, above all, decompression: the
+ *		decoder copies whole literal runs and matches instead of working
+ *		through a control bit per output byte.
+ *
+ *		Entry routines:
+ *
+ *			int32
+ *			pg_lz4_compress(const char *source, int32 slen, char *dest,
+ *							int32 dlen);
+ *
+ *				source is the input data to be compressed.
+ *
+ *				slen is the length of the input data.
+ *
+ *				dest is the output area for the compressed result.
+ *
+ *				dlen is the size of dest.  Compression gives up as soon as
+ *					the output would not fit, so callers that only want a
+ *					result smaller than some limit should pass that limit.
+ *					PG_LZ4_MAX_OUTPUT(slen) always suffices.
+ *
+ *				The return value is the number of bytes written in the
+ *				buffer dest, or -1 if compression fails; in the latter
+ *				case the contents of dest are undefined.
+ *
+ *			int32
+ *			pg_lz4_decompress(const char *source, int32 slen, char *dest,
+ *							  int32 rawsize, bool check_complete)
+ *
+ *				Same contract as pglz_decompress(): rawsize is the number
+ *				of bytes wanted, and with check_complete false a prefix of
+ *				the data may be requested.  The return value is the number
+ *				of bytes written in the buffer dest, or -1 if the input is
+ *				corrupt.
+ *
+ *		The data format:
+ *
+ *			The compressed data is a series of sequences.  Each sequence
+ *			starts with a token byte whose upper nibble is the number of
+ *			literal bytes that follow and whose lower nibble is the length
+ *			of the match that follows them, minus 4.  A nibble value of 15
+ *			means the length continues in following bytes, each added to
+ *			it, until a byte other than 255 is seen.  After the literals
+ *			comes a 2-byte little-endian offset (1-65535) back into the
+ *			output, then any extra match length bytes.
+ *
+ *			The last sequence consists of literals only and ends the
+ *			input.  To keep decoders simple, the last 5 bytes of the data
+ *			are always literals and no match starts within the last 12
+ *			bytes.  This is the block format of the LZ4 library, so data
+ *			compressed here can be decoded by any LZ4 implementation and
+ *			vice versa.
+ *
+ *		The compression algorithm:
+ *
+ *			A hash table maps the hash of 4 input bytes to the last
+ *			position where they were seen.  At each position we look up
+ *			the candidate, and if its first 4 bytes really match and it is
+ *			within reach of the offset, we extend the match as far as
+ *			possible in both directions and emit a sequence.  Otherwise we
+ *			move on, taking larger steps the longer we go without finding
+ *			a match, so that incompressible data is skipped over quickly.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ *
+ * src/common/pg_lz4.c
+ * ----------
+ */
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "common/pg_lz4.h"
+
+
+/* ----------
+ * Local definitions
+ * ----------
+ */
+#define LZ4_MINMATCH			4
+#define LZ4_LASTLITERALS		5
+#define LZ4_MFLIMIT				12
+#define LZ4_MAX_DISTANCE		65535
+#define LZ4_RUN_MASK			15
+#define LZ4_HASH_BITS			12
+#define LZ4_HASH_SIZE			(1 << LZ4_HASH_BITS)
+#define LZ4_SKIP_TRIGGER		6
+
+
+static inline uint32
+lz4_read32(const unsigned char *p)
+{
+	uint32		v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32
+lz4_hash(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/*
+ * Emit the continuation bytes of a length that did not fit in its nibble.
+ */
+static inline unsigned char *
+lz4_put_length(unsigned char *op, int32 len)
+{
+	while (len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+/*
+ * Read the continuation bytes of a length, adding them to *len.  Returns
+ * false if the input ends first or the length is absurd.
+ */
+static inline bool
+lz4_get_length(const unsigned char **ipp, const unsigned char *iend,
+			   int32 *len)
+{
+	const unsigned char *ip = *ipp;
+	unsigned char b;
+
+	do
+	{
+		if (ip >= iend || *len > PG_INT32_MAX / 2)
+			return false;
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+
+	*ipp = ip;
+	return true;
+}
+
+
+/* ----------
+ * pg_lz4_compress -
+ *
+ *		Compresses source into dest, writing at most dlen bytes.
+ * ----------
+ */
+int32
+pg_lz4_compress(const char *source, int32 slen, char *dest, int32 dlen)
+{
+	const unsigned char *base = (const unsigned char *) source;
+	const unsigned char *ip = base;
+	const unsigned char *anchor = base;
+	const unsigned char *iend = base + slen;
+	unsigned char *op = (unsigned char *) dest;
+	unsigned char *oend = op + dlen;
+	unsigned char *token;
+	int32		litlen;
+
+	if (slen < 0 || dlen <= 0)
+		return -1;
+
+	/* Inputs too short to hold a match are stored as a single literal run */
+	if (slen > LZ4_MFLIMIT)
+	{
+		const unsigned char *mflimit = iend - LZ4_MFLIMIT;
+		const unsigned char *matchlimit = iend - LZ4_LASTLITERALS;
+		int32		hashtab[LZ4_HASH_SIZE];
+		int32		misses = 1 << LZ4_SKIP_TRIGGER;
+
+		memset(hashtab, 0, sizeof(hashtab));
+		ip++;
+
+		while (ip < mflimit)
+		{
+			uint32		sequence = lz4_read32(ip);
+			uint32		h = lz4_hash(sequence);
+			const unsigned char *ref = base + hashtab[h];
+			const unsigned char *mp;
+			const unsigned char *rp;
+			int32		matchlen;
+			int32		offset;
+
+			hashtab[h] = (int32) (ip - base);
+
+			if (ip - ref > LZ4_MAX_DISTANCE || lz4_read32(ref) != sequence)
+			{
+				ip += misses++ >> LZ4_SKIP_TRIGGER;
+				continue;
+			}
+			misses = 1 << LZ4_SKIP_TRIGGER;
+
+			/* Extend the match forwards, stopping short of the last literals */
+			mp = ip + LZ4_MINMATCH;
+			rp = ref + LZ4_MINMATCH;
+			while (mp < matchlimit && *mp == *rp)
+			{
+				mp++;
+				rp++;
+			}
+
+			/* ... and backwards over the pending literals */
+			while (ip > anchor && ref > base && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			litlen = (int32) (ip - anchor);
+			matchlen = (int32) (mp - ip) - LZ4_MINMATCH;
+			offset = (int32) (ip - ref);
+
+			/* Give up if the sequence might not fit */
+			if (oend - op < 1 + litlen / 255 + 1 + litlen + 2 +
+				matchlen / 255 + 1)
+				return -1;
+
+			token = op++;
+			if (litlen >= LZ4_RUN_MASK)
+			{
+				*token = LZ4_RUN_MASK << 4;
+				op = lz4_put_length(op, litlen - LZ4_RUN_MASK);
+			}
+			else
+				*token = (unsigned char) (litlen << 4);
+			memcpy(op, anchor, litlen);
+			op += litlen;
+
+			*op++ = (unsigned char) (offset & 0xff);
+			*op++ = (unsigned char) (offset >> 8);
+
+			if (matchlen >= LZ4_RUN_MASK)
+			{
+				*token |= LZ4_RUN_MASK;
+				op = lz4_put_length(op, matchlen - LZ4_RUN_MASK);
+			}
+			else
+				*token |= (unsigned char) matchlen;
+
+			ip = anchor = mp;
+
+			/* Remember a position near the end of the match, too */
+			if (ip < mflimit)
+				hashtab[lz4_hash(lz4_read32(ip - 2))] = (int32) (ip - 2 - base);
+		}
+	}
+
+	/* Emit the remaining input as the final, literal-only sequence */
+	litlen = (int32) (iend - anchor);
+	if (oend - op < 1 + litlen / 255 + 1 + litlen)
+		return -1;
+
+	token = op++;
+	if (litlen >= LZ4_RUN_MASK)
+	{
+		*token = LZ4_RUN_MASK << 4;
+		op = lz4_put_length(op, litlen - LZ4_RUN_MASK);
+	}
+	else
+		*token = (unsigned char) (litlen << 4);
+	memcpy(op, anchor, litlen);
+	op += litlen;
+
+	return (int32) ((char *) op - dest);
+}
+
+
+/* ----------
+ * pg_lz4_decompress -
+ *
+ *		Decompresses source into dest. Returns the number of bytes
+ *		decompressed in the destination buffer, or -1 if decompression
+ *		fails.
+ * ----------
+ */
+int32
+pg_lz4_decompress(const char *source, int32 slen, char *dest,
+				  int32 rawsize, bool check_complete)
+{
+	const unsigned char *ip = (const unsigned char *) source;
+	const unsigned char *iend = ip + slen;
+	unsigned char *ostart = (unsigned char *) dest;
+	unsigned char *op = ostart;
+	unsigned char *oend = ostart + rawsize;
+
+	while (ip < iend)
+	{
+		unsigned char token;
+		int32		len;
+		int32		offset;
+		const unsigned char *ref;
+
+		/* Stop once we have the requested prefix */
+		if (op >= oend && !check_complete)
+			break;
+
+		token = *ip++;
+
+		/* Copy the literals */
+		len = token >> 4;
+		if (len == LZ4_RUN_MASK && !lz4_get_length(&ip, iend, &len))
+			return -1;
+		if (len > iend - ip)
+			return -1;
+		if (len > oend - op)
+		{
+			if (check_complete)
+				return -1;
+			len = (int32) (oend - op);
+		}
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* The last sequence has no match part */
+		if (ip >= iend || op >= oend)
+			break;
+
+		/* Copy the match */
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - ostart)
+			return -1;
+
+		len = token & LZ4_RUN_MASK;
+		if (len == LZ4_RUN_MASK && !lz4_get_length(&ip, iend, &len))
+			return -1;
+		len += LZ4_MINMATCH;
+		if (len > oend - op)
+		{
+			if (check_complete)
+				return -1;
+			len = (int32) (oend - op);
+		}
+
+		/*
+		 * The areas overlap when the offset is shorter than the match, in
+		 * which case the copy must go byte by byte to replicate the pattern.
+		 */
+		ref = op - offset;
+		if (offset >= len)
+		{
+			memcpy(op, ref, len);
+			op += len;
+		}
+		else
+		{
+			while (len-- > 0)
+				*op++ = *ref++;
+		}
+	}
+
+	/*
+	 * Check we decompressed the right amount, unless only a prefix of the
+	 * data was asked for.
+	 */
+	if (check_complete && (op != oend || ip != iend))
+		return -1;
+
+	return (int32) ((char *) op - dest);
+}
@@ -45,6 +45,10 @@ typedef struct TableScanDescData
 	struct ParallelTableScanDescData *rs_parallel;	/* parallel scan
 													 * information */
 
+	/* Range of ItemPointers for table_scan_getnextslot_tidrange() to scan. */
+	ItemPointerData rs_mintid;
+	ItemPointerData rs_maxtid;
+
 } TableScanDescData;
 typedef struct TableScanDescData *TableScanDesc;
 
@@ -182,6 +182,14 @@ typedef struct VariableCacheData
 	TransactionId latestCompletedXid;	/* newest XID that has committed or
 										 * aborted */
 
+	/*
+	 * Number of top-level transactions with XIDs that have completed, plus
+	 * the number of subtransaction aborts and of times an xmin horizon was
+	 * moved backwards.  Whenever this is unchanged, so is the result of
+	 * GetSnapshotData().
+	 */
+	uint64		xactCompletionCount;
+
 	/*
 	 * These fields are protected by CLogTruncationLock
 	 */
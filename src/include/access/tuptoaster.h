@@ -14,6 +14,7 @@
 #define TUPTOASTER_H
 
 #include "access/htup_details.h"
+#include "common/compression.h"
 #include "storage/lockdefs.h"
 #include "utils/relcache.h"
 
@@ -74,6 +75,9 @@
  */
 #define TOAST_INDEX_TARGET		(MaxHeapTupleSize / 16)
 
+/* GUC variable */
+extern int	default_toast_compression;
+
 /*
  * When we store an oversize datum externally, we divide it into chunks
  * containing at most TOAST_MAX_CHUNK_SIZE data bytes.  This number *must*
@@ -210,7 +214,32 @@ extern HeapTuple toast_build_flattened_tuple(TupleDesc tupleDesc,
  *	Create a compressed version of a varlena datum, if possible
  * ----------
  */
-extern Datum toast_compress_datum(Datum value);
+extern Datum toast_compress_datum(Datum value, PgCompressionMethod cmethod);
+
+/* ----------
+ * toast_get_compression_method -
+ *
+ *	Return the compression method to use for an attribute of a relation
+ * ----------
+ */
+extern PgCompressionMethod toast_get_compression_method(Relation rel,
+														int attnum);
+
+/* ----------
+ * toast_datum_compression_method -
+ *
+ *	Return the compression method of a varlena datum, or -1 if uncompressed
+ * ----------
+ */
+extern int	toast_datum_compression_method(Datum value);
+
+/* ----------
+ * validate_toast_compression_option -
+ *
+ *	Check the value of the "compression" attribute option
+ * ----------
+ */
+extern void validate_toast_compression_option(const char *value);
 
 /* ----------
  * toast_raw_datum_size -
@@ -51,6 +51,12 @@ CATALOG(pg_subscription,6100,SubscriptionRelationId) BKI_SHARED_RELATION BKI_ROW
 	Oid			subroident;		/* roident assigned to replication origin.
 								 * If not specified, value will be chosen. */
 
+	char		subconflictres;	/* How to resolve apply conflicts, see
+								 * SUBCONFLICT_* below */
+
+	Oid			subconflictrelid;	/* Table conflicts are logged to, or
+									 * InvalidOid */
+
 #ifdef CATALOG_VARLEN			/* variable-length fields start here */
 	/* Connection string to the publisher */
 	text		subconninfo BKI_FORCE_NOT_NULL;
@@ -71,6 +77,21 @@ CATALOG(pg_subscription,6100,SubscriptionRelationId) BKI_SHARED_RELATION BKI_ROW
 
 typedef FormData_pg_subscription *Form_pg_subscription;
 
+#ifdef EXPOSE_TO_CLIENT_CODE
+
+/*
+ * Conflict resolution methods of the apply worker, stored in
+ * pg_subscription.subconflictres.
+ */
+#define SUBCONFLICT_ERROR			'e' /* raise ERROR (default) */
+#define SUBCONFLICT_SKIP			's' /* skip the remote change */
+#define SUBCONFLICT_LAST_UPDATE_WINS 'u'	/* keep the most recently committed
+											 * version of the row */
+#define SUBCONFLICT_LOG				'l' /* skip the remote change and log it
+										 * to the conflict table */
+
+#endif							/* EXPOSE_TO_CLIENT_CODE */
+
 typedef struct Subscription
 {
 	Oid			oid;			/* Oid of the subscription */
@@ -85,6 +106,8 @@ typedef struct Subscription
 	char	   *synccommit;		/* Synchronous commit setting for worker */
 	List	   *publications;	/* List of publication names to subscribe to */
 	List	   *filterorigins;	/* List of origins to filter out */
+	char		conflictres;	/* Conflict resolution method */
+	Oid			conflictrelid;	/* Table to log conflicts to */
 } Subscription;
 
 extern Subscription *GetSubscription(Oid subid, bool missing_ok);
@@ -0,0 +1,46 @@
+/*-------------------------------------------------------------------------
+ *
+ * compression.h
+ *		Declarations for the compression methods usable for TOAST values
+ *		and full-page images
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/common/compression.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef COMMON_COMPRESSION_H
+#define COMMON_COMPRESSION_H
+
+#include "common/pg_lzcompress.h"
+
+/*
+ * The numeric values are stored on disk, in compressed varlena headers and
+ * in full-page image headers, so they must never change.
+ */
+typedef enum PgCompressionMethod
+{
+	PG_COMPRESSION_PGLZ = 0,
+	PG_COMPRESSION_LZ4 = 1
+} PgCompressionMethod;
+
+#define PG_COMPRESSION_MAX_METHOD	PG_COMPRESSION_LZ4
+
+/*
+ * Buffer size required by pg_compress() for an input of the given length,
+ * whatever the method.
+ */
+#define PG_COMPRESS_MAX_OUTPUT(_dlen)	PGLZ_MAX_OUTPUT(_dlen)
+
+extern int32 pg_compress(PgCompressionMethod method, const char *source,
+						 int32 slen, char *dest);
+extern int32 pg_decompress(PgCompressionMethod method, const char *source,
+						   int32 slen, char *dest, int32 rawsize,
+						   bool check_complete);
+extern const char *get_compression_method_name(PgCompressionMethod method);
+extern bool get_compression_method_by_name(const char *name,
+										   PgCompressionMethod *method);
+
+#endif							/* COMMON_COMPRESSION_H */
@@ -0,0 +1,104 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.h
+ *	  Batch-at-a-time evaluation of simple scan quals and aggregates.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execBatch.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "nodes/primnodes.h"
+
+/* maximum number of rows collected in one batch */
+#define EXEC_BATCH_SIZE 1024
+
+/* datatypes the batch routines know how to process */
+typedef enum BatchType
+{
+	BATCH_INT4,
+	BATCH_INT8,
+	BATCH_FLOAT8
+} BatchType;
+
+/* comparison performed by a batch qual */
+typedef enum BatchCmp
+{
+	BATCH_LT,
+	BATCH_LE,
+	BATCH_EQ,
+	BATCH_NE,
+	BATCH_GE,
+	BATCH_GT
+} BatchCmp;
+
+/* "column op constant" */
+typedef struct BatchQual
+{
+	int			col;			/* index of the column in the batch */
+	BatchType	type;
+	BatchCmp	cmp;
+	Datum		constval;
+} BatchQual;
+
+typedef enum BatchAggKind
+{
+	BATCH_AGG_COUNT_STAR,
+	BATCH_AGG_COUNT,
+	BATCH_AGG_SUM,
+	BATCH_AGG_MIN,
+	BATCH_AGG_MAX
+} BatchAggKind;
+
+/* transition function of an aggregate, applied to a whole batch */
+typedef struct BatchAgg
+{
+	BatchAggKind kind;
+	BatchType	type;			/* input type, unused for count */
+	int			col;			/* index of the input column, or -1 */
+} BatchAgg;
+
+/*
+ * A batch of rows, deformed into one array per column.  The rows that pass
+ * the quals are listed in the selection vector sel[0 .. nsel - 1].
+ */
+typedef struct ExecBatch
+{
+	int			ncols;			/* number of columns */
+	int			maxcols;		/* allocated length of attnums */
+	AttrNumber *attnums;		/* table column of each batch column */
+	AttrNumber	maxattnum;		/* largest of attnums */
+
+	/* quals evaluated on the batch; used only if all quals qualify */
+	int			nquals;
+	BatchQual  *quals;
+	bool		rowquals;		/* evaluate the scan's quals row by row? */
+
+	/* the data, allocated by ExecBatchAllocate */
+	Datum	  **values;			/* values[col][row] */
+	bool	  **isnull;			/* isnull[col][row] */
+	int			nrows;			/* rows in the batch */
+	uint16	   *sel;			/* selection vector */
+	int			nsel;			/* entries in sel */
+} ExecBatch;
+
+/* GUC parameter */
+extern PGDLLIMPORT bool batch_execution;
+
+extern ExecBatch *ExecBatchCreate(void);
+extern int	ExecBatchAddColumn(ExecBatch *batch, AttrNumber attnum);
+extern void ExecBatchAllocate(ExecBatch *batch);
+extern bool ExecBatchAddQual(ExecBatch *batch, Expr *qual, Index scanrelid);
+extern void ExecBatchEvalQuals(ExecBatch *batch);
+extern bool ExecBatchCompileAgg(Oid transfn_oid, Oid inputtype,
+								BatchAgg *agg);
+extern void ExecBatchAdvanceAgg(ExecBatch *batch, BatchAgg *agg,
+								Datum *transValue, bool *transValueIsNull);
+
+#endif							/* EXECBATCH_H */
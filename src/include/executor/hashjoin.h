@@ -243,6 +243,8 @@ typedef struct ParallelHashJoinState
 	int			nparticipants;
 	size_t		space_allowed;
 	size_t		total_tuples;	/* total number of inner tuples */
+	dsa_pointer bloom;			/* bloom filter, or InvalidDsaPointer */
+	uint32		bloom_nwords;	/* size of bloom filter in uint64 words */
 	LWLock		lock;			/* lock protecting the above */
 
 	Barrier		build_barrier;	/* synchronization for the build phases */
@@ -339,6 +341,18 @@ typedef struct HashJoinTableData
 	bool	   *hashStrict;		/* is each hash join operator strict? */
 	Oid		   *collations;
 
+	/*
+	 * Bloom filter over the hash values of all inner tuples, in all batches,
+	 * which the scan on the outer side may use to throw away tuples that
+	 * can't have a match (see ExecHashBloomMayMatch).  NULL if not wanted,
+	 * or if it turned out too full to be useful.  For Parallel Hash, each
+	 * participant fills in a private one, and ORs it into the shared one
+	 * when done; once the build is complete, this points to the latter.
+	 */
+	uint64	   *bloom;
+	uint32		bloom_mask;		/* number of words in bloom, minus one */
+	bool		bloom_ready;	/* is the bloom filter complete? */
+
 	Size		spaceUsed;		/* memory space currently used by tuples */
 	Size		spaceAllowed;	/* upper limit for space used */
 	Size		spacePeak;		/* peak space used */
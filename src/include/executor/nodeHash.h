@@ -49,6 +49,7 @@ extern bool ExecHashGetHashValue(HashJoinTable hashtable,
 								 bool outer_tuple,
 								 bool keep_nulls,
 								 uint32 *hashvalue);
+extern bool ExecHashBloomMayMatch(HashJoinTable hashtable, uint32 hashvalue);
 extern void ExecHashGetBucketAndBatch(HashJoinTable hashtable,
 									  uint32 hashvalue,
 									  int *bucketno,
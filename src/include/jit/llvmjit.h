@@ -55,6 +55,20 @@ typedef struct LLVMJitContext
 
 	/* list of handles for code emitted via Orc */
 	List	   *handles;
+
+	/*
+	 * Module collecting code that may be reused by later contexts, see
+	 * llvm_enter_cache_module(). While cache_module_active is set, it is
+	 * stored in "module" and the regular module here.
+	 */
+	LLVMModuleRef cache_module;
+	bool		cache_module_active;
+
+	/* cache entries to be created once cache_module has been emitted */
+	List	   *pending_cache_entries;
+
+	/* cached modules whose code this context may use */
+	List	   *cache_pins;
 } LLVMJitContext;
 
 
@@ -110,6 +124,14 @@ extern LLVMValueRef llvm_function_reference(LLVMJitContext *context,
 
 extern void llvm_inline(LLVMModuleRef mod);
 
+extern void llvm_enter_cache_module(LLVMJitContext *context);
+extern void llvm_leave_cache_module(LLVMJitContext *context);
+extern void *llvm_cache_lookup(LLVMJitContext *context,
+							   const char *key, int keylen);
+extern void llvm_cache_enter(LLVMJitContext *context,
+							 const char *key, int keylen,
+							 const char *funcname);
+
 /*
  ****************************************************************************
  * Code generation functions.
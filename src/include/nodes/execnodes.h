@@ -16,6 +16,7 @@
 
 #include "access/tupconvert.h"
 #include "executor/instrument.h"
+#include "lib/ilist.h"
 #include "lib/pairingheap.h"
 #include "nodes/params.h"
 #include "nodes/plannodes.h"
@@ -82,6 +83,7 @@ typedef struct ExprState
 	/*
 	 * Instructions to compute expression's return value.
 	 */
+#define FIELDNO_EXPRSTATE_STEPS 5
 	struct ExprEvalStep *steps;
 
 	/*
@@ -485,6 +487,13 @@ typedef struct ResultRelInfo
 
 	/* For use by copy.c when performing multi-inserts */
 	struct CopyMultiInsertBuffer *ri_CopyMultiInsertBuffer;
+
+	/* batch insert stuff, for foreign tables whose FDW supports it */
+	int			ri_NumSlots;	/* number of slots in the array */
+	int			ri_NumSlotsInitialized; /* number of initialized slots */
+	int			ri_BatchSize;	/* max slots inserted in a single batch */
+	TupleTableSlot **ri_Slots;	/* input tuples for batch insert */
+	TupleTableSlot **ri_PlanSlots;	/* plan tuples for batch insert */
 } ResultRelInfo;
 
 /* ----------------
@@ -908,6 +917,25 @@ typedef struct DomainConstraintState
 } DomainConstraintState;
 
 
+/* ----------------
+ *	 AsyncRequest
+ *
+ * State for an asynchronous tuple request, made by a node such as Append
+ * (the requestor) of an async-capable child such as ForeignScan (the
+ * requestee).  See executor/execAsync.c.
+ * ----------------
+ */
+typedef struct AsyncRequest
+{
+	struct PlanState *requestor;	/* Node that wants a tuple */
+	struct PlanState *requestee;	/* Node from which a tuple is wanted */
+	int			request_index;	/* Scratch space for requestor */
+	bool		callback_pending;	/* Callback is needed */
+	bool		request_complete;	/* Request complete, result valid */
+	TupleTableSlot *result;		/* Result (NULL or an empty slot if no more
+								 * tuples) */
+} AsyncRequest;
+
 /* ----------------------------------------------------------------
  *				 Executor State Trees
  *
@@ -1021,6 +1049,8 @@ typedef struct PlanState
 	bool		outeropsset;
 	bool		inneropsset;
 	bool		resultopsset;
+
+	bool		async_capable;	/* true if node is run asynchronously */
 } PlanState;
 
 /* ----------------
@@ -1203,6 +1233,10 @@ typedef struct ModifyTableState
  *							eliminated from the scan, or NULL if not possible.
  *		valid_subplans		for runtime pruning, valid appendplans indexes to
  *							scan.
+ *
+ *		The as_async* fields track async-capable subplans, which are sent
+ *		requests up front and whose tuples are returned in whatever order
+ *		they arrive.  See nodeAppend.c.
  * ----------------
  */
 
@@ -1224,6 +1258,22 @@ struct AppendState
 	Size		pstate_len;		/* size of parallel coordination info */
 	struct PartitionPruneState *as_prune_state;
 	Bitmapset  *as_valid_subplans;
+	bool		as_valid_subplans_identified;	/* is as_valid_subplans valid? */
+	bool		as_begun;		/* false means need to initialize */
+	bool		as_syncdone;	/* true if all sync plans done in async mode */
+
+	/* Asynchronous execution state */
+	Bitmapset  *as_asyncplans;	/* async-capable subplans */
+	int			as_nasyncplans; /* # of async-capable subplans */
+	struct AsyncRequest **as_asyncrequests; /* array of AsyncRequests */
+	TupleTableSlot **as_asyncresults;	/* unreturned results of async plans */
+	int			as_nasyncresults;	/* # of valid entries in as_asyncresults */
+	int			as_nasyncremain;	/* # of remaining async plans */
+	Bitmapset  *as_needrequest; /* async plans ready for a new request */
+	struct WaitEventSet *as_eventset;	/* WaitEventSet used to configure file
+										 * descriptor wait events */
+	Bitmapset  *as_valid_asyncplans;	/* valid async plans indexes */
+
 	bool		(*choose_next_subplan) (AppendState *);
 };
 
@@ -1334,6 +1384,29 @@ typedef struct ScanState
 	TupleTableSlot *ss_ScanTupleSlot;
 } ScanState;
 
+/* ----------------
+ *	 RuntimeFilterState information
+ *
+ *		A hash join's bloom filter, pushed down into the scan on its outer
+ *		side so that tuples without a join partner are thrown away as soon
+ *		as they have passed the scan's quals.  See ExecHashJoinRuntimeFilter.
+ *
+ *		hashjoin		the join whose hashtable holds the filter
+ *		hashkeys		the join's outer hash keys, over the scan tuple
+ *		nchecked		number of tuples checked so far
+ *		nremoved		number of those that were thrown away
+ *		disabled		true if the filter was found not to be selective
+ * ----------------
+ */
+typedef struct RuntimeFilterState
+{
+	struct HashJoinState *hashjoin;
+	List	   *hashkeys;		/* list of ExprState nodes */
+	uint64		nchecked;
+	uint64		nremoved;
+	bool		disabled;
+} RuntimeFilterState;
+
 /* ----------------
  *	 SeqScanState information
  * ----------------
@@ -1342,6 +1415,9 @@ typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+	struct ExecBatch *batch;	/* batch mode state, or NULL */
+	RuntimeFilterState *runtime_filter; /* pushed down from a hash join, or
+										 * NULL */
 } SeqScanState;
 
 /* ----------------
@@ -1625,6 +1701,24 @@ typedef struct TidScanState
 	HeapTupleData tss_htup;
 } TidScanState;
 
+/* ----------------
+ *	 TidRangeScanState information
+ *
+ *		trss_tidexprs		list of TidOpExpr structs (see nodeTidrangescan.c)
+ *		trss_mintid			the lowest TID in the scan range
+ *		trss_maxtid			the highest TID in the scan range
+ *		trss_inScan			is a scan currently in progress?
+ * ----------------
+ */
+typedef struct TidRangeScanState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	List	   *trss_tidexprs;
+	ItemPointerData trss_mintid;
+	ItemPointerData trss_maxtid;
+	bool		trss_inScan;
+} TidRangeScanState;
+
 /* ----------------
  *	 SubqueryScanState information
  *
@@ -1973,6 +2067,55 @@ typedef struct MaterialState
 	Tuplestorestate *tuplestorestate;
 } MaterialState;
 
+/* ----------------
+ *	 ResultCacheState information
+ *
+ *		A ResultCache node's cache is a hash table of entries, keyed by the
+ *		values of param_exprs, each holding the tuples the subplan returned
+ *		for those values.  Entries are evicted in least recently used order
+ *		once the cache would use more than work_mem.
+ * ----------------
+ */
+struct ResultCacheEntry;
+struct ResultCacheTuple;
+
+typedef struct ResultCacheInstrumentation
+{
+	uint64		cache_hits;		/* rescans satisfied by the cache */
+	uint64		cache_misses;	/* rescans that had to run the subplan */
+	uint64		cache_evictions;	/* entries evicted to stay under the
+									 * memory limit */
+	uint64		cache_overflows;	/* scans whose results didn't fit even
+									 * after evicting everything else */
+	uint64		mem_peak;		/* peak memory used by the cache, in bytes */
+} ResultCacheInstrumentation;
+
+typedef struct ResultCacheState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	int			rc_status;		/* state of the ExecResultCache state
+								 * machine */
+	int			nkeys;			/* number of cache keys */
+	struct resultcache_hash *hashtable; /* hash table of cache entries */
+	TupleDesc	hashkeydesc;	/* tuple descriptor for cache keys */
+	TupleTableSlot *tableslot;	/* slot for a key stored in the cache */
+	TupleTableSlot *probeslot;	/* slot for the key being looked up */
+	ExprState  *cache_eq_expr;	/* compares tableslot with probeslot */
+	ExprState **param_exprs;	/* exprs forming the cache key */
+	FmgrInfo   *hashfunctions;	/* hash functions for each key */
+	Oid		   *collations;		/* collations for each key */
+	Bitmapset  *keyparamids;	/* PARAM_EXEC params the keys depend on */
+	uint64		mem_used;		/* bytes of memory used by the cache */
+	uint64		mem_limit;		/* memory limit in bytes for the cache */
+	MemoryContext tableContext; /* memory context holding the cache */
+	dlist_head	lru_list;		/* keys, least recently used first */
+	struct ResultCacheTuple *last_tuple;	/* last tuple returned or stored
+											 * for the current scan */
+	struct ResultCacheEntry *entry; /* entry for the current scan */
+	bool		singlerow;		/* entries complete after the first tuple? */
+	ResultCacheInstrumentation stats;	/* execution statistics */
+} ResultCacheState;
+
 /* ----------------
  *	 Shared memory container for per-worker sort information
  * ----------------
@@ -2001,6 +2144,32 @@ typedef struct SortState
 	SharedSortInfo *shared_info;	/* one entry per worker */
 } SortState;
 
+/* ----------------
+ *	 IncrementalSortState information
+ *
+ *	 The input is sorted in batches, each holding one or more whole groups
+ *	 of tuples with equal presorted keys.  group_pivot holds the tuple that
+ *	 was read past the end of the current batch, to start the next one.
+ * ----------------
+ */
+typedef struct IncrementalSortState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	bool		bounded;		/* is the result set bounded? */
+	int64		bound;			/* if bounded, how many tuples are needed */
+	ExprState  *presorted_eq;	/* equality of the presorted keys */
+	TupleTableSlot *group_pivot;	/* a tuple of the current or next group */
+	bool		have_pivot;		/* is group_pivot the next batch's first? */
+	bool		outer_done;		/* has the outer plan been exhausted? */
+	bool		batch_sorted;	/* is tuplesortstate ready to be read? */
+	int64		bound_done;		/* number of tuples returned so far */
+	void	   *tuplesortstate; /* private state of tuplesort.c */
+	/* instrumentation */
+	int64		nbatches;		/* number of batches sorted */
+	long		max_space_used; /* largest space used by a batch, in kB */
+	bool		spilled;		/* did any batch sort on disk? */
+} IncrementalSortState;
+
 /* ---------------------
  *	GroupState information
  * ---------------------
@@ -2081,6 +2250,25 @@ typedef struct AggState
 	AggStatePerGroup *all_pergroups;	/* array of first ->pergroups, than
 										 * ->hash_pergroup */
 	ProjectionInfo *combinedproj;	/* projection machinery */
+
+	/* these fields are used to spill AGG_HASHED and AGG_MIXED input: */
+	bool		hash_spill_mode;	/* out of memory, don't create new groups */
+	bool		hash_ever_spilled;	/* spilled at all since last rescan? */
+	Size		hash_mem_limit; /* memory the hash tables may use */
+	Size		hash_mem_peak;	/* peak memory used by the hash tables */
+	double		hashentrysize;	/* observed memory per group */
+	uint64		hash_ngroups_current;	/* groups in memory, all hash tables */
+	uint64		hash_disk_used; /* bytes written to spill files */
+	int			hash_batches_used;	/* batches processed, including the
+									 * initial pass over the input */
+	struct HashAggSpill *hash_spills;	/* per grouping set spill state of
+										 * the initial pass */
+	List	   *hash_batches;	/* spilled batches not processed yet */
+	TupleTableSlot *hash_spill_slot;	/* slot for reading spilled tuples */
+
+	/* these fields are used in batch mode, see agg_batch_init: */
+	struct ExecBatch *batch;	/* batch read from the outer SeqScan */
+	struct BatchAgg *batchaggs; /* per-transition batch advance info */
 } AggState;
 
 /* ----------------
@@ -2271,6 +2459,7 @@ typedef struct HashState
 	PlanState	ps;				/* its first field is NodeTag */
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
+	bool		build_bloom;	/* build a bloom filter over the hashtable? */
 
 	SharedHashInfo *shared_info;	/* one entry per worker */
 	HashInstrumentation *hinstrument;	/* this worker's entry */
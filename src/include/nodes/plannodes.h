@@ -133,6 +133,11 @@ typedef struct Plan
 	bool		parallel_aware; /* engage parallel-aware logic? */
 	bool		parallel_safe;	/* OK to use as part of parallel plan? */
 
+	/*
+	 * information needed for asynchronous execution
+	 */
+	bool		async_capable;	/* engage asynchronous-capable logic? */
+
 	/*
 	 * Common structural data for all Plan types.
 	 */
@@ -489,6 +494,19 @@ typedef struct TidScan
 	List	   *tidquals;		/* qual(s) involving CTID = something */
 } TidScan;
 
+/* ----------------
+ *		tid range scan node
+ *
+ * tidrangequals is an implicitly AND'ed list of qual expressions of the form
+ * "CTID relop pseudoconstant", where relop is one of >,>=,<,<=.
+ * ----------------
+ */
+typedef struct TidRangeScan
+{
+	Scan		scan;
+	List	   *tidrangequals;	/* qual(s) involving CTID op something */
+} TidRangeScan;
+
 /* ----------------
  *		subquery scan node
  *
@@ -745,6 +763,13 @@ typedef struct HashJoin
 	 * perform lookups in the hashtable over the inner plan.
 	 */
 	List	   *hashkeys;
+
+	/*
+	 * The same expressions in terms of the outer plan's scan tuple, if a
+	 * bloom filter over the hashtable is to be pushed down into the outer
+	 * plan (which must then be a SeqScan); else NIL.
+	 */
+	List	   *filterkeys;
 } HashJoin;
 
 /* ----------------
@@ -756,6 +781,30 @@ typedef struct Material
 	Plan		plan;
 } Material;
 
+/* ----------------
+ *		result cache node
+ *
+ * Caches the tuples its subplan returns for each set of parameter values,
+ * so that rescans with parameters seen before needn't run the subplan.
+ * param_exprs are evaluated at each rescan to form the cache key, and
+ * compared with hashOperators.  If singlerow is true, the parent stops
+ * fetching after the first tuple of each scan, so an entry is complete as
+ * soon as it has one tuple.  est_entries is the planner's estimate of the
+ * number of entries the cache will hold, used to size its hash table.
+ * ----------------
+ */
+typedef struct ResultCache
+{
+	Plan		plan;
+
+	int			numKeys;		/* size of the two arrays below */
+	Oid		   *hashOperators;	/* hash operators for each key */
+	Oid		   *collations;		/* collations for each key */
+	List	   *param_exprs;	/* exprs forming the cache key */
+	bool		singlerow;		/* entries complete after the first tuple? */
+	uint32		est_entries;	/* number of entries expected to fit */
+} ResultCache;
+
 /* ----------------
  *		sort node
  * ----------------
@@ -770,6 +819,19 @@ typedef struct Sort
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
 } Sort;
 
+/* ----------------
+ *		incremental sort node
+ *
+ * The input is already sorted by the first nPresortedCols sort keys, so the
+ * tuples need only be sorted within groups of equal values of those.
+ * ----------------
+ */
+typedef struct IncrementalSort
+{
+	Sort		sort;
+	int			nPresortedCols; /* number of presorted columns */
+} IncrementalSort;
+
 /* ---------------
  *	 group node -
  *		Used for queries with GROUP BY (but no aggregates) specified.
@@ -0,0 +1,113 @@
+/*-------------------------------------------------------------------------
+ *
+ * simd.h
+ *	  Support for searching many bytes at once.
+ *
+ * A Vector8 holds as many bytes as the platform can compare in one go: a
+ * 128-bit SSE2 register on x86-64, where SSE2 is always available, and a
+ * 64-bit integer elsewhere, searched with the usual word-at-a-time bit
+ * tricks.  Callers must handle any bytes left over at the end of their
+ * input one at a time.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * src/include/port/simd.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__x86_64__) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define USE_SSE2
+typedef __m128i Vector8;
+#else
+#define USE_NO_SIMD
+typedef uint64 Vector8;
+#endif
+
+/*
+ * Load a chunk of memory, which need not be aligned, into a vector.
+ */
+static inline void
+vector8_load(Vector8 *v, const uint8 *s)
+{
+#ifdef USE_SSE2
+	*v = _mm_loadu_si128((const __m128i *) s);
+#else
+	memcpy(v, s, sizeof(Vector8));
+#endif
+}
+
+/*
+ * Create a vector with all elements set to the same value.
+ */
+static inline Vector8
+vector8_broadcast(const uint8 c)
+{
+#ifdef USE_SSE2
+	return _mm_set1_epi8((char) c);
+#else
+	return ~UINT64CONST(0) / 0xFF * c;
+#endif
+}
+
+/*
+ * Return true if any elements in the vector are equal to the given scalar.
+ */
+static inline bool
+vector8_has(const Vector8 v, const uint8 c)
+{
+	bool		result;
+
+#ifdef USE_SSE2
+	result = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vector8_broadcast(c))) != 0;
+#else
+	{
+		/*
+		 * XOR turns the bytes equal to c into zero bytes, which we find with
+		 * the "haszero" trick from
+		 * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
+		 */
+		Vector8		x = v ^ vector8_broadcast(c);
+
+		result = ((x - vector8_broadcast(0x01)) & ~x &
+				  vector8_broadcast(0x80)) != 0;
+	}
+#endif
+
+#ifdef USE_ASSERT_CHECKING
+	{
+		bool		assert_result = false;
+		Size		i;
+
+		for (i = 0; i < sizeof(Vector8); i++)
+		{
+			if (((const uint8 *) &v)[i] == c)
+			{
+				assert_result = true;
+				break;
+			}
+		}
+		Assert(assert_result == result);
+	}
+#endif
+
+	return result;
+}
+
+/*
+ * Return true if the high bit of any element is set.
+ */
+static inline bool
+vector8_is_highbit_set(const Vector8 v)
+{
+#ifdef USE_SSE2
+	return _mm_movemask_epi8(v) != 0;
+#else
+	return (v & vector8_broadcast(0x80)) != 0;
+#endif
+}
+
+#endif							/* SIMD_H */
@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------
+ * decodeworker.h
+ *	   Background worker decoding WAL on behalf of a logical walsender
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/replication/decodeworker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef DECODEWORKER_H
+#define DECODEWORKER_H
+
+#include "access/xlogdefs.h"
+#include "lib/stringinfo.h"
+#include "nodes/pg_list.h"
+
+/*
+ * Messages sent by the decoding worker to its walsender.  Output plugin
+ * data is sent as the complete payload of an XLogData CopyData message, so
+ * it starts with the 'w' byte of the replication protocol.
+ */
+#define DECODING_WORKER_MSG_READY		'r' /* restart_lsn, confirmed_flush */
+#define DECODING_WORKER_MSG_DATA		'w' /* XLogData message payload */
+#define DECODING_WORKER_MSG_PROGRESS	'p' /* lsn, timestamp for lag tracking */
+#define DECODING_WORKER_MSG_POSITION	'e' /* decoded up to lsn, caught up */
+
+typedef enum DecodingWorkerResult
+{
+	DECODING_WORKER_MESSAGE,	/* a message was received */
+	DECODING_WORKER_EMPTY,		/* no message available right now */
+	DECODING_WORKER_DETACHED	/* the worker has gone away */
+} DecodingWorkerResult;
+
+typedef struct DecodingWorkerHandle DecodingWorkerHandle;
+
+extern DecodingWorkerHandle *StartDecodingWorker(const char *slotname,
+												 XLogRecPtr startpoint,
+												 List *options);
+extern void StopDecodingWorker(DecodingWorkerHandle *handle);
+extern DecodingWorkerResult DecodingWorkerReceive(DecodingWorkerHandle *handle,
+												  StringInfo msg, bool nowait);
+extern void HandleDecodingWorkerMessages(DecodingWorkerHandle *handle);
+extern bool DecodingWorkerTerminated(DecodingWorkerHandle *handle);
+extern void DecodingWorkerConfirmFlush(DecodingWorkerHandle *handle,
+									   XLogRecPtr lsn);
+extern void DecodingWorkerWakeup(DecodingWorkerHandle *handle);
+
+extern void LogicalDecodingWorkerMain(Datum main_arg);
+
+#endif							/* DECODEWORKER_H */
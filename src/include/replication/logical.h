@@ -107,6 +107,14 @@ extern LogicalDecodingContext *CreateDecodingContext(XLogRecPtr start_lsn,
 													 LogicalOutputPluginWriterPrepareWrite prepare_write,
 													 LogicalOutputPluginWriterWrite do_write,
 													 LogicalOutputPluginWriterUpdateProgress update_progress);
+extern LogicalDecodingContext *CreateDecodingContextForPlugin(char *plugin,
+															  XLogRecPtr start_lsn,
+															  List *output_plugin_options,
+															  bool fast_forward,
+															  XLogPageReadCB read_page,
+															  LogicalOutputPluginWriterPrepareWrite prepare_write,
+															  LogicalOutputPluginWriterWrite do_write,
+															  LogicalOutputPluginWriterUpdateProgress update_progress);
 extern void DecodingContextFindStartpoint(LogicalDecodingContext *ctx);
 extern bool DecodingContextReady(LogicalDecodingContext *ctx);
 extern void FreeDecodingContext(LogicalDecodingContext *ctx);
@@ -36,6 +36,7 @@ extern bool wake_wal_senders;
 extern int	max_wal_senders;
 extern int	wal_sender_timeout;
 extern bool log_replication_commands;
+extern bool logical_decoding_pipeline;
 
 extern void InitWalSender(void);
 extern bool exec_replication_command(const char *query_string);
@@ -48,6 +49,7 @@ extern void WalSndInitStopping(void);
 extern void WalSndWaitStopping(void);
 extern void HandleWalSndInitStopping(void);
 extern void WalSndRqstFileReload(void);
+extern void WalSndReportCacheRebuild(int64 nrelations, int64 npublications);
 
 /*
  * Remember that we want to wakeup walsenders later
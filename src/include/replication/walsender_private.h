@@ -80,6 +80,14 @@ typedef struct WalSnd
 	 * Timestamp of the last message received from standby.
 	 */
 	TimestampTz replyTime;
+
+	/*
+	 * Number of per-relation publication entries rebuilt, and number of
+	 * publication list reloads, done by the output plugin in response to
+	 * catalog invalidations.
+	 */
+	int64		pubrelRebuilds;
+	int64		pubReloads;
 } WalSnd;
 
 extern WalSnd *MyWalSnd;
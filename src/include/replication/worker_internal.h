@@ -54,6 +54,14 @@ typedef struct LogicalRepWorker
 	TimestampTz last_recv_time;
 	XLogRecPtr	reply_lsn;
 	TimestampTz reply_time;
+
+	/*
+	 * Conflicts detected and resolved without raising an error.  Protected
+	 * by relmutex, as they're read by other backends.
+	 */
+	int64		insert_conflicts;
+	int64		update_conflicts;
+	int64		delete_conflicts;
 } LogicalRepWorker;
 
 /* Main memory context for apply worker. Permanent during worker lifetime. */
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.h
+ *	  Reading a sequence of relation blocks ahead of their use.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/read_stream.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef READ_STREAM_H
+#define READ_STREAM_H
+
+#include "storage/bufmgr.h"
+
+typedef struct ReadStream ReadStream;
+
+/*
+ * Callback returning the next block number to read, or InvalidBlockNumber
+ * at the end of the stream.
+ */
+typedef BlockNumber (*ReadStreamBlockNumberCB) (ReadStream *stream,
+												void *callback_private_data);
+
+extern ReadStream *read_stream_begin_relation(Relation rel,
+											  ForkNumber forknum,
+											  BufferAccessStrategy strategy,
+											  ReadStreamBlockNumberCB callback,
+											  void *callback_private_data);
+extern BlockNumber read_stream_peek_block(ReadStream *stream);
+extern Buffer read_stream_next_buffer(ReadStream *stream);
+extern void read_stream_reset(ReadStream *stream);
+extern void read_stream_end(ReadStream *stream);
+
+#endif							/* READ_STREAM_H */
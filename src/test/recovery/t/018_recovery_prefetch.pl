@@ -0,0 +1,78 @@
+# Test prefetching of the blocks referenced in WAL during recovery
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+if ($windows_os)
+{
+	plan skip_all => 'posix_fadvise is not available on Windows';
+}
+else
+{
+	plan tests => 4;
+}
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->start;
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+
+# Small shared_buffers, so that the standby has to read blocks back in
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', qq(
+shared_buffers = 1MB
+recovery_prefetch = on
+recovery_prefetch_distance = 64kB
+));
+$node_standby->start;
+
+# A table larger than the standby's buffer pool, updated at random, and one
+# dropped while its records may still be ahead of replay
+$node_master->safe_psql(
+	'postgres', q{
+CREATE TABLE prefetch_test (id int PRIMARY KEY, val int) WITH (fillfactor = 50);
+INSERT INTO prefetch_test SELECT g, 0 FROM generate_series(1, 20000) g;
+CREATE TABLE prefetch_dropped (id int);
+INSERT INTO prefetch_dropped SELECT g FROM generate_series(1, 10000) g;
+DROP TABLE prefetch_dropped;
+CHECKPOINT;
+UPDATE prefetch_test SET val = val + 1
+  WHERE id IN (SELECT (random() * 20000)::int FROM generate_series(1, 5000));
+UPDATE prefetch_test SET val = val + 1 WHERE id % 7 = 0;
+});
+
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+my $query = 'SELECT count(*), sum(val) FROM prefetch_test';
+is($node_standby->safe_psql('postgres', $query),
+	$node_master->safe_psql('postgres', $query),
+	'standby replayed the same data with prefetching');
+
+my $looked_at = $node_standby->safe_psql('postgres',
+	'SELECT prefetch + hit + skip_fpw + skip_init + skip_rep + skip_new > 0
+	 FROM pg_stat_prefetch_recovery');
+is($looked_at, 't', 'prefetcher looked at the blocks referenced in WAL');
+
+# Crash recovery goes through the prefetcher too
+$node_master->append_conf('postgresql.conf', 'recovery_prefetch = on');
+$node_master->restart;
+$node_master->safe_psql('postgres',
+	'UPDATE prefetch_test SET val = val + 1 WHERE id % 3 = 0');
+my $expected = $node_master->safe_psql('postgres', $query);
+$node_master->stop('immediate');
+$node_master->start;
+is($node_master->safe_psql('postgres', $query),
+	$expected, 'crash recovery with prefetching');
+is( $node_master->safe_psql(
+		'postgres',
+		'SELECT stats_reset IS NOT NULL FROM pg_stat_prefetch_recovery'),
+	't',
+	'recovery prefetching statistics were reset');
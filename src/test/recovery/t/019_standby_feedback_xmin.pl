@@ -0,0 +1,166 @@
+# Test that an xmin sent by a standby through hot_standby_feedback, without
+# a replication slot, holds back HOT pruning on the primary immediately, even
+# in sessions that could otherwise reuse their previous snapshot because no
+# transaction has completed in the meantime.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 5;
+
+# To avoid hanging while expecting some specific input from a psql
+# instance being driven by us, add a timeout high enough that it
+# should never trigger even on very slow machines, unless something
+# is really wrong.
+my $psql_timeout = IPC::Run::timer(180);
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->append_conf('postgresql.conf', 'autovacuum = off');
+$node_master->start;
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+
+# Feedback starts off, and any conflict cancels standby queries at once
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', qq(
+hot_standby_feedback = off
+max_standby_streaming_delay = 0
+));
+$node_standby->start;
+
+# Full pages, so that the primary prunes them when they are read
+$node_master->safe_psql(
+	'postgres', q[
+CREATE TABLE tab_feedback (id int, pad text);
+INSERT INTO tab_feedback SELECT g, repeat('x', 100) FROM generate_series(1, 1000) g;
+]);
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+# Take a snapshot on the standby, in a transaction that stays open
+my ($standby_stdin, $standby_stdout, $standby_stderr) = ('', '', '');
+my $standby_psql = start_psql($node_standby, \$standby_stdin,
+	\$standby_stdout, \$standby_stderr);
+$standby_stdin .= q[
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT 'before: ' || count(*) FROM tab_feedback;
+];
+ok(pump_until($standby_psql, \$standby_stdout, qr/before: 1000/m),
+	'standby snapshot taken');
+
+# Delete rows the standby snapshot still sees
+$node_master->safe_psql('postgres',
+	'DELETE FROM tab_feedback WHERE id <= 500');
+
+# Start a long-running transaction with a newer XID, which is now the
+# oldest one running
+my ($long_stdin, $long_stdout, $long_stderr) = ('', '', '');
+my $long_psql =
+  start_psql($node_master, \$long_stdin, \$long_stdout, \$long_stderr);
+$long_stdin .= q[
+BEGIN;
+SELECT 'xid: ' || txid_current();
+];
+ok(pump_until($long_psql, \$long_stdout, qr/xid: \d+/m),
+	'long-running transaction started');
+
+# A session that has computed its horizons while that transaction was the
+# oldest one, before the standby's xmin got to the primary
+my ($reader_stdin, $reader_stdout, $reader_stderr) = ('', '', '');
+my $reader_psql =
+  start_psql($node_master, \$reader_stdin, \$reader_stdout, \$reader_stderr);
+$reader_stdin .= q[
+SELECT 'reader ' || 'ready';
+];
+ok(pump_until($reader_psql, \$reader_stdout, qr/reader ready/m),
+	'reader session started');
+
+# Now send feedback, which lowers the walsender's xmin
+$node_standby->safe_psql('postgres',
+	'ALTER SYSTEM SET hot_standby_feedback = on');
+$node_standby->reload;
+$node_master->poll_query_until('postgres',
+	'SELECT backend_xmin IS NOT NULL FROM pg_stat_replication')
+  or die "timed out waiting for the standby's xmin";
+
+# Reading the table must not prune the rows the standby still needs
+$reader_stdin .= q[
+SELECT 'reader: ' || count(*) FROM tab_feedback;
+];
+pump_until($reader_psql, \$reader_stdout, qr/reader: 500/m);
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+$standby_stdin .= q[
+SELECT 'after: ' || count(*) FROM tab_feedback;
+COMMIT;
+];
+ok(pump_until($standby_psql, \$standby_stdout, qr/after: 1000/m),
+	'standby query not canceled by pruning on the primary');
+is( $node_standby->safe_psql(
+		'postgres',
+		q[SELECT confl_snapshot FROM pg_stat_database_conflicts
+		  WHERE datname = 'postgres']),
+	'0',
+	'no snapshot conflicts on the standby');
+
+$long_stdin .= q[
+COMMIT;
+];
+$_->finish for ($standby_psql, $long_psql, $reader_psql);
+
+$node_standby->stop;
+$node_master->stop;
+
+# Run psql, keeping the session alive
+sub start_psql
+{
+	my ($node, $stdin, $stdout, $stderr) = @_;
+
+	return IPC::Run::start(
+		[
+			'psql', '-X', '-qAt', '-v', 'ON_ERROR_STOP=1', '-f', '-', '-d',
+			$node->connstr('postgres')
+		],
+		'<',
+		$stdin,
+		'>',
+		$stdout,
+		'2>',
+		$stderr,
+		$psql_timeout);
+}
+
+# Pump until string is matched, or timeout occurs
+sub pump_until
+{
+	my ($proc, $stream, $untl) = @_;
+	$proc->pump_nb();
+	while (1)
+	{
+		last if $$stream =~ /$untl/;
+		if ($psql_timeout->is_expired)
+		{
+			diag("aborting wait: program timed out");
+			diag("stream contents: >>", $$stream, "<<");
+			diag("pattern searched for: ", $untl);
+
+			return 0;
+		}
+		if (not $proc->pumpable())
+		{
+			diag("aborting wait: program died");
+			diag("stream contents: >>", $$stream, "<<");
+			diag("pattern searched for: ", $untl);
+
+			return 0;
+		}
+		$proc->pump();
+	}
+	return 1;
+}
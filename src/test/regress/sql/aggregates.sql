@@ -1017,3 +1017,66 @@ select v||'a', case when v||'a' = 'aa' then 1 else 0 end, count(*)
 explain (costs off)
   select 1 from tenk1
    where (hundred, thousand) in (select twothousand, twothousand from onek);
+
+--
+-- Hash aggregation spilling to disk
+--
+set work_mem='64kB';
+set enable_sort=off;
+
+create function hashagg_spilled(query text) returns bool
+language plpgsql as
+$$
+declare
+  ln text;
+begin
+  for ln in execute 'explain (analyze, costs off, timing off, summary off) ' || query
+  loop
+    if ln like '%Batches: %' then
+      return true;
+    end if;
+  end loop;
+  return false;
+end;
+$$;
+
+explain (costs off)
+  select g % 20000 as k, count(*), sum(g), max(g::text)
+    from generate_series(1, 100000) g group by g % 20000;
+select hashagg_spilled('select g % 20000, count(*), sum(g), max(g::text)
+    from generate_series(1, 100000) g group by g % 20000');
+
+create table agg_hash_spill as
+  select g % 20000 as k, count(*) as c, sum(g) as s, max(g::text) as m
+    from generate_series(1, 100000) g group by g % 20000;
+create table agg_hash_spill_gs as
+  select g % 5000 as a, g % 7 as b, count(*) as c, sum(g) as s
+    from generate_series(1, 50000) g group by grouping sets ((g % 5000), (g % 7));
+
+set enable_sort=on;
+set enable_hashagg=off;
+
+create table agg_sort_spill as
+  select g % 20000 as k, count(*) as c, sum(g) as s, max(g::text) as m
+    from generate_series(1, 100000) g group by g % 20000;
+create table agg_sort_spill_gs as
+  select g % 5000 as a, g % 7 as b, count(*) as c, sum(g) as s
+    from generate_series(1, 50000) g group by grouping sets ((g % 5000), (g % 7));
+
+select count(*) from agg_hash_spill;
+select count(*) from
+  ((select * from agg_hash_spill except select * from agg_sort_spill)
+   union all
+   (select * from agg_sort_spill except select * from agg_hash_spill)) d;
+select count(*) from agg_hash_spill_gs;
+select count(*) from
+  ((select * from agg_hash_spill_gs except select * from agg_sort_spill_gs)
+   union all
+   (select * from agg_sort_spill_gs except select * from agg_hash_spill_gs)) d;
+
+drop table agg_hash_spill, agg_hash_spill_gs, agg_sort_spill, agg_sort_spill_gs;
+drop function hashagg_spilled(text);
+
+reset enable_hashagg;
+reset enable_sort;
+reset work_mem;
@@ -0,0 +1,50 @@
+--
+-- Batch-at-a-time execution of simple aggregates
+--
+create table batch_tbl (i int4, j int8, f float8, t text);
+insert into batch_tbl
+  select g, g * 1000000000::int8, g / 4.0, 'x' || g
+  from generate_series(1, 3000) g;
+insert into batch_tbl values (null, null, null, null), (-5, -7, 'NaN', 'nan');
+analyze batch_tbl;
+
+set max_parallel_workers_per_gather = 0;
+set batch_execution = on;
+
+explain (costs off)
+select count(*), sum(i), max(f) from batch_tbl where i > 100 and 500::float8 > f;
+
+select count(*), count(i), count(t), sum(i), sum(f),
+       min(i), max(i), min(j), max(j), min(f), max(f)
+from batch_tbl;
+
+-- quals on batches, with constants on either side
+select count(*), sum(i), sum(f), min(f), max(f)
+from batch_tbl where i > 100 and 500::float8 > f and j <> 200000000000;
+
+-- NaN sorts above all other values
+select count(*), min(i) from batch_tbl where f > 1e9::float8;
+
+-- no qualifying rows
+select count(*), count(i), sum(i), min(j), max(f)
+from batch_tbl where i > 5000;
+
+-- quals that can't be evaluated on batches are evaluated row by row
+select count(*), sum(i) from batch_tbl where t like 'x1%' and i < 20;
+select x, (select count(*) from batch_tbl where i < x)
+from (values (10), (20)) v(x);
+
+-- sum(int8) is not supported, so the regular code is used
+explain (costs off)
+select sum(j) from batch_tbl;
+
+-- the same results without batches
+reset batch_execution;
+select count(*), count(i), count(t), sum(i), sum(f),
+       min(i), max(i), min(j), max(j), min(f), max(f)
+from batch_tbl;
+select count(*), sum(i), sum(f), min(f), max(f)
+from batch_tbl where i > 100 and 500::float8 > f and j <> 200000000000;
+
+reset max_parallel_workers_per_gather;
+drop table batch_tbl;
@@ -140,3 +140,42 @@ VACUUM delete_test_table;
 -- The vacuum above should've turned the leaf page into a fast root. We just
 -- need to insert some rows to cause the fast root page to split.
 INSERT INTO delete_test_table SELECT i, 1, 2, 3 FROM generate_series(1,1000) i;
+
+--
+-- Test deduplication of duplicates into posting list tuples
+--
+CREATE TABLE dedup_test (a int, b text, c int) WITH (autovacuum_enabled = off);
+-- Built before any data is loaded, so that deduplication happens during
+-- insertions (instead of during CREATE INDEX)
+CREATE INDEX dedup_test_b ON dedup_test (b);
+INSERT INTO dedup_test SELECT i % 10, 'value ' || (i % 10), i
+  FROM generate_series(1, 20000) i;
+CREATE INDEX dedup_test_a ON dedup_test (a);
+CREATE INDEX dedup_test_a_nodedup ON dedup_test (a)
+  WITH (deduplicate_items = off);
+SELECT pg_relation_size('dedup_test_a') * 2 <
+  pg_relation_size('dedup_test_a_nodedup') AS dedup_smaller;
+DROP INDEX dedup_test_a_nodedup;
+
+-- Storage parameter can be changed
+ALTER INDEX dedup_test_a SET (deduplicate_items = off);
+SELECT reloptions FROM pg_class WHERE oid = 'dedup_test_a'::regclass;
+ALTER INDEX dedup_test_a RESET (deduplicate_items);
+
+-- Remove some (though not all) of the heap TIDs from posting lists, and all
+-- of them from others
+DELETE FROM dedup_test WHERE a = 5;
+DELETE FROM dedup_test WHERE a = 6 AND c % 3 = 0;
+VACUUM dedup_test;
+-- New duplicates overlap with existing posting lists
+INSERT INTO dedup_test SELECT 6, 'value 6', i FROM generate_series(1, 5000) i;
+
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT a, count(*) FROM dedup_test WHERE a IN (4, 5, 6) GROUP BY a ORDER BY a;
+SELECT count(*) FROM dedup_test WHERE b = 'value 6';
+SELECT count(*) FROM (SELECT a FROM dedup_test WHERE a <= 7 ORDER BY a DESC) s;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+
+DROP TABLE dedup_test;
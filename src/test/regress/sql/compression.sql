@@ -0,0 +1,130 @@
+-- test TOAST compression methods
+CREATE TABLE cmdata (f1 text);
+ALTER TABLE cmdata ALTER COLUMN f1 SET (compression = lz4);
+INSERT INTO cmdata VALUES (repeat('1234567890', 1000));
+SELECT pg_column_compression(f1) FROM cmdata;
+
+-- values compressed with another method stay readable
+ALTER TABLE cmdata ALTER COLUMN f1 SET (compression = pglz);
+INSERT INTO cmdata VALUES (repeat('0987654321', 1000));
+SELECT pg_column_compression(f1), length(f1), substr(f1, 9991) FROM cmdata;
+
+-- the default applies to columns without the option
+CREATE TABLE cmdata1 (f1 text);
+SET default_toast_compression = 'lz4';
+INSERT INTO cmdata1 VALUES (repeat('1234567890', 1000));
+RESET default_toast_compression;
+INSERT INTO cmdata1 VALUES (repeat('0987654321', 1000));
+ALTER TABLE cmdata1 ALTER COLUMN f1 RESET (compression);
+SELECT pg_column_compression(f1), length(f1) FROM cmdata1;
+
+-- uncompressed and non-varlena values
+SELECT pg_column_compression('abc'::text), pg_column_compression(42);
+
+-- out-of-line compressed values, whole and sliced
+CREATE TABLE cmlarge (f1 text);
+ALTER TABLE cmlarge ALTER COLUMN f1 SET (compression = lz4);
+INSERT INTO cmlarge
+  SELECT string_agg(md5(g::text) || repeat('x', 32), '') FROM generate_series(1, 1000) g;
+ALTER TABLE cmlarge ALTER COLUMN f1 SET (compression = pglz);
+INSERT INTO cmlarge
+  SELECT string_agg(md5(g::text) || repeat('x', 32), '') FROM generate_series(1, 1000) g;
+SELECT pg_column_compression(f1), length(f1), md5(f1),
+       substr(f1, 32001, 40) FROM cmlarge;
+SELECT pg_column_size(f1) < 64000 AS compressed FROM cmlarge;
+
+-- values are not recompressed when copied between tables
+CREATE TABLE cmcopy AS SELECT f1 FROM cmlarge;
+SELECT pg_column_compression(f1) FROM cmcopy;
+
+-- compressed index entries use the default
+SET default_toast_compression = 'lz4';
+CREATE INDEX cmdata_idx ON cmdata (f1);
+RESET default_toast_compression;
+SET enable_seqscan = off;
+SELECT length(f1) FROM cmdata WHERE f1 = repeat('1234567890', 1000);
+RESET enable_seqscan;
+
+-- full-page images compressed with either method
+SET wal_compression = lz4;
+CHECKPOINT;
+UPDATE cmdata SET f1 = f1 || 'a';
+SET wal_compression = on;
+SHOW wal_compression;
+CHECKPOINT;
+UPDATE cmdata SET f1 = f1 || 'b';
+RESET wal_compression;
+SELECT length(f1), right(f1, 2) FROM cmdata;
+
+-- invalid settings
+ALTER TABLE cmdata ALTER COLUMN f1 SET (compression = zstd);
+SET default_toast_compression = 'zstd';
+SET wal_compression = 'zstd';
+
+DROP TABLE cmdata, cmdata1, cmlarge, cmcopy;
+
+-- temporary files
+SET temp_file_compression = lz4;
+SET work_mem = '64kB';
+SET enable_mergejoin = off;
+SET enable_nestloop = off;
+-- external sort, and a window function reading it back through a tuplestore
+SELECT count(*), sum(x), count(*) FILTER (WHERE p > s) AS out_of_order
+  FROM (SELECT g AS x, md5(g::text) AS s, lag(md5(g::text)) OVER (ORDER BY md5(g::text)) AS p
+          FROM generate_series(1, 20000) g) ss;
+-- multi-batch hash join
+SELECT count(*), sum(a.g) FROM generate_series(1, 20000) a(g)
+  JOIN generate_series(1, 20000) b(g) ON a.g = b.g;
+-- random access to a tuplestore
+BEGIN;
+DECLARE c SCROLL CURSOR FOR
+  SELECT g, md5(g::text) AS s FROM generate_series(1, 20000) g;
+MOVE LAST IN c;
+FETCH BACKWARD 2 FROM c;
+FETCH ABSOLUTE 5000 FROM c;
+FETCH 2 FROM c;
+COMMIT;
+-- shared temporary files: a parallel hash join, whose batch files are read
+-- back by other participants, and a parallel btree build, whose workers'
+-- sorted runs are appended together by the leader
+CREATE TABLE cmtemp AS
+  SELECT g AS id, md5(g::text) AS t FROM generate_series(1, 20000) g;
+ALTER TABLE cmtemp SET (parallel_workers = 2);
+ANALYZE cmtemp;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+SET enable_parallel_hash = on;
+SET work_mem = '192kB';
+EXPLAIN (COSTS OFF)
+  SELECT count(*) FROM cmtemp r JOIN cmtemp s USING (id);
+SELECT count(*), sum(r.id) FROM cmtemp r JOIN cmtemp s USING (id);
+SET max_parallel_maintenance_workers = 2;
+SET maintenance_work_mem = '96MB';
+CREATE INDEX cmtemp_t_idx ON cmtemp (t);
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+EXPLAIN (COSTS OFF)
+  SELECT id FROM cmtemp WHERE t = md5('4242');
+SELECT id FROM cmtemp WHERE t = md5('4242');
+SELECT count(*) FROM cmtemp WHERE t < '1';
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+RESET enable_parallel_hash;
+RESET max_parallel_maintenance_workers;
+RESET maintenance_work_mem;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+SET work_mem = '64kB';
+DROP TABLE cmtemp;
+SET temp_file_compression = pglz;
+SELECT count(*), sum(a.g) FROM generate_series(1, 20000) a(g)
+  JOIN generate_series(1, 20000) b(g) ON a.g = b.g;
+SET temp_file_compression = zstd;
+RESET temp_file_compression;
+RESET work_mem;
+RESET enable_mergejoin;
+RESET enable_nestloop;
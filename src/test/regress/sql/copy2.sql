@@ -440,6 +440,54 @@ test1
 SELECT * FROM instead_of_insert_tbl;
 COMMIT;
 
+-- Test parallel COPY FROM
+CREATE TABLE parallel_copy (a int PRIMARY KEY, b text, c int DEFAULT 7);
+COPY parallel_copy (a, b) FROM stdin WITH (PARALLEL 2);
+1	one
+2	two
+3	three
+\.
+COPY parallel_copy FROM stdin WITH (FORMAT csv, HEADER, PARALLEL 2) WHERE a > 4;
+a,b,c
+4,four,4
+5,"five
+and a half",5
+6,six,6
+\.
+SELECT * FROM parallel_copy ORDER BY a;
+-- errors in a worker report the right line
+COPY parallel_copy FROM stdin WITH (FORMAT csv, PARALLEL 2);
+7,seven,7
+8,"eight
+",8
+x,nine,9
+\.
+COPY parallel_copy TO stdout WITH (PARALLEL 2);
+COPY parallel_copy FROM stdin WITH (FORMAT binary, PARALLEL 2);
+COPY parallel_copy FROM stdin WITH (PARALLEL -1);
+
+-- runs of ordinary bytes that end exactly at a delimiter, escape, quote or
+-- newline, at and around multiples of the vector width
+CREATE TEMP TABLE copy_skip (id int, a text, b text);
+COPY copy_skip FROM stdin;
+1	xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx	b1
+2	xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\tyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyy	b2
+3	xxxxxxxxxxxxxxxx\\xxxxxxxxxxxxxxx	b3
+4	short	zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz
+5	xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\101	b5
+6	\N	zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz
+\.
+-- CSV with an escape character different from the quote character
+COPY copy_skip FROM stdin WITH (FORMAT csv, QUOTE '"', ESCAPE '!');
+7,"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx!"yyyyyyyyyyyyyyy",b7
+8,"xxxxxxxxxxxxxxxx!!yyyyyyyyyyyyyyyy!"",b8
+9,"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+yyyyyyyy",b9
+10,xxxxxxxxxxxxxxxxxxxx!xxxxxxxxxx,zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz
+11,"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx""yyyyyyyyyyyyyyyy",b11
+\.
+COPY copy_skip TO stdout;
+
 -- clean up
 DROP TABLE forcetest;
 DROP TABLE vistest;
@@ -454,3 +502,5 @@ DROP TABLE instead_of_insert_tbl;
 DROP VIEW instead_of_insert_tbl_view;
 DROP VIEW instead_of_insert_tbl_view_2;
 DROP FUNCTION fun_instead_of_insert_tbl();
+DROP TABLE parallel_copy;
+DROP TABLE copy_skip;
@@ -0,0 +1,40 @@
+--
+-- Incremental sort
+--
+create table incsort_t (a int, b int, c text);
+insert into incsort_t
+  select i / 100, (i * 7919) % 1000, 'x' || i from generate_series(1, 10000) i;
+create index incsort_t_a_idx on incsort_t (a);
+analyze incsort_t;
+
+-- The index provides the ordering by a, so only the groups need sorting
+explain (costs off)
+select a, b from incsort_t order by a, b limit 5;
+select a, b from incsort_t order by a, b limit 5;
+
+explain (costs off)
+select a, b from incsort_t order by a, b desc limit 5;
+select a, b from incsort_t order by a, b desc limit 5;
+
+-- Not used when disabled
+set enable_incremental_sort = off;
+explain (costs off)
+select a, b from incsort_t order by a, b limit 5;
+reset enable_incremental_sort;
+
+-- Check the whole output is in order, across many batches
+set enable_sort = off;
+explain (costs off)
+select a, b from incsort_t order by a, b;
+select count(*) as total, count(*) filter (where (pa, pb) > (a, b)) as out_of_order
+  from (select a, b, lag(a) over () as pa, lag(b) over () as pb
+          from (select a, b from incsort_t order by a, b offset 0) s) t;
+
+-- A single group larger than a batch
+update incsort_t set a = 0 where a < 50;
+select count(*) as total, count(*) filter (where (pa, pb) > (a, b)) as out_of_order
+  from (select a, b, lag(a) over () as pa, lag(b) over () as pb
+          from (select a, b from incsort_t order by a, b offset 0) s) t;
+reset enable_sort;
+
+drop table incsort_t;
@@ -467,6 +467,79 @@ $$
 $$);
 rollback to settings;
 
+-- A bloom filter over the hash table is pushed down into a sequential
+-- scan on the outer side, which throws away the rows that can't find a
+-- partner before they get to the join.
+create table bloom_outer as
+  select g as id, g % 1000 as k from generate_series(1, 20000) g;
+create table bloom_inner as
+  select g as k from generate_series(1, 10) g;
+analyze bloom_outer;
+analyze bloom_inner;
+create or replace function runtime_filter_removed(query text)
+returns bigint language plpgsql
+as
+$$
+declare
+  ln text;
+  removed bigint;
+begin
+  for ln in
+    execute 'explain (analyze, costs off, summary off, timing off) ' || query
+  loop
+    if ln ~ 'Rows Removed by Runtime Filter' then
+      removed := substring(ln from '\d+')::bigint;
+    end if;
+  end loop;
+  return removed;
+end;
+$$;
+-- non-parallel
+savepoint settings;
+set local max_parallel_workers_per_gather = 0;
+set local enable_nestloop = off;
+set local enable_mergejoin = off;
+explain (costs off)
+  select count(*) from bloom_outer o join bloom_inner i using (k);
+select count(*) from bloom_outer o join bloom_inner i using (k);
+select runtime_filter_removed(
+$$
+  select count(*) from bloom_outer o join bloom_inner i using (k);
+$$) > 19000 as filtered;
+select count(*) from bloom_outer o where k in (select k from bloom_inner);
+select count(*) from bloom_outer o right join bloom_inner i using (k);
+-- an anti join needs the rows without a partner, so there's no filter
+select count(*) from bloom_outer o
+  where not exists (select 1 from bloom_inner i where i.k = o.k);
+select runtime_filter_removed(
+$$
+  select count(*) from bloom_outer o
+    where not exists (select 1 from bloom_inner i where i.k = o.k);
+$$) is null as not_filtered;
+-- the filter is only checked after the scan's own quals, so the join key
+-- is never computed for rows they reject
+select count(*) from bloom_outer o join bloom_inner i on i.k = o.id / o.k
+  where o.k <> 0;
+select runtime_filter_removed(
+$$
+  select count(*) from bloom_outer o join bloom_inner i on i.k = o.id / o.k
+    where o.k <> 0;
+$$) > 10000 as filtered;
+set local enable_hashjoin_bloom_filter = off;
+select runtime_filter_removed(
+$$
+  select count(*) from bloom_outer o join bloom_inner i using (k);
+$$) is null as not_filtered;
+rollback to settings;
+-- parallel with parallel-aware hash join
+savepoint settings;
+set local max_parallel_workers_per_gather = 2;
+set local enable_parallel_hash = on;
+set local enable_nestloop = off;
+set local enable_mergejoin = off;
+select count(*) from bloom_outer o join bloom_inner i using (k);
+rollback to settings;
+
 rollback;
 
 
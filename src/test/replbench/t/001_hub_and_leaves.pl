@@ -0,0 +1,360 @@
+# Replication throughput benchmark for the hub-and-leaves topology
+#
+# See src/test/replbench/README for the topology, the knobs and what is
+# reported.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More;
+use IPC::Run;
+use POSIX ();
+use Time::HiRes qw(time usleep);
+
+my $nleaves = $ENV{REPLBENCH_LEAVES} || 3;
+my $duration = $ENV{REPLBENCH_DURATION} || 30;
+my $clients = $ENV{REPLBENCH_CLIENTS} || 4;
+my $batch = $ENV{REPLBENCH_BATCH_ROWS} || 1;
+my $payload = $ENV{REPLBENCH_PAYLOAD} || 100;
+my $mode = $ENV{REPLBENCH_MODE} || 'live';
+my $pipeline = $ENV{REPLBENCH_PIPELINE} ? 'on' : 'off';
+
+die "REPLBENCH_MODE must be \"live\" or \"catchup\""
+  unless $mode eq 'live' || $mode eq 'catchup';
+
+plan tests => $nleaves + 1;
+
+# origin ids used by the hub for the changes coming from each leaf
+my $origin_base = 100;
+
+my $clk_tck = POSIX::sysconf(POSIX::_SC_CLK_TCK());
+
+# Set up the nodes.  Node 0 is the hub, nodes 1 .. N are the leaves.
+my @nodes;
+for my $k (0 .. $nleaves)
+{
+	my $node = get_new_node($k == 0 ? 'hub' : "leaf_$k");
+	$node->init(allows_streaming => 'logical');
+	$node->append_conf(
+		'postgresql.conf', qq(
+max_wal_senders = @{[ $nleaves + 10 ]}
+max_replication_slots = @{[ $nleaves + 10 ]}
+max_worker_processes = @{[ 2 * $nleaves + 10 ]}
+max_logical_replication_workers = @{[ $nleaves + 4 ]}
+logical_decoding_pipeline = $pipeline
+synchronous_commit = off
+wal_receiver_status_interval = 1s
+));
+	$node->start;
+
+	my $start = $k * 1000000000000 + 1;
+	$node->safe_psql(
+		'postgres', qq(
+CREATE SEQUENCE bench_orders_id_seq START WITH $start;
+CREATE TABLE bench_orders (
+	id bigint PRIMARY KEY DEFAULT nextval('bench_orders_id_seq'),
+	region int NOT NULL,
+	origin_node int NOT NULL DEFAULT $k,
+	payload text,
+	created_at timestamptz NOT NULL DEFAULT clock_timestamp(),
+	arrived_at timestamptz);
+CREATE FUNCTION bench_arrival() RETURNS trigger LANGUAGE plpgsql AS
+\$\$ BEGIN NEW.arrived_at := clock_timestamp(); RETURN NEW; END \$\$;
+CREATE TRIGGER bench_arrival BEFORE INSERT ON bench_orders
+	FOR EACH ROW EXECUTE FUNCTION bench_arrival();
+ALTER TABLE bench_orders ENABLE ALWAYS TRIGGER bench_arrival;
+));
+	push @nodes, $node;
+}
+my $hub = $nodes[0];
+
+# The hub publishes each leaf's region to that leaf, and every leaf
+# publishes its own changes back to the hub.  The leaves filter out the
+# origin the hub uses for their changes, so nothing loops back.
+for my $i (1 .. $nleaves)
+{
+	my $leaf = $nodes[$i];
+	my $origin = $origin_base + $i;
+
+	$hub->safe_psql('postgres',
+		"CREATE PUBLICATION pub_leaf_$i FOR TABLE bench_orders WHERE (region = $i)"
+	);
+	$leaf->safe_psql('postgres',
+		"CREATE PUBLICATION pub_hub FOR TABLE bench_orders");
+
+	my $leaf_connstr = $leaf->connstr . ' dbname=postgres';
+	my $hub_connstr = $hub->connstr . ' dbname=postgres';
+	$hub->safe_psql('postgres',
+		"CREATE SUBSCRIPTION sub_leaf_$i CONNECTION '$leaf_connstr application_name=hub_from_leaf_$i' PUBLICATION pub_hub WITH (copy_data = false, replication_origin_id = $origin)"
+	);
+	$leaf->safe_psql('postgres',
+		"CREATE SUBSCRIPTION sub_hub_$i CONNECTION '$hub_connstr application_name=leaf_$i' PUBLICATION pub_leaf_$i WITH (copy_data = false, filter_origins = '$origin')"
+	);
+}
+
+# Every stream, as (publisher, subscriber, application_name).
+my @streams;
+for my $i (1 .. $nleaves)
+{
+	push @streams, [ 0, $i, "leaf_$i" ];
+	push @streams, [ $i, 0, "hub_from_leaf_$i" ];
+}
+
+foreach my $s (@streams)
+{
+	$nodes[ $s->[0] ]->wait_for_catchup($s->[2]);
+}
+
+# In catchup mode, the subscriptions are disabled while the load runs and
+# the time taken to catch up afterwards is measured.
+if ($mode eq 'catchup')
+{
+	set_subscriptions_enabled(0);
+}
+
+# Load scripts.  The hub writes to all regions, including region 0 which
+# no leaf subscribes to; each leaf writes to its own region.
+my $script_dir = TestLib::tempdir;
+for my $k (0 .. $nleaves)
+{
+	my $region = $k == 0 ? "random(0, $nleaves)" : $k;
+	my $rows = "generate_series(1, $batch)";
+
+	append_to_file(
+		"$script_dir/load_$k.sql", qq(\\set region $region
+WITH ins AS (INSERT INTO bench_orders (region, payload) SELECT :region, repeat('x', $payload) FROM $rows RETURNING id) SELECT max(id) AS id FROM ins \\gset
+UPDATE bench_orders SET payload = repeat('y', $payload) WHERE id = :id;
+));
+}
+
+my @start_lsn = map { $_->lsn('insert') } @nodes;
+my %cpu_start = sender_cpu_ticks();
+
+my @pgbench;
+for my $k (0 .. $nleaves)
+{
+	my @cmd = (
+		'pgbench', '-n', '-T', $duration, '-c', $clients, '-j', $clients,
+		'-f', "$script_dir/load_$k.sql", '-h', $nodes[$k]->host,
+		'-p', $nodes[$k]->port, 'postgres');
+	my ($stdout, $stderr) = ('', '');
+	push @pgbench,
+	  {
+		h => IPC::Run::start(\@cmd, '>', \$stdout, '2>', \$stderr),
+		stdout => \$stdout,
+		stderr => \$stderr
+	  };
+}
+
+my $load_start = time;
+
+# Sample spill files while the load runs.
+my %spill_peak;
+while (time < $load_start + $duration)
+{
+	sample_spill();
+	usleep(200_000);
+}
+my @tps;
+foreach my $p (@pgbench)
+{
+	$p->{h}->finish or die "pgbench failed: ${ $p->{stderr} }";
+	push @tps, (${ $p->{stdout} } =~ /tps = ([\d.]+) \(excluding/)[0];
+}
+
+my @end_lsn = map { $_->lsn('insert') } @nodes;
+my $catchup_start = time;
+
+if ($mode eq 'catchup')
+{
+	set_subscriptions_enabled(1);
+}
+
+# Wait for every walsender to get through the WAL generated during the
+# load, and then for every subscriber to apply and flush it.
+my %decoded_at;
+my %applied_at;
+while (keys %applied_at < @streams)
+{
+	sample_spill();
+	foreach my $s (@streams)
+	{
+		my ($pub, $sub, $appname) = @$s;
+		next if $applied_at{$appname};
+
+		my $res = $nodes[$pub]->safe_psql('postgres',
+			"SELECT sent_lsn >= '$end_lsn[$pub]', replay_lsn >= '$end_lsn[$pub]' FROM pg_stat_replication WHERE application_name = '$appname'"
+		);
+		my ($decoded, $applied) = split /\|/, $res;
+		$decoded_at{$appname} ||= time if defined $decoded && $decoded eq 't';
+		$applied_at{$appname} = time if defined $applied && $applied eq 't';
+	}
+	die "timed out waiting for replication to catch up"
+	  if time - $catchup_start > 30 * $duration + 180;
+	usleep(100_000);
+}
+my %cpu_end = sender_cpu_ticks();
+
+# Everything written to a region must have arrived at the leaf owning it.
+for my $i (1 .. $nleaves)
+{
+	my $expected = $hub->safe_psql('postgres',
+		"SELECT count(*), sum(hashtext(payload)) FROM bench_orders WHERE region = $i"
+	);
+	my $got = $nodes[$i]->safe_psql('postgres',
+		"SELECT count(*), sum(hashtext(payload)) FROM bench_orders");
+	is($got, $expected, "leaf_$i converged with the hub");
+}
+my $expected = 0;
+for my $k (0 .. $nleaves)
+{
+	$expected += $nodes[$k]->safe_psql('postgres',
+		"SELECT count(*) FROM bench_orders WHERE origin_node = $k");
+}
+is( $hub->safe_psql('postgres', "SELECT count(*) FROM bench_orders"),
+	$expected, 'hub has all rows');
+
+# Report.
+my $base = $mode eq 'catchup' ? $catchup_start : $load_start;
+my @report;
+push @report,
+  sprintf(
+	"replbench: %d leaves, %d clients per node, %d s, batch %d, payload %d, mode %s, pipeline %s",
+	$nleaves, $clients, $duration, $batch, $payload, $mode, $pipeline);
+push @report, sprintf("load tps: hub %.0f, leaves %s",
+	$tps[0], join(' ', map { sprintf('%.0f', $_) } @tps[ 1 .. $#tps ]));
+push @report,
+  sprintf("%-18s %12s %12s %12s %10s %10s %10s %10s %12s",
+	'stream', 'wal MB', 'decode MB/s', 'apply rows/s', 'lag p50', 'lag p90',
+	'lag p99', 'cpu s', 'spill MB');
+
+foreach my $s (@streams)
+{
+	my ($pub, $sub, $appname) = @$s;
+	my $wal_bytes = $hub->safe_psql('postgres',
+		"SELECT '$end_lsn[$pub]'::pg_lsn - '$start_lsn[$pub]'::pg_lsn");
+	my $decode_secs = ($decoded_at{$appname} || $applied_at{$appname}) - $base;
+	my $apply_secs = $applied_at{$appname} - $base;
+
+	my ($rows, $p50, $p90, $p99) = split /\|/,
+	  $nodes[$sub]->safe_psql(
+		'postgres', qq(
+SELECT n, p[1], p[2], p[3] FROM
+  (SELECT count(*) AS n,
+		  percentile_cont(ARRAY[0.5, 0.9, 0.99]) WITHIN GROUP
+			(ORDER BY extract(epoch FROM arrived_at - created_at)) AS p
+   FROM bench_orders WHERE origin_node = $pub) s));
+
+	my $slot = slot_name($pub, $sub);
+	my $cpu = ($cpu_end{$appname} || 0) - ($cpu_start{$appname} || 0);
+
+	push @report,
+	  sprintf(
+		"%-18s %12.1f %12.1f %12.0f %10s %10s %10s %10.2f %12.1f",
+		$appname,
+		$wal_bytes / 1048576,
+		$wal_bytes / 1048576 / ($decode_secs > 0 ? $decode_secs : 1),
+		$rows / ($apply_secs > 0 ? $apply_secs : 1),
+		$mode eq 'live' ? format_secs($p50) : '-',
+		$mode eq 'live' ? format_secs($p90) : '-',
+		$mode eq 'live' ? format_secs($p99) : '-',
+		$cpu / $clk_tck,
+		($spill_peak{"$pub/$slot"} || 0) / 1048576);
+}
+push @report,
+  'lag is per row, from insert on the origin to insert on the subscriber;';
+push @report,
+  'cpu is walsender plus decoding worker time; spill is the sampled peak on disk.';
+
+diag($_) foreach @report;
+append_to_file("$TestLib::log_path/replbench_results.txt",
+	join("\n", @report) . "\n");
+
+$_->stop('fast') foreach @nodes;
+
+# Enable or disable all subscriptions, and wait for the walsenders to
+# follow.
+sub set_subscriptions_enabled
+{
+	my ($enable) = @_;
+	my $action = $enable ? 'ENABLE' : 'DISABLE';
+
+	for my $i (1 .. $nleaves)
+	{
+		$hub->safe_psql('postgres', "ALTER SUBSCRIPTION sub_leaf_$i $action");
+		$nodes[$i]->safe_psql('postgres', "ALTER SUBSCRIPTION sub_hub_$i $action");
+	}
+	for my $k (0 .. $nleaves)
+	{
+		$nodes[$k]->poll_query_until('postgres',
+			$enable
+			? "SELECT bool_and(active) FROM pg_replication_slots"
+			: "SELECT NOT bool_or(active) FROM pg_replication_slots")
+		  or die "timed out waiting for slots to become "
+		  . ($enable ? 'active' : 'inactive');
+	}
+	return;
+}
+
+# CPU time used so far by the process(es) serving each stream, in clock
+# ticks.  With logical_decoding_pipeline, that's the walsender and its
+# decoding worker, which holds the slot.  Only works where /proc exists.
+sub sender_cpu_ticks
+{
+	my %ticks;
+
+	foreach my $s (@streams)
+	{
+		my ($pub, $sub, $appname) = @$s;
+		my $pids = $nodes[$pub]->safe_psql('postgres',
+			"SELECT r.pid, s.active_pid FROM pg_stat_replication r, pg_replication_slots s WHERE r.application_name = '$appname' AND s.slot_name = '"
+			  . slot_name($pub, $sub) . "'");
+		my %seen;
+		foreach my $pid (grep { $_ ne '' && !$seen{$_}++ } split /\|/, $pids)
+		{
+			next unless -r "/proc/$pid/stat";
+			my $stat = slurp_file("/proc/$pid/stat");
+			my @f = split / /, ($stat =~ /\) (.*)/)[0];
+			$ticks{$appname} += $f[11] + $f[12];
+		}
+	}
+	return %ticks;
+}
+
+# Record the peak size of the spill files of each slot.
+sub sample_spill
+{
+	for my $k (0 .. $nleaves)
+	{
+		my $dir = $nodes[$k]->data_dir . '/pg_replslot';
+		opendir(my $dh, $dir) or next;
+		foreach my $slot (grep { !/^\./ } readdir $dh)
+		{
+			my $bytes = 0;
+			opendir(my $sdh, "$dir/$slot") or next;
+			foreach my $f (grep { /\.spill$/ } readdir $sdh)
+			{
+				$bytes += (-s "$dir/$slot/$f") || 0;
+			}
+			closedir $sdh;
+			$spill_peak{"$k/$slot"} = $bytes
+			  if $bytes > ($spill_peak{"$k/$slot"} || 0);
+		}
+		closedir $dh;
+	}
+	return;
+}
+
+# Name of the slot used by a stream, on the publisher.
+sub slot_name
+{
+	my ($pub, $sub) = @_;
+	return $sub == 0 ? "sub_leaf_$pub" : "sub_hub_$sub";
+}
+
+sub format_secs
+{
+	my ($secs) = @_;
+	return '-' unless defined $secs && $secs ne '';
+	return sprintf('%.1fms', $secs * 1000);
+}
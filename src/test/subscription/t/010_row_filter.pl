@@ -3,7 +3,7 @@ use strict;
 use warnings;
 use PostgresNode;
 use TestLib;
-use Test::More tests => 4;
+use Test::More tests => 6;
 
 # create publisher node
 my $node_publisher = get_new_node('publisher');
@@ -93,5 +93,30 @@ $result =
   $node_subscriber->safe_psql('postgres', "SELECT count(a) FROM tab_rowfilter_3");
 is($result, qq(10), 'check filtered data was copied to subscriber');
 
+# changes to publications not requested by the subscriber must not make the
+# walsender rebuild its cached publication info
+$node_publisher->safe_psql('postgres',
+	"CREATE PUBLICATION tap_pub_other FOR TABLE tab_rowfilter_1");
+$node_publisher->safe_psql('postgres',
+	"ALTER PUBLICATION tap_pub_other ADD TABLE tab_rowfilter_3");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_rowfilter_1 (a, b) VALUES (2000, 'after other')");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_publisher->safe_psql('postgres', "SELECT pubrel_rebuilds, pub_reloads FROM pg_stat_replication WHERE application_name = '$appname'");
+is($result, qq(0|0), 'check unrelated publication changes are ignored');
+
+# adding a table to a requested publication only rebuilds that table
+$node_publisher->safe_psql('postgres',
+	"ALTER PUBLICATION tap_pub_2 ADD TABLE tab_rowfilter_3");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_rowfilter_3 (a, b) VALUES (11, true)");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_publisher->safe_psql('postgres', "SELECT pubrel_rebuilds, pub_reloads FROM pg_stat_replication WHERE application_name = '$appname'");
+is($result, qq(1|0), 'check only the affected table was rebuilt');
+
 $node_subscriber->stop('fast');
 $node_publisher->stop('fast');
@@ -0,0 +1,152 @@
+# Test apply conflict resolution
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 10;
+
+# create publisher node
+my $node_publisher = get_new_node('publisher');
+$node_publisher->init(allows_streaming => 'logical');
+$node_publisher->start;
+
+# create subscriber node
+my $node_subscriber = get_new_node('subscriber');
+$node_subscriber->init(allows_streaming => 'logical');
+$node_subscriber->append_conf('postgresql.conf',
+	"track_commit_timestamp = on");
+$node_subscriber->start;
+
+# setup structure on both nodes
+$node_publisher->safe_psql('postgres',
+	"CREATE TABLE tab_conflict (a int primary key, b text)");
+$node_subscriber->safe_psql('postgres',
+	"CREATE TABLE tab_conflict (a int primary key, b text)");
+$node_subscriber->safe_psql('postgres',
+	"CREATE TABLE conflict_log (subname text, relname text, conflict_type text, resolution text, remote_tuple text, logged_at timestamptz DEFAULT now())");
+
+# setup logical replication
+my $publisher_connstr = $node_publisher->connstr . ' dbname=postgres';
+my $appname = 'tap_sub';
+$node_publisher->safe_psql('postgres',
+	"CREATE PUBLICATION tap_pub FOR TABLE tab_conflict");
+
+my $result = $node_subscriber->psql('postgres',
+	"CREATE SUBSCRIPTION tap_sub_bad CONNECTION '$publisher_connstr' PUBLICATION tap_pub WITH (connect = false, conflict_resolution = log)");
+is($result, 3, "conflict_resolution = log requires conflict_table");
+
+$node_subscriber->safe_psql('postgres',
+	"CREATE SUBSCRIPTION tap_sub CONNECTION '$publisher_connstr application_name=$appname' PUBLICATION tap_pub WITH (copy_data = false, conflict_resolution = skip)");
+
+$node_publisher->wait_for_catchup($appname);
+
+# conflicting insert is skipped and replication goes on
+$node_subscriber->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (1, 'local')");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (1, 'remote'), (2, 'remote')");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT a, b FROM tab_conflict ORDER BY a");
+is($result, qq(1|local
+2|remote), 'check conflicting insert was skipped');
+
+# missing rows are counted as conflicts
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (3, 'remote')");
+$node_publisher->wait_for_catchup($appname);
+$node_subscriber->safe_psql('postgres',
+	"DELETE FROM tab_conflict WHERE a = 3");
+$node_publisher->safe_psql('postgres',
+	"UPDATE tab_conflict SET b = 'remote updated' WHERE a = 3");
+$node_publisher->safe_psql('postgres',
+	"DELETE FROM tab_conflict WHERE a = 3");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT insert_conflicts, update_conflicts, delete_conflicts FROM pg_stat_subscription WHERE subname = 'tap_sub'");
+is($result, qq(1|1|1), 'check conflicts are counted');
+
+# last update wins: the remote row is newer, so it replaces the local one
+$node_subscriber->safe_psql('postgres',
+	"ALTER SUBSCRIPTION tap_sub SET (conflict_resolution = last_update_wins)");
+$node_subscriber->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (4, 'local')");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (4, 'remote')");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT b FROM tab_conflict WHERE a = 4");
+is($result, qq(remote), 'check newer remote insert replaced the local row');
+
+# ... but a local row committed after the remote transaction is kept
+$node_subscriber->safe_psql('postgres', "ALTER SUBSCRIPTION tap_sub DISABLE");
+$node_publisher->safe_psql('postgres',
+	"UPDATE tab_conflict SET b = 'remote older' WHERE a = 4");
+$node_publisher->safe_psql('postgres',
+	"UPDATE tab_conflict SET b = 'remote newer' WHERE a = 2");
+$node_subscriber->safe_psql('postgres',
+	"UPDATE tab_conflict SET b = 'local newer' WHERE a = 4");
+$node_subscriber->safe_psql('postgres', "ALTER SUBSCRIPTION tap_sub ENABLE");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT a, b FROM tab_conflict WHERE a IN (2, 4) ORDER BY a");
+is($result, qq(2|remote newer
+4|local newer), 'check last update wins');
+
+# on a timestamp tie, the greater version of the row wins, whichever side it
+# comes from, so that both nodes keep the same one.  Replication origin
+# timestamps let both sides commit with the same timestamp.
+my $tie_sql = q{
+SELECT pg_replication_origin_create('tie');
+SELECT pg_replication_origin_session_setup('tie');
+BEGIN;
+SELECT pg_replication_origin_xact_setup('0/1', '2020-01-01 00:00:00+00');
+INSERT INTO tab_conflict VALUES (6, '%s'), (7, '%s');
+COMMIT;
+SELECT pg_replication_origin_session_reset();
+};
+$node_subscriber->safe_psql('postgres', sprintf($tie_sql, 'tie b', 'tie a'));
+$node_publisher->safe_psql('postgres', sprintf($tie_sql, 'tie a', 'tie b'));
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT a, b FROM tab_conflict WHERE a IN (6, 7) ORDER BY a");
+is($result, qq(6|tie b
+7|tie b), 'check timestamp ties are broken deterministically');
+
+# log the conflicts into a table
+$node_subscriber->safe_psql('postgres',
+	"ALTER SUBSCRIPTION tap_sub SET (conflict_resolution = log, conflict_table = 'conflict_log')");
+$node_subscriber->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (5, 'local')");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_conflict VALUES (5, 'remote')");
+$node_publisher->wait_for_catchup($appname);
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT subname, relname, conflict_type, resolution, remote_tuple, logged_at IS NOT NULL FROM conflict_log");
+is($result, qq(tap_sub|public.tab_conflict|insert_exists|skip|(5,remote)|t), 'check conflict was logged');
+
+$result =
+  $node_subscriber->safe_psql('postgres', "SELECT b FROM tab_conflict WHERE a = 5");
+is($result, qq(local), 'check logged conflict was skipped');
+
+# the subscription depends on its conflict table
+my ($ret, $stdout, $stderr) = $node_subscriber->psql('postgres',
+	"DROP TABLE conflict_log");
+like($stderr, qr/subscription tap_sub depends on table conflict_log/,
+	'conflict table cannot be dropped while in use');
+
+$node_subscriber->safe_psql('postgres',
+	"ALTER SUBSCRIPTION tap_sub SET (conflict_resolution = skip, conflict_table = NONE)");
+$node_subscriber->safe_psql('postgres', "DROP TABLE conflict_log");
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM pg_depend WHERE classid = 'pg_subscription'::regclass");
+is($result, qq(0), 'conflict table dependency removed with conflict_table = NONE');
+
+$node_subscriber->stop('fast');
+$node_publisher->stop('fast');
@@ -0,0 +1,94 @@
+# Test logical replication with decoding done in a background worker
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 6;
+
+# create publisher node
+my $node_publisher = get_new_node('publisher');
+$node_publisher->init(allows_streaming => 'logical');
+$node_publisher->append_conf('postgresql.conf',
+	"logical_decoding_pipeline = on");
+$node_publisher->start;
+
+# create subscriber node
+my $node_subscriber = get_new_node('subscriber');
+$node_subscriber->init(allows_streaming => 'logical');
+$node_subscriber->start;
+
+# setup structure on both nodes
+$node_publisher->safe_psql('postgres',
+	"CREATE TABLE tab_pipe (a int primary key, b text)");
+$node_subscriber->safe_psql('postgres',
+	"CREATE TABLE tab_pipe (a int primary key, b text)");
+
+# setup logical replication
+my $publisher_connstr = $node_publisher->connstr . ' dbname=postgres';
+my $appname = 'tap_sub';
+$node_publisher->safe_psql('postgres',
+	"CREATE PUBLICATION tap_pub FOR TABLE tab_pipe");
+$node_subscriber->safe_psql('postgres',
+	"CREATE SUBSCRIPTION tap_sub CONNECTION '$publisher_connstr application_name=$appname' PUBLICATION tap_pub");
+
+$node_publisher->wait_for_catchup($appname);
+
+# the slot is held by the decoding worker, not by the walsender
+my $result = $node_publisher->safe_psql('postgres',
+	"SELECT a.backend_type FROM pg_replication_slots s JOIN pg_stat_activity a ON a.pid = s.active_pid WHERE s.slot_name = 'tap_sub'");
+is($result, qq(logical decoding worker), 'check slot is used by decoding worker');
+
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_pipe SELECT g, 'row ' || g FROM generate_series(1, 1000) g");
+$node_publisher->safe_psql('postgres',
+	"UPDATE tab_pipe SET b = 'updated' WHERE a % 10 = 0");
+$node_publisher->safe_psql('postgres',
+	"DELETE FROM tab_pipe WHERE a > 900");
+my $lsn = $node_publisher->lsn('insert');
+$node_publisher->wait_for_catchup($appname);
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*), count(*) FILTER (WHERE b = 'updated'), max(a) FROM tab_pipe");
+is($result, qq(900|90|900), 'check changes were replicated');
+
+# the slot is advanced by the worker once the subscriber confirms the flush
+$node_publisher->poll_query_until('postgres',
+	"SELECT confirmed_flush_lsn >= '$lsn' FROM pg_replication_slots WHERE slot_name = 'tap_sub'"
+) or die "Timed out while waiting for the slot to advance";
+pass('slot advanced');
+
+# after a reconnect, streaming resumes where the subscriber left off
+$node_subscriber->safe_psql('postgres', "ALTER SUBSCRIPTION tap_sub DISABLE");
+$node_publisher->poll_query_until('postgres',
+	"SELECT NOT active FROM pg_replication_slots WHERE slot_name = 'tap_sub'"
+) or die "Timed out while waiting for the slot to be released";
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_pipe VALUES (1001, 'after reconnect')");
+$node_subscriber->safe_psql('postgres', "ALTER SUBSCRIPTION tap_sub ENABLE");
+$node_publisher->wait_for_catchup($appname);
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM tab_pipe");
+is($result, qq(901), 'check replication resumed after reconnect');
+
+# the postmaster terminates the decoding worker at shutdown before the
+# walsender is asked to stop, which mustn't be reported to the subscriber
+# as an error
+my $log_offset = -s $node_subscriber->logfile;
+$node_publisher->restart;
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab_pipe VALUES (1002, 'after restart')");
+$node_publisher->wait_for_catchup($appname);
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM tab_pipe");
+is($result, qq(902), 'check replication resumed after publisher restart');
+
+my $log = substr(slurp_file($node_subscriber->logfile), $log_offset);
+unlike(
+	$log,
+	qr/terminating background worker|logical decoding worker/,
+	'no error sent to subscriber at publisher shutdown');
+
+$node_subscriber->stop('fast');
+$node_publisher->stop('fast');